@@ -7,42 +7,168 @@
 #include <cassert>
 #include <string>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
 //
-// Provides the same functionality as ffsl.  Needed as ffsl is not supported
-// on all platforms. Note that the positions are numbered 1 through 64, with
-// a return value of 0 indicating that there are no set bits.
+// Return the position of the lowest set bit. Positions are numbered 1
+// through 64, with a return value of 0 indicating that there are no set
+// bits.
 //
-static int find_first_set64(uint64_t value) {
-    int bit;
-
-    int lower = value;
-    if ((bit = ffs(lower)) > 0)
-        return bit;
-
-    int upper = value >> 32;
-    if ((bit = ffs(upper)) > 0)
-        return 32 + bit;
-
-    return 0;
+static inline int find_first_set64(uint64_t value) {
+    if (value == 0)
+        return 0;
+    return __builtin_ctzll(value) + 1;
 }
 
-static int find_first_clear64(uint64_t value) {
+static inline int find_first_clear64(uint64_t value) {
     return find_first_set64(~value);
 }
 
 //
-// Return the number of set bits. K&R method.
+// Return the number of set bits.
+//
+static inline int num_bits_set(uint64_t value) {
+    return __builtin_popcountll(value);
+}
+
+//
+// Kernels for the bulk operations on blocks.  The SIMD versions process 2
+// (SSE2) or 4 (AVX2) blocks per iteration and leave the remaining blocks
+// to the scalar loop.
 //
-static int num_bits_set(uint64_t value) {
-    int count = 0;
-    while (value != 0) {
-        value &= value - 1;
-        count++;
+static inline void and_blocks(uint64_t *dst, const uint64_t *lhs,
+                              const uint64_t *rhs, size_t count) {
+    size_t idx = 0;
+#if defined(__AVX2__)
+    for (; idx + 4 <= count; idx += 4) {
+        __m256i result = _mm256_and_si256(
+            _mm256_loadu_si256((const __m256i *) (lhs + idx)),
+            _mm256_loadu_si256((const __m256i *) (rhs + idx)));
+        _mm256_storeu_si256((__m256i *) (dst + idx), result);
     }
-    return count;
+#elif defined(__SSE2__)
+    for (; idx + 2 <= count; idx += 2) {
+        __m128i result = _mm_and_si128(
+            _mm_loadu_si128((const __m128i *) (lhs + idx)),
+            _mm_loadu_si128((const __m128i *) (rhs + idx)));
+        _mm_storeu_si128((__m128i *) (dst + idx), result);
+    }
+#endif
+    for (; idx < count; idx++) {
+        dst[idx] = lhs[idx] & rhs[idx];
+    }
+}
+
+static inline void or_blocks(uint64_t *dst, const uint64_t *lhs,
+                             const uint64_t *rhs, size_t count) {
+    size_t idx = 0;
+#if defined(__AVX2__)
+    for (; idx + 4 <= count; idx += 4) {
+        __m256i result = _mm256_or_si256(
+            _mm256_loadu_si256((const __m256i *) (lhs + idx)),
+            _mm256_loadu_si256((const __m256i *) (rhs + idx)));
+        _mm256_storeu_si256((__m256i *) (dst + idx), result);
+    }
+#elif defined(__SSE2__)
+    for (; idx + 2 <= count; idx += 2) {
+        __m128i result = _mm_or_si128(
+            _mm_loadu_si128((const __m128i *) (lhs + idx)),
+            _mm_loadu_si128((const __m128i *) (rhs + idx)));
+        _mm_storeu_si128((__m128i *) (dst + idx), result);
+    }
+#endif
+    for (; idx < count; idx++) {
+        dst[idx] = lhs[idx] | rhs[idx];
+    }
+}
+
+// dst = lhs & ~rhs
+static inline void andnot_blocks(uint64_t *dst, const uint64_t *lhs,
+                                 const uint64_t *rhs, size_t count) {
+    size_t idx = 0;
+#if defined(__AVX2__)
+    for (; idx + 4 <= count; idx += 4) {
+        __m256i result = _mm256_andnot_si256(
+            _mm256_loadu_si256((const __m256i *) (rhs + idx)),
+            _mm256_loadu_si256((const __m256i *) (lhs + idx)));
+        _mm256_storeu_si256((__m256i *) (dst + idx), result);
+    }
+#elif defined(__SSE2__)
+    for (; idx + 2 <= count; idx += 2) {
+        __m128i result = _mm_andnot_si128(
+            _mm_loadu_si128((const __m128i *) (rhs + idx)),
+            _mm_loadu_si128((const __m128i *) (lhs + idx)));
+        _mm_storeu_si128((__m128i *) (dst + idx), result);
+    }
+#endif
+    for (; idx < count; idx++) {
+        dst[idx] = lhs[idx] & ~rhs[idx];
+    }
+}
+
+#if defined(__SSE2__) && !defined(__AVX2__)
+static inline bool is_zero128(__m128i value) {
+    return _mm_movemask_epi8(
+        _mm_cmpeq_epi8(value, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+// Return (lhs & rhs) != 0
+static inline bool any_and_blocks(const uint64_t *lhs, const uint64_t *rhs,
+                                  size_t count) {
+    size_t idx = 0;
+#if defined(__AVX2__)
+    for (; idx + 4 <= count; idx += 4) {
+        if (!_mm256_testz_si256(
+            _mm256_loadu_si256((const __m256i *) (lhs + idx)),
+            _mm256_loadu_si256((const __m256i *) (rhs + idx))))
+            return true;
+    }
+#elif defined(__SSE2__)
+    for (; idx + 2 <= count; idx += 2) {
+        if (!is_zero128(_mm_and_si128(
+            _mm_loadu_si128((const __m128i *) (lhs + idx)),
+            _mm_loadu_si128((const __m128i *) (rhs + idx)))))
+            return true;
+    }
+#endif
+    for (; idx < count; idx++) {
+        if (lhs[idx] & rhs[idx])
+            return true;
+    }
+    return false;
+}
+
+// Return (lhs & ~rhs) != 0
+static inline bool any_andnot_blocks(const uint64_t *lhs, const uint64_t *rhs,
+                                     size_t count) {
+    size_t idx = 0;
+#if defined(__AVX2__)
+    for (; idx + 4 <= count; idx += 4) {
+        if (!_mm256_testc_si256(
+            _mm256_loadu_si256((const __m256i *) (rhs + idx)),
+            _mm256_loadu_si256((const __m256i *) (lhs + idx))))
+            return true;
+    }
+#elif defined(__SSE2__)
+    for (; idx + 2 <= count; idx += 2) {
+        if (!is_zero128(_mm_andnot_si128(
+            _mm_loadu_si128((const __m128i *) (rhs + idx)),
+            _mm_loadu_si128((const __m128i *) (lhs + idx)))))
+            return true;
+    }
+#endif
+    for (; idx < count; idx++) {
+        if (lhs[idx] & ~rhs[idx])
+            return true;
+    }
+    return false;
 }
 
 // Position pos is w.r.t the entire bitset, starts at 0.
@@ -61,6 +187,52 @@ static inline size_t bit_position(size_t idx, size_t offset) {
 }
 
 const size_t BitSet::npos;
+const size_t BitSet::Blocks::kInlineBlocks;
+
+BitSet::Blocks::Blocks(const Blocks &rhs)
+    : data_(inline_), size_(0), capacity_(kInlineBlocks) {
+    reserve(rhs.size_);
+    memcpy(data_, rhs.data_, rhs.size_ * sizeof(uint64_t));
+    size_ = rhs.size_;
+}
+
+BitSet::Blocks::~Blocks() {
+    if (data_ != inline_)
+        delete [] data_;
+}
+
+BitSet::Blocks &BitSet::Blocks::operator=(const Blocks &rhs) {
+    if (this == &rhs)
+        return *this;
+    reserve(rhs.size_);
+    memcpy(data_, rhs.data_, rhs.size_ * sizeof(uint64_t));
+    size_ = rhs.size_;
+    return *this;
+}
+
+//
+// Grow the storage to hold at least capacity blocks, preserving the
+// contents.  The storage never shrinks.
+//
+void BitSet::Blocks::reserve(size_t capacity) {
+    if (capacity <= capacity_)
+        return;
+    size_t new_capacity = std::max(capacity, (size_t) capacity_ * 2);
+    uint64_t *data = new uint64_t[new_capacity];
+    memcpy(data, data_, size_ * sizeof(uint64_t));
+    if (data_ != inline_)
+        delete [] data_;
+    data_ = data;
+    capacity_ = new_capacity;
+}
+
+void BitSet::Blocks::resize(size_t size) {
+    if (size > size_) {
+        reserve(size);
+        memset(data_ + size_, 0, (size - size_) * sizeof(uint64_t));
+    }
+    size_ = size;
+}
 
 //
 // Set bit at given position, growing the vector if needed.
@@ -277,11 +449,7 @@ size_t BitSet::find_next_clear(size_t pos) const {
 //
 bool BitSet::intersects(const BitSet &rhs) const {
     size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        if (blocks_[idx] & rhs.blocks_[idx])
-            return true;
-    }
-    return false;
+    return any_and_blocks(blocks_.data(), rhs.blocks_.data(), minsize);
 }
 
 //
@@ -293,11 +461,8 @@ bool BitSet::intersects(const BitSet &rhs) const {
 bool BitSet::operator==(const BitSet &rhs) const {
     if (blocks_.size() != rhs.blocks_.size())
         return false;
-    for (size_t idx = 0; idx < blocks_.size(); idx++) {
-        if (blocks_[idx] != rhs.blocks_[idx])
-            return false;
-    }
-    return true;
+    return memcmp(blocks_.data(), rhs.blocks_.data(),
+                  blocks_.size() * sizeof(uint64_t)) == 0;
 }
 
 //
@@ -327,9 +492,8 @@ BitSet BitSet::operator|(const BitSet &rhs) const {
     temp.blocks_.resize(maxsize);
 
     // Process common blocks.
-    for (size_t idx = 0; idx < minsize; idx++) {
-        temp.blocks_[idx] = blocks_[idx] | rhs.blocks_[idx];
-    }
+    or_blocks(temp.blocks_.data(), blocks_.data(), rhs.blocks_.data(),
+              minsize);
 
     // Process blocks that exist in LHS only. It's a noop if RHS is bigger.
     for (size_t idx = minsize; idx < blocks_.size(); idx++) {
@@ -353,12 +517,8 @@ BitSet BitSet::operator|(const BitSet &rhs) const {
 //
 BitSet &BitSet::operator&=(const BitSet &rhs) {
     size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        blocks_[idx] &= rhs.blocks_[idx];
-    }
-    for (size_t idx = minsize; idx < blocks_.size(); idx++) {
-        blocks_[idx] = 0;
-    }
+    and_blocks(blocks_.data(), blocks_.data(), rhs.blocks_.data(), minsize);
+    blocks_.resize(minsize);
     compact();
     check_invariants();
     return *this;
@@ -373,9 +533,8 @@ BitSet &BitSet::operator&=(const BitSet &rhs) {
 BitSet &BitSet::operator|=(const BitSet &rhs) {
     if (blocks_.size() < rhs.blocks_.size())
         blocks_.resize(rhs.blocks_.size());
-    for (size_t idx = 0; idx < rhs.blocks_.size(); idx++) {
-        blocks_[idx] |= rhs.blocks_[idx];
-    }
+    or_blocks(blocks_.data(), blocks_.data(), rhs.blocks_.data(),
+              rhs.blocks_.size());
     check_invariants();
     return *this;
 }
@@ -393,9 +552,7 @@ void BitSet::Set(const BitSet &rhs) {
 //
 void BitSet::Reset(const BitSet &rhs) {
     size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        blocks_[idx] &= ~rhs.blocks_[idx];
-    }
+    andnot_blocks(blocks_.data(), blocks_.data(), rhs.blocks_.data(), minsize);
     compact();
     check_invariants();
 }
@@ -411,12 +568,10 @@ void BitSet::BuildComplement(const BitSet &lhs, const BitSet &rhs) {
     blocks_.clear();
     blocks_.resize(lhs.blocks_.size());
     size_t minsize = std::min(blocks_.size(), rhs.blocks_.size());
-    for (size_t idx = 0; idx < minsize; idx++) {
-        blocks_[idx] = lhs.blocks_[idx] & ~rhs.blocks_[idx];
-    }
-    for (size_t idx = minsize; idx < lhs.blocks_.size(); idx++) {
-        blocks_[idx] = lhs.blocks_[idx];
-    }
+    andnot_blocks(blocks_.data(), lhs.blocks_.data(), rhs.blocks_.data(),
+                  minsize);
+    memcpy(blocks_.data() + minsize, lhs.blocks_.data() + minsize,
+           (lhs.blocks_.size() - minsize) * sizeof(uint64_t));
     compact();
     check_invariants();
 }
@@ -424,33 +579,17 @@ void BitSet::BuildComplement(const BitSet &lhs, const BitSet &rhs) {
 //
 // Implement (*this = lhs & rhs).
 //
-// We avoid the need to compact or to resize multiple times by building
-// the blocks in reverse order.
-//
-// Note that the for loop does not handle idx 0 since the loop  variable
-// is unsigned.
+// We avoid the need to compact by skipping the trailing blocks whose
+// intersection is 0 before building the blocks.
 //
 void BitSet::BuildIntersection(const BitSet &lhs, const BitSet &rhs) {
-    blocks_.clear();
-    size_t minsize = std::min(lhs.blocks_.size(), rhs.blocks_.size());
-
-    if (minsize == 0)
-        return;
-
-    for (size_t idx = minsize - 1; idx > 0; idx--) {
-        if (lhs.blocks_[idx] & rhs.blocks_[idx]) {
-            if (blocks_.size() == 0)
-                blocks_.resize(idx + 1);
-            blocks_[idx] = lhs.blocks_[idx] & rhs.blocks_[idx];
-        }
-    }
-
-    if (lhs.blocks_[0] & rhs.blocks_[0]) {
-        if (blocks_.size() == 0)
-            blocks_.resize(1);
-        blocks_[0] = lhs.blocks_[0] & rhs.blocks_[0];
-    }
+    size_t size = std::min(lhs.blocks_.size(), rhs.blocks_.size());
+    while (size > 0 && (lhs.blocks_[size - 1] & rhs.blocks_[size - 1]) == 0)
+        size--;
 
+    blocks_.clear();
+    blocks_.resize(size);
+    and_blocks(blocks_.data(), lhs.blocks_.data(), rhs.blocks_.data(), size);
     check_invariants();
 }
 
@@ -460,11 +599,8 @@ void BitSet::BuildIntersection(const BitSet &lhs, const BitSet &rhs) {
 bool BitSet::Contains(const BitSet &rhs) const {
     if (blocks_.size() < rhs.blocks_.size())
         return false;
-    for (size_t idx = 0; idx < rhs.blocks_.size(); idx++) {
-        if (rhs.blocks_[idx] & ~blocks_[idx])
-            return false;
-    }
-    return true;
+    return !any_andnot_blocks(rhs.blocks_.data(), blocks_.data(),
+                              rhs.blocks_.size());
 }
 
 //
@@ -12,12 +12,45 @@
 //
 // BitSet automatically resizes the bit set when needed and allows for
 // logical operations between bitsets of different sizes.  Implemented
-// using a vector of uint64_t as the underlying storage.
+// using an array of uint64_t blocks as the underlying storage.
 //
 class BitSet {
 public:
     static const size_t npos = static_cast<size_t>(-1);
 
+    //
+    // Storage for the blocks. Bitsets of up to kInlineBlocks blocks, which
+    // covers the peer sets of most RibOuts, are kept in the object itself
+    // and do not need a heap allocation.
+    //
+    class Blocks {
+    public:
+        static const size_t kInlineBlocks = 2;
+
+        Blocks() : data_(inline_), size_(0), capacity_(kInlineBlocks) { }
+        Blocks(const Blocks &rhs);
+        ~Blocks();
+        Blocks &operator=(const Blocks &rhs);
+
+        size_t size() const { return size_; }
+        uint64_t &operator[](size_t idx) { return data_[idx]; }
+        const uint64_t &operator[](size_t idx) const { return data_[idx]; }
+        uint64_t *data() { return data_; }
+        const uint64_t *data() const { return data_; }
+
+        // New blocks are zeroed.
+        void resize(size_t size);
+        void clear() { size_ = 0; }
+
+    private:
+        void reserve(size_t capacity);
+
+        uint64_t *data_;
+        uint32_t size_;
+        uint32_t capacity_;
+        uint64_t inline_[kInlineBlocks];
+    };
+
     BitSet &set(size_t pos);
     BitSet &reset(size_t pos);
     bool test(size_t pos) const;
@@ -54,7 +87,7 @@ private:
     void compact();
     void check_invariants();
 
-    std::vector<uint64_t> blocks_;
+    Blocks blocks_;
 };
 
 #endif
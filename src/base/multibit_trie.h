@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef MULTIBIT_TRIE_H
+#define MULTIBIT_TRIE_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "base/patricia.h"
+
+namespace Patricia {
+
+//
+// Container with the same interface and intrusive node as Patricia::Tree,
+// for tables that are mostly used for longest prefix match lookups.
+//
+// Entries are kept in a Patricia::Tree, which provides the ordered
+// operations (Find, FindNext, GetNext, iteration). In addition, LPMFind is
+// served by a multibit trie with a stride of 8 bits, which looks at one
+// byte of the key per level instead of one bit.
+//
+// A trie node at depth d holds the prefixes whose length is 8d+1 to 8d+8
+// bits. For each of the 256 values of byte d, the node keeps the longest of
+// its prefixes that covers the value (prefix expansion) and the child node.
+// Both arrays are compressed with a 256 bit bitmap: the leaf bitmap marks
+// the values where the best prefix changes and the child bitmap marks the
+// values that have a child. The index in the array is the number of bits
+// set in the bitmap up to the value. The expanded leaves of a node are
+// rebuilt when one of its prefixes is added or removed.
+//
+template <class D, Node D::* P, class K>
+class MultibitTree {
+public:
+    typedef Tree<D, P, K> OrderedTree;
+    typedef typename OrderedTree::Iterator Iterator;
+
+    MultibitTree() : root_(new TrieNode), default_(NULL), trie_nodes_(1) {
+    }
+
+    ~MultibitTree() {
+        DeleteTrieNode(root_);
+    }
+
+    Iterator begin() { return tree_.begin(); }
+    Iterator end() { return tree_.end(); }
+    Iterator LowerBound(D *data) { return tree_.LowerBound(data); }
+
+    std::size_t Size() { return tree_.Size(); }
+
+    bool Insert(D *data) {
+        if (!tree_.Insert(data)) {
+            return false;
+        }
+        TrieInsert(data);
+        return true;
+    }
+
+    bool Remove(D *data) {
+        if (!tree_.Remove(data)) {
+            return false;
+        }
+        TrieRemove(data);
+        return true;
+    }
+
+    D *Find(D *data) { return tree_.Find(data); }
+    D *FindNext(D *data) { return tree_.FindNext(data); }
+    D *GetNext(D *data) { return tree_.GetNext(data); }
+
+    // Returns the entry with the longest prefix that matches the key,
+    // considering only prefixes that are not longer than the key.
+    D *LPMFind(D *data) {
+        return Lookup(EntryBytes(data), K::Length(data));
+    }
+
+    // Same for a key of length bits given as a byte string in the order
+    // returned by K::ByteValue.
+    D *LPMFind(const uint8_t *key, std::size_t length) {
+        return Lookup(key, length);
+    }
+
+    // Number of trie nodes and memory they use, excluding the entries.
+    std::size_t trie_nodes() const { return trie_nodes_; }
+    std::size_t TrieMemory() const { return TrieNodeMemory(root_); }
+
+private:
+    struct Prefix {
+        Prefix(uint8_t length, uint8_t value, D *data)
+            : length(length), value(value), data(data) {
+        }
+        // Bits of the prefix in the node, 1 to 8.
+        uint8_t length;
+        // Bits of the prefix left aligned in a byte, others are 0.
+        uint8_t value;
+        D *data;
+    };
+
+    // Byte accessor for the key of an entry.
+    struct EntryBytes {
+        explicit EntryBytes(D *data) : data(data) { }
+        uint8_t operator[](std::size_t i) const {
+            return K::ByteValue(data, i);
+        }
+        D *data;
+    };
+
+    template <class Bytes>
+    D *Lookup(const Bytes &key, std::size_t length) {
+        D *best = default_;
+        TrieNode *node = root_;
+        for (std::size_t depth = 0; node != NULL && length > 0; depth++) {
+            uint8_t value = key[depth];
+            if (length < 8) {
+                D *match = node->PartialMatch(value, length);
+                if (match) {
+                    best = match;
+                }
+                break;
+            }
+            D *leaf = node->Leaf(value);
+            if (leaf) {
+                best = leaf;
+            }
+            node = node->Child(value);
+            length -= 8;
+        }
+        return best;
+    }
+
+    static uint8_t Mask(std::size_t length) {
+        return static_cast<uint8_t>(0xFF << (8 - length));
+    }
+
+    // Number of bits set in the bitmap at positions 0 through value.
+    static int Rank(const uint64_t *map, uint8_t value) {
+        int word = value >> 6;
+        int count = 0;
+        for (int i = 0; i < word; i++) {
+            count += __builtin_popcountll(map[i]);
+        }
+        uint64_t mask = (2ULL << (value & 63)) - 1;
+        return count + __builtin_popcountll(map[word] & mask);
+    }
+
+    static bool TestBit(const uint64_t *map, uint8_t value) {
+        return (map[value >> 6] & (1ULL << (value & 63))) != 0;
+    }
+
+    struct TrieNode {
+        TrieNode() {
+            std::fill(child_map, child_map + 4, 0);
+            std::fill(leaf_map, leaf_map + 4, 0);
+        }
+
+        D *Leaf(uint8_t value) const {
+            int rank = Rank(leaf_map, value);
+            return rank ? leaves[rank - 1] : NULL;
+        }
+
+        TrieNode *Child(uint8_t value) const {
+            if (!TestBit(child_map, value)) {
+                return NULL;
+            }
+            return children[Rank(child_map, value) - 1];
+        }
+
+        // Longest prefix of at most length bits that covers value.
+        D *PartialMatch(uint8_t value, std::size_t length) const {
+            D *best = NULL;
+            for (typename std::vector<Prefix>::const_iterator it =
+                 prefixes.begin(); it != prefixes.end(); ++it) {
+                if (it->length > length) {
+                    break;
+                }
+                if ((value & Mask(it->length)) == it->value) {
+                    best = it->data;
+                }
+            }
+            return best;
+        }
+
+        void AddChild(uint8_t value, TrieNode *child) {
+            int rank = Rank(child_map, value);
+            children.insert(children.begin() + rank, child);
+            child_map[value >> 6] |= 1ULL << (value & 63);
+        }
+
+        void RemoveChild(uint8_t value) {
+            int rank = Rank(child_map, value);
+            children.erase(children.begin() + rank - 1);
+            child_map[value >> 6] &= ~(1ULL << (value & 63));
+        }
+
+        // Expand the prefixes, shortest first so that longer prefixes
+        // override them, and compress the result into runs.
+        void Rebuild() {
+            D *best[256];
+            std::fill(best, best + 256, static_cast<D *>(NULL));
+            for (typename std::vector<Prefix>::const_iterator it =
+                 prefixes.begin(); it != prefixes.end(); ++it) {
+                int count = 1 << (8 - it->length);
+                std::fill(best + it->value, best + it->value + count,
+                          it->data);
+            }
+            std::fill(leaf_map, leaf_map + 4, 0);
+            leaves.clear();
+            for (int value = 0; value < 256; value++) {
+                if (best[value] != (value ? best[value - 1] : NULL)) {
+                    leaf_map[value >> 6] |= 1ULL << (value & 63);
+                    leaves.push_back(best[value]);
+                }
+            }
+        }
+
+        bool empty() const {
+            return prefixes.empty() && children.empty();
+        }
+
+        uint64_t child_map[4];
+        uint64_t leaf_map[4];
+        std::vector<TrieNode *> children;
+        std::vector<D *> leaves;
+        // Sorted by length.
+        std::vector<Prefix> prefixes;
+    };
+
+    static bool PrefixLess(const Prefix &lhs, const Prefix &rhs) {
+        return lhs.length < rhs.length;
+    }
+
+    void TrieInsert(D *data) {
+        std::size_t length = K::Length(data);
+        if (length == 0) {
+            default_ = data;
+            return;
+        }
+
+        std::size_t depth = (length - 1) / 8;
+        TrieNode *node = root_;
+        for (std::size_t i = 0; i < depth; i++) {
+            uint8_t value = K::ByteValue(data, i);
+            TrieNode *child = node->Child(value);
+            if (child == NULL) {
+                child = new TrieNode;
+                trie_nodes_++;
+                node->AddChild(value, child);
+            }
+            node = child;
+        }
+
+        uint8_t bits = length - depth * 8;
+        uint8_t value = K::ByteValue(data, depth) & Mask(bits);
+        Prefix prefix(bits, value, data);
+        node->prefixes.insert(
+            std::upper_bound(node->prefixes.begin(), node->prefixes.end(),
+                             prefix, PrefixLess),
+            prefix);
+        node->Rebuild();
+    }
+
+    void TrieRemove(D *data) {
+        std::size_t length = K::Length(data);
+        if (length == 0) {
+            default_ = NULL;
+            return;
+        }
+
+        std::size_t depth = (length - 1) / 8;
+        std::vector<TrieNode *> path;
+        TrieNode *node = root_;
+        for (std::size_t i = 0; i < depth; i++) {
+            path.push_back(node);
+            node = node->Child(K::ByteValue(data, i));
+            assert(node);
+        }
+
+        uint8_t bits = length - depth * 8;
+        uint8_t value = K::ByteValue(data, depth) & Mask(bits);
+        typename std::vector<Prefix>::iterator it;
+        for (it = node->prefixes.begin(); it != node->prefixes.end(); ++it) {
+            if (it->length == bits && it->value == value) {
+                break;
+            }
+        }
+        assert(it != node->prefixes.end());
+        node->prefixes.erase(it);
+        node->Rebuild();
+
+        // Delete the nodes that no longer hold prefixes or children.
+        while (!path.empty() && node->empty()) {
+            TrieNode *parent = path.back();
+            path.pop_back();
+            parent->RemoveChild(K::ByteValue(data, path.size()));
+            delete node;
+            trie_nodes_--;
+            node = parent;
+        }
+    }
+
+    void DeleteTrieNode(TrieNode *node) {
+        for (typename std::vector<TrieNode *>::iterator it =
+             node->children.begin(); it != node->children.end(); ++it) {
+            DeleteTrieNode(*it);
+        }
+        delete node;
+    }
+
+    std::size_t TrieNodeMemory(const TrieNode *node) const {
+        std::size_t size = sizeof(TrieNode) +
+            node->children.capacity() * sizeof(TrieNode *) +
+            node->leaves.capacity() * sizeof(D *) +
+            node->prefixes.capacity() * sizeof(Prefix);
+        for (typename std::vector<TrieNode *>::const_iterator it =
+             node->children.begin(); it != node->children.end(); ++it) {
+            size += TrieNodeMemory(*it);
+        }
+        return size;
+    }
+
+    OrderedTree tree_;
+    TrieNode *root_;
+    // Entry with a 0 length prefix.
+    D *default_;
+    std::size_t trie_nodes_;
+
+    MultibitTree(const MultibitTree &);
+    MultibitTree &operator=(const MultibitTree &);
+};
+
+};
+
+#endif /* MULTIBIT_TRIE_H */
@@ -5,6 +5,7 @@
 #ifndef PATRICIA_H
 #define PATRICIA_H
 
+#include <stdint.h>
 #include <string>
 #include <cstring>
 #include <boost/intrusive/detail/parent_from_member.hpp>
@@ -108,6 +109,13 @@ public:
         return NodeToData(FindBestMatchNode(DataToNode(data)));
     }
 
+    // Longest prefix match for a key of length bits given as a byte string
+    // in the order returned by K::ByteValue. Avoids building an entry of
+    // type D just to search with it.
+    D * LPMFind(const uint8_t *key, std::size_t length) {
+        return NodeToData(FindBestMatchNode(key, length));
+    }
+
     D * GetNext(D * data) {
         return NodeToData(GetNextNode(DataToNode(data)));
     }
@@ -483,6 +491,35 @@ private:
         return l;
     }
 
+    Node * FindBestMatchNode(const uint8_t *key, std::size_t length) {
+        Node * p, * x, *l;
+        std::size_t i = 0;
+
+        l = NULL;
+        p = NULL;
+        x = root_;
+        while (x) {
+            if (!IS_INT_NODE(x)) {
+                if (CompareKey(key, length, x, i, i)) {
+                    return x;
+                }
+                if (i == x->bitpos_) {
+                    l = x;
+                }
+            }
+            if (x->bitpos_ > length) {
+                break;
+            }
+            p = x;
+            x = GetKeyBit(key, length, x->bitpos_) ? x->right_ : x->left_;
+            if (x && (p->bitpos_ >= x->bitpos_)) {
+                break;
+            }
+        }
+
+        return l;
+    }
+
     Node * GetNextNode(Node * node) {
         Node *x, *l;
 
@@ -523,6 +560,15 @@ private:
         return K::ByteValue(data, pos >> 3) & (0x80 >> (pos & 7));
     }
 
+    static bool GetKeyBit(const uint8_t *key, std::size_t length,
+                          std::size_t pos) {
+        if (pos >= length) {
+            return false;
+        }
+
+        return key[pos >> 3] & (0x80 >> (pos & 7));
+    }
+
     bool Compare(Node *node_left, Node *node_right) {
         D * data_left = NodeToData(node_left);
         D * data_right = NodeToData(node_right);
@@ -585,6 +631,44 @@ private:
         return isEqual;
     }
 
+    // Same as Compare above, with the key on the left.
+    bool CompareKey(const uint8_t *key, std::size_t length, Node *node,
+                    std::size_t start, std::size_t& pos) {
+        D * data = NodeToData(node);
+        std::size_t shortLen;
+
+        bool isEqual;
+
+        if (length < K::Length(data)) {
+            shortLen = length;
+            isEqual = false;
+        } else {
+            shortLen = K::Length(data);
+            isEqual = (length == K::Length(data));
+        }
+
+        std::size_t byteLen = shortLen >> 3;
+
+        for (pos = start >> 3; pos < byteLen; ++pos) {
+            if (key[pos] != static_cast<uint8_t>(K::ByteValue(data, pos))) {
+                break;
+            }
+        }
+
+        pos <<= 3;
+        if (pos < start) {
+            pos = start;
+        }
+
+        for (; pos < shortLen; ++pos) {
+            if (GetKeyBit(key, length, pos) != GetBit(node, pos)) {
+                return false;
+            }
+        }
+
+        return isEqual;
+    }
+
     Node * RewireRightMost (Node *p, Node *x) {
         Node *pRight;
         if (!x) {
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/queue_task.h"
+
+#include <set>
+#include <boost/foreach.hpp>
+
+#include "base/sandesh/queue_task_types.h"
+
+using namespace std;
+
+// Registry of the named queues.
+class WorkQueueRegistry {
+public:
+    typedef set<WorkQueueBase *> QueueSet;
+
+    static WorkQueueRegistry *GetInstance() {
+        static WorkQueueRegistry registry;
+        return &registry;
+    }
+
+    tbb::mutex &mutex() { return mutex_; }
+    QueueSet &queues() { return queues_; }
+
+private:
+    tbb::mutex mutex_;
+    QueueSet queues_;
+};
+
+WorkQueueBase::WorkQueueBase()
+    : sample_time_(UTCTimestampUsec()), sample_enqueues_(0), sample_dequeues_(0) {
+}
+
+WorkQueueBase::~WorkQueueBase() {
+    if (name_.empty()) {
+        return;
+    }
+    WorkQueueRegistry *registry = WorkQueueRegistry::GetInstance();
+    tbb::mutex::scoped_lock lock(registry->mutex());
+    registry->queues().erase(this);
+}
+
+void WorkQueueBase::set_name(const string &name) {
+    WorkQueueRegistry *registry = WorkQueueRegistry::GetInstance();
+    tbb::mutex::scoped_lock lock(registry->mutex());
+    name_ = name;
+    registry->queues().insert(this);
+}
+
+void WorkQueueBase::GetAllStats(vector<Stats> *list) {
+    WorkQueueRegistry *registry = WorkQueueRegistry::GetInstance();
+    tbb::mutex::scoped_lock lock(registry->mutex());
+    uint64_t now = UTCTimestampUsec();
+    BOOST_FOREACH(WorkQueueBase *queue, registry->queues()) {
+        Stats stats;
+        queue->GetStats(&stats);
+        double elapsed = now > queue->sample_time_ ?
+            (double) (now - queue->sample_time_) / 1000000 : 0;
+        if (elapsed > 0) {
+            stats.enqueue_rate =
+                (stats.enqueues - queue->sample_enqueues_) / elapsed;
+            stats.dequeue_rate =
+                (stats.dequeues - queue->sample_dequeues_) / elapsed;
+        } else {
+            stats.enqueue_rate = 0;
+            stats.dequeue_rate = 0;
+        }
+        queue->sample_time_ = now;
+        queue->sample_enqueues_ = stats.enqueues;
+        queue->sample_dequeues_ = stats.dequeues;
+        list->push_back(stats);
+    }
+}
+
+void ShowWorkQueueReq::HandleRequest() const {
+    vector<WorkQueueBase::Stats> stats_list;
+    WorkQueueBase::GetAllStats(&stats_list);
+
+    vector<ShowWorkQueue> queues;
+    BOOST_FOREACH(const WorkQueueBase::Stats &stats, stats_list) {
+        if (!get_name().empty() &&
+            stats.name.find(get_name()) == string::npos) {
+            continue;
+        }
+        ShowWorkQueue queue;
+        queue.set_name(stats.name);
+        queue.set_task_id(stats.task_id);
+        queue.set_task_instance(stats.task_instance);
+        queue.set_enqueues(stats.enqueues);
+        queue.set_dequeues(stats.dequeues);
+        queue.set_enqueue_rate(stats.enqueue_rate);
+        queue.set_dequeue_rate(stats.dequeue_rate);
+        queue.set_queue_count(stats.queue_count);
+        queue.set_high_watermark(stats.high_watermark);
+        queue.set_adaptive(stats.adaptive);
+        queue.set_max_iterations(stats.max_iterations);
+        queue.set_callback_cost_nsecs(stats.callback_cost_nsecs);
+        queue.set_latency_histogram(vector<uint64_t>(stats.latency,
+            stats.latency + WorkQueueBase::kLatencyBuckets));
+        queues.push_back(queue);
+    }
+
+    ShowWorkQueueResp *resp = new ShowWorkQueueResp;
+    resp->set_queues(queues);
+    resp->set_context(context());
+    resp->Response();
+}
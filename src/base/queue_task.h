@@ -7,16 +7,82 @@
 // Task based queue processor implementing thread safe enqueue and dequeue
 // using concurrent queues. If queue is empty, enqueue creates a dequeue task
 // that drains the queue. The dequeue task runs a maximum of kMaxIterations
-// before yielding.
+// before yielding. In adaptive mode the number of entries per run is sized
+// from the observed cost of the callback so that a run takes about a target
+// time slice.
+//
+// Queues that are given a name report their statistics through the
+// ShowWorkQueueReq introspect.
 //
 #ifndef __QUEUE_TASK_H__
 #define __QUEUE_TASK_H__
 
+#include <algorithm>
+#include <string>
+#include <vector>
 #include <tbb/atomic.h>
 #include <tbb/concurrent_queue.h>
 #include <tbb/mutex.h>
 
 #include "base/task.h"
+#include "base/util.h"
+
+// Part of WorkQueue that does not depend on the entry type: statistics and
+// the registry of named queues.
+class WorkQueueBase {
+public:
+    // Bucket i of the latency histogram counts the entries that waited in
+    // the queue for less than 2^i usecs. The last bucket counts the rest.
+    // Entries are timed only in adaptive mode.
+    static const int kLatencyBuckets = 20;
+
+    struct Stats {
+        std::string name;
+        int task_id;
+        int task_instance;
+        uint64_t enqueues;
+        uint64_t dequeues;
+        // Per second, since the previous call to GetAllStats.
+        double enqueue_rate;
+        double dequeue_rate;
+        uint64_t queue_count;
+        uint64_t high_watermark;
+        bool adaptive;
+        size_t max_iterations;
+        uint64_t callback_cost_nsecs;
+        uint64_t latency[kLatencyBuckets];
+    };
+
+    WorkQueueBase();
+    virtual ~WorkQueueBase();
+
+    // Add the queue to the registry used by introspect.
+    void set_name(const std::string &name);
+    const std::string &name() const { return name_; }
+
+    virtual void GetStats(Stats *stats) const = 0;
+
+    // Statistics of all the named queues.
+    static void GetAllStats(std::vector<Stats> *list);
+
+    static int LatencyBucket(uint64_t usecs) {
+        int bucket = 0;
+        while (usecs && bucket < kLatencyBuckets - 1) {
+            usecs >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+private:
+    std::string name_;
+    // Sample used to compute the rates, updated by GetAllStats.
+    uint64_t sample_time_;
+    uint64_t sample_enqueues_;
+    uint64_t sample_dequeues_;
+
+    DISALLOW_COPY_AND_ASSIGN(WorkQueueBase);
+};
 
 template <typename QueueEntryT, typename QueueT>
 class QueueTaskRunner : public Task {
@@ -28,18 +94,26 @@ public:
     bool RunQueue() {
         QueueEntryT entry = QueueEntryT();
         size_t count = 0;
-        
+        size_t max_iterations = queue_->max_iterations_;
+        uint64_t start = queue_->adaptive_ ? UTCTimestampUsec() : 0;
+
         while (queue_->Dequeue(&entry)) {
             // Process the entry
+            count++;
             if (!queue_->GetCallback()(entry)) {
                 break;
             }
 
-            if (++count == queue_->max_iterations_) {
-                return queue_->RunnerDone();
+            if (count == max_iterations) {
+                break;
             }
         }
-        
+
+        if (queue_->adaptive_ && count) {
+            uint64_t now = UTCTimestampUsec();
+            queue_->UpdateBatchSize(count, now > start ? now - start : 0);
+        }
+
         // Running is done if queue_ is empty
         // While notification is being run, its possible that more entries
         // are added into queue_
@@ -75,17 +149,32 @@ struct WorkQueueDelete<QueueEntryT *> {
     void operator()(QueueT &q) {
         for (typename QueueT::iterator iter = q.unsafe_begin();
              iter != q.unsafe_end(); ++iter) {
-            delete *iter;
+            delete iter->entry;
         }
     }
 };
 
+// Queue element: the entry and the time at which it was enqueued.
+template <typename QueueEntryT>
+struct WorkQueueItem {
+    WorkQueueItem() : entry(), enqueue_time(0) { }
+    WorkQueueItem(QueueEntryT entry, uint64_t time)
+        : entry(entry), enqueue_time(time) { }
+    QueueEntryT entry;
+    uint64_t enqueue_time;
+};
+
 template <typename QueueEntryT>
-class WorkQueue {
+class WorkQueue : public WorkQueueBase {
 public:
     static const int kThreshold = 1024;
     static const int kMaxIterations = 32;
-    typedef tbb::concurrent_queue<QueueEntryT> Queue;
+    // Bounds of the batch size in adaptive mode.
+    static const int kMinAdaptiveIterations = 4;
+    static const int kMaxAdaptiveIterations = 1024;
+    // Time slice of the input queues of the control node in adaptive mode.
+    static const uint64_t kDefaultTimeSliceUsecs = 2000;
+    typedef tbb::concurrent_queue<WorkQueueItem<QueueEntryT> > Queue;
     typedef boost::function<bool (QueueEntryT)> Callback;
     typedef boost::function<bool (void)> StartRunnerFunc;
     typedef boost::function<void (bool)> TaskExitCallback;
@@ -106,8 +195,14 @@ public:
         disable_(false),
         deleted_(false),
         enqueues_(0),
-        max_iterations_(max_iterations) {
+        dequeues_(0),
+        max_iterations_(max_iterations),
+        adaptive_(false),
+        time_slice_usecs_(0),
+        callback_cost_nsecs_(0) {
         count_ = 0;
+        high_watermark_ = 0;
+        std::fill(latency_, latency_ + kLatencyBuckets, 0);
     }
 
     // Concurrency - should be called from a task whose policy
@@ -137,21 +232,57 @@ public:
     }
 
     bool Enqueue(QueueEntryT entry) {
-        queue_.push(entry);
+        // The clock is only read in adaptive mode.
+        uint64_t now = adaptive_ ? UTCTimestampUsec() : 0;
+        queue_.push(WorkQueueItem<QueueEntryT>(entry, now));
         enqueues_++;
         MayBeStartRunner();
-        return count_.fetch_and_increment() < (kThreshold - 1);
+        long count = count_.fetch_and_increment();
+        if (count >= high_watermark_) {
+            high_watermark_ = count + 1;
+        }
+        return count < (kThreshold - 1);
     }
 
     // Returns true if pop is successful.
     bool Dequeue(QueueEntryT *entry) {
-        bool success = queue_.try_pop(*entry);
+        WorkQueueItem<QueueEntryT> item;
+        bool success = queue_.try_pop(item);
         if (success) {
             count_.fetch_and_decrement();
+            dequeues_++;
+            if (item.enqueue_time) {
+                uint64_t now = UTCTimestampUsec();
+                latency_[LatencyBucket(now > item.enqueue_time ?
+                                       now - item.enqueue_time : 0)]++;
+            }
+            *entry = item.entry;
         }
         return success;
     }
 
+    // Size the number of entries processed per task run so that a run
+    // takes about time_slice_usecs. The batch stays between
+    // kMinAdaptiveIterations and kMaxAdaptiveIterations.
+    void SetAdaptive(uint64_t time_slice_usecs) {
+        adaptive_ = true;
+        time_slice_usecs_ = time_slice_usecs;
+    }
+
+    virtual void GetStats(Stats *stats) const {
+        stats->name = name();
+        stats->task_id = taskId_;
+        stats->task_instance = taskInstance_;
+        stats->enqueues = enqueues_;
+        stats->dequeues = dequeues_;
+        stats->queue_count = count_;
+        stats->high_watermark = high_watermark_;
+        stats->adaptive = adaptive_;
+        stats->max_iterations = max_iterations_;
+        stats->callback_cost_nsecs = callback_cost_nsecs_;
+        std::copy(latency_, latency_ + kLatencyBuckets, stats->latency);
+    }
+
     int GetTaskId() {
     	return taskId_;
     }
@@ -230,7 +361,38 @@ public:
         return enqueues_;
     }
 
+    uint64_t DequeueCount() {
+        return dequeues_;
+    }
+
+    uint64_t HighWatermark() {
+        return high_watermark_;
+    }
+
+    size_t max_iterations() const { return max_iterations_; }
+
 private:
+    // Called by the runner after processing count entries in elapsed_usecs.
+    // The callback cost is a moving average, in nsecs per entry.
+    void UpdateBatchSize(size_t count, uint64_t elapsed_usecs) {
+        uint64_t cost = elapsed_usecs * 1000 / count;
+        if (callback_cost_nsecs_ == 0) {
+            callback_cost_nsecs_ = cost;
+        } else {
+            callback_cost_nsecs_ = (callback_cost_nsecs_ * 7 + cost) / 8;
+        }
+        uint64_t batch = kMaxAdaptiveIterations;
+        if (callback_cost_nsecs_) {
+            batch = time_slice_usecs_ * 1000 / callback_cost_nsecs_;
+        }
+        if (batch < (uint64_t) kMinAdaptiveIterations) {
+            batch = kMinAdaptiveIterations;
+        } else if (batch > (uint64_t) kMaxAdaptiveIterations) {
+            batch = kMaxAdaptiveIterations;
+        }
+        max_iterations_ = batch;
+    }
+
     bool RunnerDone() {
         tbb::mutex::scoped_lock lock(mutex_);
         if (queue_.empty()) {
@@ -262,7 +424,13 @@ private:
     bool disable_;
     bool deleted_;
     uint64_t enqueues_;
+    uint64_t dequeues_;
+    tbb::atomic<long> high_watermark_;
     size_t max_iterations_;
+    bool adaptive_;
+    uint64_t time_slice_usecs_;
+    uint64_t callback_cost_nsecs_;
+    uint64_t latency_[kLatencyBuckets];
 
     friend class QueueTaskRunner<QueueEntryT, WorkQueue<QueueEntryT> >;
 
@@ -10,6 +10,7 @@
 
 #include "tbb/task.h"
 #include "tbb/enumerable_thread_specific.h"
+#include "tbb/spin_mutex.h"
 #include "base/logging.h"
 #include "base/task.h"
 
@@ -23,6 +24,9 @@ typedef tbb::enumerable_thread_specific<Task *> TaskInfo;
 
 static TaskInfo task_running;
 
+typedef std::vector<Task::RunExitCallback> RunExitCallbackList;
+static tbb::enumerable_thread_specific<RunExitCallbackList> run_exit_callbacks;
+
 // Vector of Task entries
 typedef std::vector<TaskEntry *> TaskEntryList;
 
@@ -38,6 +42,7 @@ public:
 
 private:
     tbb::task *execute();
+    void RunExitCallbacks();
 
     Task    *parent_;
 
@@ -137,6 +142,11 @@ struct TaskDeferEntryCmp {
 // run_count_   : Number of tasks running in context of this task-group
 // deferq_      : Tasks deferred till run_count_ on this task becomes 0
 // task_entry_  : Default TaskEntry used for task without an instance
+// policy_bound_: True if the group or any of its entries is referenced by a
+//                policy rule. Only groups that are not bound are scheduled
+//                without TaskScheduler::mutex_ in GROUP_LOCK mode
+// mutex_       : Protects the group and its TaskEntries. Always acquired after
+//                TaskScheduler::mutex_ when both are needed
 class TaskGroup {
 public:
     TaskGroup(int task_id);
@@ -154,6 +164,9 @@ public:
     void RunDeferQ();
     void TaskExited(Task *t);
     void PolicySet();
+    void PolicyBound() { policy_bound_ = true; }
+    bool policy_bound() const { return policy_bound_; }
+    tbb::spin_mutex &mutex() { return mutex_; }
     void TaskStarted() {run_count_++;};
     TaskStats *GetTaskGroupStats();
     TaskStats *GetTaskStats();
@@ -191,7 +204,9 @@ private:
     static const int        kVectorGrowSize = 16;
     int                     task_id_;
     bool                    policy_set_;// policy already set?
+    bool                    policy_bound_;// referenced by any policy?
     int                     run_count_; // # of tasks running in the group
+    tbb::spin_mutex         mutex_;
 
     TaskGroupPolicyList     policy_;    // Policy rules for the group
     TaskDeferList           deferq_;    // Tasks deferred till run_count_ is 0
@@ -214,6 +229,7 @@ tbb::task *TaskImpl::execute() {
     running = parent_;
     try {
         bool is_complete = parent_->Run();
+        RunExitCallbacks();
         running = NULL;
         if (is_complete == true) {
             parent_->SetTaskComplete();
@@ -227,15 +243,32 @@ tbb::task *TaskImpl::execute() {
         static std::string what = e.what();
 
         LOG(DEBUG, "!!!! ERROR !!!! Task caught fatal exception: " << what);
+        RunExitCallbacks();
         assert(0);
     } catch (...) {
         LOG(DEBUG, "!!!! ERROR !!!! Task caught fatal unknown exception");
+        RunExitCallbacks();
         assert(0);
     }
 
     return NULL;
 }
 
+// Invoke the functions registered with Task::AtRunExit during the run that
+// just completed, including the ones that they register in turn. Also called
+// if Run() throws, so that they don't run after an unrelated task.
+void TaskImpl::RunExitCallbacks() {
+    RunExitCallbackList &callbacks = run_exit_callbacks.local();
+    while (!callbacks.empty()) {
+        RunExitCallbackList list;
+        list.swap(callbacks);
+        for (RunExitCallbackList::iterator iter = list.begin();
+             iter != list.end(); ++iter) {
+            (*iter)();
+        }
+    }
+}
+
 // Destructor called when a task execution is compeleted. Invoked
 // implicitly by tbb::task. 
 // Invokes OnTaskExit to schedule tasks pending tasks
@@ -276,9 +309,14 @@ int TaskScheduler::GetThreadCount() {
 // part of tbb. So, initialize TBB with one thread more than its default
 TaskScheduler::TaskScheduler() : 
     task_scheduler_(GetThreadCount() + 1),
-    running_(true), seqno_(0), id_max_(0) {
+    locking_mode_(GLOBAL_LOCK), id_max_(0) {
+    running_ = true;
+    seqno_ = 0;
+    group_lock_count_ = 0;
+    global_lock_count_ = 0;
     hw_thread_count_ = GetThreadCount();
-    task_group_db_.resize(TaskScheduler::kVectorGrowSize);
+    task_group_db_.grow_to_at_least(TaskScheduler::kVectorGrowSize);
+    task_group_db_size_ = task_group_db_.size();
     stop_entry_ = new TaskEntry(-1);
 }
 
@@ -302,6 +340,7 @@ TaskScheduler::~TaskScheduler() {
     delete stop_entry_;
     stop_entry_ = NULL;
     task_group_db_.clear();
+    task_group_db_size_ = 0;
 
     return;
 }
@@ -319,11 +358,14 @@ TaskScheduler *TaskScheduler::GetInstance() {
 }
 
 // Get TaskGroup for a task_id. Grows task_entry_db_ if necessary
+// Must be called with mutex_ held, as it may create the TaskGroup.
 TaskGroup *TaskScheduler::GetTaskGroup(int task_id) {
     assert(task_id >= 0);
-    int size = task_group_db_.size();
+    int size = task_group_db_size_;
     if (size <= task_id) {
-        task_group_db_.resize(task_id + TaskScheduler::kVectorGrowSize);
+        task_group_db_.grow_to_at_least(task_id +
+                                        TaskScheduler::kVectorGrowSize);
+        task_group_db_size_ = task_group_db_.size();
     }
 
     TaskGroup *group = task_group_db_[task_id];
@@ -340,6 +382,45 @@ TaskGroup *TaskScheduler::QueryTaskGroup(int task_id) {
     return task_group_db_[task_id];
 }
 
+// Lookup TaskGroup for a task_id without holding mutex_. Returns NULL if the
+// group is not created yet. Elements of task_group_db_ never move, so the
+// lookup is safe against a concurrent GetTaskGroup growing the vector.
+TaskGroup *TaskScheduler::LookupTaskGroup(int task_id) {
+    if (task_id < 0 || task_id >= task_group_db_size_)
+        return NULL;
+    return task_group_db_[task_id];
+}
+
+// A TaskGroup can be scheduled holding only its own lock if it is not
+// referenced by any policy. Must be called with the group lock held.
+// running_ is only modified with all group locks held, hence a stopped
+// scheduler (which queues to the shared stop_entry_) is always handled
+// under mutex_.
+bool TaskScheduler::IsGroupLockEligible(TaskGroup *group) const {
+    return (locking_mode_ == GROUP_LOCK && !group->policy_bound() && running_);
+}
+
+// Acquire the locks of all TaskGroups. Must be called with mutex_ held,
+// which guarantees that no other thread holds more than one group lock and
+// that no TaskGroup gets created while the locks are held.
+void TaskScheduler::LockTaskGroups() {
+    for (int i = 0; i < task_group_db_size_; i++) {
+        TaskGroup *group = task_group_db_[i];
+        if (group != NULL) {
+            group->mutex().lock();
+        }
+    }
+}
+
+void TaskScheduler::UnlockTaskGroups() {
+    for (int i = 0; i < task_group_db_size_; i++) {
+        TaskGroup *group = task_group_db_[i];
+        if (group != NULL) {
+            group->mutex().unlock();
+        }
+    }
+}
+
 // Get TaskGroup for a task_id. Grows task_entry_db_ if necessary
 TaskEntry *TaskScheduler::GetTaskEntry(int task_id, int task_instance) {
     TaskGroup *group = GetTaskGroup(task_id);
@@ -364,11 +445,21 @@ TaskEntry *TaskScheduler::QueryTaskEntry(int task_id, int task_instance) {
 void TaskScheduler::SetPolicy(int task_id, TaskPolicy &policy) {
     tbb::mutex::scoped_lock     lock(mutex_);
 
+    // Create all the groups involved before taking the group locks, so that
+    // no group referenced by the policy can be scheduled without mutex_ once
+    // the policy is in place.
     TaskGroup *group = GetTaskGroup(task_id);
+    for (TaskPolicy::iterator it = policy.begin(); it != policy.end(); ++it) {
+        GetTaskGroup(it->match_id);
+    }
+    LockTaskGroups();
+
     TaskEntry *group_entry = group->GetTaskEntry(-1);
     group->PolicySet();
+    group->PolicyBound();
 
     for (TaskPolicy::iterator it = policy.begin(); it != policy.end(); ++it) {
+        GetTaskGroup(it->match_id)->PolicyBound();
 
         if (it->match_instance == -1) {
             TaskGroup *policy_group = GetTaskGroup(it->match_id);
@@ -385,12 +476,29 @@ void TaskScheduler::SetPolicy(int task_id, TaskPolicy &policy) {
             policy_entry->AddPolicy(group_entry);
         }
     }
+
+    UnlockTaskGroups();
 }
 
 // Enqueue a Task for running. Starts task if all policy rules are met else 
 // puts task in waitq
 void TaskScheduler::Enqueue(Task *t) {
+    if (locking_mode_ == GROUP_LOCK) {
+        TaskGroup *group = LookupTaskGroup(t->GetTaskId());
+        if (group != NULL) {
+            tbb::spin_mutex::scoped_lock group_lock(group->mutex());
+            if (IsGroupLockEligible(group)) {
+                group_lock_count_++;
+                EnqueueUnLocked(t);
+                return;
+            }
+        }
+    }
+
     tbb::mutex::scoped_lock     lock(mutex_);
+    TaskGroup *group = GetTaskGroup(t->GetTaskId());
+    tbb::spin_mutex::scoped_lock group_lock(group->mutex());
+    global_lock_count_++;
 
     EnqueueUnLocked(t);
 }
@@ -437,6 +545,8 @@ void TaskScheduler::EnqueueUnLocked(Task *t) {
 // [Note]: The caller needs to ensure that the task exists when Cancel() is invoked. 
 TaskScheduler::CancelReturnCode TaskScheduler::Cancel(Task *t) {
     tbb::mutex::scoped_lock  lock(mutex_);
+    TaskGroup *group = GetTaskGroup(t->GetTaskId());
+    tbb::spin_mutex::scoped_lock group_lock(group->mutex());
 
     // If the task is in RUN state, mark the task for cancellation and return.
     if (t->state_ == Task::RUN) {
@@ -486,10 +596,27 @@ TaskScheduler::CancelReturnCode TaskScheduler::Cancel(Task *t) {
 // Method invoked on exit of a Task.
 // Exit of a task can potentially start tasks in pendingq.
 void TaskScheduler::OnTaskExit(Task *t) {
+    TaskGroup *group = LookupTaskGroup(t->GetTaskId());
+    assert(group != NULL);
+
+    if (locking_mode_ == GROUP_LOCK) {
+        tbb::spin_mutex::scoped_lock group_lock(group->mutex());
+        if (IsGroupLockEligible(group)) {
+            group_lock_count_++;
+            TaskExitUnLocked(t, group);
+            return;
+        }
+    }
+
     tbb::mutex::scoped_lock lock(mutex_);
+    tbb::spin_mutex::scoped_lock group_lock(group->mutex());
+    global_lock_count_++;
+    TaskExitUnLocked(t, group);
+}
 
-    TaskEntry *entry = QueryTaskEntry(t->GetTaskId(), t->GetTaskInstance());
-    entry->TaskExited(t, GetTaskGroup(t->GetTaskId()));
+void TaskScheduler::TaskExitUnLocked(Task *t, TaskGroup *group) {
+    TaskEntry *entry = group->QueryTaskEntry(t->GetTaskInstance());
+    entry->TaskExited(t, group);
 
     //
     // Delete the task it is not marked for recycling or already cancelled.
@@ -511,17 +638,23 @@ void TaskScheduler::OnTaskExit(Task *t) {
 
 void TaskScheduler::Stop() {
     tbb::mutex::scoped_lock             lock(mutex_);
+    LockTaskGroups();
 
     running_ = false;
+
+    UnlockTaskGroups();
 }
 
 void TaskScheduler::Start() {
     tbb::mutex::scoped_lock             lock(mutex_);
+    LockTaskGroups();
 
     running_ = true;
 
     // Run all tasks that may be suspended
     stop_entry_->RunDeferQ();
+
+    UnlockTaskGroups();
     return;
 }
 
@@ -542,8 +675,10 @@ void TaskScheduler::Print() {
 // Returns true if there are no tasks enqueued and/or running
 bool TaskScheduler::IsEmpty() {
     TaskGroup *group;
+    bool empty = true;
 
     tbb::mutex::scoped_lock lock(mutex_);
+    LockTaskGroups();
 
     for (TaskGroupDb::iterator it = task_group_db_.begin();
          it != task_group_db_.end(); ++it) {
@@ -551,11 +686,13 @@ bool TaskScheduler::IsEmpty() {
             continue;
         }
         if (group->TaskRunCount() || (false == group->IsWaitQEmpty())) {
-            return false;
+            empty = false;
+            break;
         }
     }
 
-    return true;
+    UnlockTaskGroups();
+    return empty;
 }
 
 int TaskScheduler::GetTaskId(const string &name) {
@@ -689,7 +826,7 @@ void TaskScheduler::ClearRunningTask() {
 ////////////////////////////////////////////////////////////////////////////
 
 TaskGroup::TaskGroup(int task_id) : task_id_(task_id), policy_set_(false), 
-    run_count_(0) {
+    policy_bound_(false), run_count_(0) {
     task_entry_db_.resize(TaskGroup::kVectorGrowSize);
     task_entry_ = new TaskEntry(task_id);
     memset(&stats_, 0, sizeof(stats_));
@@ -1150,6 +1287,13 @@ Task *Task::Running() {
     return running;
 }
 
+bool Task::AtRunExit(RunExitCallback callback) {
+    if (Running() == NULL)
+        return false;
+    run_exit_callbacks.local().push_back(callback);
+    return true;
+}
+
 ostream& operator<<(ostream& out, const Task &t) {
     out <<  "Task <" << t.task_id_ << "," << t.task_instance_ << ":" 
         << t.seqno_ << "> ";
@@ -31,9 +31,12 @@
 #ifndef ctrlplane_task_h
 #define ctrlplane_task_h
 
+#include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <map>
 #include <vector>
+#include <tbb/atomic.h>
+#include <tbb/concurrent_vector.h>
 #include <tbb/mutex.h>
 #include <tbb/reader_writer_lock.h>
 #include <tbb/task.h>
@@ -92,6 +95,14 @@ public:
     // return a pointer to the current task the code is executing under.
     static Task *Running();
 
+    // Register a function to be called on the current thread as soon as the
+    // running task returns from Run(), while it still holds its exclusion.
+    // Lets code invoked many times within one run of a task defer work to
+    // the end of the run. Returns false, without registering the function,
+    // if the caller isn't executing under a task.
+    typedef boost::function<void(void)> RunExitCallback;
+    static bool AtRunExit(RunExitCallback callback);
+
 private:
     friend class TaskEntry;
     friend class TaskScheduler;
@@ -121,8 +132,23 @@ private:
 // which may now be runnable. It is important that this process is efficient
 // such that exit events do not scan tasks that are not waiting on a particular
 // task id or task instance to have a 0 count.
+//
+// Locking modes:
+// GLOBAL_LOCK : Every enqueue, exit and policy check is serialized on mutex_.
+// GROUP_LOCK  : Tasks of a TaskGroup that is not referenced by any policy are
+//               enqueued and exited holding only the lock of their TaskGroup.
+//               Such a group can only interact with itself, so exclusion
+//               between its instances is still enforced. Groups bound by a
+//               policy continue to be scheduled under mutex_.
+// Ready tasks are spawned on the tbb worker that made them runnable and are
+// stolen by idle workers, so both modes only differ in the bookkeeping lock.
 class TaskScheduler {
 public:
+    enum LockingMode {
+        GLOBAL_LOCK,
+        GROUP_LOCK,
+    };
+
     TaskScheduler();
     ~TaskScheduler();
 
@@ -148,6 +174,13 @@ public:
     bool GetRunStatus() { return running_; };
     int GetTaskId(const std::string &name);
 
+    LockingMode locking_mode() const { return locking_mode_; }
+    void set_locking_mode(LockingMode mode) { locking_mode_ = mode; }
+
+    // Number of enqueue/exit events handled without the scheduler mutex.
+    uint64_t group_lock_count() const { return group_lock_count_; }
+    uint64_t global_lock_count() const { return global_lock_count_; }
+
     TaskStats *GetTaskGroupStats(int task_id);
     TaskStats *GetTaskStats(int task_id);
     TaskStats *GetTaskStats(int task_id, int instance_id);
@@ -175,7 +208,7 @@ public:
 
 private:
     friend class ConcurrencyScope;
-    typedef std::vector<TaskGroup *> TaskGroupDb;
+    typedef tbb::concurrent_vector<tbb::atomic<TaskGroup *> > TaskGroupDb;
     typedef std::map<std::string, int> TaskIdMap;
 
     static const int        kVectorGrowSize = 16;
@@ -189,13 +222,25 @@ private:
     void ClearRunningTask();
     void WaitForTerminateCompletion();
 
+    TaskGroup *LookupTaskGroup(int task_id);
+    bool IsGroupLockEligible(TaskGroup *group) const;
+    void LockTaskGroups();
+    void UnlockTaskGroups();
+    void TaskExitUnLocked(Task *task, TaskGroup *group);
+
     TaskEntry               *stop_entry_;
 
     tbb::task_scheduler_init task_scheduler_;
     tbb::mutex              mutex_;
-    bool                    running_;
-    int                     seqno_;
+    tbb::atomic<bool>       running_;
+    tbb::atomic<int>        seqno_;
     TaskGroupDb             task_group_db_;
+    // Number of slots in task_group_db_ that are fully constructed. Used by
+    // the lock-free group lookup instead of task_group_db_.size().
+    tbb::atomic<int>        task_group_db_size_;
+    LockingMode             locking_mode_;
+    tbb::atomic<uint64_t>   group_lock_count_;
+    tbb::atomic<uint64_t>   global_lock_count_;
 
     tbb::reader_writer_lock id_map_mutex_;
     TaskIdMap               id_map_;
@@ -2,15 +2,20 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <algorithm>
+#include <iostream>
+
 #include "base/bitset.h"
 #include "base/logging.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
 #include "testing/gunit.h"
 
 using namespace std;
 
 class BitSetTest : public ::testing::Test {
 protected:
-    vector<uint64_t> &get_blocks(BitSet &bitset) {
+    BitSet::Blocks &get_blocks(BitSet &bitset) {
         return bitset.blocks_;
     }
 };
@@ -26,7 +31,7 @@ static int num_bits_set(uint64_t value) {
 
 TEST_F(BitSetTest, Basic) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
     EXPECT_EQ(bitset.size(), 0);
     EXPECT_EQ(blocks.size(), 0);
 }
@@ -35,7 +40,7 @@ TEST_F(BitSetTest, Basic) {
 TEST_F(BitSetTest, set1) {
     for (int pos = 0; pos <= 63; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 1);
         EXPECT_EQ(blocks[0],  1LL << pos);
@@ -47,7 +52,7 @@ TEST_F(BitSetTest, set1) {
 TEST_F(BitSetTest, set2) {
     for (int pos = 128; pos <= 191; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 3);
         EXPECT_EQ(blocks[0], 0 );
@@ -61,7 +66,7 @@ TEST_F(BitSetTest, set2) {
 TEST_F(BitSetTest, set3)  {
     for (int pos = 0; pos <= 1023; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), pos / 64 + 1);
         EXPECT_EQ(blocks[pos / 64], 1LL << (pos % 64));
@@ -72,7 +77,7 @@ TEST_F(BitSetTest, set3)  {
 // Set all bits within block idx 1 and verify.
 TEST_F(BitSetTest, set4) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
     for (int pos = 64; pos <= 127; pos++) {
         bitset.set(pos);
     }
@@ -85,7 +90,7 @@ TEST_F(BitSetTest, set4) {
 TEST_F(BitSetTest, reset1) {
     for (int pos = 0; pos <= 63; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 1);
         bitset.reset(pos);
@@ -97,7 +102,7 @@ TEST_F(BitSetTest, reset1) {
 TEST_F(BitSetTest, reset2) {
     for (int pos = 64; pos <= 127; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 2);
         bitset.reset(pos);
@@ -109,7 +114,7 @@ TEST_F(BitSetTest, reset2) {
 TEST_F(BitSetTest, reset3) {
     for (int pos = 0; pos <= 1023; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), pos / 64 + 1);
         bitset.reset(pos);
@@ -121,7 +126,7 @@ TEST_F(BitSetTest, reset3) {
 TEST_F(BitSetTest, reset4)  {
     for (int pos = 64; pos <= 127; pos++) {
         BitSet bitset;
-        vector<uint64_t> &blocks = get_blocks(bitset);
+        BitSet::Blocks &blocks = get_blocks(bitset);
         bitset.set(pos);
         EXPECT_EQ(blocks.size(), 2);
         bitset.reset(128);
@@ -133,7 +138,7 @@ TEST_F(BitSetTest, reset4)  {
 //  Set bits 0-127 and reset 0-63.
 TEST_F(BitSetTest, reset5) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
     for (int pos = 0; pos <= 127; pos++) {
         bitset.set(pos);
     }
@@ -150,7 +155,7 @@ TEST_F(BitSetTest, reset5) {
 //  Set bits 0-127 and reset 64-127.
 TEST_F(BitSetTest, reset6) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
     for (int pos = 0; pos <= 127; pos++) {
         bitset.set(pos);
     }
@@ -169,7 +174,7 @@ TEST_F(BitSetTest, reset6) {
 // Clear an empty BitSet.
 TEST_F(BitSetTest, clear1) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
     bitset.clear();
     EXPECT_EQ(blocks.size(), 0);
 }
@@ -178,7 +183,7 @@ TEST_F(BitSetTest, clear1) {
 // Clear BitSet with first/last bit set in each idx.
 TEST_F(BitSetTest, clear2) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
 
     for (int idx = 0; idx < 32; idx++) {
         bitset.set(idx * 64);
@@ -198,7 +203,7 @@ TEST_F(BitSetTest, clear2) {
 // Clear BitSet with all bits set in idx 0 thru 15.
 TEST_F(BitSetTest, clear3) {
     BitSet bitset;
-    vector<uint64_t> &blocks = get_blocks(bitset);
+    BitSet::Blocks &blocks = get_blocks(bitset);
     for (int pos = 0; pos < 64 * 16 ; pos++) {
         bitset.set(pos);
     }
@@ -1836,6 +1841,91 @@ TEST_F(BitSetTest, String2) {
     }
 }
 
+// Copy and assign between bitsets kept inline and on the heap.
+TEST_F(BitSetTest, CopyAssign) {
+    for (int small = 0; small < 512; small += 37) {
+        for (int large = 0; large < 512; large += 41) {
+            BitSet lhs, rhs;
+            lhs.set(small);
+            rhs.set(large);
+            rhs.set(large / 2);
+            BitSet copy(rhs);
+            EXPECT_EQ(rhs, copy);
+            lhs = rhs;
+            EXPECT_EQ(rhs, lhs);
+            lhs = lhs;
+            EXPECT_EQ(rhs, lhs);
+            lhs.reset(large);
+            lhs.reset(large / 2);
+            EXPECT_TRUE(lhs.empty());
+            EXPECT_EQ(rhs, copy);
+        }
+    }
+}
+
+// Build a bitset of the given size with every 3rd bit set.
+static BitSet BenchBitSet(size_t size, size_t start) {
+    BitSet bitset;
+    for (size_t pos = start; pos < size; pos += 3) {
+        bitset.set(pos);
+    }
+    return bitset;
+}
+
+// Benchmark the operations used on peer sets by the export path for
+// typical peer set sizes. Runs a small number of iterations as part of
+// the unit tests; set BITSET_BENCH_COUNT to e.g. 1000000 for real numbers.
+TEST_F(BitSetTest, Bench) {
+    int count = task_util_bench_count("BITSET_BENCH_COUNT", 10000);
+
+    size_t sizes[] = { 16, 64, 128, 256, 1024, 4096 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        BitSet lhs = BenchBitSet(sizes[i], 0);
+        BitSet rhs = BenchBitSet(sizes[i], 1);
+        BitSet all = lhs | rhs;
+        size_t result = 0;
+
+        uint64_t start = UTCTimestampUsec();
+        for (int j = 0; j < count; j++) {
+            BitSet temp(lhs);
+            temp |= rhs;
+            result += temp.any();
+        }
+        uint64_t copy_or = UTCTimestampUsec() - start;
+
+        start = UTCTimestampUsec();
+        for (int j = 0; j < count; j++) {
+            BitSet temp = all & rhs;
+            result += temp.any();
+        }
+        uint64_t and_op = UTCTimestampUsec() - start;
+
+        start = UTCTimestampUsec();
+        for (int j = 0; j < count; j++) {
+            result += lhs.intersects(rhs);
+            result += all.Contains(rhs);
+        }
+        uint64_t test_ops = UTCTimestampUsec() - start;
+
+        int walk_count = std::max(count / (int) sizes[i], 1);
+        start = UTCTimestampUsec();
+        for (int j = 0; j < walk_count; j++) {
+            for (size_t pos = all.find_first(); pos != BitSet::npos;
+                 pos = all.find_next(pos)) {
+                result++;
+            }
+        }
+        uint64_t walk = UTCTimestampUsec() - start;
+        EXPECT_NE(0U, result);
+
+        cout << "bits " << sizes[i]
+             << " copy+or " << copy_or * 1000 / count << "ns"
+             << " and " << and_op * 1000 / count << "ns"
+             << " intersects+contains " << test_ops * 1000 / count << "ns"
+             << " walk " << walk * 1000 / walk_count << "ns" << endl;
+    }
+}
+
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <vector>
+
+#include "base/multibit_trie.h"
+#include "base/logging.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+class Route {
+public:
+    Route(uint32_t ip = 0, int len = 0)
+        : ip_(len ? ip & (0xFFFFFFFF << (32 - len)) : 0), len_(len) {
+    }
+
+    class RtKey {
+    public:
+        static std::size_t Length(Route *route) {
+            return route->len_;
+        }
+
+        static char ByteValue(Route *route, std::size_t i) {
+            return (route->ip_ >> (24 - 8 * i)) & 0xFF;
+        }
+    };
+
+    uint32_t ip_;
+    int len_;
+    Patricia::Node rtnode_;
+    Patricia::Node mbnode_;
+};
+
+typedef Patricia::Tree<Route, &Route::rtnode_, Route::RtKey> RouteTable;
+typedef Patricia::MultibitTree<Route, &Route::mbnode_, Route::RtKey>
+    MultibitRouteTable;
+
+// Prefix lengths are drawn from a distribution similar to an Internet
+// routing table, where most prefixes are /16 to /24.
+static int RandomLength() {
+    static const int lengths[] = {
+        8, 12, 14, 15, 16, 16, 17, 18, 19, 20, 20, 21, 22, 22, 23, 23,
+        24, 24, 24, 24, 24, 24, 24, 25, 27, 28, 30, 31, 32, 32
+    };
+    return lengths[rand() % (sizeof(lengths) / sizeof(lengths[0]))];
+}
+
+static uint32_t RandomAddress() {
+    return ((uint32_t) rand() << 16) ^ (uint32_t) rand();
+}
+
+static void KeyBytes(uint32_t ip, uint8_t *bytes) {
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = (ip >> (24 - 8 * i)) & 0xFF;
+    }
+}
+
+class MultibitTrieTest : public ::testing::Test {
+protected:
+    virtual void TearDown() {
+        for (vector<Route *>::iterator it = routes_.begin();
+             it != routes_.end(); ++it) {
+            mbtree_.Remove(*it);
+            ptree_.Remove(*it);
+        }
+        STLDeleteValues(&routes_);
+    }
+
+    // Add a route to both tables unless it is already present.
+    Route *Add(uint32_t ip, int len) {
+        Route *route = new Route(ip, len);
+        if (!mbtree_.Insert(route)) {
+            delete route;
+            return NULL;
+        }
+        EXPECT_TRUE(ptree_.Insert(route));
+        routes_.push_back(route);
+        return route;
+    }
+
+    void Delete(Route *route) {
+        EXPECT_TRUE(mbtree_.Remove(route));
+        EXPECT_FALSE(mbtree_.Remove(route));
+        EXPECT_TRUE(ptree_.Remove(route));
+        routes_.erase(find(routes_.begin(), routes_.end(), route));
+        delete route;
+    }
+
+    // Compare the result of LPMFind on both tables for random host
+    // addresses and for addresses close to the routes in the table.
+    void VerifyLookups(int count) {
+        for (int i = 0; i < count; i++) {
+            uint32_t ip = RandomAddress();
+            if (!routes_.empty() && (i % 2)) {
+                ip = routes_[rand() % routes_.size()]->ip_ ^ (rand() & 0xFF);
+            }
+            Route key(ip, 32);
+            Route *match = ptree_.LPMFind(&key);
+            ASSERT_EQ(match, mbtree_.LPMFind(&key));
+            int len = 1 + rand() % 32;
+            Route short_key(ip, len);
+            Route *short_match = ptree_.LPMFind(&short_key);
+            ASSERT_EQ(short_match, mbtree_.LPMFind(&short_key));
+
+            // Key only lookups.
+            uint8_t bytes[4];
+            KeyBytes(ip, bytes);
+            ASSERT_EQ(match, ptree_.LPMFind(bytes, 32));
+            ASSERT_EQ(match, mbtree_.LPMFind(bytes, 32));
+            ASSERT_EQ(short_match, ptree_.LPMFind(bytes, len));
+            ASSERT_EQ(short_match, mbtree_.LPMFind(bytes, len));
+        }
+    }
+
+    RouteTable ptree_;
+    MultibitRouteTable mbtree_;
+    vector<Route *> routes_;
+};
+
+TEST_F(MultibitTrieTest, Basic) {
+    Route *rt8 = Add(0x0A000000, 8);
+    Route *rt16 = Add(0x0A010000, 16);
+    Route *rt20 = Add(0x0A011000, 20);
+    Route *rt32 = Add(0x0A011001, 32);
+    EXPECT_TRUE(Add(0x0A010000, 16) == NULL);
+    EXPECT_EQ(4U, mbtree_.Size());
+
+    Route key1(0x0A011001, 32);
+    EXPECT_EQ(rt32, mbtree_.LPMFind(&key1));
+    Route key2(0x0A011002, 32);
+    EXPECT_EQ(rt20, mbtree_.LPMFind(&key2));
+    Route key3(0x0A012002, 32);
+    EXPECT_EQ(rt16, mbtree_.LPMFind(&key3));
+    Route key4(0x0A020000, 32);
+    EXPECT_EQ(rt8, mbtree_.LPMFind(&key4));
+    Route key5(0x0B000000, 32);
+    EXPECT_TRUE(mbtree_.LPMFind(&key5) == NULL);
+
+    // Key shorter than the longer matching prefixes.
+    Route key6(0x0A011001, 18);
+    EXPECT_EQ(rt16, mbtree_.LPMFind(&key6));
+
+    Route *rt0 = Add(0, 0);
+    EXPECT_EQ(rt0, mbtree_.LPMFind(&key5));
+    Delete(rt0);
+    EXPECT_TRUE(mbtree_.LPMFind(&key5) == NULL);
+
+    Delete(rt20);
+    EXPECT_EQ(rt16, mbtree_.LPMFind(&key2));
+    Delete(rt32);
+    EXPECT_EQ(rt16, mbtree_.LPMFind(&key1));
+    Delete(rt16);
+    EXPECT_EQ(rt8, mbtree_.LPMFind(&key1));
+    Delete(rt8);
+    EXPECT_TRUE(mbtree_.LPMFind(&key1) == NULL);
+    EXPECT_EQ(1U, mbtree_.trie_nodes());
+}
+
+// Ordered operations behave as on Patricia::Tree.
+TEST_F(MultibitTrieTest, Ordered) {
+    srand(1);
+    for (int i = 0; i < 1000; i++) {
+        Add(RandomAddress(), RandomLength());
+    }
+    EXPECT_EQ(ptree_.Size(), mbtree_.Size());
+
+    Route *route = NULL;
+    Route *mbroute = NULL;
+    size_t count = 0;
+    do {
+        route = ptree_.GetNext(route);
+        mbroute = mbtree_.GetNext(mbroute);
+        EXPECT_EQ(route, mbroute);
+        count++;
+    } while (route);
+    EXPECT_EQ(mbtree_.Size() + 1, count);
+
+    for (vector<Route *>::iterator it = routes_.begin();
+         it != routes_.end(); ++it) {
+        Route key((*it)->ip_, (*it)->len_);
+        EXPECT_EQ(*it, mbtree_.Find(&key));
+    }
+}
+
+// Random inserts and deletes, checking lookups against Patricia::Tree.
+TEST_F(MultibitTrieTest, Random) {
+    srand(2);
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < 5000; i++) {
+            Add(RandomAddress(), RandomLength());
+        }
+        for (int i = 0; i < 100; i++) {
+            Add(RandomAddress(), rand() % 33);
+        }
+        VerifyLookups(20000);
+
+        random_shuffle(routes_.begin(), routes_.end());
+        size_t remove_count = routes_.size() / 2;
+        for (size_t i = 0; i < remove_count; i++) {
+            Delete(routes_.back());
+        }
+        VerifyLookups(20000);
+    }
+
+    while (!routes_.empty()) {
+        Delete(routes_.back());
+    }
+    EXPECT_EQ(1U, mbtree_.trie_nodes());
+}
+
+// Compare LPMFind on Patricia::Tree and MultibitTree. Runs with a small
+// number of prefixes as part of the unit tests; set MULTIBIT_TRIE_BENCH_COUNT
+// to e.g. 200000 for meaningful numbers.
+TEST_F(MultibitTrieTest, Bench) {
+    int count = task_util_bench_count("MULTIBIT_TRIE_BENCH_COUNT", 10000);
+
+    srand(3);
+    uint64_t start = UTCTimestampUsec();
+    for (int i = 0; i < count; i++) {
+        Route *route = new Route(RandomAddress(), RandomLength());
+        if (ptree_.Insert(route)) {
+            routes_.push_back(route);
+        } else {
+            delete route;
+        }
+    }
+    uint64_t ptree_insert = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    for (vector<Route *>::iterator it = routes_.begin();
+         it != routes_.end(); ++it) {
+        mbtree_.Insert(*it);
+    }
+    uint64_t mbtree_insert = UTCTimestampUsec() - start;
+
+    const int kLookups = 1000000;
+    vector<Route> keys;
+    keys.reserve(kLookups);
+    for (int i = 0; i < kLookups; i++) {
+        uint32_t ip = RandomAddress();
+        if (i % 2) {
+            ip = routes_[rand() % routes_.size()]->ip_ | (rand() & 0xFF);
+        }
+        keys.push_back(Route(ip, 32));
+    }
+
+    start = UTCTimestampUsec();
+    size_t ptree_found = 0;
+    for (int i = 0; i < kLookups; i++) {
+        ptree_found += (ptree_.LPMFind(&keys[i]) != NULL);
+    }
+    uint64_t ptree_lookup = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    size_t mbtree_found = 0;
+    for (int i = 0; i < kLookups; i++) {
+        mbtree_found += (mbtree_.LPMFind(&keys[i]) != NULL);
+    }
+    uint64_t mbtree_lookup = UTCTimestampUsec() - start;
+    EXPECT_EQ(ptree_found, mbtree_found);
+
+    // Same lookups by key only, without a Route to search with.
+    vector<uint8_t> key_bytes(kLookups * 4);
+    for (int i = 0; i < kLookups; i++) {
+        KeyBytes(keys[i].ip_, &key_bytes[i * 4]);
+    }
+
+    start = UTCTimestampUsec();
+    ptree_found = 0;
+    for (int i = 0; i < kLookups; i++) {
+        ptree_found += (ptree_.LPMFind(&key_bytes[i * 4], 32) != NULL);
+    }
+    uint64_t ptree_key_lookup = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    mbtree_found = 0;
+    for (int i = 0; i < kLookups; i++) {
+        mbtree_found += (mbtree_.LPMFind(&key_bytes[i * 4], 32) != NULL);
+    }
+    uint64_t mbtree_key_lookup = UTCTimestampUsec() - start;
+    EXPECT_EQ(ptree_found, mbtree_found);
+
+    cout << "prefixes " << routes_.size() << " lookups " << kLookups << endl;
+    cout << "patricia  insert " << ptree_insert << "us lookup "
+         << ptree_lookup << "us key lookup " << ptree_key_lookup << "us"
+         << endl;
+    cout << "multibit  insert " << mbtree_insert << "us lookup "
+         << mbtree_lookup << "us key lookup " << mbtree_key_lookup
+         << "us trie nodes " << mbtree_.trie_nodes()
+         << " trie memory " << mbtree_.TrieMemory() << " bytes" << endl;
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    return RUN_ALL_TESTS();
+}
@@ -486,6 +486,27 @@ TEST_F(PatriciaTest, LPMFind1) {
     EXPECT_EQ(route->nexthop_, 4);
 }
 
+// Same lookups as LPMFind1, by key only.
+TEST_F(PatriciaTest, LPMFindKey) {
+    Rt rt_key[] = {{0x01010011, 32, 3},
+                   {0x01110101, 32, 2},
+                   {0x01010000, 16, 2},
+                   {0x01010001, 32, 4},
+                   {0x0b010109, 31, 55},
+                   {0x0c000000, 32, 1}
+                   };
+
+    for (std::size_t i = 0; i < sizeof(rt_key) / sizeof(rt_key[0]); i++) {
+        uint8_t key[4];
+        for (int j = 0; j < 4; j++) {
+            key[j] = (rt_key[i].ip >> (24 - 8 * j)) & 0xFF;
+        }
+        Route *route = itbl_->LPMFind(key, rt_key[i].len);
+        EXPECT_NE(route, (Route *)NULL);
+        EXPECT_EQ(route->nexthop_, rt_key[i].nh);
+    }
+}
+
 int main(int argc, char **argv) {
     LoggingInit();
     ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <boost/bind.hpp>
+
+#include "base/logging.h"
+#include "base/queue_task.h"
+#include "base/task.h"
+#include "base/test/task_test_util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+class QueueTaskTest : public ::testing::Test {
+protected:
+    QueueTaskTest()
+        : task_id_(TaskScheduler::GetInstance()->GetTaskId("test::Queue")),
+          work_usecs_(0), processed_(0) {
+    }
+
+public:
+    bool Callback(int entry) {
+        if (work_usecs_) {
+            usleep(work_usecs_);
+        }
+        processed_++;
+        return true;
+    }
+
+protected:
+    int task_id_;
+    int work_usecs_;
+    uint64_t processed_;
+};
+
+// Counters, high watermark and latency histogram. Entries are timed only in
+// adaptive mode.
+TEST_F(QueueTaskTest, Stats) {
+    WorkQueue<int> queue(task_id_, 0,
+                         boost::bind(&QueueTaskTest::Callback, this, _1));
+    queue.set_name("test::Stats");
+    queue.SetAdaptive(100000);
+
+    const uint64_t kCount = 100;
+    task_util::TaskSchedulerStop();
+    for (uint64_t i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    EXPECT_EQ(kCount, queue.HighWatermark());
+    EXPECT_EQ(kCount, queue.QueueCount());
+    usleep(10000);
+    task_util::TaskSchedulerStart();
+    task_util::WaitForIdle();
+
+    EXPECT_EQ(kCount, processed_);
+    EXPECT_EQ(kCount, queue.EnqueueCount());
+    EXPECT_EQ(kCount, queue.DequeueCount());
+    EXPECT_EQ(kCount, queue.HighWatermark());
+
+    vector<WorkQueueBase::Stats> stats_list;
+    WorkQueueBase::GetAllStats(&stats_list);
+    ASSERT_EQ(1U, stats_list.size());
+    const WorkQueueBase::Stats &stats = stats_list[0];
+    EXPECT_EQ("test::Stats", stats.name);
+    EXPECT_EQ(0U, stats.queue_count);
+    EXPECT_LT(0, stats.enqueue_rate);
+    uint64_t total = 0;
+    for (int i = 0; i < WorkQueueBase::kLatencyBuckets; i++) {
+        total += stats.latency[i];
+    }
+    EXPECT_EQ(kCount, total);
+    // Entries waited for the scheduler to be started.
+    EXPECT_EQ(0U, stats.latency[0]);
+    queue.Shutdown();
+}
+
+// Without adaptive mode the clock isn't read and no latency is recorded.
+TEST_F(QueueTaskTest, NoLatency) {
+    WorkQueue<int> queue(task_id_, 0,
+                         boost::bind(&QueueTaskTest::Callback, this, _1));
+    queue.set_name("test::NoLatency");
+
+    const uint64_t kCount = 10;
+    for (uint64_t i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    task_util::WaitForIdle();
+    EXPECT_EQ(kCount, processed_);
+
+    vector<WorkQueueBase::Stats> stats_list;
+    WorkQueueBase::GetAllStats(&stats_list);
+    ASSERT_EQ(1U, stats_list.size());
+    const WorkQueueBase::Stats &stats = stats_list[0];
+    EXPECT_EQ(kCount, stats.dequeues);
+    for (int i = 0; i < WorkQueueBase::kLatencyBuckets; i++) {
+        EXPECT_EQ(0U, stats.latency[i]);
+    }
+    queue.Shutdown();
+}
+
+// An expensive callback shrinks the batch to fit the time slice.
+TEST_F(QueueTaskTest, Adaptive) {
+    WorkQueue<int> queue(task_id_, 0,
+                         boost::bind(&QueueTaskTest::Callback, this, _1));
+    queue.SetAdaptive(2000);
+    work_usecs_ = 200;
+
+    const uint64_t kCount = 200;
+    for (uint64_t i = 0; i < kCount; i++) {
+        queue.Enqueue(i);
+    }
+    task_util::WaitForIdle();
+    EXPECT_EQ(kCount, processed_);
+    EXPECT_GE(queue.max_iterations(),
+              (size_t) WorkQueue<int>::kMinAdaptiveIterations);
+    EXPECT_LT(queue.max_iterations(), (size_t) WorkQueue<int>::kMaxIterations);
+    queue.Shutdown();
+}
+
+// Unnamed queues are not reported.
+TEST_F(QueueTaskTest, Registry) {
+    WorkQueue<int> queue(task_id_, 0,
+                         boost::bind(&QueueTaskTest::Callback, this, _1));
+    vector<WorkQueueBase::Stats> stats_list;
+    WorkQueueBase::GetAllStats(&stats_list);
+    EXPECT_EQ(0U, stats_list.size());
+
+    {
+        WorkQueue<int> named(task_id_, 1,
+                             boost::bind(&QueueTaskTest::Callback, this, _1));
+        named.set_name("test::Named");
+        WorkQueueBase::GetAllStats(&stats_list);
+        ASSERT_EQ(1U, stats_list.size());
+        EXPECT_EQ(1, stats_list[0].task_instance);
+        named.Shutdown();
+    }
+    stats_list.clear();
+    WorkQueueBase::GetAllStats(&stats_list);
+    EXPECT_EQ(0U, stats_list.size());
+    queue.Shutdown();
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <pthread.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <boost/foreach.hpp>
+#include <tbb/atomic.h>
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+static tbb::atomic<long> run_count;
+
+// Task that does no work. Used to measure the scheduler overhead.
+class NullTask : public Task {
+public:
+    NullTask(int task_id, int instance) : Task(task_id, instance) { }
+    virtual bool Run() {
+        run_count++;
+        return true;
+    }
+};
+
+// Task that records the number of concurrently running tasks of its own
+// kind and the kind it is mutually exclusive with.
+class ExclusionTask : public Task {
+public:
+    ExclusionTask(int task_id, tbb::atomic<int> *self,
+                  tbb::atomic<int> *other, tbb::atomic<int> *violations)
+        : Task(task_id), self_(self), other_(other), violations_(violations) {
+    }
+    virtual bool Run() {
+        (*self_)++;
+        if (*other_ != 0) {
+            (*violations_)++;
+        }
+        for (volatile int i = 0; i < 1000; i++) {
+        }
+        if (*other_ != 0) {
+            (*violations_)++;
+        }
+        (*self_)--;
+        run_count++;
+        return true;
+    }
+
+private:
+    tbb::atomic<int> *self_;
+    tbb::atomic<int> *other_;
+    tbb::atomic<int> *violations_;
+};
+
+// Task that records if two tasks of the same instance run concurrently.
+class InstanceTask : public Task {
+public:
+    InstanceTask(int task_id, int instance, tbb::atomic<int> *active,
+                 tbb::atomic<int> *violations)
+        : Task(task_id, instance), active_(active), violations_(violations) {
+    }
+    virtual bool Run() {
+        if ((*active_)++ != 0) {
+            (*violations_)++;
+        }
+        for (volatile int i = 0; i < 1000; i++) {
+        }
+        (*active_)--;
+        run_count++;
+        return true;
+    }
+
+private:
+    tbb::atomic<int> *active_;
+    tbb::atomic<int> *violations_;
+};
+
+struct ProducerArgs {
+    int task_id;
+    int count;
+};
+
+static void *ProducerRun(void *arg) {
+    ProducerArgs *args = static_cast<ProducerArgs *>(arg);
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    for (int i = 0; i < args->count; i++) {
+        scheduler->Enqueue(new NullTask(args->task_id, -1));
+    }
+    return NULL;
+}
+
+class TaskBenchTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        scheduler_ = TaskScheduler::GetInstance();
+        run_count = 0;
+    }
+
+    virtual void TearDown() {
+        scheduler_->set_locking_mode(TaskScheduler::GLOBAL_LOCK);
+    }
+
+    void WaitForRunCount(long expected) {
+        while (run_count < expected) {
+            usleep(100);
+        }
+        while (!scheduler_->IsEmpty()) {
+            usleep(100);
+        }
+    }
+
+    // Enqueue tasks_per_thread tasks from each of thread_count producer
+    // threads, each producer using its own task group. Returns the number
+    // of tasks enqueued and run per second.
+    double EnqueueThroughput(int thread_count, int tasks_per_thread) {
+        vector<ProducerArgs> args(thread_count);
+        for (int i = 0; i < thread_count; i++) {
+            ostringstream name;
+            name << "bench::Producer" << i;
+            args[i].task_id = scheduler_->GetTaskId(name.str());
+            args[i].count = tasks_per_thread;
+        }
+
+        run_count = 0;
+        uint64_t start = UTCTimestampUsec();
+        vector<pthread_t> thread_ids;
+        for (int i = 0; i < thread_count; i++) {
+            pthread_t tid;
+            pthread_create(&tid, NULL, &ProducerRun, &args[i]);
+            thread_ids.push_back(tid);
+        }
+        pthread_t tid;
+        BOOST_FOREACH(tid, thread_ids) { pthread_join(tid, NULL); }
+        WaitForRunCount((long) thread_count * tasks_per_thread);
+        uint64_t elapsed = UTCTimestampUsec() - start;
+
+        return (double) thread_count * tasks_per_thread * 1000000 /
+            (elapsed ? elapsed : 1);
+    }
+
+    TaskScheduler *scheduler_;
+};
+
+// Tasks of groups bound by a policy must still be mutually exclusive when
+// independent groups are scheduled under their own lock.
+TEST_F(TaskBenchTest, GroupLockPolicy) {
+    scheduler_->set_locking_mode(TaskScheduler::GROUP_LOCK);
+
+    int tid_a = scheduler_->GetTaskId("bench::PolicyA");
+    int tid_b = scheduler_->GetTaskId("bench::PolicyB");
+    int tid_c = scheduler_->GetTaskId("bench::Independent");
+    TaskPolicy policy;
+    policy.push_back(TaskExclusion(tid_b));
+    scheduler_->SetPolicy(tid_a, policy);
+
+    tbb::atomic<int> active_a, active_b, violations;
+    active_a = 0;
+    active_b = 0;
+    violations = 0;
+    tbb::atomic<int> active_inst[4];
+    for (int i = 0; i < 4; i++) {
+        active_inst[i] = 0;
+    }
+
+    const int kCount = 2000;
+    for (int i = 0; i < kCount; i++) {
+        scheduler_->Enqueue(
+            new ExclusionTask(tid_a, &active_a, &active_b, &violations));
+        scheduler_->Enqueue(
+            new ExclusionTask(tid_b, &active_b, &active_a, &violations));
+        scheduler_->Enqueue(
+            new InstanceTask(tid_c, i % 4, &active_inst[i % 4], &violations));
+    }
+    WaitForRunCount(3 * kCount);
+
+    EXPECT_EQ(0, violations);
+    EXPECT_NE(0U, scheduler_->group_lock_count());
+}
+
+// Stop/Start must hold back tasks of independent groups as well.
+TEST_F(TaskBenchTest, GroupLockStopStart) {
+    scheduler_->set_locking_mode(TaskScheduler::GROUP_LOCK);
+    int tid = scheduler_->GetTaskId("bench::StopStart");
+
+    scheduler_->Stop();
+    for (int i = 0; i < 100; i++) {
+        scheduler_->Enqueue(new NullTask(tid, i % 2 ? -1 : 1));
+    }
+    usleep(10000);
+    EXPECT_EQ(0, run_count);
+    EXPECT_FALSE(scheduler_->IsEmpty());
+    scheduler_->Start();
+    WaitForRunCount(100);
+    EXPECT_EQ(100, run_count);
+}
+
+// Benchmark enqueue throughput as the number of producer threads grows.
+// Number of tasks per producer can be overridden with TASK_BENCH_COUNT.
+TEST_F(TaskBenchTest, EnqueueThroughput) {
+    int tasks_per_thread = task_util_bench_count("TASK_BENCH_COUNT", 100000);
+
+    int max_threads = scheduler_->HardwareThreadCount();
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        scheduler_->set_locking_mode(TaskScheduler::GLOBAL_LOCK);
+        double global_rate = EnqueueThroughput(threads, tasks_per_thread);
+        scheduler_->set_locking_mode(TaskScheduler::GROUP_LOCK);
+        double group_rate = EnqueueThroughput(threads, tasks_per_thread);
+        cout << "threads " << threads
+             << " global_lock " << (uint64_t) global_rate << " tasks/s"
+             << " group_lock " << (uint64_t) group_rate << " tasks/s" << endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    return RUN_ALL_TESTS();
+}
@@ -4,6 +4,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <boost/bind.hpp>
 #include "tbb/task.h"
 #include "base/task.h"
 #include "base/logging.h"
@@ -1354,6 +1355,181 @@ TEST_F(TestUT, test9_1)
     EXPECT_TRUE(scheduler->IsEmpty());
 }
 
+/* Functions registered with AtRunExit are called once the task returns from
+ * Run(), in the order they were registered, and not outside of a task */
+class RunExitTask : public Task {
+public:
+    RunExitTask(std::vector<int> *order) : Task(93, 0), order_(order) { }
+    bool Run() {
+        EXPECT_TRUE(Task::AtRunExit(
+            boost::bind(&RunExitTask::Callback, order_, 1)));
+        EXPECT_TRUE(Task::AtRunExit(
+            boost::bind(&RunExitTask::Callback, order_, 2)));
+        order_->push_back(0);
+        return true;
+    }
+    static void Callback(std::vector<int> *order, int value) {
+        EXPECT_TRUE(Task::Running() != NULL);
+        order->push_back(value);
+    }
+private:
+    std::vector<int> *order_;
+};
+
+TEST_F(TestUT, test10_0)
+{
+    std::vector<int> order;
+    EXPECT_FALSE(Task::AtRunExit(
+        boost::bind(&RunExitTask::Callback, &order, 3)));
+    scheduler->Enqueue(new RunExitTask(&order));
+    for (int i = 0; i < 100 && !scheduler->IsEmpty(); i++) {
+        usleep(100000);
+    }
+    EXPECT_TRUE(scheduler->IsEmpty());
+    ASSERT_EQ(3U, order.size());
+    EXPECT_EQ(0, order[0]);
+    EXPECT_EQ(1, order[1]);
+    EXPECT_EQ(2, order[2]);
+}
+
+/* In GROUP_LOCK mode, tasks of a group that no policy refers to are scheduled
+ * under the group lock only. Tasks of the same instance must still not run
+ * concurrently, and policies must still be enforced. */
+class GroupLockTask : public Task {
+public:
+    GroupLockTask(int id, int inst, tbb::atomic<int> *self,
+                  tbb::atomic<int> *other, tbb::atomic<int> *violations)
+        : Task(id, inst), self_(self), other_(other), violations_(violations) {
+    }
+    bool Run() {
+        if ((*self_)++ != 0 && GetTaskInstance() != -1) {
+            (*violations_)++;
+        }
+        for (int i = 0; i < 10; i++) {
+            if (other_ != NULL && *other_ != 0) {
+                (*violations_)++;
+            }
+            usleep(10);
+        }
+        (*self_)--;
+        return true;
+    }
+private:
+    tbb::atomic<int> *self_;
+    tbb::atomic<int> *other_;
+    tbb::atomic<int> *violations_;
+};
+
+static void GroupLockWait() {
+    for (int i = 0; i < 100 && !scheduler->IsEmpty(); i++) {
+        usleep(100000);
+    }
+    EXPECT_TRUE(scheduler->IsEmpty());
+}
+
+/* Instances of a group without policy are mutually exclusive */
+TEST_F(TestUT, test11_0)
+{
+    scheduler->set_locking_mode(TaskScheduler::GROUP_LOCK);
+    uint64_t group_lock_count = scheduler->group_lock_count();
+
+    tbb::atomic<int> active[4];
+    tbb::atomic<int> violations;
+    violations = 0;
+    for (int i = 0; i < 4; i++) {
+        active[i] = 0;
+    }
+    for (int i = 0; i < 400; i++) {
+        scheduler->Enqueue(new GroupLockTask(94, i % 4, &active[i % 4], NULL,
+                                             &violations));
+    }
+    GroupLockWait();
+    EXPECT_EQ(0, violations);
+    EXPECT_LE(group_lock_count + 400, scheduler->group_lock_count());
+
+    scheduler->set_locking_mode(TaskScheduler::GLOBAL_LOCK);
+}
+
+/* Groups bound by a policy are scheduled under the scheduler mutex and
+ * remain mutually exclusive */
+TEST_F(TestUT, test11_1)
+{
+    TaskExclusion       rule[] = { TaskExclusion(96) };
+    TaskPolicy          policy;
+
+    InitPolicy(rule, sizeof(rule)/ sizeof(TaskExclusion), &policy);
+    scheduler->SetPolicy(95, policy);
+    scheduler->set_locking_mode(TaskScheduler::GROUP_LOCK);
+    uint64_t group_lock_count = scheduler->group_lock_count();
+
+    tbb::atomic<int> active_95, active_96;
+    tbb::atomic<int> violations;
+    active_95 = 0;
+    active_96 = 0;
+    violations = 0;
+    for (int i = 0; i < 200; i++) {
+        scheduler->Enqueue(new GroupLockTask(95, -1, &active_95, &active_96,
+                                             &violations));
+        scheduler->Enqueue(new GroupLockTask(96, -1, &active_96, &active_95,
+                                             &violations));
+    }
+    GroupLockWait();
+    EXPECT_EQ(0, violations);
+    EXPECT_EQ(group_lock_count, scheduler->group_lock_count());
+
+    scheduler->set_locking_mode(TaskScheduler::GLOBAL_LOCK);
+}
+
+/* A policy set while a task of a group without policy is running applies to
+ * that task */
+class GroupLockHoldTask : public Task {
+public:
+    GroupLockHoldTask(int id, tbb::atomic<bool> *started,
+                      tbb::atomic<bool> *release)
+        : Task(id), started_(started), release_(release) {
+    }
+    bool Run() {
+        *started_ = true;
+        for (int i = 0; i < 1000 && !*release_; i++) {
+            usleep(10000);
+        }
+        return true;
+    }
+private:
+    tbb::atomic<bool> *started_;
+    tbb::atomic<bool> *release_;
+};
+
+TEST_F(TestUT, test11_2)
+{
+    scheduler->set_locking_mode(TaskScheduler::GROUP_LOCK);
+
+    tbb::atomic<bool> started_97, release_97, started_98, release_98;
+    started_97 = false;
+    release_97 = false;
+    started_98 = false;
+    release_98 = true;
+    scheduler->Enqueue(new GroupLockHoldTask(97, &started_97, &release_97));
+    for (int i = 0; i < 100 && !started_97; i++) {
+        usleep(10000);
+    }
+    ASSERT_TRUE(started_97);
+
+    TaskExclusion       rule[] = { TaskExclusion(97) };
+    TaskPolicy          policy;
+    InitPolicy(rule, sizeof(rule)/ sizeof(TaskExclusion), &policy);
+    scheduler->SetPolicy(98, policy);
+    scheduler->Enqueue(new GroupLockHoldTask(98, &started_98, &release_98));
+    usleep(100000);
+    EXPECT_FALSE(started_98);
+
+    release_97 = true;
+    GroupLockWait();
+    EXPECT_TRUE(started_98);
+
+    scheduler->set_locking_mode(TaskScheduler::GLOBAL_LOCK);
+}
+
 int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
@@ -113,6 +113,15 @@ static inline unsigned long long int task_util_retry_count() {
     return retry;
 }
 
+// Number of iterations of a benchmark: the value of the environment variable
+// name if it is set, default_count otherwise. Benchmarks that run as part of
+// the unit tests default to a small count.
+static inline unsigned long task_util_bench_count(const char *name,
+                                                  unsigned long default_count) {
+    char *str = getenv(name);
+    return str ? strtoul(str, NULL, 0) : default_count;
+}
+
 #define TASK_UTIL_EXPECT_EQ(expected, actual) \
     TASK_UTIL_WAIT_EQ(expected, actual, task_util_wait_time(), \
                       task_util_retry_count(), "")
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <iostream>
+#include <vector>
+#include <tbb/atomic.h>
+
+#include "base/logging.h"
+#include "base/timer.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "io/test/event_manager_test.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+static tbb::atomic<long> fire_count;
+
+static bool TimerFire() {
+    fire_count++;
+    return false;
+}
+
+class TimerBenchTest : public ::testing::Test {
+protected:
+    TimerBenchTest() : evm_(new EventManager()) {
+    }
+
+    virtual void SetUp() {
+        thread_.reset(new ServerThread(evm_.get()));
+        thread_->Start();
+        fire_count = 0;
+
+        count_ = task_util_bench_count("TIMER_BENCH_COUNT", 100000);
+        for (int i = 0; i < count_; i++) {
+            timers_.push_back(TimerManager::CreateTimer(*evm_->io_service(),
+                "bench::Timer", Timer::GetTimerTaskId(), i % 8));
+        }
+    }
+
+    virtual void TearDown() {
+        task_util::WaitForIdle();
+        for (size_t i = 0; i < timers_.size(); i++) {
+            TimerManager::DeleteTimer(timers_[i]);
+        }
+        timers_.clear();
+        task_util::WaitForIdle();
+        evm_->Shutdown();
+        if (thread_.get() != NULL) {
+            thread_->Join();
+        }
+        task_util::WaitForIdle();
+    }
+
+    int count_;
+    vector<Timer *> timers_;
+    auto_ptr<ServerThread> thread_;
+    auto_ptr<EventManager> evm_;
+};
+
+// Benchmark the start and cancel of timers that never expire, like the
+// hold timers of established peers. Number of timers can be overridden
+// with TIMER_BENCH_COUNT.
+TEST_F(TimerBenchTest, StartCancel) {
+    uint64_t start = UTCTimestampUsec();
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < count_; i++) {
+            timers_[i]->Start(60000 + i % 1000, TimerFire);
+        }
+        for (int i = 0; i < count_; i++) {
+            timers_[i]->Cancel();
+        }
+    }
+    uint64_t elapsed = UTCTimestampUsec() - start;
+    EXPECT_EQ(0, fire_count);
+    cout << "timers " << count_ << " start/cancel "
+         << (uint64_t) ((double) 10 * count_ * 1000000 /
+                        (elapsed ? elapsed : 1))
+         << " timers/s" << endl;
+}
+
+// Benchmark the expiry of timers spread over one second.
+TEST_F(TimerBenchTest, Expiry) {
+    uint64_t start = UTCTimestampUsec();
+    for (int i = 0; i < count_; i++) {
+        timers_[i]->Start(i % 1000, TimerFire);
+    }
+    TASK_UTIL_EXPECT_EQ(count_, fire_count);
+    uint64_t elapsed = UTCTimestampUsec() - start;
+    cout << "timers " << count_ << " expired in " << elapsed / 1000
+         << " msec" << endl;
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    LoggingInit();
+    return RUN_ALL_TESTS();
+}
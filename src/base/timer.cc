@@ -4,74 +4,394 @@
 
 #include "base/timer.h"
 
+#include <time.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
 class Timer::TimerTask : public Task {
 public:
-    TimerTask(TimerPtr timer, boost::system::error_code ec)
-        : Task(timer->task_id_, timer->task_instance_), timer_(timer), ec_(ec) {
+    typedef std::vector<std::pair<TimerPtr, uint64_t> > TimerList;
+
+    TimerTask(int task_id, int task_instance, boost::system::error_code ec)
+        : Task(task_id, task_instance), ec_(ec) {
     }
 
     virtual ~TimerTask() {
     }
 
-    // Invokes user callback.
-    // Timer could have been cancelled or delete when task was enqueued
+    void AddTimer(TimerPtr timer, uint64_t generation) {
+        timers_.push_back(std::make_pair(timer, generation));
+    }
+
+    // Invokes user callback of all the timers.
+    // Timer could have been cancelled, restarted or deleted after it expired
     virtual bool Run() {
+        for (TimerList::iterator it = timers_.begin(); it != timers_.end();
+             ++it) {
+            Fire(it->first.get(), it->second);
+        }
+        return true;
+    }
+
+private:
+    void Fire(Timer *timer, uint64_t generation) {
         {
-            tbb::mutex::scoped_lock lock(timer_->mutex_);
+            tbb::mutex::scoped_lock lock(timer->mutex_);
 
-            // Handle timer Cancelled when it was enqueued to TBB
-            // Removes Task reference
-            if (timer_->state_ == Timer::Cancelled) {
-                return true;
+            // Handle timer Cancelled, or Cancelled and Started again, after
+            // it expired.
+            if (timer->state_ != Timer::Running ||
+                timer->generation_ != generation) {
+                return;
             }
 
             // Conditions to invoke user callback met. Fire it
-            timer_->SetState(Timer::Fired);
+            timer->SetState(Timer::Fired);
         }
 
         bool restart = false;
 
         // TODO: Is this error needed by user?
-        if (ec_ && !timer_->error_handler_.empty()) {
-            timer_->error_handler_(timer_->name_,
-                                   std::string(ec_.category().name()),
-                                   ec_.message());
+        if (ec_ && !timer->error_handler_.empty()) {
+            timer->error_handler_(timer->name_,
+                                  std::string(ec_.category().name()),
+                                  ec_.message());
         } else {
-            restart = timer_->handler_();
+            restart = timer->handler_();
         }
 
-        OnTaskCancel();
+        {
+            tbb::mutex::scoped_lock lock(timer->mutex_);
+            timer->SetState(Timer::Init);
+        }
 
         if (restart) {
-            timer_->Start(timer_->time_, timer_->handler_,
-                          timer_->error_handler_);
+            timer->Start(timer->time_, timer->handler_,
+                         timer->error_handler_);
         }
-        return true;
     }
 
-    // Task Cancelled/Destroyed when it was Fired.
-    void OnTaskCancel() {
-        tbb::mutex::scoped_lock lock(timer_->mutex_);
+    TimerList timers_;
+    boost::system::error_code ec_;
+    DISALLOW_COPY_AND_ASSIGN(TimerTask);
+};
+
+//
+// Time traits of the timer that drives the wheel. Time is kept in
+// microseconds of the monotonic clock, so that changes to the system time
+// neither fire the timers early nor hold them back.
+//
+struct MonotonicTimeTraits {
+    typedef uint64_t time_type;
+    typedef int64_t duration_type;
+
+    static time_type now() {
+#ifdef __APPLE__
+        static mach_timebase_info_data_t info;
+        if (info.denom == 0) {
+            mach_timebase_info(&info);
+        }
+        return mach_absolute_time() * info.numer / info.denom / 1000;
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+    }
+    static time_type add(time_type t, duration_type d) { return t + d; }
+    static duration_type subtract(time_type t1, time_type t2) {
+        return t1 - t2;
+    }
+    static bool less_than(time_type t1, time_type t2) { return t1 < t2; }
+    static boost::posix_time::time_duration to_posix_duration(
+        duration_type d) {
+        return boost::posix_time::microseconds(d);
+    }
+};
+
+//
+// Hierarchical timer wheel shared by all the Timers of an io_service.
+//
+// The wheel has kLevels levels of kSlots slots. The slots of level 0 are
+// one tick (millisecond) apart, and each slot of a level covers all the
+// slots of the level below. A timer is put in the level 0 slot of its
+// expiry tick if it expires within kSlots ticks, else in the slot of the
+// lowest level that covers its expiry. Whenever the current tick wraps
+// around a level, the timers in the next slot of the level above are
+// cascaded down. Starting and cancelling a timer are constant time.
+//
+// A single timer on the monotonic clock, armed only while there are timers
+// on the wheel, advances the wheel. Runs of empty slots are skipped, and if
+// the driver fires more than a turn of level 0 past the tick it was armed
+// for, all the timers are put back on the wheel at once rather than
+// stepping through every tick.
+// The timers that expire are handed to one TimerTask per task id and task
+// instance.
+//
+// The wheel is an io_service service, so that it goes away along with the
+// io_service.
+//
+class TimerWheel : public boost::asio::io_service::service {
+public:
+    static boost::asio::io_service::id id;
+
+    static const int kLevels = 4;
+    static const int kSlotBits = 8;
+    static const int kSlots = 1 << kSlotBits;
+    static const uint64_t kSlotMask = kSlots - 1;
+
+    explicit TimerWheel(boost::asio::io_service &service)
+        : boost::asio::io_service::service(service),
+          driver_(service),
+          start_(MonotonicTimeTraits::now()),
+          tick_(0), armed_(0), count_(0), shutdown_(false) {
+    }
+
+    virtual ~TimerWheel() {
+    }
+
+    // Put the timer on the wheel to expire in time msec. Adds a reference
+    // to the timer. Called with the timer mutex held.
+    void Add(Timer *timer, int time) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        if (shutdown_) {
+            return;
+        }
 
-        if (timer_->timer_task_ != this) {
-            assert(!timer_->timer_task_);
+        // Round up, the timer must not expire early.
+        uint64_t expiry = (Now() + 999) / 1000 + time;
+        if (expiry <= tick_) {
+            expiry = tick_ + 1;
         }
+        timer->expiry_ = expiry;
+        timer->generation_++;
+        intrusive_ptr_add_ref(timer);
+        Insert(timer);
+        count_++;
+
+        if (armed_ == 0 || expiry < armed_) {
+            Arm(expiry);
+        }
+    }
 
-        timer_->timer_task_ = NULL;
-        timer_->SetState(Timer::Init);
+    // Take the timer off the wheel. Returns true if it was on the wheel, in
+    // which case the caller must drop the reference of the wheel after
+    // releasing the timer mutex. Called with the timer mutex held.
+    bool Remove(Timer *timer) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        if (!timer->wheel_node_.is_linked()) {
+            return false;
+        }
+        timer->wheel_node_.unlink();
+        count_--;
+        return true;
     }
 
 private:
-    TimerPtr timer_;
-    boost::system::error_code ec_;
-    DISALLOW_COPY_AND_ASSIGN(TimerTask);
+    typedef boost::intrusive::member_hook<Timer, Timer::WheelHook,
+            &Timer::wheel_node_> WheelMember;
+    typedef boost::intrusive::list<Timer, WheelMember,
+            boost::intrusive::constant_time_size<false> > Slot;
+    typedef std::vector<std::pair<Timer::TimerPtr, uint64_t> > ExpiredList;
+    typedef std::map<std::pair<int, int>, Timer::TimerTask *> TaskMap;
+    typedef boost::asio::basic_deadline_timer<uint64_t,
+            MonotonicTimeTraits> DriverTimer;
+
+    virtual void shutdown_service() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        shutdown_ = true;
+        boost::system::error_code ec;
+        driver_.cancel(ec);
+        for (int level = 0; level < kLevels; level++) {
+            for (int slot = 0; slot < kSlots; slot++) {
+                while (!slots_[level][slot].empty()) {
+                    Timer *timer = &slots_[level][slot].front();
+                    slots_[level][slot].pop_front();
+                    intrusive_ptr_release(timer);
+                }
+            }
+        }
+        count_ = 0;
+    }
+
+    // Microseconds since the wheel was created.
+    uint64_t Now() const {
+        return MonotonicTimeTraits::now() - start_;
+    }
+
+    void Insert(Timer *timer) {
+        uint64_t delta = timer->expiry_ - tick_;
+        int level = 0;
+        while (level < kLevels - 1 &&
+               delta >= (1ULL << ((level + 1) * kSlotBits))) {
+            level++;
+        }
+        uint64_t slot = (timer->expiry_ >> (level * kSlotBits)) & kSlotMask;
+        slots_[level][slot].push_back(*timer);
+    }
+
+    void Cascade(int level, uint64_t slot) {
+        Slot list;
+        list.swap(slots_[level][slot]);
+        while (!list.empty()) {
+            Timer *timer = &list.front();
+            list.pop_front();
+            Insert(timer);
+        }
+    }
+
+    // Take all the timers off the wheel and move the wheel to the given
+    // tick. Timers that expired by then are collected, the others are put
+    // back on the wheel.
+    void Rebuild(uint64_t tick, ExpiredList *expired) {
+        Slot list;
+        for (int level = 0; level < kLevels; level++) {
+            for (int slot = 0; slot < kSlots; slot++) {
+                list.splice(list.end(), slots_[level][slot]);
+            }
+        }
+        tick_ = tick;
+        while (!list.empty()) {
+            Timer *timer = &list.front();
+            list.pop_front();
+            if (timer->expiry_ <= tick_) {
+                count_--;
+                expired->push_back(std::make_pair(Timer::TimerPtr(timer, false),
+                                                  timer->generation_));
+            } else {
+                Insert(timer);
+            }
+        }
+    }
+
+    // Process all ticks up to the given tick and collect the expired
+    // timers, along with the reference of the wheel. The driver may be
+    // armed up to a turn of level 0 ahead, so lateness is measured against
+    // the armed tick rather than the last tick processed.
+    void Advance(uint64_t tick, uint64_t armed, ExpiredList *expired) {
+        if (tick <= tick_) {
+            return;
+        }
+        uint64_t base = std::max(tick_, armed);
+        if (count_ != 0 && tick > base + kSlots) {
+            Rebuild(tick, expired);
+            return;
+        }
+        while (tick_ < tick) {
+            if (count_ == 0) {
+                tick_ = tick;
+                break;
+            }
+
+            // Skip the empty slots of level 0, up to the next cascade.
+            uint64_t next = tick_ + 1;
+            while (next < tick && (next & kSlotMask) != 0 &&
+                   slots_[0][next & kSlotMask].empty()) {
+                next++;
+            }
+            tick_ = next;
+            for (int level = 1; level < kLevels; level++) {
+                if ((tick_ >> ((level - 1) * kSlotBits)) & kSlotMask) {
+                    break;
+                }
+                Cascade(level, (tick_ >> (level * kSlotBits)) & kSlotMask);
+            }
+            Slot &slot = slots_[0][tick_ & kSlotMask];
+            while (!slot.empty()) {
+                Timer *timer = &slot.front();
+                slot.pop_front();
+                count_--;
+                expired->push_back(std::make_pair(Timer::TimerPtr(timer, false),
+                                                  timer->generation_));
+            }
+        }
+    }
+
+    void Arm(uint64_t tick) {
+        armed_ = tick;
+        boost::system::error_code ec;
+        driver_.expires_at(start_ + tick * 1000, ec);
+        driver_.async_wait(boost::bind(&TimerWheel::Run, this,
+                                       boost::asio::placeholders::error));
+    }
+
+    // Arm the driver for the next tick with timers to expire or cascade.
+    void ArmNext() {
+        if (count_ == 0) {
+            return;
+        }
+        uint64_t tick = tick_ + 1;
+        for (int i = 1; i < kSlots; i++, tick++) {
+            if ((tick & kSlotMask) == 0 ||
+                !slots_[0][tick & kSlotMask].empty()) {
+                break;
+            }
+        }
+        Arm(tick);
+    }
+
+    // ASIO callback on driver expiry. Start a task per task id and instance
+    // to serve the expired timers.
+    void Run(const boost::system::error_code &ec) {
+        if (ec && ec.value() == boost::asio::error::operation_aborted) {
+            return;
+        }
+
+        ExpiredList expired;
+        {
+            tbb::mutex::scoped_lock lock(mutex_);
+            if (shutdown_) {
+                return;
+            }
+            uint64_t armed = armed_;
+            armed_ = 0;
+            Advance(Now() / 1000, armed, &expired);
+            ArmNext();
+        }
+
+        TaskMap tasks;
+        for (ExpiredList::iterator it = expired.begin(); it != expired.end();
+             ++it) {
+            Timer *timer = it->first.get();
+            std::pair<int, int> key(timer->task_id_, timer->task_instance_);
+            TaskMap::iterator loc = tasks.find(key);
+            if (loc == tasks.end()) {
+                loc = tasks.insert(std::make_pair(key, new Timer::TimerTask(
+                    timer->task_id_, timer->task_instance_, ec))).first;
+            }
+            loc->second->AddTimer(it->first, it->second);
+        }
+
+        TaskScheduler *scheduler = TaskScheduler::GetInstance();
+        for (TaskMap::iterator it = tasks.begin(); it != tasks.end(); ++it) {
+            scheduler->Enqueue(it->second);
+        }
+    }
+
+    tbb::mutex mutex_;
+    DriverTimer driver_;
+    uint64_t start_;    // Monotonic time the wheel was created, in usec
+    uint64_t tick_;     // Last tick processed
+    uint64_t armed_;    // Tick the driver is armed for, 0 if not armed
+    size_t count_;      // Number of timers on the wheel
+    bool shutdown_;
+    Slot slots_[kLevels][kSlots];
 };
 
+boost::asio::io_service::id TimerWheel::id;
+
 Timer::Timer(boost::asio::io_service &service, const std::string &name,
           int task_id, int task_instance)
-    : boost::asio::deadline_timer(service), name_(name), handler_(NULL),
-    error_handler_(NULL), state_(Init), timer_task_(NULL), time_(0),
-    task_id_(task_id), task_instance_(task_instance) {
+    : name_(name), handler_(NULL),
+    error_handler_(NULL), state_(Init), time_(0),
+    task_id_(task_id), task_instance_(task_instance),
+    wheel_(&boost::asio::use_service<TimerWheel>(service)),
+    expiry_(0), generation_(0) {
     refcount_ = 0;
 }
 
@@ -98,59 +418,34 @@ bool Timer::Start(int time, Handler handler, ErrorHandler error_handler) {
     // Restart the timer
     handler_ = handler;
     error_handler_ = error_handler;
-    boost::system::error_code ec;
-    expires_from_now(boost::posix_time::milliseconds(time), ec);
-    if (ec) {
-        return false;
-    }
-
+    time_ = time;
     SetState(Running);
-    async_wait(boost::bind(Timer::StartTimerTask, this, TimerPtr(this), time,
-                            boost::asio::placeholders::error));
+    wheel_->Add(this, time);
     return true;
 }
 
 // Cancel a running timer
 bool Timer::Cancel() {
-    tbb::mutex::scoped_lock lock(mutex_);
-
-    // A fired timer cannot be cancelled
-    if (state_ == Fired) {
-        return false;
-    }
-
-    // Cancel Task. If Task cancel succeeds, there will be no callback.
-    // Reset TaskRef if call succeeds.
-    if (timer_task_) {
-        TaskScheduler::CancelReturnCode rc = 
-            TaskScheduler::GetInstance()->Cancel(timer_task_);
-        assert(rc != TaskScheduler::FAILED);
-        timer_task_ = NULL;
-    }
+    bool removed;
+    {
+        tbb::mutex::scoped_lock lock(mutex_);
 
-    SetState(Cancelled);
-    return true;
-}
-
-// ASIO callback on timer expiry. Start a task to serve the timer
-void Timer::StartTimerTask(boost::asio::deadline_timer* t, TimerPtr timer,
-                           int time, const boost::system::error_code &ec) {
-    tbb::mutex::scoped_lock lock(timer->mutex_);
+        // A fired timer cannot be cancelled
+        if (state_ == Fired) {
+            return false;
+        }
 
-    if (timer->state_ == Cancelled) {
-        return;
+        // Take the timer off the wheel. If it has already expired, the task
+        // skips it since it's not Running anymore.
+        removed = wheel_->Remove(this);
+        SetState(Cancelled);
     }
 
-    // If timer was cancelled, no callback is invoked
-    if (ec && ec.value() == boost::asio::error::operation_aborted) {
-        return;
+    // Drop the reference of the wheel.
+    if (removed) {
+        intrusive_ptr_release(this);
     }
-
-    // Start a task and add Task reference.
-    assert(timer->timer_task_ == NULL);
-    timer->timer_task_ = new TimerTask(timer, ec);
-    timer->time_ = time;
-    TaskScheduler::GetInstance()->Enqueue(timer->timer_task_);
+    return true;
 }
 
 //
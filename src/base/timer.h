@@ -3,8 +3,10 @@
  */
 
 //  Timer implementation using ASIO and Task infrastructure. 
-//  Registers an ASIO timer. On ASIO timer expiry, a task will be created to
-//  run the timer. Supports user specified task-id.
+//  Registers the timer on a timer wheel shared by all the timers of the
+//  io_service. The wheel is driven by a single ASIO timer on the monotonic
+//  clock. On each tick, a task is created per task-id and task instance to
+//  run the timers that expired in the tick. Supports user specified task-id.
 //
 //  Operations supported
 //  - Create a timer by allocating an object of type Timer
@@ -15,8 +17,8 @@
 //    There can be atmost one "Task" outstanding for the timer.
 //
 //  - Cancel a timer
-//    Cancels a running timer. Both ASIO registerations and task spawned will
-//    be cancelled.
+//    Cancels a running timer. The timer is taken off the timer wheel, and
+//    is skipped by the task if it has already expired.
 //
 //    If timer is already fired, "Cancel" api will fail and return 'false'
 //
@@ -28,9 +30,10 @@
 //  - Timer is allocated by application
 //  - Applications must call TimerManager::DeleteTimer() to delete the timer
 //  - All operations on timer are protected by mutex
-//  - When timer is running, it can have references from ASIO and Task. 
-//    Timer class will keep of reference from ASIO and Task. Timer will
-//    be deleted when both the references go away. (via intrusive pointer)
+//  - When timer is running, it can have references from the timer wheel and
+//    Task. Timer class will keep of reference from the wheel and Task. Timer
+//    will be deleted when both the references go away. (via intrusive
+//    pointer)
 //
 
 #ifndef TIMER_H_
@@ -41,16 +44,20 @@
 #include <boost/asio/placeholders.hpp>
 #include <boost/bind.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/intrusive/list.hpp>
 #include <boost/function.hpp>
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 #include <set>
 
 #include <base/task.h>
+#include <base/util.h>
 
-class Timer : public boost::asio::deadline_timer {
+class TimerWheel;
+
+class Timer {
 private:
-	// Task used to fire the timer
+	// Task used to fire the timers that expired in a tick
     class TimerTask;
 
 public:
@@ -106,6 +113,7 @@ public:
 private:
     friend class TimerManager;
     friend class TimerTest;
+    friend class TimerWheel;
 
     friend void intrusive_ptr_add_ref(Timer *timer);
     friend void intrusive_ptr_release(Timer *timer);
@@ -118,9 +126,8 @@ private:
         Cancelled       = 3,
     };
 
-    // ASIO callback on timer expiry. Start a task to serve the timer
-    static void StartTimerTask(boost::asio::deadline_timer* t, TimerPtr t_ptr,
-                               int time, const boost::system::error_code &ec);
+    typedef boost::intrusive::list_member_hook<
+        boost::intrusive::link_mode<boost::intrusive::auto_unlink> > WheelHook;
 
     void SetState(TimerState s) { state_ = s; }
     static int GetTimerInstanceId() { return -1; }
@@ -139,11 +146,18 @@ private:
     ErrorHandler error_handler_;
     mutable tbb::mutex mutex_;
     TimerState state_;
-    TimerTask *timer_task_;
     int time_;
     int task_id_;
     int task_instance_;
     tbb::atomic<int> refcount_;
+
+    // Timer wheel state, protected by the mutex of both timer and wheel.
+    TimerWheel *wheel_;
+    WheelHook wheel_node_;
+    uint64_t expiry_;       // Tick of the wheel at which the timer expires
+    uint64_t generation_;   // Incremented every time it's put on the wheel
+
+    DISALLOW_COPY_AND_ASSIGN(Timer);
 };
 
 inline void intrusive_ptr_add_ref(Timer *timer) {
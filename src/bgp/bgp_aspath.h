@@ -113,13 +113,20 @@ public:
 
     friend std::size_t hash_value(AsPath const &as_path) {
         size_t hash = 0;
-        boost::hash_combine(hash, as_path.path().ToString());
+        const AsPathSpec &spec = as_path.path();
+        for (size_t i = 0; i < spec.path_segments.size(); i++) {
+            const AsPathSpec::PathSegment *ps = spec.path_segments[i];
+            boost::hash_combine(hash, ps->path_segment_type);
+            boost::hash_range(hash, ps->path_segment.begin(),
+                              ps->path_segment.end());
+        }
         return hash;
     }
 
 private:
     friend int intrusive_ptr_add_ref(const AsPath *cpath);
     friend int intrusive_ptr_del_ref(const AsPath *cpath);
+    friend bool intrusive_ptr_try_add_ref(const AsPath *cpath);
     friend void intrusive_ptr_release(const AsPath *cpath);
 
     mutable tbb::atomic<int> refcount_;
@@ -135,6 +142,16 @@ inline int intrusive_ptr_del_ref(const AsPath *cpath) {
     return cpath->refcount_.fetch_and_decrement();
 }
 
+inline bool intrusive_ptr_try_add_ref(const AsPath *cpath) {
+    int count = cpath->refcount_;
+    while (count > 0) {
+        int prev = cpath->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count) return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline void intrusive_ptr_release(const AsPath *cpath) {
     int prev = cpath->refcount_.fetch_and_decrement();
     if (prev == 1) {
@@ -203,6 +203,7 @@ BgpAttr::BgpAttr()
       med_(0), local_pref_(0), atomic_aggregate_(false),
       aggregator_as_num_(0), aggregator_address_() {
     refcount_ = 0;
+    wire_format_[0] = wire_format_[1] = NULL;
 }
 
 BgpAttr::BgpAttr(BgpAttrDB *attr_db)
@@ -210,6 +211,7 @@ BgpAttr::BgpAttr(BgpAttrDB *attr_db)
       nexthop_(), med_(0), local_pref_(0), atomic_aggregate_(false),
       aggregator_as_num_(0), aggregator_address_() {
     refcount_ = 0;
+    wire_format_[0] = wire_format_[1] = NULL;
 }
 
 BgpAttr::BgpAttr(BgpAttrDB *attr_db, const BgpAttrSpec &spec)
@@ -219,6 +221,7 @@ BgpAttr::BgpAttr(BgpAttrDB *attr_db, const BgpAttrSpec &spec)
       atomic_aggregate_(false),
       aggregator_as_num_(0), aggregator_address_() {
     refcount_ = 0;
+    wire_format_[0] = wire_format_[1] = NULL;
     for (std::vector<BgpAttribute *>::const_iterator it = spec.begin();
          it < spec.end(); it++) {
         (*it)->ToCanonical(this);
@@ -236,6 +239,25 @@ BgpAttr::BgpAttr(const BgpAttr &rhs)
       ext_community_(rhs.ext_community_),
       label_block_(rhs.label_block_), olist_(rhs.olist_) {
     refcount_ = 0; 
+    wire_format_[0] = wire_format_[1] = NULL;
+}
+
+BgpAttr::~BgpAttr() {
+    delete wire_format_[0];
+    delete wire_format_[1];
+}
+
+// Set the wire format unless another thread did so first, in which case
+// the passed data is freed. Returns the wire format in use.
+const std::vector<uint8_t> *BgpAttr::set_wire_format(bool nexthop,
+        std::vector<uint8_t> *data) const {
+    std::vector<uint8_t> *prev =
+        wire_format_[nexthop].compare_and_swap(data, NULL);
+    if (prev != NULL) {
+        delete data;
+        return prev;
+    }
+    return data;
 }
 
 void BgpAttr::set_as_path(const AsPathSpec *spec) {
@@ -319,17 +341,29 @@ int BgpAttr::CompareTo(const BgpAttr &rhs) const {
     return 0;
 }
 
+// Hash an address without formatting it, since the hash is computed on
+// every Locate.
+static void HashCombineAddress(size_t *hash, const IpAddress &address) {
+    if (address.is_v4()) {
+        boost::hash_combine(*hash, address.to_v4().to_ulong());
+    } else {
+        Ip6Address::bytes_type bytes = address.to_v6().to_bytes();
+        boost::hash_range(*hash, bytes.begin(), bytes.end());
+    }
+}
+
 std::size_t hash_value(BgpAttr const &attr) {
     size_t hash = 0;
 
     boost::hash_combine(hash, attr.origin_);
-    boost::hash_combine(hash, attr.nexthop_.to_string());
+    HashCombineAddress(&hash, attr.nexthop_);
     boost::hash_combine(hash, attr.med_);
     boost::hash_combine(hash, attr.local_pref_);
     boost::hash_combine(hash, attr.atomic_aggregate_);
     boost::hash_combine(hash, attr.aggregator_as_num_);
-    boost::hash_combine(hash, attr.aggregator_address_.to_string());
-    boost::hash_combine(hash, attr.source_rd_.ToString());
+    HashCombineAddress(&hash, attr.aggregator_address_);
+    const uint8_t *rd = attr.source_rd_.GetData();
+    boost::hash_range(hash, rd, rd + RouteDistinguisher::kSize);
 
     if (attr.label_block_) {
         boost::hash_combine(hash, attr.label_block_->first());
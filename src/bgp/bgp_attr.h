@@ -141,6 +141,7 @@ struct BgpMpNlri : public BgpAttribute {
     std::vector<uint8_t> nexthop;
 
     std::vector<BgpProtoPrefix *> nlri;
+    BgpProtoNlriData nlri_data;
 };
 
 struct BgpAttrLabelBlock : public BgpAttribute {
@@ -164,7 +165,7 @@ public:
 
     friend std::size_t hash_value(BgpOListElem const &elem) {
         size_t hash = 0;
-        boost::hash_combine(hash, elem.address.to_string());
+        boost::hash_combine(hash, elem.address.to_ulong());
         boost::hash_combine(hash, elem.label);
         return hash;
     }
@@ -237,7 +238,7 @@ public:
     BgpAttr(BgpAttrDB *attr_db);
     BgpAttr(const BgpAttr &rhs);
     BgpAttr(BgpAttrDB *attr_db, const BgpAttrSpec &spec);
-    virtual ~BgpAttr() { }
+    virtual ~BgpAttr();
 
     virtual void Remove();
     int CompareTo(const BgpAttr &rhs) const;
@@ -277,10 +278,20 @@ public:
     BgpOListPtr olist() const { return olist_; }
     BgpAttrDB *attr_db() const { return attr_db_; }
 
+    // Path attributes other than MP_REACH_NLRI in wire format, with or
+    // without the NEXT_HOP attribute. Built on first use by BgpMessage and
+    // kept for the lifetime of the attribute.
+    const std::vector<uint8_t> *wire_format(bool nexthop) const {
+        return wire_format_[nexthop];
+    }
+    const std::vector<uint8_t> *set_wire_format(bool nexthop,
+                                                std::vector<uint8_t> *data) const;
+
 private:
     friend class BgpAttrDB;
     friend int intrusive_ptr_add_ref(const BgpAttr *cattrp);
     friend int intrusive_ptr_del_ref(const BgpAttr *cattrp);
+    friend bool intrusive_ptr_try_add_ref(const BgpAttr *cattrp);
     friend void intrusive_ptr_release(const BgpAttr *cattrp);
 
     mutable tbb::atomic<int> refcount_;
@@ -298,6 +309,7 @@ private:
     ExtCommunityPtr ext_community_;
     LabelBlockPtr label_block_;
     BgpOListPtr olist_;
+    mutable tbb::atomic<std::vector<uint8_t> *> wire_format_[2];
 };
 
 inline int intrusive_ptr_add_ref(const BgpAttr *cattrp) {
@@ -308,6 +320,16 @@ inline int intrusive_ptr_del_ref(const BgpAttr *cattrp) {
     return cattrp->refcount_.fetch_and_decrement();
 }
 
+inline bool intrusive_ptr_try_add_ref(const BgpAttr *cattrp) {
+    int count = cattrp->refcount_;
+    while (count > 0) {
+        int prev = cattrp->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count) return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline void intrusive_ptr_release(const BgpAttr *cattrp) {
     int prev = cattrp->refcount_.fetch_and_decrement();
     if (prev == 1) {
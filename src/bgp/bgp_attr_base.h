@@ -9,7 +9,8 @@
 #include <boost/scoped_array.hpp>
 #include <set>
 #include <string>
-#include <tbb/mutex.h>
+#include <tbb/atomic.h>
+#include <tbb/spin_rw_mutex.h>
 #include <vector>
 #include "base/parse_object.h"
 #include "base/task.h"
@@ -66,11 +67,26 @@ struct BgpProtoPrefix : public ParseObject {
     uint8_t type; // only applicable for evpn
 };
 
+// Prefixes of an NLRI field left in wire format by BgpProto::DecodeInPlace.
+// The data belongs to the message and is read with BgpProto::PrefixIterator.
+struct BgpProtoNlriData {
+    BgpProtoNlriData() : data(NULL), size(0) { }
+    const uint8_t *data;
+    size_t size;
+};
+
 // Base class to manage BGP Path Attributes database. This class provides
 // thread safe access to the data base.
 //
-// Lock contention can be tuned by varying the hash table size passed to the
-// constructor.
+// The data base is split into stripes based on the hash of the attribute
+// contents, each with its own reader-writer lock. Lock contention can be
+// tuned by varying the number of stripes passed to the constructor.
+//
+// Locate of an attribute that is already present only takes the stripe lock
+// in shared mode, so that lookups from different threads do not serialize.
+// The lock is taken exclusively to insert an attribute and to delete one
+// whose last reference is released. Entries are ordered by the full hash
+// first, so that most comparisons do not involve the attribute contents.
 //
 // Attribute contents must be hashable via hash_value() and hashed using
 // boost::hash_combine() to partition the attribute database.
@@ -80,14 +96,18 @@ class BgpPathAttributeDB {
 public:
     BgpPathAttributeDB(int hash_size = GetHashSize()) :
             hash_size_(hash_size), set_(new Set[hash_size]),
-            mutex_(new tbb::mutex[hash_size]) {
+            mutex_(new tbb::spin_rw_mutex[hash_size]) {
+        lookup_hits_ = 0;
+        inserts_ = 0;
+        retries_ = 0;
+        lock_contention_ = 0;
     }
 
     size_t Size() {
         size_t size = 0;
 
         for (size_t i = 0; i < hash_size_; i++) {
-            tbb::mutex::scoped_lock lock(mutex_[i]);
+            tbb::spin_rw_mutex::scoped_lock lock(mutex_[i], false);
             size += set_[i].size();
         }
         return size;
@@ -95,9 +115,11 @@ public:
 
     void Delete(Type *attr) {
         size_t hash = HashCompute(attr);
+        size_t stripe = hash % hash_size_;
 
-        tbb::mutex::scoped_lock lock(mutex_[hash]);
-        set_[hash].erase(attr);
+        tbb::spin_rw_mutex::scoped_lock lock;
+        Acquire(&lock, stripe, true);
+        set_[stripe].erase(Entry(hash, attr));
     }
 
     // Locate passed in attribute in the data base based on the attr ptr.
@@ -111,21 +133,81 @@ public:
         return LocateInternal(attr);
     }
 
+    size_t hash_size() const { return hash_size_; }
+
+    // Number of Locate calls that found the attribute with the lock held in
+    // shared mode.
+    uint64_t lookup_hits() const { return lookup_hits_; }
+
+    // Number of attributes inserted into the data base.
+    uint64_t inserts() const { return inserts_; }
+
+    // Number of times Locate found an equal attribute that was being
+    // deleted and had to try again.
+    uint64_t retries() const { return retries_; }
+
+    // Number of lock acquisitions that could not be granted immediately.
+    uint64_t lock_contention() const { return lock_contention_; }
+
 private:
-    const size_t HashCompute(Type *attr) const {
-        if (hash_size_ <= 1) return 0;
+    struct Entry {
+        Entry(size_t hash, Type *attr) : hash(hash), attr(attr) { }
+        size_t hash;
+        Type *attr;
+    };
+
+    struct EntryCompare {
+        bool operator()(const Entry &lhs, const Entry &rhs) const {
+            if (lhs.hash != rhs.hash) {
+                return lhs.hash < rhs.hash;
+            }
+            return TypeCompare()(lhs.attr, rhs.attr);
+        }
+    };
 
+    typedef std::set<Entry, EntryCompare> Set;
+
+    static size_t HashCompute(Type *attr) {
         size_t hash = 0;
         boost::hash_combine(hash, *attr);
-        return hash % hash_size_;
+        return hash;
     }
 
     static size_t GetHashSize() {
         char *str = getenv("BGP_PATH_ATTRIBUTE_DB_HASH_SIZE");
 
-        // Use just one bucket for now.
-        if (!str) return 1;
-        return strtoul(str, NULL, 0);
+        if (!str) return kDefaultHashSize;
+        size_t size = strtoul(str, NULL, 0);
+        return size ? size : 1;
+    }
+
+    void Acquire(tbb::spin_rw_mutex::scoped_lock *lock, size_t stripe,
+                 bool write) {
+        if (!lock->try_acquire(mutex_[stripe], write)) {
+            lock_contention_++;
+            lock->acquire(mutex_[stripe], write);
+        }
+    }
+
+    // Returns the attribute equal to the passed one with a reference taken,
+    // or NULL if there is none that can be used.
+    TypePtr Lookup(size_t hash, size_t stripe, Type *attr) {
+        tbb::spin_rw_mutex::scoped_lock lock;
+        Acquire(&lock, stripe, false);
+        typename Set::iterator it = set_[stripe].find(Entry(hash, attr));
+        if (it == set_[stripe].end()) {
+            return TypePtr();
+        }
+
+        // The entry cannot be freed while the lock is held, since Delete
+        // needs it exclusively. It can however have had its last reference
+        // released, in which case it is about to be deleted and must not be
+        // used. Other readers may be looking at the same entry, hence the
+        // refcount is only incremented if it is not 0.
+        if (!intrusive_ptr_try_add_ref(it->attr)) {
+            return TypePtr();
+        }
+        return TypePtr(it->attr, false);
     }
 
     // This template safely retrieves an attribute entry from its data base.
@@ -135,31 +217,45 @@ private:
     // existing entry is returned.
     TypePtr LocateInternal(Type *attr) {
 
-        // Hash attribute contents to to avoid potential mutex contention.
+        // Hash attribute contents once, both to pick the stripe and to order
+        // the entries within it.
         size_t hash = HashCompute(attr);
+        size_t stripe = hash % hash_size_;
+
+        // Common case of an attribute that is already present.
+        TypePtr ptr = Lookup(hash, stripe, attr);
+        if (ptr) {
+            lookup_hits_++;
+            delete attr;
+            return ptr;
+        }
+
         while (true) {
 
-            // Grab mutex to keep db access thread safe.
-            tbb::mutex::scoped_lock lock(mutex_[hash]);
+            // Grab the lock exclusively to insert the passed entry.
+            tbb::spin_rw_mutex::scoped_lock lock;
+            Acquire(&lock, stripe, true);
             std::pair<typename Set::iterator, bool> ret;
 
             // Try to insert the passed entry into the database.
-            ret = set_[hash].insert(attr);
+            ret = set_[stripe].insert(Entry(hash, attr));
+            Type *entry = ret.first->attr;
 
             // Take a reference to prevent this entry from getting deleted.
             // Counter is automatically incremented, hence we get thread safety
             // here.
-            int prev = intrusive_ptr_add_ref(*ret.first);
+            int prev = intrusive_ptr_add_ref(entry);
 
             // Check if passed in entry did get into the data base.
             if (ret.second) {
+                inserts_++;
 
                 // Take intrusive pointer, thereby incrementing the refcount.
-                TypePtr ptr = TypePtr(*ret.first);
+                TypePtr ptr = TypePtr(entry);
 
                 // Release redundant refcount taken above to protect this entry
                 // from getting deleted, as we have now bumped up refcount above
-                intrusive_ptr_del_ref(*ret.first);
+                intrusive_ptr_del_ref(entry);
                 return ptr;
             }
 
@@ -177,28 +273,34 @@ private:
                 delete attr;
 
                 // Take intrusive pointer, thereby incrementing the refcount.
-                TypePtr ptr = TypePtr(*ret.first);
+                TypePtr ptr = TypePtr(entry);
 
                 // Release redundant refcount taken above to protect this entry
                 // from getting deleted, as we have now bumped up refcount above
-                intrusive_ptr_del_ref(*ret.first);
+                intrusive_ptr_del_ref(entry);
                 return ptr;
             }
 
             // Decrement the counter bumped up above as we can't use this entry
             // which is above to be deleted. Instead, retry inserting the passed
             // entry again, into the database.
-            intrusive_ptr_del_ref(*ret.first);
+            retries_++;
+            intrusive_ptr_del_ref(entry);
         }
 
         assert(false);
         return NULL;
     }
 
-    typedef std::set<Type *, TypeCompare> Set;
+    static const size_t kDefaultHashSize = 64;
+
     size_t hash_size_;
     boost::scoped_array<Set> set_;
-    boost::scoped_array<tbb::mutex> mutex_;
+    boost::scoped_array<tbb::spin_rw_mutex> mutex_;
+    tbb::atomic<uint64_t> lookup_hits_;
+    tbb::atomic<uint64_t> inserts_;
+    tbb::atomic<uint64_t> retries_;
+    tbb::atomic<uint64_t> lock_contention_;
 };
 
 #endif
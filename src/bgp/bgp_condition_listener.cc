@@ -42,18 +42,34 @@ public:
     // When the walk actually starts, pending_walk_list_ entries are moved to 
     // current_walk_list_.
     //
-    void WalkStarted(DBTableWalker::WalkId id) {
-        id_ = id;
+    void WalkStarted() {
         pending_walk_list_.swap(current_walk_list_);
         pending_walk_list_.clear();
     }
 
+    void SetWalkId(DBTableWalker::WalkId id) {
+        id_ = id;
+    }
+
     DBTableWalker::WalkId GetWalkId() const {
         return id_;
     }
 
     void ResetWalkId() {
         id_ = DBTableWalker::kInvalidWalkerId;
+        walk_end_.reset();
+    }
+
+    //
+    // Last route of the table to be walked for the current_walk_list_.
+    // NULL if the walk goes till the end of the table.
+    //
+    const DBEntry *walk_end() const {
+        return walk_end_.get();
+    }
+
+    void set_walk_end(std::auto_ptr<DBEntry> end) {
+        walk_end_ = end;
     }
 
     bool walk_in_progress() {
@@ -84,6 +100,7 @@ private:
     WalkList pending_walk_list_;
     WalkList current_walk_list_;
     DBTableWalker::WalkId id_;
+    std::auto_ptr<DBEntry> walk_end_;
 };
 
 //
@@ -97,6 +114,12 @@ private:
 // Holds a table reference to ensure that table with active walk or listener
 // is not deleted
 //
+// Match objects that are only interested in a range of routes are indexed
+// by range, so that a route notification is dispatched only to the objects
+// whose range covers the route. The ranges in the index don't overlap; an
+// object with a range that partially overlaps an existing one is treated
+// as interested in all routes.
+//
 class ConditionMatchTableState {
 public:
     typedef std::set<ConditionMatchPtr> MatchList;
@@ -114,10 +137,20 @@ public:
         return &match_object_list_;
     }
 
-    void AddMatchObject(ConditionMatch *obj) {
-        match_object_list_.insert(ConditionMatchPtr(obj));
+    // Match objects interested in all routes of the table
+    const MatchList &wildcard_objects() const {
+        return wildcard_object_list_;
     }
 
+    void AddMatchObject(BgpTable *table, ConditionMatch *obj);
+    void RemoveMatchObject(ConditionMatch *obj);
+
+    const MatchList *FindRangeObjects(const DBEntry *entry) const;
+    bool IsInterested(ConditionMatch *obj, const DBEntry *entry) const;
+    bool GetWalkRange(BgpTable *table, const WalkRequest::WalkList &list,
+                      std::auto_ptr<DBEntry> *begin,
+                      std::auto_ptr<DBEntry> *end) const;
+
     //
     // Mutex required to manager MatchState list for concurrency
     //
@@ -126,9 +159,28 @@ public:
     }
 
 private:
+    struct MatchRange {
+        std::auto_ptr<DBEntry> begin;
+        std::auto_ptr<DBEntry> end;
+        MatchList objects;
+    };
+
+    struct EntryCompare {
+        bool operator()(const DBEntry *lhs, const DBEntry *rhs) const {
+            return lhs->IsLess(*rhs);
+        }
+    };
+
+    // MatchRange indexed by the first route in the range
+    typedef std::map<const DBEntry *, MatchRange *, EntryCompare> RangeMap;
+    typedef std::map<const ConditionMatch *, MatchRange *> RangeIndex;
+
     tbb::mutex table_state_mutex_;
     DBTableBase::ListenerId id_;
     MatchList match_object_list_;
+    MatchList wildcard_object_list_;
+    RangeMap range_map_;
+    RangeIndex range_index_;
     LifetimeRef<ConditionMatchTableState> table_delete_ref_;
     DISALLOW_COPY_AND_ASSIGN(ConditionMatchTableState);
 };
@@ -163,7 +215,7 @@ void BgpConditionListener::AddMatchCondition(BgpTable *table,
     } else {
         ts = loc->second;
     }
-    ts->AddMatchObject(obj);
+    ts->AddMatchObject(table, obj);
     TableWalk(table, obj, cb);
 }
 
@@ -293,25 +345,40 @@ void BgpConditionListener::TableWalk(BgpTable *table, ConditionMatch *obj,
     walk_trigger_->Set();
 }
 
+//
+// If all match objects in the walk are interested in a range of routes, the
+// walk starts at the first route of the ranges and stops after the last one.
+//
 bool BgpConditionListener::StartWalk() {
     CHECK_CONCURRENCY("bgp::Config");
 
     DBTableWalker::WalkCompleteFn walk_complete 
         = boost::bind(&BgpConditionListener::WalkDone, this, _1);
 
-    DBTableWalker::WalkFn walker 
-        = boost::bind(&BgpConditionListener::BgpRouteNotify, this, server(),
-                      _1, _2);
-
     for(WalkRequestMap::iterator it = walk_map_.begin(); 
         it != walk_map_.end(); it++) {
-        if (it->second->walk_in_progress()) {
+        WalkRequest *walk_req = it->second;
+        if (walk_req->walk_in_progress()) {
             continue;
         }
+        walk_req->WalkStarted();
+
+        DBRequestKey *key_start = NULL;
+        TableMap::iterator loc = map_.find(it->first);
+        std::auto_ptr<DBEntry> begin, end;
+        if (loc != map_.end() && loc->second->GetWalkRange(
+                it->first, *walk_req->walk_list(), &begin, &end)) {
+            key_start = begin->GetDBRequestKey().release();
+            walk_req->set_walk_end(end);
+        }
+
+        DBTableWalker::WalkFn walker 
+            = boost::bind(&BgpConditionListener::BgpRouteWalk, this, server(),
+                          walk_req, _1, _2);
         DB *db = server()->database();
-        DBTableWalker::WalkId id = 
-            db->GetWalker()->WalkTable(it->first, NULL, walker, walk_complete);
-        it->second->WalkStarted(id);
+        DBTableWalker::WalkId id = db->GetWalker()->WalkTable(
+            it->first, key_start, walker, walk_complete);
+        walk_req->SetWalkId(id);
     }
     return true;
 }
@@ -331,9 +398,23 @@ bool BgpConditionListener::BgpRouteNotify(BgpServer *server,
     DBTableBase::ListenerId id = ts->GetListenerId();
     assert(id != DBTableBase::kInvalidId);
 
-    for(ConditionMatchTableState::MatchList::iterator match_obj_it = 
-        ts->match_objects()->begin();
-        match_obj_it != ts->match_objects()->end(); match_obj_it++) {
+    for(ConditionMatchTableState::MatchList::const_iterator match_obj_it = 
+        ts->wildcard_objects().begin();
+        match_obj_it != ts->wildcard_objects().end(); match_obj_it++) {
+        bool deleted = false;
+        if ((*match_obj_it)->deleted() || del_rt) {
+            deleted = true;
+        }
+        (*match_obj_it)->Match(server, bgptable, rt, deleted);
+    }
+
+    const ConditionMatchTableState::MatchList *range_objects =
+        ts->FindRangeObjects(rt);
+    if (!range_objects)
+        return true;
+    for(ConditionMatchTableState::MatchList::const_iterator match_obj_it = 
+        range_objects->begin();
+        match_obj_it != range_objects->end(); match_obj_it++) {
         bool deleted = false;
         if ((*match_obj_it)->deleted() || del_rt) {
             deleted = true;
@@ -343,6 +424,42 @@ bool BgpConditionListener::BgpRouteNotify(BgpServer *server,
     return true;
 }
 
+//
+// Table walker
+// Only the match objects for which the walk was started need to see the
+// routes, the others have already seen them in BgpRouteNotify.
+//
+bool BgpConditionListener::BgpRouteWalk(BgpServer *server, 
+                                        WalkRequest *walk_req,
+                                        DBTablePartBase *root,
+                                        DBEntryBase *entry) {
+    BgpTable *bgptable = static_cast<BgpTable *>(root->parent());
+    BgpRoute *rt = static_cast<BgpRoute *> (entry);
+    bool del_rt = rt->IsDeleted();
+
+    // Stop the walk of this partition if we are past the end of the range.
+    if (walk_req->walk_end() && walk_req->walk_end()->IsLess(*rt))
+        return false;
+
+    TableMap::iterator loc = map_.find(bgptable);
+    assert(loc != map_.end());
+    ConditionMatchTableState *ts = loc->second;
+
+    for(WalkRequest::WalkList::iterator walk_it = 
+        walk_req->walk_list()->begin();
+        walk_it != walk_req->walk_list()->end(); walk_it++) {
+        ConditionMatch *obj = walk_it->first.get();
+        if (!ts->IsInterested(obj, rt))
+            continue;
+        bool deleted = false;
+        if (obj->deleted() || del_rt) {
+            deleted = true;
+        }
+        obj->Match(server, bgptable, rt, deleted);
+    }
+    return true;
+}
+
 // 
 // WalkComplete function
 // At the end of the walk reset the WalkId.
@@ -397,7 +514,7 @@ void BgpConditionListener::UnregisterCondition(BgpTable *bgptable,
     //
     if ((!walk_state || !walk_state->is_walk_pending(obj)) && 
         obj->deleted()) {
-        ts->match_objects()->erase(obj);
+        ts->RemoveMatchObject(obj);
     }
 
     if (ts->match_objects()->empty()) {
@@ -414,6 +531,135 @@ ConditionMatchTableState::ConditionMatchTableState(BgpTable *table,
 }
 
 ConditionMatchTableState::~ConditionMatchTableState() {
+    for (RangeMap::iterator it = range_map_.begin();
+         it != range_map_.end(); ++it) {
+        delete it->second;
+    }
+}
+
+void ConditionMatchTableState::AddMatchObject(BgpTable *table,
+                                              ConditionMatch *obj) {
+    std::pair<MatchList::iterator, bool> ret =
+        match_object_list_.insert(ConditionMatchPtr(obj));
+    if (!ret.second)
+        return;
+
+    std::auto_ptr<DBEntry> begin, end;
+    if (!obj->MatchRange(table, &begin, &end)) {
+        wildcard_object_list_.insert(ConditionMatchPtr(obj));
+        return;
+    }
+
+    // Share the range with other objects if it's the same.
+    RangeMap::iterator loc = range_map_.find(begin.get());
+    if (loc != range_map_.end()) {
+        MatchRange *range = loc->second;
+        if (!range->end->IsLess(*end) && !end->IsLess(*range->end)) {
+            range->objects.insert(ConditionMatchPtr(obj));
+            range_index_.insert(std::make_pair(obj, range));
+        } else {
+            wildcard_object_list_.insert(ConditionMatchPtr(obj));
+        }
+        return;
+    }
+
+    // Treat the object as a wildcard if the range overlaps with the next
+    // or the previous range.
+    loc = range_map_.upper_bound(begin.get());
+    if (loc != range_map_.end() && !end->IsLess(*loc->first)) {
+        wildcard_object_list_.insert(ConditionMatchPtr(obj));
+        return;
+    }
+    if (loc != range_map_.begin()) {
+        --loc;
+        if (!loc->second->end->IsLess(*begin)) {
+            wildcard_object_list_.insert(ConditionMatchPtr(obj));
+            return;
+        }
+    }
+
+    MatchRange *range = new MatchRange;
+    range->begin = begin;
+    range->end = end;
+    range->objects.insert(ConditionMatchPtr(obj));
+    range_map_.insert(std::make_pair(range->begin.get(), range));
+    range_index_.insert(std::make_pair(obj, range));
+}
+
+void ConditionMatchTableState::RemoveMatchObject(ConditionMatch *obj) {
+    ConditionMatchPtr match(obj);
+    wildcard_object_list_.erase(match);
+    RangeIndex::iterator loc = range_index_.find(obj);
+    if (loc != range_index_.end()) {
+        MatchRange *range = loc->second;
+        range_index_.erase(loc);
+        range->objects.erase(match);
+        if (range->objects.empty()) {
+            range_map_.erase(range->begin.get());
+            delete range;
+        }
+    }
+    match_object_list_.erase(match);
+}
+
+//
+// Return the match objects whose range covers the entry.
+//
+const ConditionMatchTableState::MatchList *
+ConditionMatchTableState::FindRangeObjects(const DBEntry *entry) const {
+    if (range_map_.empty())
+        return NULL;
+    RangeMap::const_iterator loc = range_map_.upper_bound(entry);
+    if (loc == range_map_.begin())
+        return NULL;
+    --loc;
+    if (loc->second->end->IsLess(*entry))
+        return NULL;
+    return &loc->second->objects;
+}
+
+bool ConditionMatchTableState::IsInterested(ConditionMatch *obj,
+                                            const DBEntry *entry) const {
+    RangeIndex::const_iterator loc = range_index_.find(obj);
+    if (loc != range_index_.end()) {
+        const MatchRange *range = loc->second;
+        return !entry->IsLess(*range->begin) && !range->end->IsLess(*entry);
+    }
+    return (wildcard_object_list_.find(ConditionMatchPtr(obj)) !=
+            wildcard_object_list_.end());
+}
+
+//
+// Get the range of routes that covers the ranges of all the match objects
+// in the list. Returns false if any of them is interested in all routes.
+//
+bool ConditionMatchTableState::GetWalkRange(BgpTable *table,
+        const WalkRequest::WalkList &list,
+        std::auto_ptr<DBEntry> *begin, std::auto_ptr<DBEntry> *end) const {
+    const DBEntry *first = NULL;
+    const DBEntry *last = NULL;
+    for (WalkRequest::WalkList::const_iterator it = list.begin();
+         it != list.end(); ++it) {
+        RangeIndex::const_iterator loc = range_index_.find(it->first.get());
+        if (loc == range_index_.end()) {
+            if (wildcard_object_list_.find(it->first) !=
+                wildcard_object_list_.end()) {
+                return false;
+            }
+            continue;
+        }
+        const MatchRange *range = loc->second;
+        if (!first || range->begin->IsLess(*first))
+            first = range->begin.get();
+        if (!last || last->IsLess(*range->end))
+            last = range->end.get();
+    }
+    if (!first)
+        return false;
+
+    *begin = table->AllocEntry(first->GetDBRequestKey().get());
+    *end = table->AllocEntry(last->GetDBRequestKey().get());
+    return true;
 }
 
 WalkRequest::WalkRequest() : id_(DBTableWalker::kInvalidWalkerId) {
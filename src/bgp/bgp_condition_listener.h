@@ -6,6 +6,7 @@
 #define ctrlplane_bgp_condition_listener_h
 
 #include <map>
+#include <memory>
 #include <set>
 
 #include <boost/intrusive_ptr.hpp>
@@ -40,6 +41,15 @@ public:
     virtual bool Match(BgpServer *server, BgpTable *table, 
                        BgpRoute *route, bool deleted) = 0;
 
+    // Range of routes [begin, end], in table order, that the match is
+    // interested in. Match is only invoked for routes in the range.
+    // Returns false if the match is interested in all routes of the table.
+    // Concurrency: bgp::Config task
+    virtual bool MatchRange(BgpTable *table, std::auto_ptr<DBEntry> *begin,
+                            std::auto_ptr<DBEntry> *end) {
+        return false;
+    }
+
     bool deleted() {
         return deleted_;
     }
@@ -161,6 +171,10 @@ private:
     bool BgpRouteNotify(BgpServer *server, DBTablePartBase *root,
                         DBEntryBase *entry);
 
+    // Table walker
+    bool BgpRouteWalk(BgpServer *server, WalkRequest *walk_req,
+                      DBTablePartBase *root, DBEntryBase *entry);
+
     void TableWalk(BgpTable *table, ConditionMatch *obj, RequestDoneCb cb);
 
     bool StartWalk();
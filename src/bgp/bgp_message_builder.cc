@@ -4,26 +4,35 @@
 
 #include "bgp/bgp_message_builder.h"
 
+#include <string.h>
+
 #include "base/logging.h"
 #include "base/parse_object.h"
 #include "bgp/bgp_log.h"
 #include "bgp/bgp_route.h"
 #include "net/bgp_af.h"
 
-BgpMessage::BgpMessage() {
+BgpMessage::BgpMessage()
+    : msg_length_offset_(-1), attr_length_offset_(-1), mp_length_offset_(-1),
+      datalen_(0) {
 }
 
 BgpMessage::~BgpMessage() {
 }
 
-void BgpMessage::StartReach(const RibOutAttr *roattr, const BgpRoute *route) {
+//
+// Encode the path attributes of attr other than MP_REACH_NLRI. The result
+// only depends on the attribute, which is interned, so it is computed once
+// and kept in the BgpAttr.
+//
+const std::vector<uint8_t> *BgpMessage::EncodeAttributes(const BgpAttr *attr,
+                                                         bool nexthop) {
     BgpProto::Update update;
-    const BgpAttr *attr = roattr->attr();
 
     BgpAttrOrigin *origin = new BgpAttrOrigin(attr->origin());
     update.path_attributes.push_back(origin);
 
-    if ((route->Afi() == BgpAf::IPv4) && (route->Safi() == BgpAf::Unicast)) {
+    if (nexthop) {
         BgpAttrNextHop *nh = new BgpAttrNextHop(attr->nexthop().to_v4().to_ulong());
         update.path_attributes.push_back(nh);
     }
@@ -73,27 +82,86 @@ void BgpMessage::StartReach(const RibOutAttr *roattr, const BgpRoute *route) {
         update.path_attributes.push_back(ext_comm);
     }
 
-    std::vector<uint8_t> nh;
+    uint8_t data[BgpProto::kMaxMessageSize];
+    EncodeOffsets offsets;
+    int datalen = BgpProto::Encode(&update, data, sizeof(data), &offsets);
+    int offset = offsets.FindOffset("BgpPathAttribute");
+    assert(datalen > 0 && offset > 0);
 
+    // Skip the message header and the path attributes length.
+    std::vector<uint8_t> *wire_format =
+        new std::vector<uint8_t>(data + offset + 2, data + datalen);
+    return attr->set_wire_format(nexthop, wire_format);
+}
+
+//
+// Build the message from the cached path attributes, leaving only the
+// MP_REACH_NLRI attribute to be encoded.
+//
+void BgpMessage::StartReach(const RibOutAttr *roattr, const BgpRoute *route) {
+    const BgpAttr *attr = roattr->attr();
+    bool nexthop =
+        (route->Afi() == BgpAf::IPv4) && (route->Safi() == BgpAf::Unicast);
+    const std::vector<uint8_t> *attributes = attr->wire_format(nexthop);
+    if (!attributes) {
+        attributes = EncodeAttributes(attr, nexthop);
+    }
+
+    std::vector<uint8_t> nh;
     route->BuildBgpProtoNextHop(nh, attr->nexthop());
 
-    BgpMpNlri *nlri =
-        new BgpMpNlri(BgpAttribute::MPReachNlri, route->Afi(), route->Safi(), nh);
-    update.path_attributes.push_back(nlri);
+    // Marker, length, type, withdrawn routes length and path attributes
+    // length, followed by the path attributes and the fixed part of the
+    // MP_REACH_NLRI attribute.
+    size_t mp_reach_size = 4 + 3 + 1 + nh.size() + 1;
+    size_t size = BgpProto::kMinMessageSize + 4 + attributes->size() +
+        mp_reach_size;
+    if (size > sizeof(data_)) {
+        BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                "MP Reach Encoding failed", size, route->ToString());
+        assert(false);
+    }
 
-    if (route) {
-        BgpProtoPrefix *prefix = new BgpProtoPrefix;
-        route->BuildProtoPrefix(prefix, roattr->label());
-        nlri->nlri.push_back(prefix);
-        num_reach_route_++;
+    uint8_t *data = data_;
+    memset(data, 0xff, 16);
+    data += 16;
+    msg_length_offset_ = data - data_;
+    data += 2;
+    *data++ = BgpProto::UPDATE;
+    put_value(data, 2, 0);
+    data += 2;
+    attr_length_offset_ = data - data_;
+    data += 2;
+    if (!attributes->empty()) {
+        memcpy(data, &(*attributes)[0], attributes->size());
+        data += attributes->size();
     }
 
-    datalen_ = BgpProto::Encode(&update, data_, sizeof(data_),
-            &encode_offsets_);
-    if (datalen_ <= 0) {
+    *data++ = BgpAttribute::Optional | BgpAttribute::ExtendedLength;
+    *data++ = BgpAttribute::MPReachNlri;
+    mp_length_offset_ = data - data_;
+    data += 2;
+    put_value(data, 2, route->Afi());
+    data += 2;
+    *data++ = route->Safi();
+    *data++ = nh.size();
+    if (!nh.empty()) {
+        memcpy(data, &nh[0], nh.size());
+        data += nh.size();
+    }
+    *data++ = 0;
+
+    datalen_ = data - data_;
+    put_value(&data_[msg_length_offset_], 2, datalen_);
+    put_value(&data_[attr_length_offset_], 2,
+              datalen_ - attr_length_offset_ - 2);
+    put_value(&data_[mp_length_offset_], 2, datalen_ - mp_length_offset_ - 2);
+
+    bool result = AddRoute(route, roattr);
+    if (!result) {
         BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                 "MP Reach Encoding failed", datalen_, route->ToString());
-        assert(datalen_ > 0);
+        assert(result);
     }
 }
 
@@ -111,13 +179,17 @@ void BgpMessage::StartUnreach(const BgpRoute *route) {
         num_unreach_route_++;
     }
 
+    EncodeOffsets encode_offsets;
     datalen_ = BgpProto::Encode(&update, data_, sizeof(data_),
-            &encode_offsets_);
+            &encode_offsets);
     if (datalen_ <= 0) {
         BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                 "MP Unreach Encoding failed", datalen_, route->ToString());
         assert(datalen_ > 0);
     }
+    msg_length_offset_ = encode_offsets.FindOffset("BgpMsgLength");
+    attr_length_offset_ = encode_offsets.FindOffset("BgpPathAttribute");
+    mp_length_offset_ = encode_offsets.FindOffset("MpReachUnreachNlri");
     BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_DEBUG, BGP_LOG_FLAG_TRACE,
             "Encoded Withdraw NLRI", datalen_, route->ToString());
 }
@@ -130,8 +202,7 @@ void BgpMessage::Start(const RibOutAttr *roattr, const BgpRoute *route) {
     }
 }
 
-bool BgpMessage::UpdateLength(const char *tag, int size, int delta) {
-    int offset = encode_offsets_.FindOffset(tag);
+bool BgpMessage::UpdateLength(int offset, int size, int delta) {
     if (offset < 0) {
         return false;
     }
@@ -162,14 +233,14 @@ bool BgpMessage::AddRoute(const BgpRoute *route, const RibOutAttr *roattr) {
     if (result <= 0) return false;
 
     datalen_ += result;
-    if (!UpdateLength("BgpMsgLength", 2, result)) {
+    if (!UpdateLength(msg_length_offset_, 2, result)) {
         BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                 "Cannot find BGP message length", datalen_, route->ToString());
         assert(false);
         return false;
     }
 
-    if (!UpdateLength("BgpPathAttribute", 2, result)) {
+    if (!UpdateLength(attr_length_offset_, 2, result)) {
         BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                 "Cannot find BGP attributes length", datalen_,
                 route->ToString());
@@ -177,7 +248,7 @@ bool BgpMessage::AddRoute(const BgpRoute *route, const RibOutAttr *roattr) {
         return false;
     }
 
-    if (!UpdateLength("MpReachUnreachNlri", 2, result)) {
+    if (!UpdateLength(mp_length_offset_, 2, result)) {
         BGP_LOG(BgpMessageBuilder, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                 "Cannot find MP Reach/Unreach NLRI length", datalen_,
                 route->ToString());
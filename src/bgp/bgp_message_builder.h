@@ -18,11 +18,16 @@ public:
     virtual const uint8_t *GetData(IPeerUpdate *ipeer_update, size_t *lenp);
 
 private:
+    static const std::vector<uint8_t> *EncodeAttributes(const BgpAttr *attr,
+                                                        bool nexthop);
     void StartReach(const RibOutAttr *roattr, const BgpRoute *route);
     void StartUnreach(const BgpRoute *route);
-    bool UpdateLength(const char *tag, int size, int delta);
+    bool UpdateLength(int offset, int size, int delta);
 
-    EncodeOffsets encode_offsets_;
+    // Offsets of the length fields updated when routes are added.
+    int msg_length_offset_;
+    int attr_length_offset_;
+    int mp_length_offset_;
     uint8_t data_[BgpProto::kMaxMessageSize];
     size_t datalen_;
     DISALLOW_COPY_AND_ASSIGN(BgpMessage);
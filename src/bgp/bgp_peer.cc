@@ -30,6 +30,8 @@
 #include "bgp/l3vpn/inetvpn_table.h"
 #include "bgp/routing-instance/peer_manager.h"
 #include "bgp/routing-instance/routing_instance.h"
+#include "bgp/rtarget/rtarget_group_mgr.h"
+#include "bgp/rtarget/rtarget_table.h"
 #include "io/event_manager.h"
 #include "net/address.h"
 #include "net/bgp_af.h"
@@ -427,6 +429,9 @@ bool BgpPeer::IsFamilySupported(Address::Family family) {
     case Address::EVPN:
         return MpNlriAllowed(BgpAf::L2Vpn, BgpAf::EVpn);
         break;
+    case Address::RTARGET:
+        return MpNlriAllowed(BgpAf::IPv4, BgpAf::RTarget);
+        break;
     default:
         break;
     }
@@ -441,6 +446,9 @@ void BgpPeer::PostCloseRelease() {
         server_->FreePeerIndex(index_);
         index_ = -1;
     }
+    RTargetGroupMgr *group_mgr = GetRTargetGroupMgr();
+    if (group_mgr)
+        group_mgr->UnregisterPeer(this);
     TimerManager::DeleteTimer(keepalive_timer_);
 }
 
@@ -539,10 +547,29 @@ bool BgpPeer::AcceptSession(BgpSession *session) {
     return state_machine_->PassiveOpen(session);
 }
 
+RTargetGroupMgr *BgpPeer::GetRTargetGroupMgr() {
+    RoutingInstance *instance = GetRoutingInstance();
+    RTargetTable *table = static_cast<RTargetTable *>(
+        instance->GetTable(Address::RTARGET));
+    return (table ? table->GetGroupMgr() : NULL);
+}
+
 void BgpPeer::RegisterAllTables() {
     PeerRibMembershipManager *membership_mgr = server_->membership_mgr();
     RoutingInstance *instance = GetRoutingInstance();
 
+    // Tell the RTargetGroupMgr whether the peer supports route target
+    // constrained distribution before joining the VPN table, so that no
+    // VPN routes are sent until the peer advertises its membership routes.
+    RTargetGroupMgr *group_mgr = GetRTargetGroupMgr();
+    if (group_mgr) {
+        if (IsFamilySupported(Address::RTARGET)) {
+            group_mgr->RegisterPeer(this);
+        } else {
+            group_mgr->UnregisterPeer(this);
+        }
+    }
+
     if (IsFamilySupported(Address::INET)) {
         BgpTable *table = instance->GetTable(Address::INET);
         BGP_LOG_TABLE_PEER(this, SandeshLevel::SYS_DEBUG, BGP_LOG_FLAG_TRACE,
@@ -575,6 +602,17 @@ void BgpPeer::RegisterAllTables() {
             membership_req_pending_++;
         }
     }
+
+    if (IsFamilySupported(Address::RTARGET)) {
+        BgpTable *rtable = instance->GetTable(Address::RTARGET);
+        BGP_LOG_TABLE_PEER(this, SandeshLevel::SYS_DEBUG, BGP_LOG_FLAG_TRACE,
+                           rtable, "Register peer with the table");
+        if (rtable) {
+            membership_mgr->Register(this, rtable, policy_, -1,
+             boost::bind(&BgpPeer::MembershipRequestCallback, this, _1, _2));
+            membership_req_pending_++;
+        }
+    }
     BgpPeerInfoData peer_info;
     peer_info.set_name(ToUVEKey());
     peer_info.set_send_state("not advertising");
@@ -589,10 +627,11 @@ void BgpPeer::SendOpen(TcpSession *session) {
     openmsg.as_num = server->autonomous_system();
     openmsg.holdtime = state_machine_->hold_time();
     openmsg.identifier = local_bgp_id_;
-    static const uint8_t cap_mp[3][4] = {
+    static const uint8_t cap_mp[4][4] = {
         { 0, BgpAf::IPv4,  0, BgpAf::Unicast },
         { 0, BgpAf::IPv4,  0, BgpAf::Vpn },
         { 0, BgpAf::L2Vpn, 0, BgpAf::EVpn },
+        { 0, BgpAf::IPv4,  0, BgpAf::RTarget },
     };
 
     BgpProto::OpenMessage::OptParam *opt_param =
@@ -619,6 +658,13 @@ void BgpPeer::SendOpen(TcpSession *session) {
                         cap_mp[2], 4);
         opt_param->capabilities.push_back(cap);
     }
+    if (LookupFamily(Address::RTARGET)) {
+        BgpProto::OpenMessage::Capability *cap =
+                new BgpProto::OpenMessage::Capability(
+                        BgpProto::OpenMessage::Capability::MpExtension,
+                        cap_mp[3], 4);
+        opt_param->capabilities.push_back(cap);
+    }
 
     if (opt_param->capabilities.size()) {
         openmsg.opt_params.push_back(opt_param);
@@ -779,7 +825,10 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
 
     
     RoutingInstance *instance = GetRoutingInstance();
-    if (msg->nlri.size() || msg->withdrawn_routes.size()) {
+    BgpProto::PrefixIterator withdrawn(msg->withdrawn_routes,
+                                       msg->withdrawn_data);
+    BgpProto::PrefixIterator reach(msg->nlri, msg->nlri_data);
+    if (withdrawn.HasNext() || reach.HasNext()) {
         InetTable *table =
             static_cast<InetTable *>(instance->GetTable(Address::INET));
         if (!table) {
@@ -790,24 +839,21 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
 
         BGP_LOG_TABLE_PEER(this, SandeshLevel::SYS_DEBUG, BGP_LOG_FLAG_SYSLOG,
                            table, "Process Nlri::Unicast routes");
-        for (vector<BgpProtoPrefix *>::const_iterator it =
-             msg->withdrawn_routes.begin(); it != msg->withdrawn_routes.end();
-             ++it++) {
+        while (withdrawn.HasNext()) {
             DBRequest req;
             req.oper = DBRequest::DB_ENTRY_DELETE;
             req.data.reset(NULL);
-            Ip4Prefix prefix = Ip4Prefix(**it);
+            Ip4Prefix prefix = Ip4Prefix(*withdrawn.Next());
             req.key.reset(new InetTable::RequestKey(prefix, this));
             table->Enqueue(&req);
             inc_rx_route_unreach();
         }
         
-        for (vector<BgpProtoPrefix *>::const_iterator it = msg->nlri.begin();
-             it != msg->nlri.end(); ++it) {
+        while (reach.HasNext()) {
             DBRequest req;
             req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
             req.data.reset(new InetTable::RequestData(attr, flags, 0));
-            Ip4Prefix prefix = Ip4Prefix(**it);
+            Ip4Prefix prefix = Ip4Prefix(*reach.Next());
             req.key.reset(new InetTable::RequestKey(prefix, this));
             table->Enqueue(&req);
             inc_rx_route_reach();
@@ -851,13 +897,13 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
                                BGP_LOG_FLAG_SYSLOG, table,
                                "Process BgpMpNlri::Unicast routes");
 
-            vector<BgpProtoPrefix *>::const_iterator it;
-            for (it = nlri->nlri.begin(); it < nlri->nlri.end(); it++) {
+            BgpProto::PrefixIterator it(nlri);
+            while (it.HasNext()) {
                 DBRequest req;
                 req.oper = oper;
                 if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
                     req.data.reset(new InetTable::RequestData(attr, flags, 0));
-                Ip4Prefix prefix = Ip4Prefix(**it);
+                Ip4Prefix prefix = Ip4Prefix(*it.Next());
                 req.key.reset(new InetTable::RequestKey(prefix, this));
                 table->Enqueue(&req);
             }
@@ -872,17 +918,18 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
                                BGP_LOG_FLAG_SYSLOG, table,
                                "Process BgpMpNlri::Vpn routes");
 
-            vector<BgpProtoPrefix *>::const_iterator it;
-            for (it = nlri->nlri.begin(); it < nlri->nlri.end(); it++) {
-                uint32_t label = ((*it)->prefix[0] << 16 |
-                                  (*it)->prefix[1] << 8 |
-                                  (*it)->prefix[2]) >> 4;
+            BgpProto::PrefixIterator it(nlri);
+            while (it.HasNext()) {
+                const BgpProtoPrefix *prefix = it.Next();
+                uint32_t label = (prefix->prefix[0] << 16 |
+                                  prefix->prefix[1] << 8 |
+                                  prefix->prefix[2]) >> 4;
                 DBRequest req;
                 req.oper = oper;
                 if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
                     req.data.reset(new InetVpnTable::RequestData(attr, flags, label));
-                req.key.reset(new InetVpnTable::RequestKey(InetVpnPrefix(**it),
-                                                           this));
+                req.key.reset(new InetVpnTable::RequestKey(
+                    InetVpnPrefix(*prefix), this));
                 table->Enqueue(&req);
             }
             break;
@@ -897,27 +944,60 @@ void BgpPeer::ProcessUpdate(const BgpProto::Update *msg) {
                                BGP_LOG_FLAG_SYSLOG, table,
                                "Process BgpMpNlri::EVpn routes");
 
-            vector<BgpProtoPrefix *>::const_iterator it;
+            BgpProto::PrefixIterator it(nlri);
             size_t label_offset = 24;
-            for (it = nlri->nlri.begin(); it < nlri->nlri.end(); it++) {
-                if ((*it)->type != 2) {
+            while (it.HasNext()) {
+                const BgpProtoPrefix *prefix = it.Next();
+                if (prefix->type != 2) {
                     BGP_LOG_PEER(this, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                                  BGP_PEER_DIR_IN,
-                                 "EVPN: Unsupported route type " << (*it)->type);
+                                 "EVPN: Unsupported route type " << prefix->type);
                     continue;
                 }
-                uint32_t label = ((*it)->prefix[label_offset] << 16 |
-                                  (*it)->prefix[label_offset + 1] << 8 |
-                                  (*it)->prefix[label_offset + 2]) >> 4;
+                uint32_t label = (prefix->prefix[label_offset] << 16 |
+                                  prefix->prefix[label_offset + 1] << 8 |
+                                  prefix->prefix[label_offset + 2]) >> 4;
                 DBRequest req;
                 req.oper = oper;
                 if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
                     req.data.reset(new EvpnTable::RequestData(attr, flags, label));
-                req.key.reset(new EvpnTable::RequestKey(EvpnPrefix(**it), this));
+                req.key.reset(new EvpnTable::RequestKey(EvpnPrefix(*prefix),
+                                                        this));
+                table->Enqueue(&req);
+            }
+            break;
+        }
+
+        case BgpAf::RTarget: {
+            RTargetTable *table =
+              static_cast<RTargetTable *>(instance->GetTable(Address::RTARGET));
+            assert(table);
+            BGP_LOG_TABLE_PEER(this, SandeshLevel::SYS_DEBUG,
+                               BGP_LOG_FLAG_SYSLOG, table,
+                               "Process BgpMpNlri::RTarget routes");
+
+            BgpProto::PrefixIterator it(nlri);
+            while (it.HasNext()) {
+                const BgpProtoPrefix *prefix = it.Next();
+                if (prefix->prefixlen != 0 &&
+                    prefix->prefixlen != RTargetPrefix::kPrefixLen) {
+                    BGP_LOG_PEER(this, SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                                 BGP_PEER_DIR_IN,
+                                 "RTarget: Unsupported prefix length " <<
+                                 prefix->prefixlen);
+                    continue;
+                }
+                DBRequest req;
+                req.oper = oper;
+                if (oper == DBRequest::DB_ENTRY_ADD_CHANGE)
+                    req.data.reset(new RTargetTable::RequestData(attr, flags, 0));
+                req.key.reset(new RTargetTable::RequestKey(
+                    RTargetPrefix(*prefix), this));
                 table->Enqueue(&req);
             }
             break;
         }
+
         default:
             continue;
         }
@@ -1019,7 +1099,7 @@ string BgpPeer::BytesToHexString(const u_int8_t *msg, size_t size) {
 void BgpPeer::ReceiveMsg(BgpSession *session, const u_int8_t *msg,
                          size_t size) {
     ParseErrorContext ec;
-    BgpProto::BgpMessage *minfo = BgpProto::Decode(msg, size, &ec);
+    BgpProto::BgpMessage *minfo = BgpProto::DecodeInPlace(msg, size, &ec);
 
     if (minfo == NULL) {
         BGP_TRACE_PEER_PACKET(this, msg, size, SandeshLevel::SYS_WARN);
@@ -1064,7 +1144,7 @@ BgpAttrPtr BgpPeer::GetMpNlriNexthop(BgpMpNlri *nlri, BgpAttrPtr attr) {
     Ip4Address::bytes_type bt = { { 0 } };
 
     if (nlri->afi == BgpAf::IPv4) {
-        if (nlri->safi == BgpAf::Unicast) {
+        if (nlri->safi == BgpAf::Unicast || nlri->safi == BgpAf::RTarget) {
             std::copy(nlri->nexthop.begin(), nlri->nexthop.end(),
                       bt.begin());
             update_nh = true;
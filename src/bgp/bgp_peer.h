@@ -29,6 +29,7 @@ class BgpPeerInfo;
 class BgpServer;
 class BgpSession;
 class RoutingInstance;
+class RTargetGroupMgr;
 class StateMachine;
 class BgpSession;
 class BgpPeerInfo;
@@ -211,6 +212,7 @@ private:
     virtual bool MpNlriAllowed(uint16_t afi, uint8_t safi);
     BgpAttrPtr GetMpNlriNexthop(BgpMpNlri *nlri, BgpAttrPtr attr);
     bool IsFamilySupported(Address::Family family);
+    RTargetGroupMgr *GetRTargetGroupMgr();
 
     void PostCloseRelease();
     void CustomClose();
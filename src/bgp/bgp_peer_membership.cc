@@ -329,6 +329,9 @@ PeerRibMembershipManager::PeerRibMembershipManager(BgpServer *server) :
         membership_task_id_, kMembershipTaskInstanceId,
         boost::bind(&PeerRibMembershipManager::IPeerRibEventCallback, this,
                     _1));
+    event_queue_->set_name("Peer Membership");
+    event_queue_->SetAdaptive(
+        WorkQueue<IPeerRibEvent *>::kDefaultTimeSliceUsecs);
 }
 
 //
@@ -100,6 +100,71 @@ BgpProto::Update::~Update() {
     STLDeleteValues(&nlri);
 }
 
+static void RebaseNlriData(BgpProtoNlriData *nlri_data, const uint8_t *from,
+                           const uint8_t *to) {
+    if (nlri_data->data != NULL) {
+        nlri_data->data = to + (nlri_data->data - from);
+    }
+}
+
+void BgpProto::Update::SetBuffer(const uint8_t *data, size_t size) {
+    buffer.assign(data, data + size);
+    if (buffer.empty()) {
+        return;
+    }
+    const uint8_t *copy = &buffer[0];
+    RebaseNlriData(&withdrawn_data, data, copy);
+    RebaseNlriData(&nlri_data, data, copy);
+    for (vector<BgpAttribute *>::iterator it = path_attributes.begin();
+         it != path_attributes.end(); ++it) {
+        if ((*it)->code == BgpAttribute::MPReachNlri ||
+            (*it)->code == BgpAttribute::MPUnreachNlri) {
+            BgpMpNlri *nlri = static_cast<BgpMpNlri *>(*it);
+            RebaseNlriData(&nlri->nlri_data, data, copy);
+        }
+    }
+}
+
+BgpProto::PrefixIterator::PrefixIterator(
+        const vector<BgpProtoPrefix *> &prefixes,
+        const BgpProtoNlriData &nlri_data)
+    : iter_(prefixes.begin()), end_(prefixes.end()),
+      data_(nlri_data.data), data_end_(nlri_data.data + nlri_data.size),
+      evpn_(false) {
+}
+
+BgpProto::PrefixIterator::PrefixIterator(const BgpMpNlri *nlri)
+    : iter_(nlri->nlri.begin()), end_(nlri->nlri.end()),
+      data_(nlri->nlri_data.data),
+      data_end_(nlri->nlri_data.data + nlri->nlri_data.size),
+      evpn_(nlri->afi == BgpAf::L2Vpn && nlri->safi == BgpAf::EVpn) {
+}
+
+bool BgpProto::PrefixIterator::HasNext() const {
+    return iter_ != end_ || data_ < data_end_;
+}
+
+// The prefixes in wire format have been validated by DecodeInPlace.
+const BgpProtoPrefix *BgpProto::PrefixIterator::Next() {
+    if (iter_ != end_) {
+        return *iter_++;
+    }
+    int size;
+    if (evpn_) {
+        prefix_.type = data_[0];
+        size = data_[1];
+        prefix_.prefixlen = size * 8;
+        data_ += 2;
+    } else {
+        prefix_.prefixlen = data_[0];
+        size = (prefix_.prefixlen + 7) / 8;
+        data_ += 1;
+    }
+    prefix_.prefix.assign(data_, data_ + size);
+    data_ += size;
+    return &prefix_;
+}
+
 struct BgpAttrCodeCompare {
     bool operator()(BgpAttribute *lhs, BgpAttribute *rhs) {
         return lhs->code < rhs->code;
@@ -115,6 +180,7 @@ int BgpProto::Update::Validate(const BgpPeer *peer, std::string &data) {
     bool origin = false, nh = false, as_path = false, mp_reach_nlri = false, local_pref = false;
 
     bool ibgp = (peer->PeerType() == IBGP);
+    bool has_nlri = !nlri.empty() || nlri_data.size > 0;
 
     BgpAttrSpec::const_iterator it;
     std::string rxed_attr("Path attributes : ");
@@ -148,13 +214,13 @@ int BgpProto::Update::Validate(const BgpPeer *peer, std::string &data) {
 
     BGP_LOG_PEER(peer, SandeshLevel::SYS_DEBUG, BGP_LOG_FLAG_TRACE,
                  BGP_PEER_DIR_IN, rxed_attr);
-    if (nlri.size() > 0 && !nh) {
+    if (has_nlri && !nh) {
         // next-hop attribute must be present if IPv4 NLRI is present
         char attrib_type = BgpAttribute::NextHop;
         data = std::string(&attrib_type, 1);
         return BgpProto::Notification::MissingWellKnownAttrib;
     }
-    if (nlri.size() > 0 || mp_reach_nlri) {
+    if (has_nlri || mp_reach_nlri) {
         // origin and as_path must be present if any NLRI is present
         if (!origin) {
             char attrib_type = BgpAttribute::Origin;
@@ -792,7 +858,8 @@ public:
         bool match(const BgpMpNlri *obj) {
             return 
                 (((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::Unicast)) ||
-                 ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::Vpn)));
+                 ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::Vpn)) ||
+                 ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::RTarget)));
         }
     };
 
@@ -863,6 +930,9 @@ public:
             if ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::Vpn)) {
                 value = 0;
             }
+            if ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::RTarget)) {
+                value = 0;
+            }
         }
 
         static int get(BgpMpNlri *obj) {
@@ -875,6 +945,9 @@ public:
             if ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::Vpn)) {
                 return 0;
             }
+            if ((obj->afi == BgpAf::IPv4) && (obj->safi == BgpAf::RTarget)) {
+                return 0;
+            }
             return -1;
         }
     };
@@ -886,8 +959,66 @@ public:
     > Choice;
 };
 
+//
+// Prefixes of the withdrawn routes or NLRI field of an UPDATE, or of a
+// MP_REACH_NLRI or MP_UNREACH_NLRI attribute, for DecodeInPlace. Takes the
+// rest of the enclosing field and only checks that it is a list of
+// prefixes.
+//
+// A prefix that runs past the end of its field is an Invalid Network Field
+// error. The elements above do not bound the prefix address by the field
+// and read it from the following field, or past the end of the message.
+//
+template <class C, BgpProtoNlriData C::*Member>
+class BgpPrefixBlock : public ElementBase {
+public:
+    static const int kErrorCode = BgpProto::Notification::UpdateMsgErr;
+    static const int kErrorSubcode =
+            BgpProto::Notification::InvalidNetworkField;
+
+    template <typename T>
+    static int Parse(const uint8_t *data, size_t size, ParseContext *context,
+                     T *obj) {
+        int type = PrefixType(obj);
+        if (type < 0) {
+            // Same as BgpPathAttributeMpNlriChoice.
+            context->SetError(0, 0, "BgpPathAttributeMpNlriChoice", data, 0);
+            return -1;
+        }
+        const uint8_t *prefix = data;
+        size_t left = size;
+        while (left > 0) {
+            size_t length;
+            if (type == 1) {
+                length = (left < 2) ? left + 1 : 2 + prefix[1];
+            } else {
+                length = 1 + (prefix[0] + 7) / 8;
+            }
+            if (length > left) {
+                context->SetError(kErrorCode, kErrorSubcode, "BgpPrefixBlock",
+                                  prefix, left);
+                return -1;
+            }
+            prefix += length;
+            left -= length;
+        }
+        (obj->*Member).data = data;
+        (obj->*Member).size = size;
+        return size;
+    }
+
+private:
+    static int PrefixType(const BgpProto::Update *obj) {
+        return 0;
+    }
+    static int PrefixType(BgpMpNlri *obj) {
+        return BgpPathAttributeMpNlriChoice::MpChoice::get(obj);
+    }
+};
+
+template <class Nlri>
 class BgpPathAttributeMpReachNlriSequence :
-public ProtoSequence<BgpPathAttributeMpReachNlriSequence> {
+public ProtoSequence<BgpPathAttributeMpReachNlriSequence<Nlri> > {
 public:
     struct Offset {
         std::string operator()() {
@@ -902,11 +1033,12 @@ public:
                   BgpAttributeValue<1, BgpMpNlri, uint8_t, &BgpMpNlri::safi>,
                   BgpPathAttributeMpNlriNextHop,
                   BgpPathAttributeReserved,
-                  BgpPathAttributeMpNlriChoice> Sequence;
+                  Nlri> Sequence;
 };
 
+template <class Nlri>
 class BgpPathAttributeMpUnreachNlriSequence :
-public ProtoSequence<BgpPathAttributeMpUnreachNlriSequence> {
+public ProtoSequence<BgpPathAttributeMpUnreachNlriSequence<Nlri> > {
 public:
     struct Offset {
         std::string operator()() {
@@ -919,9 +1051,11 @@ public:
     typedef mpl::list<BgpPathAttrLength,
                   BgpAttributeValue<2, BgpMpNlri, uint16_t, &BgpMpNlri::afi>,
                   BgpAttributeValue<1, BgpMpNlri, uint8_t, &BgpMpNlri::safi>,
-                  BgpPathAttributeMpNlriChoice> Sequence;
+                  Nlri> Sequence;
 };
 
+typedef BgpPrefixBlock<BgpMpNlri, &BgpMpNlri::nlri_data> BgpMpNlriInPlace;
+
 class BgpPathAttrUnknownValue : public ProtoElement<BgpPathAttrUnknownValue> {
 public:
     static const int kSize = -1;
@@ -946,11 +1080,8 @@ public:
     typedef mpl::list<BgpPathAttrLength, BgpPathAttrUnknownValue> Sequence;
 };
 
-class BgpPathAttribute : public ProtoChoice<BgpPathAttribute> {
-public:
-    static const int kSize = 1;
-
-    typedef Accessor<BgpAttribute, uint8_t, &BgpAttribute::code> Setter;
+template <class MpNlri>
+struct BgpPathAttributeChoice {
     typedef mpl::map<
           mpl::pair<mpl::int_<BgpAttribute::Origin>,
                     BgpAttrTemplate<BgpAttrOrigin, 1, int,
@@ -972,13 +1103,29 @@ public:
           mpl::pair<mpl::int_<BgpAttribute::Communities>,
                     BgpPathAttributeCommunities>,
           mpl::pair<mpl::int_<BgpAttribute::MPReachNlri>,
-                    BgpPathAttributeMpReachNlriSequence>,
+                    BgpPathAttributeMpReachNlriSequence<MpNlri> >,
           mpl::pair<mpl::int_<BgpAttribute::MPUnreachNlri>,
-                    BgpPathAttributeMpUnreachNlriSequence>,
+                    BgpPathAttributeMpUnreachNlriSequence<MpNlri> >,
           mpl::pair<mpl::int_<BgpAttribute::ExtendedCommunities>,
                     BgpPathAttributeExtendedCommunities>,
           mpl::pair<mpl::int_<-1>, BgpPathAttributeUnknown>
-    > Choice;
+    > type;
+};
+
+class BgpPathAttribute : public ProtoChoice<BgpPathAttribute> {
+public:
+    static const int kSize = 1;
+
+    typedef Accessor<BgpAttribute, uint8_t, &BgpAttribute::code> Setter;
+    typedef BgpPathAttributeChoice<BgpPathAttributeMpNlriChoice>::type Choice;
+};
+
+class BgpPathAttributeInPlace : public ProtoChoice<BgpPathAttributeInPlace> {
+public:
+    static const int kSize = 1;
+
+    typedef Accessor<BgpAttribute, uint8_t, &BgpAttribute::code> Setter;
+    typedef BgpPathAttributeChoice<BgpMpNlriInPlace>::type Choice;
 };
 
 class BgpPathAttributeList : public ProtoSequence<BgpPathAttributeList> {
@@ -1045,6 +1192,63 @@ public:
     typedef mpl::list<BgpMarker, BgpMsgLength, BgpMsgType> Sequence;
 };
 
+//
+// UPDATE message for DecodeInPlace. Same as above, except for the prefixes.
+//
+class BgpUpdateWithdrawnRoutesInPlace :
+    public ProtoSequence<BgpUpdateWithdrawnRoutesInPlace> {
+public:
+    static const int kSize = 2;
+    static const int kMinOccurs = 0;
+    static const int kErrorCode = BgpProto::Notification::UpdateMsgErr;
+    static const int kErrorSubcode =
+            BgpProto::Notification::MalformedAttributeList;
+    typedef mpl::list<BgpPrefixBlock<BgpProto::Update,
+                      &BgpProto::Update::withdrawn_data> > Sequence;
+};
+
+class BgpPathAttributeListInPlace :
+    public ProtoSequence<BgpPathAttributeListInPlace> {
+public:
+    static const int kSize = 2;
+    static const int kMinOccurs = 0;
+    static const int kMaxOccurs = -1;
+    static const int kErrorCode = BgpProto::Notification::UpdateMsgErr;
+    static const int kErrorSubcode =
+            BgpProto::Notification::MalformedAttributeList;
+    typedef CollectionAccessor<BgpProto::Update,
+                vector<BgpAttribute *>,
+                &BgpProto::Update::path_attributes> ContextStorer;
+    typedef mpl::list<BgpPathAttributeFlags, BgpPathAttributeInPlace> Sequence;
+};
+
+class BgpUpdateMessageInPlace : public ProtoSequence<BgpUpdateMessageInPlace> {
+public:
+    typedef mpl::list<BgpUpdateWithdrawnRoutesInPlace,
+                      BgpPathAttributeListInPlace,
+                      BgpPrefixBlock<BgpProto::Update,
+                                     &BgpProto::Update::nlri_data> > Sequence;
+    typedef BgpProto::Update ContextType;
+};
+
+class BgpMsgTypeInPlace : public ProtoChoice<BgpMsgTypeInPlace> {
+public:
+    static const int kSize = 1;
+    static const int kErrorCode = BgpProto::Notification::MsgHdrErr;
+    static const int kErrorSubcode = BgpProto::Notification::BadMsgType;
+    typedef mpl::map<
+        mpl::pair<mpl::int_<BgpProto::OPEN>, BgpOpenMessage>,
+        mpl::pair<mpl::int_<BgpProto::NOTIFICATION>, BgpNotificationMessage>,
+        mpl::pair<mpl::int_<BgpProto::KEEPALIVE>, BgpKeepaliveMessage>,
+        mpl::pair<mpl::int_<BgpProto::UPDATE>, BgpUpdateMessageInPlace>
+    > Choice;
+};
+
+class BgpProtocolInPlace : public ProtoSequence<BgpProtocolInPlace> {
+public:
+    typedef mpl::list<BgpMarker, BgpMsgLength, BgpMsgTypeInPlace> Sequence;
+};
+
 BgpProto::BgpMessage *BgpProto::Decode(const uint8_t *data, size_t size,
                                        ParseErrorContext *ec) {
     ParseContext context;
@@ -1058,6 +1262,25 @@ BgpProto::BgpMessage *BgpProto::Decode(const uint8_t *data, size_t size,
     return static_cast<BgpMessage *>(context.release());
 }
 
+BgpProto::BgpMessage *BgpProto::DecodeInPlace(const uint8_t *data,
+                                              size_t size,
+                                              ParseErrorContext *ec) {
+    ParseContext context;
+    int result = BgpProtocolInPlace::Parse(data, size, &context,
+                                           (void *) NULL);
+    if (result < 0) {
+        if (ec) {
+            *ec = context.error_context();
+        }
+        return NULL;
+    }
+    BgpMessage *msg = static_cast<BgpMessage *>(context.release());
+    if (msg->type == UPDATE) {
+        static_cast<Update *>(msg)->SetBuffer(data, size);
+    }
+    return msg;
+}
+
 int BgpProto::Encode(const BgpMessage *msg, uint8_t *data, size_t size,
                      EncodeOffsets *offsets) {
     EncodeContext ctx;
@@ -280,10 +280,45 @@ public:
         int CompareTo(const Update &rhs) const;
         static BgpProto::Update *Decode(const uint8_t *data, size_t size);
 
+        // Keep a copy of the message the prefixes in wire format refer to.
+        void SetBuffer(const uint8_t *data, size_t size);
+
         std::vector <BgpProtoPrefix *> withdrawn_routes;
         std::vector <BgpAttribute *> path_attributes;
         std::vector <BgpProtoPrefix *> nlri;
         static int EncodeData(Update *msg, uint8_t *data, size_t size);
+
+        // Set instead of withdrawn_routes and nlri by DecodeInPlace.
+        BgpProtoNlriData withdrawn_data;
+        BgpProtoNlriData nlri_data;
+        std::vector<uint8_t> buffer;
+    };
+
+    //
+    // Iterator over the prefixes of the withdrawn routes or NLRI field of
+    // an UPDATE, or of a MP_REACH_NLRI or MP_UNREACH_NLRI attribute.
+    // Prefixes left in wire format are decoded one at a time into a
+    // BgpProtoPrefix that belongs to the iterator and is overwritten by
+    // the next call to Next.
+    //
+    class PrefixIterator {
+    public:
+        PrefixIterator(const std::vector<BgpProtoPrefix *> &prefixes,
+                       const BgpProtoNlriData &nlri_data);
+        explicit PrefixIterator(const BgpMpNlri *nlri);
+
+        bool HasNext() const;
+        const BgpProtoPrefix *Next();
+
+    private:
+        std::vector<BgpProtoPrefix *>::const_iterator iter_;
+        std::vector<BgpProtoPrefix *>::const_iterator end_;
+        const uint8_t *data_;
+        const uint8_t *data_end_;
+        bool evpn_;
+        BgpProtoPrefix prefix_;
+
+        DISALLOW_COPY_AND_ASSIGN(PrefixIterator);
     };
 
     static const int kMinMessageSize = 19;
@@ -292,6 +327,12 @@ public:
     static BgpMessage *Decode(const uint8_t *data, size_t size,
                               ParseErrorContext *ec = NULL);
 
+    // Same as Decode, but the prefixes of an UPDATE are only validated and
+    // left in wire format instead of being built into BgpProtoPrefix lists.
+    // The message is parsed where it is and copied once into the Update.
+    static BgpMessage *DecodeInPlace(const uint8_t *data, size_t size,
+                                     ParseErrorContext *ec = NULL);
+
     static int Encode(const BgpMessage *msg, uint8_t *data, size_t size,
                       EncodeOffsets *offsets = NULL);
     static int Encode(const BgpMpNlri *msg, uint8_t *data, size_t size,
@@ -389,17 +389,26 @@ void RibOutUpdates::UpdatePack(int queue_id, Message *message,
 // message to each of them.  Update the blocked RibPeerSet with peers that
 // become blocked after sending the message.
 //
+// Messages that support it are sent as a list of buffers, so that the part
+// that's common to all peers is not copied for each peer.
+//
 void RibOutUpdates::UpdateSend(Message *message, const RibPeerSet &dst,
         RibPeerSet *blocked) {
     CHECK_CONCURRENCY("bgp::SendTask");
 
+    IPeerUpdate::BufferList buffers;
     RibOut::PeerIterator iter(ribout_, dst);
     while (iter.HasNext()) {
         int ix_current = iter.index();
         IPeerUpdate *peer = iter.Next();
-        size_t msgsize;
-        const uint8_t *data = message->GetData(peer, &msgsize);
-        bool more = peer->SendUpdate(data, msgsize);
+        bool more;
+        if (message->GetBuffers(peer, &buffers)) {
+            more = peer->SendUpdateBuffers(buffers);
+        } else {
+            size_t msgsize;
+            const uint8_t *data = message->GetData(peer, &msgsize);
+            more = peer->SendUpdate(data, msgsize);
+        }
         if (!more) {
             blocked->set(ix_current);
         }
@@ -36,31 +36,46 @@ const BgpPath *BgpRoute::BestPath() const {
 //
 // Insert given path and redo path selection.
 //
+// The path list is always kept sorted, so the new path is inserted at its
+// position instead of sorting the whole list again.  This relies on paths
+// not changing in place: a path with new attributes is added as a new path
+// and the old one is deleted.
+//
 void BgpRoute::InsertPath(BgpPath *path) {
     const Path *prev_front = front();
 
-    insert(path);
-
-    Sort(&BgpTable::PathSelection, prev_front);
+    size_t compares = InsertSorted(path, &BgpTable::PathSelection, prev_front);
 
     // Update counters.
     BgpTable *table = static_cast<BgpTable *>(get_table());
-    if (table) table->UpdatePathCount(path, +1);
+    if (table) {
+        table->UpdatePathCount(path, +1);
+        table->UpdatePathSelectionCount(compares);
+    }
     path->UpdatePeerRefCount(+1);
 }
 
 //
 // Delete given path and redo path selection.
 //
+// PathSelection is not transitive, since MED is only compared between paths
+// from the same neighbor AS. The paths on either side of the deleted one are
+// compared, and all paths are sorted again if they are out of order.
+//
 void BgpRoute::DeletePath(BgpPath *path) {
     const Path *prev_front = front();
 
-    remove(path);
-    Sort(&BgpTable::PathSelection, prev_front);
+    size_t compares;
+    bool in_order =
+        RemoveSorted(path, &BgpTable::PathSelection, prev_front, &compares);
 
     // Update counters.
     BgpTable *table = static_cast<BgpTable *>(get_table());
-    if (table) table->UpdatePathCount(path, -1);
+    if (table) {
+        table->UpdatePathCount(path, -1);
+        if (in_order)
+            table->UpdatePathSelectionCount(compares);
+    }
     path->UpdatePeerRefCount(-1);
 
     delete path;
@@ -30,6 +30,7 @@
 #include "bgp/security_group/security_group.h"
 #include "bgp/tunnel_encap/tunnel_encap.h"
 #include "db/db_table_partition.h"
+#include "db/db_table_walker.h"
 #include "xmpp/xmpp_server.h"
 
 using namespace boost::assign;
@@ -601,12 +602,15 @@ public:
     static void FillRoutingTableStats(ShowRoutingInstanceTable &rit,
                                       BgpTable *table) {
         rit.set_name(table->name());
-        rit.set_walk_requests(
-            table->database()->GetWalker()->walk_request_count());
-        rit.set_walk_completes(
-            table->database()->GetWalker()->walk_complete_count());
-        rit.set_walk_cancels(
-            table->database()->GetWalker()->walk_cancel_count());
+        DBTableWalker *walker = table->database()->GetWalker();
+        rit.set_walk_requests(walker->walk_request_count());
+        rit.set_walk_completes(walker->walk_complete_count());
+        rit.set_walk_cancels(walker->walk_cancel_count());
+        rit.set_walk_traversals(walker->walk_traversal_count());
+        rit.set_walk_coalesced(walker->walk_coalesce_count());
+        rit.set_walk_visits(walker->walk_visit_count());
+        rit.set_walk_avg_latency_usecs(walker->walk_latency_avg_usecs());
+        rit.set_walk_max_latency_usecs(walker->walk_latency_max_usecs());
         size_t markers;
         rit.set_pending_updates(table->GetPendingRiboutsCount(markers));
         rit.set_markers(markers);
@@ -615,6 +619,16 @@ public:
         rit.secondary_paths = table->GetSecondaryPathCount();
         rit.infeasible_paths = table->GetInfeasiblePathCount();
         rit.paths = rit.primary_paths + rit.secondary_paths;
+        rit.set_path_selections(table->GetPathSelectionCount());
+        rit.set_path_selection_compares(
+            table->GetPathSelectionCompareCount());
+        rit.set_listener_states(table->StateCount());
+        if (rit.prefixes) {
+            rit.set_state_bytes_per_entry(
+                table->StateMemory() / rit.prefixes);
+            rit.set_state_map_bytes_per_entry(
+                table->StateMapMemory() / rit.prefixes);
+        }
     }
 
     static void FillRoutingInstanceInfo(const RequestPipeline::StageData *sd,
@@ -1312,6 +1326,23 @@ public:
                         socket_stats.write_blocked_duration_usecs/
                         socket_stats.write_blocked);
             }
+            peer_socket_stats.set_syscalls(socket_stats.write_syscalls);
+            if (socket_stats.write_syscalls) {
+                peer_socket_stats.set_average_syscall_bytes(
+                    socket_stats.write_syscall_bytes/
+                    socket_stats.write_syscalls);
+            }
+        }
+
+        static void GetBufferPoolStats(TcpServer *server,
+                              TcpServerBufferPoolStats &buffer_pool_stats) {
+            const TcpBufferPool &pool = server->GetBufferPool();
+            buffer_pool_stats.buffer_size = pool.buffer_size();
+            buffer_pool_stats.hits = pool.stats().hits;
+            buffer_pool_stats.misses = pool.stats().misses;
+            buffer_pool_stats.recycled = pool.stats().recycled;
+            buffer_pool_stats.freed = pool.stats().freed;
+            buffer_pool_stats.free_buffers = pool.free_count();
         }
 
 };
@@ -1334,6 +1365,11 @@ public:
         GetTxSocketStats(bsc->bgp_server->session_manager(), peer_socket_stats);
         resp->set_tx_socket_stats(peer_socket_stats);
 
+        TcpServerBufferPoolStats buffer_pool_stats;
+        GetBufferPoolStats(bsc->bgp_server->session_manager(),
+                           buffer_pool_stats);
+        resp->set_rx_buffer_pool_stats(buffer_pool_stats);
+
         resp->set_context(req->context());
         resp->Response();
         return true;
@@ -1374,6 +1410,11 @@ public:
                          peer_socket_stats);
         resp->set_tx_socket_stats(peer_socket_stats);
 
+        TcpServerBufferPoolStats buffer_pool_stats;
+        GetBufferPoolStats(bsc->xmpp_peer_manager->xmpp_server(),
+                           buffer_pool_stats);
+        resp->set_rx_buffer_pool_stats(buffer_pool_stats);
+
         resp->set_context(req->context());
         resp->Response();
         return true;
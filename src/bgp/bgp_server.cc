@@ -186,6 +186,8 @@ BgpServer::BgpServer(EventManager *evm)
       config_mgr_(new BgpConfigManager),
       updater_(new ConfigUpdater(this)) {
     num_up_peer_ = 0;
+    sched_mgr_->set_max_workers(
+        TaskScheduler::GetInstance()->HardwareThreadCount());
 }
 
 BgpServer::~BgpServer() {
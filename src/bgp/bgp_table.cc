@@ -61,6 +61,8 @@ BgpTable::BgpTable(DB *db, const string &name)
 	primary_path_count_ = 0;
 	secondary_path_count_ = 0;
 	infeasible_path_count_ = 0;
+	path_selection_count_ = 0;
+	path_selection_compare_count_ = 0;
 }
 
 BgpTable::~BgpTable() {
@@ -424,3 +426,8 @@ void BgpTable::UpdatePathCount(const BgpPath *path, int count) {
         infeasible_path_count_ += count;
     }
 }
+
+void BgpTable::UpdatePathSelectionCount(size_t compares) {
+    path_selection_count_++;
+    path_selection_compare_count_ += compares;
+}
@@ -95,6 +95,15 @@ public:
         return infeasible_path_count_;
     }
 
+    // Each path selection done without sorting all paths of the route.
+    void UpdatePathSelectionCount(size_t compares);
+    const uint64_t GetPathSelectionCount() const {
+        return path_selection_count_;
+    }
+    const uint64_t GetPathSelectionCompareCount() const {
+        return path_selection_compare_count_;
+    }
+
 private:
     class DeleteActor;
     friend class BgpTableTest;
@@ -108,6 +117,8 @@ private:
     tbb::atomic<uint64_t> primary_path_count_;
     tbb::atomic<uint64_t> secondary_path_count_;
     tbb::atomic<uint64_t> infeasible_path_count_;
+    tbb::atomic<uint64_t> path_selection_count_;
+    tbb::atomic<uint64_t> path_selection_compare_count_;
 
     DISALLOW_COPY_AND_ASSIGN(BgpTable);
 };
@@ -28,6 +28,8 @@
 #include "bgp/routing-instance/routing_instance.h"
 #include "bgp/scheduling_group.h"
 #include "bgp/security_group/security_group.h"
+#include "bgp/tunnel_encap/tunnel_encap.h"
+#include "bgp/xmpp_item_decoder.h"
 
 #include "net/bgp_af.h"
 #include "net/mac_address.h"
@@ -233,6 +235,7 @@ public:
     }
 
     virtual bool SendUpdate(const uint8_t *msg, size_t msgsize);
+    virtual bool SendUpdateBuffers(const BufferList &buffers);
     virtual std::string ToString() const {
         return parent_->ToString();
     }
@@ -288,6 +291,13 @@ public:
     virtual tbb::atomic<int> GetRefCount() const { return refcount_; }
 
 private:
+    void SendBlocked() {
+        XmppPeerInfoData peer_info;
+        peer_info.set_name(ToUVEKey());
+        peer_info.set_send_state("not in sync");
+        XMPPPeerInfo::Send(peer_info);
+    }
+
     void WriteReadyCb(const boost::system::error_code &ec) {
         if (!server_) return;
         SchedulingGroupManager *sg_mgr = server_->scheduling_group_manager();
@@ -328,10 +338,23 @@ bool BgpXmppChannel::XmppPeer::SendUpdate(const uint8_t *msg, size_t msgsize) {
         send_ready_ = channel->Send(msg, msgsize, xmps::BGP,
                 boost::bind(&BgpXmppChannel::XmppPeer::WriteReadyCb, this, _1));
         if (!send_ready_) {
-            XmppPeerInfoData peer_info;
-            peer_info.set_name(ToUVEKey());
-            peer_info.set_send_state("not in sync");
-            XMPPPeerInfo::Send(peer_info);
+            SendBlocked();
+        }
+        return send_ready_;
+    } else {
+        return false;
+    }
+}
+
+bool BgpXmppChannel::XmppPeer::SendUpdateBuffers(const BufferList &buffers) {
+    XmppChannel *channel = parent_->channel_;
+    if (channel->GetPeerState() == xmps::READY) {
+        parent_->stats_[1].rt_updates ++;
+        if (SkipUpdateSend()) return true;
+        send_ready_ = channel->SendBuffers(buffers, xmps::BGP,
+                boost::bind(&BgpXmppChannel::XmppPeer::WriteReadyCb, this, _1));
+        if (!send_ready_) {
+            SendBlocked();
         }
         return send_ready_;
     } else {
@@ -427,7 +450,7 @@ bool BgpXmppChannel::XmppDecodeAddress(int af, const string &address,
 }
 
 void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
-                                      const pugi::xml_node &node, 
+                                      const pugi::xml_node &node,
                                       bool add_change) {
     autogen::McastItemType item;
     item.Clear();
@@ -453,8 +476,8 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
         return;
     }
 
-    error_code error;
-    IpAddress grp_address = IpAddress::from_string("0.0.0.0", error);
+    XmppMcastItem mcast_item;
+    IpAddress grp_address = Ip4Address();
     if (!item.entry.nlri.group.empty()) {
         if (!(XmppDecodeAddress(item.entry.nlri.af,
                                 item.entry.nlri.group, &grp_address))) {
@@ -464,9 +487,10 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
             return;
         }
     }
+    mcast_item.group = grp_address.to_v4();
 
-    IpAddress src_address = IpAddress::from_string("0.0.0.0", error);
-    if (!item.entry.nlri.source.empty()) { 
+    IpAddress src_address = Ip4Address();
+    if (!item.entry.nlri.source.empty()) {
         if (!(XmppDecodeAddress(item.entry.nlri.af,
                                 item.entry.nlri.source, &src_address))) {
             BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
@@ -475,11 +499,54 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
             return;
         }
     }
-  
+    mcast_item.source = src_address.to_v4();
+
+    if (add_change) {
+        vector<uint32_t> labels;
+
+        // Agents should send only one next-hop in the item
+        if (item.entry.next_hops.next_hop.size() != 1) {
+            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+                    SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                    "More than one nexthop received for the group:"
+                    << item.entry.nlri.group);
+                return;
+        }
+
+        // Label Allocation item.entry.label by parsing the range
+        if (!stringToIntegerList(item.entry.next_hops.next_hop[0].label, "-", labels) ||
+            labels.size() != 2) {
+            BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                "Bad label block range:" << item.entry.next_hops.next_hop[0].label);
+            return;
+        }
+        mcast_item.label_first = labels[0];
+        mcast_item.label_last = labels[1];
+
+        //Next-hop ipaddress
+        IpAddress nh_address;
+        if (!(XmppDecodeAddress(item.entry.next_hops.next_hop[0].af,
+                                item.entry.next_hops.next_hop[0].address, &nh_address))) {
+            BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                "Error parsing nexthop address:" <<
+                 item.entry.next_hops.next_hop[0].address <<
+                " family:" << item.entry.next_hops.next_hop[0].af <<
+                " for multicast route");
+            return;
+        }
+        mcast_item.nexthop = nh_address.to_v4();
+    }
+
+    ProcessMcastItem(vrf_name, mcast_item, add_change);
+}
+
+void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
+                                      const XmppMcastItem &item,
+                                      bool add_change) {
     RoutingInstanceMgr *instance_mgr = bgp_server_->routing_instance_mgr();
     if (!instance_mgr) {
         BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN,
-              BGP_LOG_FLAG_ALL, 
+              BGP_LOG_FLAG_ALL,
               " ProcessMcastItem: Routing Instance Manager not found");
         return;
     }
@@ -487,13 +554,13 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
     bool subscribe_pending = false;
     int instance_id = -1;
     BgpTable *table = NULL;
-    //Build the key to the Multicast DBTable 
+    //Build the key to the Multicast DBTable
     PeerRibMembershipManager *mgr = bgp_server_->membership_mgr();
     if (rt_instance != NULL) {
         table = rt_instance->GetTable(Address::INETMCAST);
         if (table == NULL) {
             BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_WARN,
-                                       BGP_LOG_FLAG_ALL, 
+                                       BGP_LOG_FLAG_ALL,
                                        "Inet Multicast table not found");
             return;
         }
@@ -507,8 +574,8 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
                 instance_id = loc->second.instance_id;
                 subscribe_pending = true;
             } else {
-                BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, 
-                   SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL, 
+                BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+                   SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                    "Inet Multicast Route not processed as no subscription pending");
                 return;
             }
@@ -516,8 +583,8 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
             if (IPeerRib *rib = mgr->IPeerRibFind(peer_.get(), table)) {
                 instance_id = rib->instance_id();
             } else {
-                BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, 
-                   SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL, 
+                BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+                   SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                    "Inet Multicast Route not processed as peer is not registered");
                 return;
             }
@@ -530,15 +597,15 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
             subscribe_pending = true;
             instance_id = loc->second;
         } else {
-            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, 
-               SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL, 
+            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+               SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                "Inet Multicast Route not processed as no subscription pending");
             return;
         }
     }
 
     RouteDistinguisher mc_rd(peer_->bgp_identifier(), instance_id);
-    InetMcastPrefix mc_prefix(mc_rd, grp_address.to_v4(), src_address.to_v4());
+    InetMcastPrefix mc_prefix(mc_rd, item.group, item.source);
 
     //Build and enqueue a DB request for route-addition
     DBRequest req;
@@ -546,43 +613,15 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
 
     if (add_change) {
         req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
-        vector<uint32_t> labels;
-
-        // Agents should send only one next-hop in the item
-        if (item.entry.next_hops.next_hop.size() != 1) {
-            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
-                    SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
-                    "More than one nexthop received for the group:"
-                    << item.entry.nlri.group);
-                return;
-        }
-
-        // Label Allocation item.entry.label by parsing the range
-        if (!stringToIntegerList(item.entry.next_hops.next_hop[0].label, "-", labels) ||
-            labels.size() != 2) {
-            BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
-                "Bad label block range:" << item.entry.next_hops.next_hop[0].label);
-            return;
-        }
 
         BgpAttrSpec attrs;
-        LabelBlockPtr lbptr = lb_mgr_->LocateBlock(labels[0], labels[1]);
+        LabelBlockPtr lbptr =
+            lb_mgr_->LocateBlock(item.label_first, item.label_last);
 
         BgpAttrLabelBlock attr_label(lbptr);
         attrs.push_back(&attr_label);
 
-        //Next-hop ipaddress
-        IpAddress nh_address;
-        if (!(XmppDecodeAddress(item.entry.next_hops.next_hop[0].af,
-                                item.entry.next_hops.next_hop[0].address, &nh_address))) {
-            BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
-                "Error parsing nexthop address:" << 
-                 item.entry.next_hops.next_hop[0].address << 
-                " family:" << item.entry.next_hops.next_hop[0].af <<
-                " for multicast route");
-            return;
-        }
-        BgpAttrNextHop nexthop(nh_address.to_v4().to_ulong());
+        BgpAttrNextHop nexthop(item.nexthop.to_ulong());
         attrs.push_back(&nexthop);
 
         BgpAttrPtr attr = bgp_server_->attr_db()->Locate(attrs);
@@ -600,7 +639,7 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
         //
         DBRequest *request_entry = new DBRequest();
         request_entry->Swap(&req);
-        std::string table_name = 
+        std::string table_name =
             RoutingInstance::GetTableNameFromVrf(vrf_name, Address::INETMCAST);
         defer_q_.insert(std::make_pair(std::make_pair(vrf_name, table_name),
                                        request_entry));
@@ -617,16 +656,14 @@ void BgpXmppChannel::ProcessMcastItem(std::string vrf_name,
     }
 
     BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_DEBUG,
-                               BGP_LOG_FLAG_ALL, "Inet Multicast Group " 
-                               << item.entry.nlri.group <<
-                               " Source " << item.entry.nlri.source <<
-                               " Label Range: " << 
-                               ((item.entry.next_hops.next_hop.size() == 1) ?
-                                 item.entry.next_hops.next_hop[0].label.c_str():
-                                 "Invalid Label Range")
-                               << " from peer:" << peer_->ToString() << 
+                               BGP_LOG_FLAG_ALL, "Inet Multicast Group "
+                               << item.group <<
+                               " Source " << item.source <<
+                               " Label Range: " << item.label_first <<
+                               "-" << item.label_last
+                               << " from peer:" << peer_->ToString() <<
                                " is enqueued for " <<
-                               (add_change ? "add/change" : "delete")); 
+                               (add_change ? "add/change" : "delete"));
     table->Enqueue(&req);
 }
 
@@ -650,9 +687,9 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
         return;
     }
 
+    XmppInetItem inet_item;
     error_code error;
-    Ip4Prefix rt_prefix = Ip4Prefix::FromString(item.entry.nlri.address,
-                                                &error);
+    inet_item.prefix = Ip4Prefix::FromString(item.entry.nlri.address, &error);
     if (error) {
         BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_WARN,
                                    BGP_LOG_FLAG_ALL,
@@ -660,11 +697,54 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
                                    item.entry.nlri.address);
         return;
     }
- 
+
+    if (add_change && !item.entry.next_hops.next_hop.empty()) {
+
+        // Agents should send only one next-hop in the item
+        if (item.entry.next_hops.next_hop.size() != 1) {
+            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+                SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                "More than one nexthop received for the prefix "
+                    << item.entry.nlri.address);
+            return;
+        }
+        IpAddress nh_address;
+        if (!(XmppDecodeAddress(
+                  item.entry.next_hops.next_hop[0].af,
+                  item.entry.next_hops.next_hop[0].address,
+                  &nh_address))) {
+            BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN,
+                BGP_LOG_FLAG_ALL, "Error parsing nexthop address:" <<
+                item.entry.next_hops.next_hop[0].address <<
+                " family:" << item.entry.next_hops.next_hop[0].af <<
+                " for unicast route");
+            return;
+        }
+        inet_item.nexthop = nh_address.to_v4();
+        inet_item.label = item.entry.next_hops.next_hop[0].label;
+
+        // Tunnel Encap list
+        for (std::vector<std::string>::const_iterator it =
+             item.entry.next_hops.next_hop[0].tunnel_encapsulation_list.begin();
+             it !=
+             item.entry.next_hops.next_hop[0].tunnel_encapsulation_list.end();
+             it++) {
+            inet_item.tunnel_encap.push_back(
+                TunnelEncapType::TunnelEncapFromString(*it));
+        }
+    }
+
+    inet_item.security_group = item.entry.security_group_list.security_group;
+
+    ProcessItem(vrf_name, inet_item, add_change);
+}
+
+void BgpXmppChannel::ProcessItem(string vrf_name, const XmppInetItem &item,
+                                 bool add_change) {
     RoutingInstanceMgr *instance_mgr = bgp_server_->routing_instance_mgr();
     if (!instance_mgr) {
         BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN,
-              BGP_LOG_FLAG_ALL, 
+              BGP_LOG_FLAG_ALL,
               " ProcessItem: Routing Instance Manager not found");
         return;
     }
@@ -716,8 +796,8 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
             subscribe_pending = true;
             instance_id = loc->second;
         } else {
-            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, 
-               SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL, 
+            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+               SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
                "Inet Route not processed as no subscription pending");
             return;
         }
@@ -727,10 +807,8 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
         instance_id = rt_instance->index();
 
     DBRequest req;
-    req.key.reset(new InetTable::RequestKey(rt_prefix, peer_.get()));
+    req.key.reset(new InetTable::RequestKey(item.prefix, peer_.get()));
 
-    IpAddress nh_address(Ip4Address(0));
-    uint32_t label = 0;
     uint32_t flags = 0;
     ExtCommunitySpec ext;
 
@@ -738,55 +816,25 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
         req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
         BgpAttrSpec attrs;
 
-        if (!item.entry.next_hops.next_hop.empty()) {
-
-            // Agents should send only one next-hop in the item
-            if (item.entry.next_hops.next_hop.size() != 1) {
-                BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
-                    SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
-                    "More than one nexthop received for the prefix "
-                        << item.entry.nlri.address);
-                return;
-            }
-            if (!(XmppDecodeAddress(
-                      item.entry.next_hops.next_hop[0].af,
-                      item.entry.next_hops.next_hop[0].address,
-                      &nh_address))) {
-                BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, 
-                    BGP_LOG_FLAG_ALL, "Error parsing nexthop address:" << 
-                    item.entry.next_hops.next_hop[0].address << 
-                    " family:" << item.entry.next_hops.next_hop[0].af <<
-                    " for unicast route");
-                return;
-            }
-            label = item.entry.next_hops.next_hop[0].label;
-
-            bool no_valid_tunnel_encap = true;
-            // Tunnel Encap list
-            for (std::vector<std::string>::const_iterator it = 
-                 item.entry.next_hops.next_hop[0].tunnel_encapsulation_list.begin(); 
-                 it !=
-                 item.entry.next_hops.next_hop[0].tunnel_encapsulation_list.end();
-                 it++) {
+        bool no_valid_tunnel_encap = true;
+        for (std::vector<TunnelEncapType::Encap>::const_iterator it =
+             item.tunnel_encap.begin(); it != item.tunnel_encap.end(); it++) {
+            if (*it != TunnelEncapType::UNSPEC) {
+                no_valid_tunnel_encap = false;
                 TunnelEncap tun_encap(*it);
-                if (tun_encap.tunnel_encap() != TunnelEncapType::UNSPEC) {
-                    no_valid_tunnel_encap = false;
-                    ext.communities.push_back(tun_encap.GetExtCommunityValue());
-                }
+                ext.communities.push_back(tun_encap.GetExtCommunityValue());
             }
-            //
-            // If all of the tunnel encaps published by the agent is invalid, 
-            // mark the path as infeasible
-            // If agent has not published any tunnel encap, default the tunnel 
-            // encap to "gre"
-            //
-            if
-                (!item.entry.next_hops.next_hop[0].tunnel_encapsulation_list.tunnel_encapsulation.empty() &&
-                no_valid_tunnel_encap)
-                flags = BgpPath::NoTunnelEncap;
         }
+        //
+        // If all of the tunnel encaps published by the agent is invalid,
+        // mark the path as infeasible
+        // If agent has not published any tunnel encap, default the tunnel
+        // encap to "gre"
+        //
+        if (!item.tunnel_encap.empty() && no_valid_tunnel_encap)
+            flags = BgpPath::NoTunnelEncap;
 
-        BgpAttrNextHop nexthop(nh_address.to_v4().to_ulong());
+        BgpAttrNextHop nexthop(item.nexthop.to_ulong());
         attrs.push_back(&nexthop);
 
         BgpAttrSourceRd source_rd(
@@ -794,9 +842,9 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
         attrs.push_back(&source_rd);
 
         // SGID list
-        for (std::vector<int>::iterator it = 
-             item.entry.security_group_list.security_group.begin(); 
-             it != item.entry.security_group_list.security_group.end(); 
+        for (std::vector<int>::const_iterator it =
+             item.security_group.begin();
+             it != item.security_group.end();
              it++) {
             SecurityGroup sg(bgp_server_->autonomous_system(), *it);
             ext.communities.push_back(sg.GetExtCommunityValue());
@@ -815,7 +863,7 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
 
         BgpAttrPtr attr = bgp_server_->attr_db()->Locate(attrs);
 
-        req.data.reset(new InetTable::RequestData(attr, flags, label));
+        req.data.reset(new InetTable::RequestData(attr, flags, item.label));
         stats_[0].reach++;
     } else {
         req.oper = DBRequest::DB_ENTRY_DELETE;
@@ -826,9 +874,9 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
     if (subscribe_pending) {
         DBRequest *request_entry = new DBRequest();
         request_entry->Swap(&req);
-        std::string table_name = 
+        std::string table_name =
             RoutingInstance::GetTableNameFromVrf(vrf_name, Address::INET);
-        defer_q_.insert(std::make_pair(std::make_pair(vrf_name, table_name), 
+        defer_q_.insert(std::make_pair(std::make_pair(vrf_name, table_name),
                                        request_entry));
         return;
     }
@@ -837,9 +885,9 @@ void BgpXmppChannel::ProcessItem(string vrf_name,
 
     BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_DEBUG,
                                BGP_LOG_FLAG_ALL,
-                               "Inet route " << item.entry.nlri.address <<
-                               " with next-hop " << nh_address
-                               << " and label " << label
+                               "Inet route " << item.prefix.ToString() <<
+                               " with next-hop " << item.nexthop
+                               << " and label " << item.label
                                <<  " is enqueued for "
                                << (add_change ? "add/change" : "delete"));
     table->Enqueue(&req);
@@ -886,8 +934,43 @@ void BgpXmppChannel::ProcessEnetItem(string vrf_name,
                                    item.entry.nlri.address);
         return;
     }
-    EnetPrefix enet_prefix(mac_addr, ip_prefix);
 
+    XmppEnetItem enet_item;
+    enet_item.prefix = EnetPrefix(mac_addr, ip_prefix);
+
+    if (add_change && !item.entry.next_hops.next_hop.empty()) {
+
+        // Agents should send only one next-hop in the item
+        if (item.entry.next_hops.next_hop.size() != 1) {
+            BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
+                SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                "More than one nexthop received for the prefix "
+                    << item.entry.nlri.mac << ","
+                    << item.entry.nlri.address);
+            return;
+        }
+        IpAddress nh_address;
+        if (!(XmppDecodeAddress(
+                  item.entry.next_hops.next_hop[0].af,
+                  item.entry.next_hops.next_hop[0].address,
+                  &nh_address))) {
+            BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
+                "Error parsing nexthop address:" <<
+                item.entry.next_hops.next_hop[0].address <<
+                " family:" << item.entry.next_hops.next_hop[0].af <<
+                " for enet route");
+            return;
+        }
+        enet_item.nexthop = nh_address.to_v4();
+        enet_item.label = item.entry.next_hops.next_hop[0].label;
+    }
+
+    ProcessEnetItem(vrf_name, enet_item, add_change);
+}
+
+void BgpXmppChannel::ProcessEnetItem(string vrf_name,
+                                     const XmppEnetItem &item,
+                                     bool add_change) {
     RoutingInstanceMgr *instance_mgr = bgp_server_->routing_instance_mgr();
     if (!instance_mgr) {
         BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN,
@@ -954,41 +1037,13 @@ void BgpXmppChannel::ProcessEnetItem(string vrf_name,
         instance_id = rt_instance->index();
 
     DBRequest req;
-    req.key.reset(new EnetTable::RequestKey(enet_prefix, peer_.get()));
-
-    IpAddress nh_address(Ip4Address(0));
-    uint32_t label = 0;
+    req.key.reset(new EnetTable::RequestKey(item.prefix, peer_.get()));
 
     if (add_change) {
         req.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
         BgpAttrSpec attrs;
 
-        if (!item.entry.next_hops.next_hop.empty()) {
-
-            // Agents should send only one next-hop in the item
-            if (item.entry.next_hops.next_hop.size() != 1) {
-                BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name,
-                    SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
-                    "More than one nexthop received for the prefix "
-                        << item.entry.nlri.mac << ","
-                        << item.entry.nlri.address);
-                return;
-            }
-            if (!(XmppDecodeAddress(
-                      item.entry.next_hops.next_hop[0].af,
-                      item.entry.next_hops.next_hop[0].address,
-                      &nh_address))) {
-                BGP_LOG_XMPP_PEER(Peer(), SandeshLevel::SYS_WARN, BGP_LOG_FLAG_ALL,
-                    "Error parsing nexthop address:" <<
-                    item.entry.next_hops.next_hop[0].address <<
-                    " family:" << item.entry.next_hops.next_hop[0].af <<
-                    " for enet route");
-                return;
-            }
-            label = item.entry.next_hops.next_hop[0].label;
-        }
-
-        BgpAttrNextHop nexthop(nh_address.to_v4().to_ulong());
+        BgpAttrNextHop nexthop(item.nexthop.to_ulong());
         attrs.push_back(&nexthop);
 
         BgpAttrSourceRd source_rd(
@@ -997,7 +1052,7 @@ void BgpXmppChannel::ProcessEnetItem(string vrf_name,
 
         BgpAttrPtr attr = bgp_server_->attr_db()->Locate(attrs);
 
-        req.data.reset(new EnetTable::RequestData(attr, 0, label));
+        req.data.reset(new EnetTable::RequestData(attr, 0, item.label));
         stats_[0].reach++;
     } else {
         req.oper = DBRequest::DB_ENTRY_DELETE;
@@ -1019,10 +1074,9 @@ void BgpXmppChannel::ProcessEnetItem(string vrf_name,
 
     BGP_LOG_XMPP_PEER_INSTANCE(Peer(), vrf_name, SandeshLevel::SYS_DEBUG,
                                BGP_LOG_FLAG_ALL,
-                               "Enet route " << item.entry.nlri.mac << ","
-                               << item.entry.nlri.address
-                               << " with next-hop " << nh_address
-                               << " and label " << label
+                               "Enet route " << item.prefix.ToString()
+                               << " with next-hop " << item.nexthop
+                               << " and label " << item.label
                                <<  " is enqueued for "
                                << (add_change ? "add/change" : "delete"));
     table->Enqueue(&req);
@@ -1389,35 +1443,73 @@ void BgpXmppChannel::ReceiveUpdate(const XmppStanza::XmppMessage *msg) {
             } else if (iq->action.compare("unsubscribe") == 0) {
                 ProcessSubscriptionRequest(iq->node, iq, false);
             } else if (iq->action.compare("publish") == 0) {
-                XmlBase *impl = msg->dom.get();
                 stats_[0].rt_updates++;
-                XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl);
-                for (xml_node item = pugi->FindNode("item"); item;
-                    item = item.next_sibling()) {
-                    if (strcmp(item.name(), "item") != 0) continue;
-
-                        std::string id(iq->as_node.c_str());
-                        char *str = const_cast<char *>(id.c_str());
-                        char *saveptr;
-                        char *af = strtok_r(str, "/", &saveptr);
-                        char *safi = strtok_r(NULL, "/", &saveptr);
-
-                        if (atoi(af) == BgpAf::IPv4 &&
-                            atoi(safi) == BgpAf::Unicast) {
-                            ProcessItem(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::IPv4 &&
-                            atoi(safi) == BgpAf::Mcast) {
-                            ProcessMcastItem(iq->node, item, iq->is_as_node);
-                        } else if (atoi(af) == BgpAf::L2Vpn &&
-                                   atoi(safi) == BgpAf::Enet) {
-                            ProcessEnetItem(iq->node, item, iq->is_as_node);
-                        }
-                }
+                ProcessPublishRequest(iq);
             }
         }
     }
 }
 
+//
+// Decode the items straight from the stanza when possible. The items that
+// the XmppItemDecoder doesn't handle, and all of the remaining ones, are
+// processed using the dom of the complete stanza, which is only built at
+// that point.
+//
+void BgpXmppChannel::ProcessPublishRequest(
+        const XmppStanza::XmppMessageIq *iq) {
+    std::string id(iq->as_node.c_str());
+    char *str = const_cast<char *>(id.c_str());
+    char *saveptr;
+    char *af_str = strtok_r(str, "/", &saveptr);
+    char *safi_str = strtok_r(NULL, "/", &saveptr);
+    if (af_str == NULL || safi_str == NULL)
+        return;
+    int af = atoi(af_str);
+    int safi = atoi(safi_str);
+
+    size_t decoded = 0;
+    if (!iq->data.empty()) {
+        XmppItemDecoder decoder(iq->data.data(), iq->data.size());
+        if (af == BgpAf::IPv4 && safi == BgpAf::Unicast) {
+            XmppInetItem item;
+            while (decoder.NextItem() && decoder.DecodeInetItem(&item)) {
+                ProcessItem(iq->node, item, iq->is_as_node);
+            }
+        } else if (af == BgpAf::IPv4 && safi == BgpAf::Mcast) {
+            XmppMcastItem item;
+            while (decoder.NextItem() && decoder.DecodeMcastItem(&item)) {
+                ProcessMcastItem(iq->node, item, iq->is_as_node);
+            }
+        } else if (af == BgpAf::L2Vpn && safi == BgpAf::Enet) {
+            XmppEnetItem item;
+            while (decoder.NextItem() && decoder.DecodeEnetItem(&item)) {
+                ProcessEnetItem(iq->node, item, iq->is_as_node);
+            }
+        }
+        if (!decoder.failed())
+            return;
+        decoded = decoder.count();
+    }
+
+    XmlBase *impl = iq->LoadDom();
+    XmlPugi *pugi = reinterpret_cast<XmlPugi *>(impl);
+    size_t count = 0;
+    for (xml_node item = pugi->FindNode("item"); item;
+        item = item.next_sibling()) {
+        if (strcmp(item.name(), "item") != 0) continue;
+        if (count++ < decoded) continue;
+
+        if (af == BgpAf::IPv4 && safi == BgpAf::Unicast) {
+            ProcessItem(iq->node, item, iq->is_as_node);
+        } else if (af == BgpAf::IPv4 && safi == BgpAf::Mcast) {
+            ProcessMcastItem(iq->node, item, iq->is_as_node);
+        } else if (af == BgpAf::L2Vpn && safi == BgpAf::Enet) {
+            ProcessEnetItem(iq->node, item, iq->is_as_node);
+        }
+    }
+}
+
 bool BgpXmppChannelManager::DeleteExecutor(BgpXmppChannel *channel) {
     if (channel->deleted()) return true;
     channel->set_deleted(true);
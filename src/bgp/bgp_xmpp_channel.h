@@ -31,6 +31,9 @@ class BgpXmppChannelMock;
 class BgpXmppChannelManager;
 class BgpXmppChannelManagerMock;
 class XmppSession;
+struct XmppInetItem;
+struct XmppEnetItem;
+struct XmppMcastItem;
 
 class BgpXmppChannel {
 public:
@@ -98,12 +101,19 @@ private:
 
     virtual void ReceiveUpdate(const XmppStanza::XmppMessage *msg);
 
+    void ProcessPublishRequest(const XmppStanza::XmppMessageIq *iq);
     void ProcessItem(std::string rt_instance, const pugi::xml_node &item,
                      bool add_change);
+    void ProcessItem(std::string rt_instance, const XmppInetItem &item,
+                     bool add_change);
     void ProcessMcastItem(std::string rt_instance, 
                           const pugi::xml_node &item, bool add_change);
+    void ProcessMcastItem(std::string rt_instance,
+                          const XmppMcastItem &item, bool add_change);
     void ProcessEnetItem(std::string rt_instance,
                          const pugi::xml_node &item, bool add_change);
+    void ProcessEnetItem(std::string rt_instance,
+                         const XmppEnetItem &item, bool add_change);
     void ProcessSubscriptionRequest(std::string rt_instance,
                                     const XmppStanza::XmppMessageIq *iq,
                                     bool add_change);
@@ -63,6 +63,7 @@ public:
 private:
     friend int intrusive_ptr_add_ref(const Community *ccomm);
     friend int intrusive_ptr_del_ref(const Community *ccomm);
+    friend bool intrusive_ptr_try_add_ref(const Community *ccomm);
     friend void intrusive_ptr_release(const Community *ccomm);
 
     mutable tbb::atomic<int> refcount_;
@@ -78,6 +79,16 @@ inline int intrusive_ptr_del_ref(const Community *ccomm) {
     return ccomm->refcount_.fetch_and_decrement();
 }
 
+inline bool intrusive_ptr_try_add_ref(const Community *ccomm) {
+    int count = ccomm->refcount_;
+    while (count > 0) {
+        int prev = ccomm->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count) return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline void intrusive_ptr_release(const Community *ccomm) {
     int prev = ccomm->refcount_.fetch_and_decrement();
     if (prev == 1) {
@@ -199,6 +210,7 @@ public:
 private:
     friend int intrusive_ptr_add_ref(const ExtCommunity *cextcomm);
     friend int intrusive_ptr_del_ref(const ExtCommunity *cextcomm);
+    friend bool intrusive_ptr_try_add_ref(const ExtCommunity *cextcomm);
     friend void intrusive_ptr_release(const ExtCommunity *cextcomm);
 
     mutable tbb::atomic<int> refcount_;
@@ -214,6 +226,16 @@ inline int intrusive_ptr_del_ref(const ExtCommunity *cextcomm) {
     return cextcomm->refcount_.fetch_and_decrement();
 }
 
+inline bool intrusive_ptr_try_add_ref(const ExtCommunity *cextcomm) {
+    int count = cextcomm->refcount_;
+    while (count > 0) {
+        int prev = cextcomm->refcount_.compare_and_swap(count + 1, count);
+        if (prev == count) return true;
+        count = prev;
+    }
+    return false;
+}
+
 inline void intrusive_ptr_release(const ExtCommunity *cextcomm) {
     int prev = cextcomm->refcount_.fetch_and_decrement();
     if (prev == 1) {
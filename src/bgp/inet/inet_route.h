@@ -74,6 +74,12 @@ public:
         return (cmp < 0);
     }
 
+    // Address followed by prefix length, which is the order of CompareTo.
+    virtual uint64_t SortKey() const {
+        return ((uint64_t) prefix_.ip4_addr().to_ulong() << 8) |
+            prefix_.prefixlen();
+    }
+
     // Check whether 'this' is more specific than rhs.
     virtual bool IsMoreSpecific(const std::string &match) const;
     virtual u_int16_t Afi() const { return BgpAf::IPv4; }
@@ -36,6 +36,9 @@ public:
     virtual size_t Hash(const DBEntry *entry) const;
     virtual size_t Hash(const DBRequestKey *key) const;
 
+    // InetRoute::SortKey is unique for every prefix.
+    virtual bool UseBTreeStorage() const { return true; }
+
     virtual bool Export(RibOut *ribout, Route *route,
                         const RibPeerSet &peerset,
                         UpdateInfoSList &info_slist);
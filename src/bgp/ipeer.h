@@ -5,6 +5,9 @@
 #ifndef __IPEER_H__
 #define __IPEER_H__
 
+#include <vector>
+#include <boost/asio/buffer.hpp>
+
 #include "bgp/bgp_proto.h"
 #include "tbb/atomic.h"
 
@@ -13,6 +16,8 @@ class PeerCloseManager;
 
 class IPeerUpdate {
 public:
+    typedef std::vector<boost::asio::const_buffer> BufferList;
+
     virtual ~IPeerUpdate() { }
     // Printable name
     virtual std::string ToString() const = 0;
@@ -20,6 +25,19 @@ public:
     // Send an update. Returns true if the peer can send additional messages,
     // false if it is send blocked.
     virtual bool SendUpdate(const uint8_t *msg, size_t msgsize) = 0;
+
+    // Send an update made of several buffers. The default implementation
+    // copies them into one buffer and calls SendUpdate.
+    virtual bool SendUpdateBuffers(const BufferList &buffers) {
+        std::vector<uint8_t> data;
+        for (BufferList::const_iterator iter = buffers.begin();
+             iter != buffers.end(); ++iter) {
+            const uint8_t *src =
+                boost::asio::buffer_cast<const uint8_t *>(*iter);
+            data.insert(data.end(), src, src + boost::asio::buffer_size(*iter));
+        }
+        return SendUpdate(data.empty() ? NULL : &data[0], data.size());
+    }
 };
 
 class IPeerDebugStats {
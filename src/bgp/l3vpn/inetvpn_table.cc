@@ -13,6 +13,8 @@
 #include "bgp/inet/inet_table.h"
 #include "bgp/l3vpn/inetvpn_route.h"
 #include "bgp/routing-instance/routing_instance.h"
+#include "bgp/rtarget/rtarget_group_mgr.h"
+#include "bgp/rtarget/rtarget_table.h"
 #include "db/db_table_partition.h"
 
 using namespace std;
@@ -132,7 +134,24 @@ BgpRoute *InetVpnTable::RouteReplicate(BgpServer *server,
 bool InetVpnTable::Export(RibOut *ribout, Route *route,
         const RibPeerSet &peerset, UpdateInfoSList &uinfo_slist) {
     BgpRoute *bgp_route = static_cast<BgpRoute *> (route);
-    UpdateInfo *uinfo = GetUpdateInfo(ribout, bgp_route, peerset);
+
+    // Leave out the BGP peers that have not expressed interest in any of
+    // the route targets of the route.
+    RTargetGroupMgr *rtarget_mgr = NULL;
+    if (ribout->IsEncodingBgp()) {
+        RTargetTable *rtarget_table = static_cast<RTargetTable *>(
+            routing_instance()->GetTable(Address::RTARGET));
+        if (rtarget_table)
+            rtarget_mgr = rtarget_table->GetGroupMgr();
+    }
+    RibPeerSet filtered_peerset(peerset);
+    if (rtarget_mgr) {
+        rtarget_mgr->FilterPeerSet(ribout, bgp_route, &filtered_peerset);
+        if (filtered_peerset.empty())
+            return false;
+    }
+
+    UpdateInfo *uinfo = GetUpdateInfo(ribout, bgp_route, filtered_peerset);
     if (!uinfo) return false;
     uinfo_slist->push_front(*uinfo);
 
@@ -18,6 +18,14 @@ public:
     virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *roattr) = 0;
     virtual void Finish() = 0;
     virtual const uint8_t *GetData(IPeerUpdate *peer_update, size_t *lenp) = 0;
+
+    // Scatter/gather alternative to GetData for messages that are mostly the
+    // same for all peers. Returns false if the message doesn't support it.
+    // The buffers are valid until the message is modified or destroyed.
+    virtual bool GetBuffers(IPeerUpdate *peer_update,
+                            IPeerUpdate::BufferList *buffers) {
+        return false;
+    }
     uint32_t num_reach_routes() const { 
         return num_reach_route_; 
     }
@@ -4,6 +4,8 @@
 
 #include "bgp/routing-instance/routepath_replicator.h"
 
+#include <algorithm>
+
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
@@ -24,6 +26,9 @@
 #include "bgp/routing-instance/routing_instance.h"
 #include "bgp/routing-instance/rtarget_group.h"
 #include "bgp/routing-instance/routing_instance_analytics_types.h"
+#include "bgp/rtarget/rtarget_group_mgr.h"
+#include "bgp/rtarget/rtarget_table.h"
+#include "db/db.h"
 #include "db/db_table_partition.h"
 #include "db/db_table_walker.h"
 
@@ -62,7 +67,8 @@ void TableState::ManagedDelete() {
 
 RoutePathReplicator::RoutePathReplicator(
         BgpServer *server, Address::Family family)
-        : server_(server),
+        : dest_cache_(DB::PartitionCount()),
+          server_(server),
           family_(family),
           walk_trigger_(new TaskTrigger(
           boost::bind(&RoutePathReplicator::StartWalk, this),
@@ -93,6 +99,59 @@ RoutePathReplicator::GetRtGroup(
     return GetRtGroup(rt);
 }
 
+//
+// Get the sorted list of tables that import any of the RouteTargets in the
+// extended community.
+//
+// Extended communities are interned, so the result is cached by identity.
+// The cache is kept per db partition since the table listener runs in all
+// partitions in parallel.  It's flushed from the bgp::Config task, which is
+// mutually exclusive with the db::DBTable task, whenever the import tables
+// of a RtGroup change.
+//
+const RoutePathReplicator::TableList &
+RoutePathReplicator::GetDestinationTables(int part_id,
+                                          const ExtCommunityPtr &ext_community) {
+    DestinationCache &cache = dest_cache_[part_id];
+    DestinationCache::iterator loc = cache.find(ext_community);
+    if (loc != cache.end())
+        return loc->second;
+
+    if (cache.size() >= kMaxDestinationCacheSize)
+        cache.clear();
+    TableList &tables = cache[ext_community];
+    BOOST_FOREACH(const ExtCommunity::ExtCommunityValue &comm,
+                  ext_community->communities()) {
+        if (!ExtCommunity::is_route_target(comm))
+            continue;
+        RtGroup *rtgroup = GetRtGroup(comm);
+        if (rtgroup) {
+            tables.insert(tables.end(), rtgroup->GetImportTables().begin(),
+                          rtgroup->GetImportTables().end());
+        }
+    }
+
+    // Duplicate tables to be removed
+    std::sort(tables.begin(), tables.end());
+    tables.erase(std::unique(tables.begin(), tables.end()), tables.end());
+    return tables;
+}
+
+void RoutePathReplicator::FlushDestinationCache() {
+    CHECK_CONCURRENCY("bgp::Config");
+    BOOST_FOREACH(DestinationCache &cache, dest_cache_) {
+        cache.clear();
+    }
+}
+
+size_t RoutePathReplicator::GetDestinationCacheSize() const {
+    size_t size = 0;
+    BOOST_FOREACH(const DestinationCache &cache, dest_cache_) {
+        size += cache.size();
+    }
+    return size;
+}
+
 RtGroup *
 RoutePathReplicator::LocateRtGroup(const RouteTarget &rt) {
     RtGroup *group = GetRtGroup(rt);
@@ -206,6 +265,37 @@ RoutePathReplicator::BulkReplicationDone(DBTableBase *table) {
     unreg_trigger_->Set();
 }
 
+//
+// Keep the route target membership routes originated for the import route
+// targets of the VRF tables in sync. The VPN table itself imports all route
+// targets and doesn't contribute to the local interest.
+//
+void RoutePathReplicator::UpdateLocalInterest(BgpTable *table,
+                                              const RouteTarget &rt,
+                                              bool add) {
+    if (table->family() == family())
+        return;
+
+    RoutingInstance *master =
+        server()->routing_instance_mgr()->GetRoutingInstance(
+                                     BgpConfigManager::kMasterInstance);
+    if (!master)
+        return;
+    RTargetTable *rtarget_table =
+        static_cast<RTargetTable *>(master->GetTable(Address::RTARGET));
+    if (!rtarget_table || rtarget_table->IsDeleted())
+        return;
+    RTargetGroupMgr *mgr = rtarget_table->GetGroupMgr();
+    if (!mgr)
+        return;
+
+    if (add) {
+        mgr->AddInterest(rt);
+    } else {
+        mgr->RemoveInterest(rt);
+    }
+}
+
 void RoutePathReplicator::Join(BgpTable *table, const RouteTarget &rt,
                                bool import) {
     CHECK_CONCURRENCY("bgp::Config");
@@ -213,10 +303,13 @@ void RoutePathReplicator::Join(BgpTable *table, const RouteTarget &rt,
     RtGroup *group = LocateRtGroup(rt);
 
     // Add the Table to Group
-    if (import)
+    if (import) {
         group->AddImportTable(table);
-    else
+        FlushDestinationCache();
+        UpdateLocalInterest(table, rt, true);
+    } else {
         group->AddExportTable(table);
+    }
 
     RPR_TRACE(TableJoin, table->name(), rt.ToString(), import);
     if (import) {
@@ -256,6 +349,8 @@ void RoutePathReplicator::Leave(BgpTable *table, const RouteTarget &rt,
 
     if (import) {
         group->RemoveImportTable(table);
+        FlushDestinationCache();
+        UpdateLocalInterest(table, rt, false);
         BOOST_FOREACH(BgpTable *bgptable, group->GetExportTables()) {
             RequestWalk(bgptable);
         }
@@ -290,6 +385,7 @@ void RoutePathReplicator::Leave(BgpTable *table, const RouteTarget &rt,
                 group->RemoveImportTable(vpntable);
                 group->RemoveExportTable(vpntable);
                 rt_group_map_.erase(rt);
+                FlushDestinationCache();
             }
         }
     } else if (group->empty()) {
@@ -452,28 +548,12 @@ bool RoutePathReplicator::BgpTableListener(DBTablePartBase *root,
         if (!ext_community)
             continue;
 
-        RtGroup::RtGroupMemberList super_set;
-
-        // For each RouteTarget extended community, get the list of tables to
-        // replicate to.
-        BOOST_FOREACH(const ExtCommunity::ExtCommunityValue &comm, 
-                      ext_community->communities()) {
-            if (!ExtCommunity::is_route_target(comm))
-                continue;
-            RtGroup *rtgroup = GetRtGroup(comm);
-            if (rtgroup) {
-                super_set.insert(super_set.end(), 
-                                 rtgroup->GetImportTables().begin(),
-                                 rtgroup->GetImportTables().end());
-            }
-        }
-
+        // Get the list of tables to replicate to based on the RouteTarget
+        // extended communities.
+        const TableList &super_set =
+            GetDestinationTables(root->index(), extcomm_ptr);
         if (super_set.empty()) continue;
 
-        // Duplicate tables to be removed
-        super_set.sort();
-        super_set.unique();
-
         // To all destination tables.. call replicate
         BOOST_FOREACH(BgpTable *dest, super_set) {
             // same as source table... skip
@@ -6,6 +6,8 @@
 #define ctrlplane_routepath_replicator_h
 
 #include <list>
+#include <map>
+#include <vector>
 
 #include <boost/ptr_container/ptr_map.hpp>
 #include <tbb/mutex.h>
@@ -187,13 +189,30 @@ public:
 
     bool UnregisterTables();
 
+    // Number of entries in the destination table cache, all partitions
+    size_t GetDestinationCacheSize() const;
+
 private:
     typedef std::map<BgpTable *, TableState *> RtGroupTableState;
     typedef std::map<BgpTable *, BulkSyncState *> BulkSyncOrders;
     typedef std::set<BgpTable *> UnregTableList;
+    typedef std::vector<BgpTable *> TableList;
+    typedef std::map<ExtCommunityPtr, TableList> DestinationCache;
+
+    // Each cache entry holds a reference to the ExtCommunity, keeping it
+    // alive until the entry is flushed, plus the list of import tables.
+    // A partition cache is cleared when it reaches this size, which bounds
+    // the memory to kMaxDestinationCacheSize entries per db partition.
+    static const size_t kMaxDestinationCacheSize = 1024;
 
     bool StartWalk();
 
+    const TableList &GetDestinationTables(int part_id,
+                                          const ExtCommunityPtr &ext_community);
+    void FlushDestinationCache();
+    void UpdateLocalInterest(BgpTable *table, const RouteTarget &rt,
+                             bool add);
+
     void DeleteSecondaryPath(BgpTable  *table, BgpRoute *rt,
                              const RtReplicated::SecondaryRouteInfo &rtinfo);
     void DBStateSync(BgpTable *table, BgpRoute *rt, DBTableBase::ListenerId id,
@@ -207,6 +226,8 @@ private:
     RtGroupTableState table_state_;
     BulkSyncOrders bulk_sync_;
     UnregTableList unreg_table_list_;
+    // Destination tables for an extended community, per db partition
+    std::vector<DestinationCache> dest_cache_;
     BgpServer *server_;
     Address::Family family_;
     boost::scoped_ptr<TaskTrigger> walk_trigger_;
@@ -460,6 +460,18 @@ void RoutingInstance::ProcessConfig(BgpServer *server) {
 
     // Create BGP Table
     if (name_ == BgpConfigManager::kMasterInstance) {
+        // Create the route target membership table before the VPN tables
+        // so that the import route targets of the VRFs are tracked from the
+        // start.
+        BgpTable *table_rtarget = static_cast<BgpTable *>(
+                server->database()->CreateTable("bgp.rtarget.0"));
+        if (table_rtarget != NULL) {
+            ROUTING_INSTANCE_TRACE(TableCreate, server, name(),
+                table_rtarget->name(),
+                Address::FamilyToString(Address::RTARGET));
+            AddTable(table_rtarget);
+        }
+
         InetVpnTableCreate(server);
         EvpnTableCreate(server);
 
@@ -867,6 +879,8 @@ std::string RoutingInstance::GetTableNameFromVrf(std::string name,
         table_name = "bgp.l3vpn.0";
     } else if (fmly == Address::EVPN) {
         table_name = "bgp.evpn.0";
+    } else if (fmly == Address::RTARGET) {
+        table_name = "bgp.rtarget.0";
     } else if (name == BgpConfigManager::kMasterInstance) {
         table_name = Address::FamilyToString(fmly) + ".0";
     } else {
@@ -95,6 +95,19 @@ static int GetOriginVnIndex(const BgpRoute *route) {
 // For the purpose of route aggregation, two condition needs to be matched
 //      1. More specific route present in any of the Dest BgpTable partition
 //      2. Connected route(for nexthop) present in Src BgpTable
+//
+// In the source table, only the connected route (of any length) can match.
+// All routes in the destination table can match.
+//
+bool ServiceChain::MatchRange(BgpTable *table, std::auto_ptr<DBEntry> *begin,
+                              std::auto_ptr<DBEntry> *end) {
+    if (table != src_table() || table == dest_table())
+        return false;
+    begin->reset(new InetRoute(Ip4Prefix(service_chain_addr().to_v4(), 0)));
+    end->reset(new InetRoute(Ip4Prefix(service_chain_addr().to_v4(), 32)));
+    return true;
+}
+
 bool ServiceChain::Match(BgpServer *server, BgpTable *table, 
                               BgpRoute *route, bool deleted) {
     CHECK_CONCURRENCY("db::DBTable");
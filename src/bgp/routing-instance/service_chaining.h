@@ -142,6 +142,8 @@ public:
 
     virtual bool Match(BgpServer *server, BgpTable *table, 
                        BgpRoute *route, bool deleted);
+    virtual bool MatchRange(BgpTable *table, std::auto_ptr<DBEntry> *begin,
+                            std::auto_ptr<DBEntry> *end);
 
     void FillServiceChainInfo(ShowServicechainInfo &info) const; 
 
@@ -163,6 +163,14 @@ public:
     virtual bool Match(BgpServer *server, BgpTable *table, 
                        BgpRoute *route, bool deleted);
 
+    // Only the routes for the nexthop address (of any length) can match.
+    virtual bool MatchRange(BgpTable *table, std::auto_ptr<DBEntry> *begin,
+                            std::auto_ptr<DBEntry> *end) {
+        begin->reset(new InetRoute(Ip4Prefix(nexthop_.to_v4(), 0)));
+        end->reset(new InetRoute(Ip4Prefix(nexthop_.to_v4(), 32)));
+        return true;
+    }
+
     void set_unregistered() {
         unregistered_ = true;
     }
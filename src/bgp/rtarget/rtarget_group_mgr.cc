@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/rtarget/rtarget_group_mgr.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+#include "base/task_annotations.h"
+#include "base/task_trigger.h"
+#include "bgp/bgp_attr.h"
+#include "bgp/bgp_path.h"
+#include "bgp/bgp_route.h"
+#include "bgp/bgp_server.h"
+#include "bgp/ipeer.h"
+#include "bgp/routing-instance/routing_instance.h"
+#include "bgp/rtarget/rtarget_route.h"
+#include "bgp/rtarget/rtarget_table.h"
+#include "db/db.h"
+#include "db/db_table_partition.h"
+
+using namespace std;
+
+class RTargetGroupMgr::DeleteActor : public LifetimeActor {
+public:
+    DeleteActor(RTargetGroupMgr *group_mgr)
+        : LifetimeActor(group_mgr->table_->routing_instance()->server()->
+                lifetime_manager()),
+          group_mgr_(group_mgr) {
+    }
+    virtual ~DeleteActor() {
+    }
+
+    virtual bool MayDelete() const {
+        return group_mgr_->MayDelete();
+    }
+
+    virtual void Shutdown() {
+        group_mgr_->Shutdown();
+    }
+
+    virtual void Destroy() {
+        group_mgr_->table_->DestroyGroupMgr();
+    }
+
+private:
+    RTargetGroupMgr *group_mgr_;
+};
+
+//
+// The BGP peers that have a path for a route in the RTargetTable.
+//
+class RTargetGroupMgr::RTargetState : public DBState {
+public:
+    typedef std::set<const IPeer *> PeerSet;
+    PeerSet peers;
+};
+
+RTargetGroupMgr::RTargetGroupMgr(RTargetTable *table)
+    : table_(table),
+      listener_id_(DBTableBase::kInvalidId),
+      walk_all_(false),
+      walk_id_(DBTableWalker::kInvalidWalkerId),
+      walk_rtargets_all_(false),
+      walk_trigger_(new TaskTrigger(
+          boost::bind(&RTargetGroupMgr::StartWalk, this),
+          TaskScheduler::GetInstance()->GetTaskId("bgp::Config"), 0)),
+      table_delete_ref_(this, table->deleter()) {
+    route_states_ = 0;
+    deleter_.reset(new DeleteActor(this));
+}
+
+RTargetGroupMgr::~RTargetGroupMgr() {
+}
+
+//
+// Register a DBListener for the RTargetTable.
+//
+void RTargetGroupMgr::Initialize() {
+    listener_id_ = table_->Register(
+        boost::bind(&RTargetGroupMgr::RouteListener, this, _1, _2));
+}
+
+//
+// Cancel any walk in progress and unregister from the RTargetTable.
+//
+void RTargetGroupMgr::Terminate() {
+    if (walk_id_ != DBTableWalker::kInvalidWalkerId) {
+        DB *db = table_->routing_instance()->server()->database();
+        db->GetWalker()->WalkCancel(walk_id_);
+        walk_id_ = DBTableWalker::kInvalidWalkerId;
+    }
+    table_->Unregister(listener_id_);
+}
+
+//
+// Add local interest in a route target i.e. a local routing instance
+// imports it. The first reference originates a membership route with
+// the local AS as the origin AS.
+//
+void RTargetGroupMgr::AddInterest(const RouteTarget &rtarget) {
+    CHECK_CONCURRENCY("bgp::Config");
+
+    if (deleter_->IsDeleted())
+        return;
+
+    LocalInterestMap::iterator loc = local_interest_.find(rtarget);
+    if (loc != local_interest_.end()) {
+        loc->second.first++;
+        return;
+    }
+
+    uint32_t as = table_->routing_instance()->server()->autonomous_system();
+    local_interest_.insert(make_pair(rtarget, make_pair(1, as)));
+    AddLocalRoute(rtarget, as);
+}
+
+//
+// Remove local interest in a route target. The last reference withdraws
+// the membership route.
+//
+void RTargetGroupMgr::RemoveInterest(const RouteTarget &rtarget) {
+    CHECK_CONCURRENCY("bgp::Config");
+
+    LocalInterestMap::iterator loc = local_interest_.find(rtarget);
+    if (loc == local_interest_.end())
+        return;
+    if (--loc->second.first > 0)
+        return;
+
+    DeleteLocalRoute(rtarget, loc->second.second);
+    local_interest_.erase(loc);
+}
+
+void RTargetGroupMgr::AddLocalRoute(const RouteTarget &rtarget, uint32_t as) {
+    RTargetRoute rt_key(RTargetPrefix(as, rtarget));
+    DBTablePartition *partition =
+        static_cast<DBTablePartition *>(table_->GetTablePartition(&rt_key));
+    BgpRoute *route = static_cast<BgpRoute *>(partition->Find(&rt_key));
+    if (route == NULL) {
+        route = new RTargetRoute(rt_key.GetPrefix());
+        partition->Add(route);
+    } else {
+        route->ClearDelete();
+    }
+
+    if (route->FindPath(NULL, 0, BgpPath::BGP_XMPP))
+        return;
+
+    BgpServer *server = table_->routing_instance()->server();
+    BgpAttrSpec attr_spec;
+    BgpAttrOrigin origin(BgpAttrOrigin::IGP);
+    attr_spec.push_back(&origin);
+    BgpAttrNextHop nexthop(server->bgp_identifier());
+    attr_spec.push_back(&nexthop);
+    BgpAttrPtr attr = server->attr_db()->Locate(attr_spec);
+
+    const IPeer *peer = NULL;
+    route->InsertPath(new BgpPath(peer, BgpPath::BGP_XMPP, attr, 0, 0));
+    partition->Notify(route);
+}
+
+void RTargetGroupMgr::DeleteLocalRoute(const RouteTarget &rtarget,
+                                       uint32_t as) {
+    RTargetRoute rt_key(RTargetPrefix(as, rtarget));
+    DBTablePartition *partition =
+        static_cast<DBTablePartition *>(table_->GetTablePartition(&rt_key));
+    BgpRoute *route = static_cast<BgpRoute *>(partition->Find(&rt_key));
+    if (route == NULL || route->IsDeleted())
+        return;
+
+    route->RemovePath(NULL, 0, BgpPath::BGP_XMPP);
+    if (!route->BestPath()) {
+        partition->Delete(route);
+    } else {
+        partition->Notify(route);
+    }
+}
+
+//
+// Register a BGP peer that has negotiated the route-target family. Called
+// when the peer is established, before it joins the VPN table, so that no
+// routes are exported to it until it advertises its membership routes.
+//
+void RTargetGroupMgr::RegisterPeer(const IPeer *peer) {
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, true);
+    rtarget_peers_.insert(peer);
+}
+
+//
+// Unregister a BGP peer, either because it didn't negotiate the route-target
+// family on its latest session or because it is being deleted.
+//
+void RTargetGroupMgr::UnregisterPeer(const IPeer *peer) {
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, true);
+    rtarget_peers_.erase(peer);
+}
+
+//
+// Return true if the peer is interested in any of the route targets. Peers
+// that have not advertised any membership routes are interested in all
+// routes only if they have not negotiated the route-target family.
+//
+// Must be called with the rw_mutex_ held.
+//
+bool RTargetGroupMgr::IsPeerInterested(const IPeer *peer,
+        const RouteTargetSet &rtargets) const {
+    if (peers_.find(peer) == peers_.end())
+        return (rtarget_peers_.find(peer) == rtarget_peers_.end());
+
+    InterestMap::const_iterator loc = interest_.find(RouteTarget::null_rtarget);
+    if (loc != interest_.end() && loc->second.count(peer))
+        return true;
+
+    for (RouteTargetSet::const_iterator it = rtargets.begin();
+         it != rtargets.end(); ++it) {
+        loc = interest_.find(*it);
+        if (loc != interest_.end() && loc->second.count(peer))
+            return true;
+    }
+    return false;
+}
+
+//
+// Remove the peers that are not interested in the route from the peerset.
+//
+// Concurrency: called from the db::DBTable task of the VPN table.
+//
+void RTargetGroupMgr::FilterPeerSet(RibOut *ribout, const BgpRoute *route,
+                                    RibPeerSet *peerset) const {
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, false);
+    if (peers_.empty() && rtarget_peers_.empty())
+        return;
+
+    const BgpPath *path = route->BestPath();
+    if (!path)
+        return;
+
+    RouteTargetSet rtargets;
+    const ExtCommunity *ext_community = path->GetAttr()->ext_community();
+    if (ext_community) {
+        BOOST_FOREACH(const ExtCommunity::ExtCommunityValue &value,
+                      ext_community->communities()) {
+            if (ExtCommunity::is_route_target(value))
+                rtargets.insert(RouteTarget(value));
+        }
+    }
+
+    RibPeerSet candidates(*peerset);
+    for (RibOut::PeerIterator iter(ribout, candidates); iter.HasNext(); ) {
+        int index = iter.index();
+        const IPeer *peer = static_cast<IPeer *>(iter.Next());
+        if (!IsPeerInterested(peer, rtargets))
+            peerset->reset(index);
+    }
+}
+
+//
+// DBListener callback handler for the RTargetTable. Updates the interest
+// of the BGP peers that have paths for the route.
+//
+void RTargetGroupMgr::RouteListener(DBTablePartBase *tpart,
+                                    DBEntryBase *db_entry) {
+    CHECK_CONCURRENCY("db::DBTable");
+
+    RTargetRoute *route = static_cast<RTargetRoute *>(db_entry);
+    RTargetState *state = static_cast<RTargetState *>(
+        db_entry->GetState(table_, listener_id_));
+
+    RTargetState::PeerSet peers;
+    if (!route->IsDeleted()) {
+        for (Route::PathList::const_iterator it = route->GetPathList().begin();
+             it != route->GetPathList().end(); ++it) {
+            const BgpPath *path = static_cast<const BgpPath *>(it.operator->());
+            const IPeer *peer = path->GetPeer();
+            if (peer && !peer->IsXmppPeer())
+                peers.insert(peer);
+        }
+    }
+
+    if (!state) {
+        if (peers.empty())
+            return;
+        state = new RTargetState;
+        db_entry->SetState(table_, listener_id_, state);
+        route_states_++;
+    }
+
+    const RouteTarget &rtarget = route->GetPrefix().rtarget();
+    BOOST_FOREACH(const IPeer *peer, peers) {
+        if (!state->peers.count(peer))
+            AddPeerInterest(rtarget, peer);
+    }
+    BOOST_FOREACH(const IPeer *peer, state->peers) {
+        if (!peers.count(peer))
+            RemovePeerInterest(rtarget, peer);
+    }
+    state->peers.swap(peers);
+
+    if (state->peers.empty()) {
+        db_entry->ClearState(table_, listener_id_);
+        delete state;
+        if (route_states_.fetch_and_decrement() == 1)
+            MayResumeDelete();
+    }
+}
+
+void RTargetGroupMgr::AddPeerInterest(const RouteTarget &rtarget,
+                                      const IPeer *peer) {
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, true);
+    if (interest_[rtarget][peer]++ == 0)
+        changed_rtargets_.insert(rtarget);
+    if (peers_[peer]++ == 0 || rtarget == RouteTarget::null_rtarget)
+        walk_all_ = true;
+    lock.release();
+    walk_trigger_->Set();
+}
+
+void RTargetGroupMgr::RemovePeerInterest(const RouteTarget &rtarget,
+                                         const IPeer *peer) {
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, true);
+    InterestMap::iterator loc = interest_.find(rtarget);
+    assert(loc != interest_.end());
+    if (--loc->second[peer] == 0) {
+        loc->second.erase(peer);
+        if (loc->second.empty())
+            interest_.erase(loc);
+        changed_rtargets_.insert(rtarget);
+    }
+    if (--peers_[peer] == 0) {
+        peers_.erase(peer);
+        walk_all_ = true;
+    }
+    if (rtarget == RouteTarget::null_rtarget)
+        walk_all_ = true;
+    lock.release();
+    walk_trigger_->Set();
+}
+
+//
+// Start a walk of the VPN table to re-evaluate the routes with the route
+// targets whose interest changed. Changes that happen while a walk is in
+// progress are handled by another walk once it completes.
+//
+bool RTargetGroupMgr::StartWalk() {
+    CHECK_CONCURRENCY("bgp::Config");
+
+    BgpTable *vpn_table =
+        table_->routing_instance()->GetTable(Address::INETVPN);
+
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, true);
+    if (walk_id_ != DBTableWalker::kInvalidWalkerId)
+        return true;
+    if (!walk_all_ && changed_rtargets_.empty())
+        return true;
+
+    walk_rtargets_.clear();
+    walk_rtargets_.swap(changed_rtargets_);
+    walk_rtargets_all_ = walk_all_;
+    walk_all_ = false;
+    if (!vpn_table || vpn_table->IsDeleted() || deleter_->IsDeleted())
+        return true;
+
+    DB *db = table_->routing_instance()->server()->database();
+    walk_id_ = db->GetWalker()->WalkTable(vpn_table, NULL,
+        boost::bind(&RTargetGroupMgr::RouteNotify, this, _1, _2),
+        boost::bind(&RTargetGroupMgr::WalkDone, this, _1));
+    return true;
+}
+
+bool RTargetGroupMgr::RouteNotify(DBTablePartBase *root, DBEntryBase *entry) {
+    BgpRoute *route = static_cast<BgpRoute *>(entry);
+    if (route->IsDeleted())
+        return true;
+
+    if (!walk_rtargets_all_) {
+        const BgpPath *path = route->BestPath();
+        if (!path)
+            return true;
+        const ExtCommunity *ext_community = path->GetAttr()->ext_community();
+        if (!ext_community)
+            return true;
+
+        bool match = false;
+        BOOST_FOREACH(const ExtCommunity::ExtCommunityValue &value,
+                      ext_community->communities()) {
+            if (ExtCommunity::is_route_target(value) &&
+                walk_rtargets_.count(RouteTarget(value))) {
+                match = true;
+                break;
+            }
+        }
+        if (!match)
+            return true;
+    }
+
+    root->Notify(entry);
+    return true;
+}
+
+void RTargetGroupMgr::WalkDone(DBTableBase *table) {
+    tbb::spin_rw_mutex::scoped_lock lock(rw_mutex_, true);
+    walk_id_ = DBTableWalker::kInvalidWalkerId;
+    lock.release();
+    walk_trigger_->Set();
+}
+
+//
+// Initiate shutdown of the RTargetGroupMgr by withdrawing all the locally
+// originated membership routes.
+//
+void RTargetGroupMgr::Shutdown() {
+    CHECK_CONCURRENCY("bgp::Config");
+
+    for (LocalInterestMap::iterator it = local_interest_.begin();
+         it != local_interest_.end(); ++it) {
+        DeleteLocalRoute(it->first, it->second.second);
+    }
+    local_interest_.clear();
+}
+
+//
+// The RTargetGroupMgr can be deleted once the DBState for all routes has
+// been cleaned up.
+//
+bool RTargetGroupMgr::MayDelete() const {
+    CHECK_CONCURRENCY("bgp::Config");
+    return (route_states_ == 0 && local_interest_.empty());
+}
+
+void RTargetGroupMgr::ManagedDelete() {
+    deleter_->Delete();
+}
+
+void RTargetGroupMgr::MayResumeDelete() {
+    if (!deleter()->IsDeleted())
+        return;
+
+    BgpServer *server = table_->routing_instance()->server();
+    server->lifetime_manager()->Enqueue(deleter());
+}
+
+LifetimeActor *RTargetGroupMgr::deleter() {
+    return deleter_.get();
+}
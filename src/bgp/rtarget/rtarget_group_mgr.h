@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_rtarget_group_mgr_h
+#define ctrlplane_rtarget_group_mgr_h
+
+#include <map>
+#include <set>
+
+#include <boost/scoped_ptr.hpp>
+#include <tbb/atomic.h>
+#include <tbb/spin_rw_mutex.h>
+
+#include "base/lifetime.h"
+#include "base/util.h"
+#include "bgp/bgp_ribout.h"
+#include "bgp/rtarget/rtarget_address.h"
+#include "db/db_table_walker.h"
+
+class BgpRoute;
+class DBEntryBase;
+class DBTablePartBase;
+class IPeer;
+class RTargetTable;
+class TaskTrigger;
+
+//
+// This class implements route target constrained distribution (RFC 4684)
+// for the VPN table of the master instance.
+//
+// It keeps track of the route targets that each BGP peer is interested in,
+// based on the route target membership routes received from the peer in
+// the bgp.rtarget.0 table. A peer that has advertised the default route
+// target is interested in all routes. A peer that has negotiated the
+// route-target family but not advertised any membership routes yet is not
+// interested in any route; the first membership route from the peer causes
+// all the routes to be re-evaluated. A peer that has not negotiated the
+// route-target family is interested in all routes. The VPN table
+// consults the RTargetGroupMgr when exporting a route to a BGP RibOut and
+// leaves out the peers that are not interested in any of its route targets,
+// so that no updates are ever enqueued for them.
+//
+// The import route targets of the local routing instances are originated
+// as membership routes, so that peers supporting route target constrained
+// distribution can filter the routes that they send to us.
+//
+// Changes to the interest of the peers are accumulated and the affected VPN
+// routes are re-evaluated with a walk of the VPN table.
+//
+// There's a 1:1 relationship between the RTargetGroupMgr and the
+// RTargetTable, with the RTargetGroupMgr being a dependent of the table via
+// the LifetimeManager infrastructure.
+//
+class RTargetGroupMgr {
+public:
+    explicit RTargetGroupMgr(RTargetTable *table);
+    ~RTargetGroupMgr();
+
+    void Initialize();
+    void Terminate();
+
+    void AddInterest(const RouteTarget &rtarget);
+    void RemoveInterest(const RouteTarget &rtarget);
+
+    void RegisterPeer(const IPeer *peer);
+    void UnregisterPeer(const IPeer *peer);
+
+    void FilterPeerSet(RibOut *ribout, const BgpRoute *route,
+                       RibPeerSet *peerset) const;
+
+    void ManagedDelete();
+    void Shutdown();
+    bool MayDelete() const;
+    void MayResumeDelete();
+
+    LifetimeActor *deleter();
+
+private:
+    class DeleteActor;
+    class RTargetState;
+    typedef std::map<const IPeer *, int> PeerRefMap;
+    typedef std::map<RouteTarget, PeerRefMap> InterestMap;
+    typedef std::map<RouteTarget, std::pair<int, uint32_t> > LocalInterestMap;
+    typedef std::set<RouteTarget> RouteTargetSet;
+    typedef std::set<const IPeer *> PeerSet;
+
+    bool IsPeerInterested(const IPeer *peer,
+                          const RouteTargetSet &rtargets) const;
+    void RouteListener(DBTablePartBase *tpart, DBEntryBase *db_entry);
+    void AddPeerInterest(const RouteTarget &rtarget, const IPeer *peer);
+    void RemovePeerInterest(const RouteTarget &rtarget, const IPeer *peer);
+
+    void AddLocalRoute(const RouteTarget &rtarget, uint32_t as);
+    void DeleteLocalRoute(const RouteTarget &rtarget, uint32_t as);
+
+    bool StartWalk();
+    bool RouteNotify(DBTablePartBase *root, DBEntryBase *entry);
+    void WalkDone(DBTableBase *table);
+
+    RTargetTable *table_;
+    int listener_id_;
+    tbb::atomic<int> route_states_;
+
+    // Protects the interest of the peers and the pending changes.
+    mutable tbb::spin_rw_mutex rw_mutex_;
+    InterestMap interest_;
+    PeerRefMap peers_;
+    // Peers that negotiated the route-target family.
+    PeerSet rtarget_peers_;
+    RouteTargetSet changed_rtargets_;
+    bool walk_all_;
+    DBTableWalker::WalkId walk_id_;
+
+    // Route targets being re-evaluated by the walk in progress.
+    RouteTargetSet walk_rtargets_;
+    bool walk_rtargets_all_;
+
+    LocalInterestMap local_interest_;
+    boost::scoped_ptr<TaskTrigger> walk_trigger_;
+
+    boost::scoped_ptr<DeleteActor> deleter_;
+    LifetimeRef<RTargetGroupMgr> table_delete_ref_;
+
+    DISALLOW_COPY_AND_ASSIGN(RTargetGroupMgr);
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/rtarget/rtarget_route.h"
+
+#include "bgp/rtarget/rtarget_table.h"
+
+using namespace std;
+using boost::system::error_code;
+
+// Route Target Membership NLRI Format
+//
+// +---------------------------------------+
+// |  Origin AS (4 octets)                 |
+// +---------------------------------------+
+// |  Route Target (8 octets)              |
+// +---------------------------------------+
+
+RTargetPrefix::RTargetPrefix(const BgpProtoPrefix &prefix) : as_(0) {
+    if (prefix.prefixlen == 0)
+        return;
+    assert(prefix.prefixlen == kPrefixLen);
+    as_ = get_value(&prefix.prefix[0], 4);
+    RouteTarget::bytes_type bt = { { 0 } };
+    std::copy(prefix.prefix.begin() + 4, prefix.prefix.end(), bt.begin());
+    rtarget_ = RouteTarget(bt);
+}
+
+void RTargetPrefix::BuildProtoPrefix(BgpProtoPrefix *prefix) const {
+    prefix->prefix.clear();
+    if (IsDefault()) {
+        prefix->prefixlen = 0;
+        return;
+    }
+
+    prefix->prefixlen = kPrefixLen;
+    prefix->prefix.resize(kPrefixLen / 8, 0);
+    put_value(&prefix->prefix[0], 4, as_);
+    const RouteTarget::bytes_type &rt_bytes = rtarget_.GetExtCommunity();
+    std::copy(rt_bytes.begin(), rt_bytes.end(), prefix->prefix.begin() + 4);
+}
+
+// as:target:x:y
+RTargetPrefix RTargetPrefix::FromString(const string &str, error_code *errorp) {
+    RTargetPrefix prefix;
+
+    size_t pos = str.find(':');
+    if (pos == string::npos) {
+        if (errorp != NULL) {
+            *errorp = make_error_code(boost::system::errc::invalid_argument);
+        }
+        return prefix;
+    }
+
+    string as_str = str.substr(0, pos);
+    char *endptr;
+    uint32_t as = strtoul(as_str.c_str(), &endptr, 10);
+    if (as_str.empty() || *endptr != '\0') {
+        if (errorp != NULL) {
+            *errorp = make_error_code(boost::system::errc::invalid_argument);
+        }
+        return prefix;
+    }
+
+    string rt_str = str.substr(pos + 1);
+    RouteTarget rtarget;
+    if (rt_str != "target:0:0") {
+        error_code rt_err;
+        rtarget = RouteTarget::FromString(rt_str, &rt_err);
+        if (rt_err != 0) {
+            if (errorp != NULL) {
+                *errorp = rt_err;
+            }
+            return prefix;
+        }
+    }
+
+    prefix.as_ = as;
+    prefix.rtarget_ = rtarget;
+    return prefix;
+}
+
+string RTargetPrefix::ToString() const {
+    char temp[16];
+    snprintf(temp, sizeof(temp), "%u:", as_);
+    return string(temp) + rtarget_.ToString();
+}
+
+int RTargetPrefix::CompareTo(const RTargetPrefix &rhs) const {
+    KEY_COMPARE(as_, rhs.as_);
+    if (rtarget_ < rhs.rtarget_)
+        return -1;
+    if (rhs.rtarget_ < rtarget_)
+        return 1;
+    return 0;
+}
+
+RTargetRoute::RTargetRoute(const RTargetPrefix &prefix)
+    : prefix_(prefix) {
+}
+
+int RTargetRoute::CompareTo(const Route &rhs) const {
+    const RTargetRoute &other = static_cast<const RTargetRoute &>(rhs);
+    return prefix_.CompareTo(other.prefix_);
+}
+
+string RTargetRoute::ToString() const {
+    return prefix_.ToString();
+}
+
+void RTargetRoute::SetKey(const DBRequestKey *reqkey) {
+    const RTargetTable::RequestKey *key =
+        static_cast<const RTargetTable::RequestKey *>(reqkey);
+    prefix_ = key->prefix;
+}
+
+void RTargetRoute::BuildProtoPrefix(BgpProtoPrefix *prefix,
+                                    uint32_t label) const {
+    prefix_.BuildProtoPrefix(prefix);
+}
+
+void RTargetRoute::BuildBgpProtoNextHop(vector<uint8_t> &nh,
+                                        IpAddress nexthop) const {
+    nh.resize(4);
+    const Ip4Address::bytes_type &addr_bytes = nexthop.to_v4().to_bytes();
+    std::copy(addr_bytes.begin(), addr_bytes.end(), nh.begin());
+}
+
+DBEntryBase::KeyPtr RTargetRoute::GetDBRequestKey() const {
+    RTargetTable::RequestKey *key =
+        new RTargetTable::RequestKey(GetPrefix(), NULL);
+    return KeyPtr(key);
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_rtarget_route_h
+#define ctrlplane_rtarget_route_h
+
+#include <boost/system/error_code.hpp>
+
+#include "base/util.h"
+#include "bgp/bgp_attr_base.h"
+#include "bgp/bgp_common.h"
+#include "bgp/bgp_route.h"
+#include "bgp/rtarget/rtarget_address.h"
+#include "net/bgp_af.h"
+
+//
+// Route target membership prefix (RFC 4684). The NLRI consists of the
+// 4 byte origin AS followed by the route target. A zero length prefix
+// is the default route target, which expresses interest in all routes.
+// Partial route target prefixes are not supported.
+//
+class RTargetPrefix {
+public:
+    static const int kPrefixLen = (4 + RouteTarget::kSize) * 8;
+
+    RTargetPrefix() : as_(0) { }
+    explicit RTargetPrefix(const BgpProtoPrefix &prefix);
+    RTargetPrefix(uint32_t as, const RouteTarget &rtarget)
+        : as_(as), rtarget_(rtarget) {
+    }
+
+    static RTargetPrefix FromString(const std::string &str,
+                                    boost::system::error_code *errorp = NULL);
+    std::string ToString() const;
+    int CompareTo(const RTargetPrefix &rhs) const;
+
+    void BuildProtoPrefix(BgpProtoPrefix *prefix) const;
+
+    uint32_t as() const { return as_; }
+    const RouteTarget &rtarget() const { return rtarget_; }
+    bool IsDefault() const {
+        return as_ == 0 && rtarget_ == RouteTarget::null_rtarget;
+    }
+
+private:
+    uint32_t as_;
+    RouteTarget rtarget_;
+};
+
+class RTargetRoute : public BgpRoute {
+public:
+    explicit RTargetRoute(const RTargetPrefix &prefix);
+    virtual int CompareTo(const Route &rhs) const;
+    virtual std::string ToString() const;
+
+    const RTargetPrefix &GetPrefix() const { return prefix_; }
+
+    virtual KeyPtr GetDBRequestKey() const;
+    virtual void SetKey(const DBRequestKey *reqkey);
+
+    virtual void BuildProtoPrefix(BgpProtoPrefix *prefix, uint32_t label) const;
+    virtual void BuildBgpProtoNextHop(std::vector<uint8_t> &nh,
+                                      IpAddress nexthop) const;
+
+    virtual bool IsLess(const DBEntry &genrhs) const {
+        const RTargetRoute &rhs = static_cast<const RTargetRoute &>(genrhs);
+        int cmp = CompareTo(rhs);
+        return (cmp < 0);
+    }
+
+    virtual u_int16_t Afi() const { return BgpAf::IPv4; }
+    virtual u_int8_t Safi() const { return BgpAf::RTarget; }
+
+private:
+    RTargetPrefix prefix_;
+
+    DISALLOW_COPY_AND_ASSIGN(RTargetRoute);
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/rtarget/rtarget_table.h"
+
+#include <boost/functional/hash.hpp>
+
+#include "base/util.h"
+#include "bgp/bgp_ribout.h"
+#include "bgp/bgp_route.h"
+#include "bgp/rtarget/rtarget_group_mgr.h"
+#include "db/db_table_partition.h"
+
+using namespace std;
+
+size_t RTargetTable::HashFunction(const RTargetPrefix &prefix) {
+    return boost::hash_value(prefix.rtarget().GetExtCommunityValue());
+}
+
+RTargetTable::RTargetTable(DB *db, const std::string &name)
+    : BgpTable(db, name), group_mgr_(NULL) {
+}
+
+std::auto_ptr<DBEntry> RTargetTable::AllocEntry(
+        const DBRequestKey *key) const {
+    const RequestKey *pfxkey = static_cast<const RequestKey *>(key);
+    return std::auto_ptr<DBEntry> (new RTargetRoute(pfxkey->prefix));
+}
+
+std::auto_ptr<DBEntry> RTargetTable::AllocEntryStr(
+        const string &key_str) const {
+    RTargetPrefix prefix = RTargetPrefix::FromString(key_str);
+    return std::auto_ptr<DBEntry> (new RTargetRoute(prefix));
+}
+
+size_t RTargetTable::Hash(const DBRequestKey *key) const {
+    const RequestKey *rkey = static_cast<const RequestKey *>(key);
+    size_t value = HashFunction(rkey->prefix);
+    return value % DB::PartitionCount();
+}
+
+size_t RTargetTable::Hash(const DBEntry *entry) const {
+    const RTargetRoute *rt_entry = static_cast<const RTargetRoute *>(entry);
+    size_t value = HashFunction(rt_entry->GetPrefix());
+    return value % DB::PartitionCount();
+}
+
+BgpRoute *RTargetTable::TableFind(DBTablePartition *rtp,
+        const DBRequestKey *prefix) {
+    const RequestKey *pfxkey = static_cast<const RequestKey *>(prefix);
+    RTargetRoute rt_key(pfxkey->prefix);
+    return static_cast<BgpRoute *>(rtp->Find(&rt_key));
+}
+
+DBTableBase *RTargetTable::CreateTable(DB *db, const std::string &name) {
+    RTargetTable *table = new RTargetTable(db, name);
+    table->Init();
+    return table;
+}
+
+//
+// Route target membership routes are never replicated.
+//
+BgpRoute *RTargetTable::RouteReplicate(BgpServer *server,
+        BgpTable *src_table, BgpRoute *src_rt, const BgpPath *src_path,
+        ExtCommunityPtr community) {
+    return NULL;
+}
+
+//
+// Route target membership routes are only advertised to BGP peers.
+//
+bool RTargetTable::Export(RibOut *ribout, Route *route,
+        const RibPeerSet &peerset, UpdateInfoSList &uinfo_slist) {
+    if (!ribout->IsEncodingBgp())
+        return false;
+
+    BgpRoute *bgp_route = static_cast<BgpRoute *> (route);
+    UpdateInfo *uinfo = GetUpdateInfo(ribout, bgp_route, peerset);
+    if (!uinfo)
+        return false;
+    uinfo_slist->push_front(*uinfo);
+
+    return true;
+}
+
+void RTargetTable::CreateGroupMgr() {
+    assert(!group_mgr_);
+    group_mgr_ = new RTargetGroupMgr(this);
+    group_mgr_->Initialize();
+}
+
+void RTargetTable::DestroyGroupMgr() {
+    group_mgr_->Terminate();
+    delete group_mgr_;
+    group_mgr_ = NULL;
+}
+
+void RTargetTable::set_routing_instance(RoutingInstance *rtinstance) {
+    BgpTable::set_routing_instance(rtinstance);
+    CreateGroupMgr();
+}
+
+static void RegisterFactory() {
+    DB::RegisterFactory("bgp.rtarget.0", &RTargetTable::CreateTable);
+}
+
+MODULE_INITIALIZER(RegisterFactory);
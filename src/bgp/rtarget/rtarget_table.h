@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_rtarget_table_h
+#define ctrlplane_rtarget_table_h
+
+#include "bgp/bgp_table.h"
+#include "bgp/rtarget/rtarget_route.h"
+
+class RTargetGroupMgr;
+
+//
+// Route target membership table i.e. bgp.rtarget.0 in the master instance.
+// Routes are exchanged with BGP peers that negotiated the route-target
+// family and are used by the RTargetGroupMgr to determine the route targets
+// that each peer is interested in.
+//
+class RTargetTable : public BgpTable {
+public:
+    struct RequestKey : BgpTable::RequestKey {
+        RequestKey(const RTargetPrefix &prefix, const IPeer *ipeer)
+            : prefix(prefix), peer(ipeer) {
+        }
+        RTargetPrefix prefix;
+        const IPeer *peer;
+        virtual const IPeer *GetPeer() const { return peer; }
+    };
+
+    RTargetTable(DB *db, const std::string &name);
+
+    virtual std::auto_ptr<DBEntry> AllocEntry(const DBRequestKey *key) const;
+    virtual std::auto_ptr<DBEntry> AllocEntryStr(const std::string &key) const;
+
+    virtual Address::Family family() const { return Address::RTARGET; }
+
+    virtual size_t Hash(const DBEntry *entry) const;
+    virtual size_t Hash(const DBRequestKey *key) const;
+
+    virtual BgpRoute *RouteReplicate(BgpServer *server, BgpTable *src_table,
+                                     BgpRoute *src_rt, const BgpPath *path,
+                                     ExtCommunityPtr ptr);
+
+    virtual bool Export(RibOut *ribout, Route *route,
+                        const RibPeerSet &peerset,
+                        UpdateInfoSList &info_slist);
+
+    void CreateGroupMgr();
+    void DestroyGroupMgr();
+    RTargetGroupMgr *GetGroupMgr() { return group_mgr_; }
+
+    static size_t HashFunction(const RTargetPrefix &prefix);
+    static DBTableBase *CreateTable(DB *db, const std::string &name);
+
+    virtual void set_routing_instance(RoutingInstance *rtinstance);
+
+private:
+    virtual BgpRoute *TableFind(DBTablePartition *rtp,
+                                const DBRequestKey *prefix);
+
+    RTargetGroupMgr *group_mgr_;
+
+    DISALLOW_COPY_AND_ASSIGN(RTargetTable);
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/test/task_test_util.h"
+#include "bgp/bgp_attr.h"
+#include "bgp/bgp_config.h"
+#include "bgp/bgp_log.h"
+#include "bgp/bgp_path.h"
+#include "bgp/bgp_server.h"
+#include "bgp/bgp_session_manager.h"
+#include "bgp/l3vpn/inetvpn_route.h"
+#include "bgp/l3vpn/inetvpn_table.h"
+#include "bgp/rtarget/rtarget_route.h"
+#include "bgp/rtarget/rtarget_table.h"
+#include "bgp/test/bgp_server_test_util.h"
+#include "control-node/control_node.h"
+#include "db/db.h"
+#include "io/test/event_manager_test.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+//
+// OVERVIEW
+//
+// Route target constrained distribution between two BgpServers A and B that
+// negotiate the inet-vpn and route-target families. VPN routes are added to
+// bgp.l3vpn.0 on A. Only the routes with a route target that B imports are
+// advertised to B, and the set follows the routing instances configured on
+// B as it originates and withdraws its membership routes.
+//
+
+static const char *config_routers = "\
+<config>\
+    <bgp-router name='A'>\
+        <autonomous-system>64496</autonomous-system>\
+        <identifier>192.168.1.101</identifier>\
+        <address>127.0.0.1</address>\
+        <port>%d</port>\
+        <address-families>\
+            <family>inet-vpn</family>\
+            <family>route-target</family>\
+        </address-families>\
+    </bgp-router>\
+    <bgp-router name='B'>\
+        <autonomous-system>64496</autonomous-system>\
+        <identifier>192.168.1.102</identifier>\
+        <address>127.0.0.1</address>\
+        <port>%d</port>\
+        <address-families>\
+            <family>inet-vpn</family>\
+            <family>route-target</family>\
+        </address-families>\
+    </bgp-router>\
+</config>\
+";
+
+static const char *config_blue = "\
+<config>\
+    <routing-instance name='blue'>\
+        <vrf-target>target:64496:1</vrf-target>\
+    </routing-instance>\
+</config>\
+";
+
+static const char *config_red = "\
+<config>\
+    <routing-instance name='red'>\
+        <vrf-target>target:64496:2</vrf-target>\
+    </routing-instance>\
+</config>\
+";
+
+static const char *config_red_delete = "\
+<delete>\
+    <routing-instance name='red'>\
+        <vrf-target>target:64496:2</vrf-target>\
+    </routing-instance>\
+</delete>\
+";
+
+class RTargetPeerTest : public ::testing::Test {
+protected:
+    RTargetPeerTest() : thread_(&evm_), peer_a_(NULL), peer_b_(NULL) { }
+
+    virtual void SetUp() {
+        a_.reset(new BgpServerTest(&evm_, "A"));
+        b_.reset(new BgpServerTest(&evm_, "B"));
+        a_->session_manager()->Initialize(0);
+        b_->session_manager()->Initialize(0);
+        thread_.Start();
+
+        char config[4096];
+        snprintf(config, sizeof(config), config_routers,
+                 a_->session_manager()->GetPort(),
+                 b_->session_manager()->GetPort());
+        a_->Configure(config);
+        b_->Configure(config);
+        task_util::WaitForIdle();
+
+        string instance_name(BgpConfigManager::kMasterInstance);
+        TASK_UTIL_EXPECT_TRUE(
+            a_->FindPeer(instance_name.c_str(), instance_name + ":B") != NULL);
+        TASK_UTIL_EXPECT_TRUE(
+            b_->FindPeer(instance_name.c_str(), instance_name + ":A") != NULL);
+        peer_b_ = a_->FindPeer(instance_name.c_str(), instance_name + ":B");
+        peer_a_ = b_->FindPeer(instance_name.c_str(), instance_name + ":A");
+        TASK_UTIL_EXPECT_EQ(StateMachine::ESTABLISHED, peer_a_->GetState());
+        TASK_UTIL_EXPECT_EQ(StateMachine::ESTABLISHED, peer_b_->GetState());
+
+        a_vpn_ = static_cast<BgpTable *>(
+            a_->database()->FindTable("bgp.l3vpn.0"));
+        ASSERT_TRUE(a_vpn_ != NULL);
+        b_vpn_ = static_cast<BgpTable *>(
+            b_->database()->FindTable("bgp.l3vpn.0"));
+        ASSERT_TRUE(b_vpn_ != NULL);
+        a_rtarget_ = static_cast<BgpTable *>(
+            a_->database()->FindTable("bgp.rtarget.0"));
+        ASSERT_TRUE(a_rtarget_ != NULL);
+    }
+
+    virtual void TearDown() {
+        a_->Shutdown();
+        b_->Shutdown();
+        task_util::WaitForIdle();
+        evm_.Shutdown();
+        thread_.Join();
+        task_util::WaitForIdle();
+    }
+
+    void AddVPNRoute(const string &prefix, const string &target) {
+        BgpAttrSpec attr_spec;
+        BgpAttrOrigin origin(BgpAttrOrigin::IGP);
+        attr_spec.push_back(&origin);
+        BgpAttrNextHop nexthop(0x7f000001);
+        attr_spec.push_back(&nexthop);
+        ExtCommunitySpec commspec;
+        RouteTarget tgt = RouteTarget::FromString(target);
+        const ExtCommunity::ExtCommunityValue &extcomm =
+            tgt.GetExtCommunity();
+        commspec.communities.push_back(
+            get_value(extcomm.data(), extcomm.size()));
+        attr_spec.push_back(&commspec);
+        BgpAttrPtr attr = a_->attr_db()->Locate(attr_spec);
+
+        DBRequest request;
+        request.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        request.key.reset(new InetVpnTable::RequestKey(
+            InetVpnPrefix::FromString(prefix), NULL));
+        request.data.reset(new BgpTable::RequestData(attr, 0, 16));
+        a_vpn_->Enqueue(&request);
+        task_util::WaitForIdle();
+    }
+
+    void DeleteVPNRoute(const string &prefix) {
+        DBRequest request;
+        request.oper = DBRequest::DB_ENTRY_DELETE;
+        request.key.reset(new InetVpnTable::RequestKey(
+            InetVpnPrefix::FromString(prefix), NULL));
+        a_vpn_->Enqueue(&request);
+        task_util::WaitForIdle();
+    }
+
+    BgpRoute *VPNRouteLookup(BgpTable *table, const string &prefix) {
+        InetVpnTable::RequestKey key(InetVpnPrefix::FromString(prefix), NULL);
+        return static_cast<BgpRoute *>(table->Find(&key));
+    }
+
+    // Return true if A has received the membership route of B for the
+    // route target.
+    bool HasMembership(const string &target) {
+        RTargetTable::RequestKey key(
+            RTargetPrefix(64496, RouteTarget::FromString(target)), NULL);
+        BgpRoute *route = static_cast<BgpRoute *>(a_rtarget_->Find(&key));
+        return (route != NULL && route->FindPath(peer_b_) != NULL);
+    }
+
+    EventManager evm_;
+    ServerThread thread_;
+    auto_ptr<BgpServerTest> a_;
+    auto_ptr<BgpServerTest> b_;
+    BgpPeer *peer_a_;
+    BgpPeer *peer_b_;
+    BgpTable *a_vpn_;
+    BgpTable *b_vpn_;
+    BgpTable *a_rtarget_;
+};
+
+TEST_F(RTargetPeerTest, MembershipChange) {
+    // A imports blue and red, B only blue.
+    a_->Configure(config_blue);
+    a_->Configure(config_red);
+    b_->Configure(config_blue);
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_TRUE(HasMembership("target:64496:1"));
+    task_util::WaitForIdle();
+    EXPECT_FALSE(HasMembership("target:64496:2"));
+
+    AddVPNRoute("192.168.1.101:1:10.0.1.1/32", "target:64496:1");
+    AddVPNRoute("192.168.1.101:1:10.0.1.2/32", "target:64496:2");
+
+    // The red route is withheld from B.
+    TASK_UTIL_EXPECT_TRUE(
+        VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.1/32") != NULL);
+    task_util::WaitForIdle();
+    EXPECT_TRUE(VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.2/32") == NULL);
+
+    // B starts importing red, the red route is sent.
+    b_->Configure(config_red);
+    TASK_UTIL_EXPECT_TRUE(HasMembership("target:64496:2"));
+    TASK_UTIL_EXPECT_TRUE(
+        VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.2/32") != NULL);
+
+    // B stops importing red, the red route is withdrawn.
+    b_->Configure(config_red_delete);
+    TASK_UTIL_EXPECT_FALSE(HasMembership("target:64496:2"));
+    TASK_UTIL_EXPECT_TRUE(
+        VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.2/32") == NULL);
+    EXPECT_TRUE(VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.1/32") != NULL);
+
+    DeleteVPNRoute("192.168.1.101:1:10.0.1.1/32");
+    DeleteVPNRoute("192.168.1.101:1:10.0.1.2/32");
+    TASK_UTIL_EXPECT_TRUE(
+        VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.1/32") == NULL);
+}
+
+// B supports the route-target family but doesn't import any route target
+// yet, so it isn't sent any VPN routes until it advertises its membership.
+TEST_F(RTargetPeerTest, NoMembership) {
+    a_->Configure(config_blue);
+    task_util::WaitForIdle();
+    AddVPNRoute("192.168.1.101:1:10.0.1.1/32", "target:64496:1");
+    task_util::WaitForIdle();
+    EXPECT_FALSE(HasMembership("target:64496:1"));
+    EXPECT_TRUE(VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.1/32") == NULL);
+
+    b_->Configure(config_blue);
+    TASK_UTIL_EXPECT_TRUE(HasMembership("target:64496:1"));
+    TASK_UTIL_EXPECT_TRUE(
+        VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.1/32") != NULL);
+
+    DeleteVPNRoute("192.168.1.101:1:10.0.1.1/32");
+    TASK_UTIL_EXPECT_TRUE(
+        VPNRouteLookup(b_vpn_, "192.168.1.101:1:10.0.1.1/32") == NULL);
+}
+
+static void SetUp() {
+    ControlNode::SetDefaultSchedulingPolicy();
+    BgpServerTest::GlobalSetUp();
+}
+
+static void TearDown() {
+    task_util::WaitForIdle();
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->Terminate();
+}
+
+int main(int argc, char **argv) {
+    bgp_log_test::init();
+    ::testing::InitGoogleTest(&argc, argv);
+    SetUp();
+    int result = RUN_ALL_TESTS();
+    TearDown();
+    return result;
+}
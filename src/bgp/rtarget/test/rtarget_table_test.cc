@@ -0,0 +1,503 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/rtarget/rtarget_table.h"
+
+#include <boost/assign/list_of.hpp>
+#include <boost/bind.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
+
+#include "base/logging.h"
+#include "base/task.h"
+#include "base/task_annotations.h"
+#include "base/test/task_test_util.h"
+#include "bgp/bgp_attr.h"
+#include "bgp/bgp_config.h"
+#include "bgp/bgp_log.h"
+#include "bgp/bgp_ribout.h"
+#include "bgp/l3vpn/inetvpn_route.h"
+#include "bgp/l3vpn/inetvpn_table.h"
+#include "bgp/routing-instance/routing_instance.h"
+#include "bgp/rtarget/rtarget_group_mgr.h"
+#include "bgp/rtarget/rtarget_route.h"
+#include "bgp/scheduling_group.h"
+#include "bgp/test/bgp_server_test_util.h"
+#include "control-node/control_node.h"
+#include "db/db.h"
+#include "io/test/event_manager_test.h"
+#include "testing/gunit.h"
+
+using namespace std;
+using boost::assign::list_of;
+
+//
+// OVERVIEW
+//
+// Tests for route target constrained distribution of the routes in the
+// bgp.l3vpn.0 table of a single BgpServer.
+//
+// Membership routes are added to bgp.rtarget.0 on behalf of mock BGP peers
+// and the resulting peer set is verified by calling InetVpnTable::Export
+// with a RibOut that has all the mock peers registered. The first two mock
+// peers have negotiated the route-target family, the last one has not. The
+// local routing instances are configured with BgpServerTest::Configure.
+//
+
+static const char *config_blue = "\
+<config>\
+    <routing-instance name='blue'>\
+        <vrf-target>target:64496:1</vrf-target>\
+    </routing-instance>\
+</config>\
+";
+
+class BgpPeerMock : public IPeer {
+public:
+    explicit BgpPeerMock(const string &name) : name_(name) { }
+    virtual std::string ToString() const { return name_; }
+    virtual std::string ToUVEKey() const { return name_; }
+    virtual bool SendUpdate(const uint8_t *msg, size_t msgsize) { return true; }
+    virtual BgpServer *server() { return NULL; }
+    virtual IPeerClose *peer_close() { return NULL; }
+    virtual IPeerDebugStats *peer_stats() { return NULL; }
+    virtual bool IsReady() const { return true; }
+    virtual bool IsXmppPeer() const { return false; }
+    virtual void Close() { }
+    BgpProto::BgpPeerType PeerType() const { return BgpProto::IBGP; }
+    virtual uint32_t bgp_identifier() const { return 0; }
+    virtual const std::string GetStateName() const { return "UNKNOWN"; }
+    virtual void UpdateRefCount(int count) { }
+    virtual tbb::atomic<int> GetRefCount() const {
+        tbb::atomic<int> count;
+        count = 0;
+        return count;
+    }
+
+private:
+    string name_;
+};
+
+class RTargetTableTest : public ::testing::Test {
+protected:
+    static const int kPeerCount = 3;
+    static const as_t kAsNumber = 64496;
+
+    RTargetTableTest()
+        : server_(&evm_, "local"), thread_(&evm_),
+          policy_(BgpProto::IBGP, RibExportPolicy::BGP, kAsNumber, -1, 0),
+          vpn_(NULL), rtarget_(NULL), ribout_(NULL),
+          listener_id_(DBTableBase::kInvalidId), server_shutdown_(false) {
+    }
+
+    virtual void SetUp() {
+        server_.set_autonomous_system(kAsNumber);
+        thread_.Start();
+        task_util::WaitForIdle();
+
+        RoutingInstance *master = NULL;
+        TASK_UTIL_EXPECT_TRUE((master =
+            server_.routing_instance_mgr()->GetRoutingInstance(
+                BgpConfigManager::kMasterInstance)) != NULL);
+        ASSERT_TRUE(master != NULL);
+        vpn_ = static_cast<InetVpnTable *>(master->GetTable(Address::INETVPN));
+        ASSERT_TRUE(vpn_ != NULL);
+        rtarget_ = static_cast<RTargetTable *>(
+            master->GetTable(Address::RTARGET));
+        ASSERT_TRUE(rtarget_ != NULL);
+        EXPECT_EQ(rtarget_, server_.database()->FindTable("bgp.rtarget.0"));
+        ASSERT_TRUE(rtarget_->GetGroupMgr() != NULL);
+
+        for (int idx = 0; idx < kPeerCount; idx++) {
+            ostringstream oss;
+            oss << "peer" << idx;
+            peers_.push_back(new BgpPeerMock(oss.str()));
+        }
+    }
+
+    virtual void TearDown() {
+        if (listener_id_ != DBTableBase::kInvalidId)
+            vpn_->Unregister(listener_id_);
+        if (ribout_) {
+            ConcurrencyScope scope("bgp::PeerMembership");
+            for (vector<BgpPeerMock *>::iterator it = peers_.begin();
+                 it != peers_.end(); ++it) {
+                ribout_->Deactivate(*it);
+                ribout_->Unregister(*it);
+            }
+        }
+        if (!server_shutdown_)
+            server_.Shutdown();
+        task_util::WaitForIdle();
+        evm_.Shutdown();
+        thread_.Join();
+        task_util::WaitForIdle();
+        STLDeleteValues(&peers_);
+    }
+
+    // Create a RibOut for the VPN table with all the peers registered. All
+    // but the last peer support the route-target family.
+    void CreateRibOut() {
+        RTargetGroupMgr *group_mgr = rtarget_->GetGroupMgr();
+        for (int idx = 0; idx < kPeerCount - 1; idx++)
+            group_mgr->RegisterPeer(peers_[idx]);
+
+        ConcurrencyScope scope("bgp::PeerMembership");
+        ribout_ = vpn_->RibOutLocate(&mgr_, policy_);
+        for (vector<BgpPeerMock *>::iterator it = peers_.begin();
+             it != peers_.end(); ++it) {
+            ribout_->Register(*it);
+        }
+    }
+
+    void RegisterListener() {
+        listener_id_ = vpn_->Register(
+            boost::bind(&RTargetTableTest::VpnTableListener, this, _1, _2));
+    }
+
+    void VpnTableListener(DBTablePartBase *root, DBEntryBase *entry) {
+        BgpRoute *route = static_cast<BgpRoute *>(entry);
+        tbb::mutex::scoped_lock lock(mutex_);
+        notify_count_[route->ToString()]++;
+    }
+
+    int GetNotifyCount(const string &prefix) {
+        tbb::mutex::scoped_lock lock(mutex_);
+        return notify_count_[prefix];
+    }
+
+    void ClearNotifyCount() {
+        tbb::mutex::scoped_lock lock(mutex_);
+        notify_count_.clear();
+    }
+
+    // An empty target is the default route target.
+    RTargetPrefix MembershipPrefix(as_t as, const string &target) {
+        if (target.empty())
+            return RTargetPrefix();
+        return RTargetPrefix(as, RouteTarget::FromString(target));
+    }
+
+    void AddMembershipRoute(IPeer *peer, const string &target) {
+        BgpAttrSpec attr_spec;
+        BgpAttrOrigin origin(BgpAttrOrigin::IGP);
+        attr_spec.push_back(&origin);
+        BgpAttrPtr attr = server_.attr_db()->Locate(attr_spec);
+
+        DBRequest request;
+        request.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        request.key.reset(new RTargetTable::RequestKey(
+            MembershipPrefix(kAsNumber + 1, target), peer));
+        request.data.reset(new BgpTable::RequestData(attr, 0, 0));
+        rtarget_->Enqueue(&request);
+        task_util::WaitForIdle();
+    }
+
+    void DeleteMembershipRoute(IPeer *peer, const string &target) {
+        DBRequest request;
+        request.oper = DBRequest::DB_ENTRY_DELETE;
+        request.key.reset(new RTargetTable::RequestKey(
+            MembershipPrefix(kAsNumber + 1, target), peer));
+        rtarget_->Enqueue(&request);
+        task_util::WaitForIdle();
+    }
+
+    RTargetRoute *FindLocalMembershipRoute(const string &target) {
+        RTargetTable::RequestKey key(
+            MembershipPrefix(kAsNumber, target), NULL);
+        return static_cast<RTargetRoute *>(rtarget_->Find(&key));
+    }
+
+    void AddVPNRoute(const string &prefix, const vector<string> &targets) {
+        BgpAttrSpec attr_spec;
+        BgpAttrOrigin origin(BgpAttrOrigin::IGP);
+        attr_spec.push_back(&origin);
+        BgpAttrNextHop nexthop(0x01010101);
+        attr_spec.push_back(&nexthop);
+        ExtCommunitySpec commspec;
+        for (vector<string>::const_iterator it = targets.begin();
+             it != targets.end(); ++it) {
+            RouteTarget tgt = RouteTarget::FromString(*it);
+            const ExtCommunity::ExtCommunityValue &extcomm =
+                tgt.GetExtCommunity();
+            commspec.communities.push_back(
+                get_value(extcomm.data(), extcomm.size()));
+        }
+        attr_spec.push_back(&commspec);
+        BgpAttrPtr attr = server_.attr_db()->Locate(attr_spec);
+
+        DBRequest request;
+        request.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        request.key.reset(new InetVpnTable::RequestKey(
+            InetVpnPrefix::FromString(prefix), NULL));
+        request.data.reset(new BgpTable::RequestData(attr, 0, 16));
+        vpn_->Enqueue(&request);
+        task_util::WaitForIdle();
+    }
+
+    void DeleteVPNRoute(const string &prefix) {
+        DBRequest request;
+        request.oper = DBRequest::DB_ENTRY_DELETE;
+        request.key.reset(new InetVpnTable::RequestKey(
+            InetVpnPrefix::FromString(prefix), NULL));
+        vpn_->Enqueue(&request);
+        task_util::WaitForIdle();
+    }
+
+    RibPeerSet BuildPeerSet(const vector<int> &indexes) {
+        RibPeerSet peerset;
+        for (vector<int>::const_iterator it = indexes.begin();
+             it != indexes.end(); ++it) {
+            peerset.set(ribout_->GetPeerIndex(peers_[*it]));
+        }
+        return peerset;
+    }
+
+    // Export the route to all the peers and return the peers that it's
+    // advertised to.
+    RibPeerSet ExportPeerSet(const string &prefix) {
+        InetVpnTable::RequestKey key(InetVpnPrefix::FromString(prefix), NULL);
+        BgpRoute *route = static_cast<BgpRoute *>(vpn_->Find(&key));
+        EXPECT_TRUE(route != NULL);
+        if (!route)
+            return RibPeerSet();
+
+        vector<int> all;
+        for (int idx = 0; idx < kPeerCount; idx++)
+            all.push_back(idx);
+        UpdateInfoSList uinfo_slist;
+        if (!vpn_->Export(ribout_, route, BuildPeerSet(all), uinfo_slist))
+            return RibPeerSet();
+        EXPECT_EQ(1, uinfo_slist->size());
+        return uinfo_slist->front().target;
+    }
+
+    EventManager evm_;
+    BgpServerTest server_;
+    ServerThread thread_;
+    SchedulingGroupManager mgr_;
+    RibExportPolicy policy_;
+    InetVpnTable *vpn_;
+    RTargetTable *rtarget_;
+    RibOut *ribout_;
+    vector<BgpPeerMock *> peers_;
+    DBTableBase::ListenerId listener_id_;
+    tbb::mutex mutex_;
+    map<string, int> notify_count_;
+    bool server_shutdown_;
+};
+
+// Peers that support the route-target family but have not advertised any
+// membership routes get none of the routes, while peers that don't support
+// the family get all of them.
+TEST_F(RTargetTableTest, NoMembership) {
+    CreateRibOut();
+    AddVPNRoute("192.168.0.1:1:10.0.1.1/32", list_of("target:64496:1"));
+    AddVPNRoute("192.168.0.1:1:10.0.1.2/32", vector<string>());
+
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.2/32"));
+
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.1/32");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.2/32");
+}
+
+// Routes are only exported to the peers interested in one of their route
+// targets, and to the peers that don't support the route-target family.
+TEST_F(RTargetTableTest, Filter) {
+    CreateRibOut();
+    AddMembershipRoute(peers_[0], "target:64496:1");
+    AddMembershipRoute(peers_[1], "target:64496:2");
+    AddVPNRoute("192.168.0.1:1:10.0.1.1/32", list_of("target:64496:1"));
+    AddVPNRoute("192.168.0.1:1:10.0.1.2/32", list_of("target:64496:2"));
+    AddVPNRoute("192.168.0.1:1:10.0.1.3/32", list_of("target:64496:3"));
+    AddVPNRoute("192.168.0.1:1:10.0.1.4/32",
+                list_of("target:64496:1")("target:64496:2"));
+
+    EXPECT_EQ(BuildPeerSet(list_of(0)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(1)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.2/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.3/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(0)(1)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.4/32"));
+
+    // Without the peer that doesn't support the route-target family, a route
+    // that nobody is interested in is not exported at all.
+    UpdateInfoSList uinfo_slist;
+    InetVpnTable::RequestKey key(
+        InetVpnPrefix::FromString("192.168.0.1:1:10.0.1.3/32"), NULL);
+    BgpRoute *route = static_cast<BgpRoute *>(vpn_->Find(&key));
+    ASSERT_TRUE(route != NULL);
+    EXPECT_FALSE(vpn_->Export(ribout_, route, BuildPeerSet(list_of(0)(1)),
+                              uinfo_slist));
+    EXPECT_EQ(0, uinfo_slist->size());
+
+    DeleteMembershipRoute(peers_[0], "target:64496:1");
+    DeleteMembershipRoute(peers_[1], "target:64496:2");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.1/32");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.2/32");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.3/32");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.4/32");
+}
+
+// A peer that advertised the default route target gets all the routes.
+TEST_F(RTargetTableTest, DefaultMembership) {
+    CreateRibOut();
+    AddMembershipRoute(peers_[0], "target:64496:1");
+    AddMembershipRoute(peers_[1], "target:64496:2");
+    AddMembershipRoute(peers_[1], "");
+    AddVPNRoute("192.168.0.1:1:10.0.1.1/32", list_of("target:64496:1"));
+    AddVPNRoute("192.168.0.1:1:10.0.1.2/32", vector<string>());
+
+    EXPECT_EQ(BuildPeerSet(list_of(0)(1)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(1)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.2/32"));
+
+    DeleteMembershipRoute(peers_[1], "");
+    EXPECT_EQ(BuildPeerSet(list_of(0)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+
+    DeleteMembershipRoute(peers_[0], "target:64496:1");
+    DeleteMembershipRoute(peers_[1], "target:64496:2");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.1/32");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.2/32");
+}
+
+// Routes with the route target whose interest changed are re-evaluated, so
+// that they are advertised to, or withdrawn from, the peer. Routes with
+// other route targets are left alone.
+TEST_F(RTargetTableTest, InterestChange) {
+    CreateRibOut();
+    RegisterListener();
+    AddMembershipRoute(peers_[0], "target:64496:2");
+    AddVPNRoute("192.168.0.1:1:10.0.1.1/32", list_of("target:64496:1"));
+    AddVPNRoute("192.168.0.1:1:10.0.1.2/32", list_of("target:64496:2"));
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+
+    ClearNotifyCount();
+    AddMembershipRoute(peers_[0], "target:64496:1");
+    TASK_UTIL_EXPECT_EQ(1, GetNotifyCount("192.168.0.1:1:10.0.1.1/32"));
+    EXPECT_EQ(0, GetNotifyCount("192.168.0.1:1:10.0.1.2/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(0)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+
+    ClearNotifyCount();
+    DeleteMembershipRoute(peers_[0], "target:64496:1");
+    TASK_UTIL_EXPECT_EQ(1, GetNotifyCount("192.168.0.1:1:10.0.1.1/32"));
+    EXPECT_EQ(0, GetNotifyCount("192.168.0.1:1:10.0.1.2/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+
+    // The first membership route of a peer re-evaluates all the routes,
+    // since the peer wasn't sent any of them so far.
+    ClearNotifyCount();
+    AddMembershipRoute(peers_[1], "target:64496:1");
+    TASK_UTIL_EXPECT_EQ(1, GetNotifyCount("192.168.0.1:1:10.0.1.1/32"));
+    TASK_UTIL_EXPECT_EQ(1, GetNotifyCount("192.168.0.1:1:10.0.1.2/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(1)(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+    DeleteMembershipRoute(peers_[1], "target:64496:1");
+
+    // The last membership route of the peer goes away, all the routes are
+    // re-evaluated and withdrawn from the peer, which still supports the
+    // route-target family and isn't interested in anything.
+    ClearNotifyCount();
+    DeleteMembershipRoute(peers_[0], "target:64496:2");
+    TASK_UTIL_EXPECT_EQ(1, GetNotifyCount("192.168.0.1:1:10.0.1.1/32"));
+    TASK_UTIL_EXPECT_EQ(1, GetNotifyCount("192.168.0.1:1:10.0.1.2/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.1/32"));
+    EXPECT_EQ(BuildPeerSet(list_of(2)),
+              ExportPeerSet("192.168.0.1:1:10.0.1.2/32"));
+
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.1/32");
+    DeleteVPNRoute("192.168.0.1:1:10.0.1.2/32");
+}
+
+// The import route targets of the local routing instances are originated
+// as membership routes with the local AS.
+TEST_F(RTargetTableTest, LocalMembership) {
+    EXPECT_TRUE(FindLocalMembershipRoute("target:64496:1") == NULL);
+
+    server_.Configure(config_blue);
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_TRUE(FindLocalMembershipRoute("target:64496:1") != NULL);
+    RTargetRoute *route = FindLocalMembershipRoute("target:64496:1");
+    EXPECT_TRUE(route->FindPath(NULL, 0, BgpPath::BGP_XMPP) != NULL);
+
+    // Add an import route target to the instance.
+    server_.Configure("\
+<config>\
+    <routing-instance name='blue'>\
+        <vrf-target>target:64496:2</vrf-target>\
+    </routing-instance>\
+</config>\
+");
+    TASK_UTIL_EXPECT_TRUE(FindLocalMembershipRoute("target:64496:2") != NULL);
+    EXPECT_TRUE(FindLocalMembershipRoute("target:64496:1") != NULL);
+
+    // Remove the original import route target from the instance.
+    server_.Configure("\
+<delete>\
+    <routing-instance name='blue'>\
+        <vrf-target>target:64496:1</vrf-target>\
+    </routing-instance>\
+</delete>\
+");
+    TASK_UTIL_EXPECT_TRUE(FindLocalMembershipRoute("target:64496:1") == NULL);
+    EXPECT_TRUE(FindLocalMembershipRoute("target:64496:2") != NULL);
+
+    server_.Configure("\
+<delete>\
+    <routing-instance name='blue'>\
+        <vrf-target>target:64496:2</vrf-target>\
+    </routing-instance>\
+</delete>\
+");
+    TASK_UTIL_EXPECT_TRUE(FindLocalMembershipRoute("target:64496:2") == NULL);
+}
+
+// The bgp.rtarget.0 table and its RTargetGroupMgr go away along with the
+// master instance, even when local membership routes are still present.
+TEST_F(RTargetTableTest, Teardown) {
+    server_.Configure(config_blue);
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_TRUE(FindLocalMembershipRoute("target:64496:1") != NULL);
+    AddMembershipRoute(peers_[0], "target:64496:1");
+    DeleteMembershipRoute(peers_[0], "target:64496:1");
+
+    server_shutdown_ = true;
+    server_.Shutdown();
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_TRUE(
+        server_.database()->FindTable("bgp.rtarget.0") == NULL);
+    TASK_UTIL_EXPECT_TRUE(
+        server_.database()->FindTable("bgp.l3vpn.0") == NULL);
+}
+
+static void SetUp() {
+    ControlNode::SetDefaultSchedulingPolicy();
+    BgpServerTest::GlobalSetUp();
+}
+
+static void TearDown() {
+    task_util::WaitForIdle();
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->Terminate();
+}
+
+int main(int argc, char **argv) {
+    bgp_log_test::init();
+    ::testing::InitGoogleTest(&argc, argv);
+    SetUp();
+    int result = RUN_ALL_TESTS();
+    TearDown();
+    return result;
+}
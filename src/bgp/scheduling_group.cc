@@ -387,13 +387,22 @@ RibOut &SchedulingGroup::PeerState::circular_iterator::dereference() const {
     return *indexmap_.At(index_)->ribout();
 }
 
+//
+// The footprint of a WorkBase is the set of RibStates and PeerStates that
+// may be accessed when processing it. It's built on demand and is valid as
+// long as the generation matches the one of the SchedulingGroup.
+//
 struct SchedulingGroup::WorkBase {
     enum Type {
         WPeer,
         WRibOut
     };
-    WorkBase(Type type) : type(type) { }
+    WorkBase(Type type) : type(type), generation(0), start(0) { }
     Type type;
+    uint64_t generation;
+    GroupPeerSet peers;
+    BitSet ribouts;
+    uint64_t start;         // when a Worker started processing the entry
 };
 
 struct SchedulingGroup::WorkRibOut : public SchedulingGroup::WorkBase {
@@ -418,8 +427,9 @@ public:
     virtual bool Run() {
         CHECK_CONCURRENCY("bgp::SendTask");
 
+        auto_ptr<WorkBase> wentry;
         while (true) {
-            auto_ptr<WorkBase> wentry = group_->WorkDequeue();
+            wentry = group_->WorkDequeue(this, wentry.get());
             if (wentry.get() == NULL) {
                 break;
             }
@@ -444,7 +454,9 @@ private:
     SchedulingGroup *group_;
 };
 
-SchedulingGroup::SchedulingGroup() : running_(false), worker_task_(NULL) {
+SchedulingGroup::SchedulingGroup()
+    : max_workers_(1), active_(0), generation_(1), stats_(Stats()),
+      active_start_(0) {
     if (send_task_id_ == -1) {
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
         send_task_id_ = scheduler->GetTaskId("bgp::SendTask");
@@ -452,9 +464,30 @@ SchedulingGroup::SchedulingGroup() : running_(false), worker_task_(NULL) {
 }
 
 SchedulingGroup::~SchedulingGroup() {
-    if (worker_task_) {
-        TaskScheduler *scheduler = TaskScheduler::GetInstance();
-        scheduler->Cancel(worker_task_);
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    for (list<Worker *>::iterator iter = workers_.begin();
+         iter != workers_.end(); ++iter) {
+        scheduler->Cancel(*iter);
+    }
+}
+
+void SchedulingGroup::set_max_workers(int max_workers) {
+    mutex::scoped_lock lock(mutex_);
+    max_workers_ = max(max_workers, 1);
+}
+
+//
+// Concurrency: called from arbitrary task.
+//
+void SchedulingGroup::GetStats(Stats *stats) const {
+    mutex::scoped_lock lock(mutex_);
+    *stats = stats_;
+    stats->max_workers = max_workers_;
+    stats->peer_count = peer_state_imap_.count();
+    stats->ribout_count = rib_state_imap_.count();
+    stats->queue_count = work_queue_.size();
+    if (active_) {
+        stats->active_usecs += UTCTimestampUsec() - active_start_;
     }
 }
 
@@ -474,6 +507,7 @@ void SchedulingGroup::Add(RibOut *ribout, IPeerUpdate *peer) {
     PeerState *ps = peer_state_imap_.Locate(peer);
     rs->Add(ps);
     ps->Add(rs);
+    generation_++;
 }
 
 //
@@ -496,6 +530,7 @@ void SchedulingGroup::Remove(RibOut *ribout, IPeerUpdate *peer) {
     if (ps->empty())  {
         peer_state_imap_.Remove(peer, ps->index());
     }
+    generation_++;
 }
 
 //
@@ -647,8 +682,17 @@ void SchedulingGroup::Merge(SchedulingGroup *rhs) {
 
     // Finally transfer the work queue from the old SchedulingGroup to this
     // one and clear the old SchedulingGroup. It's the caller responsibility
-    // to delete the old SchedulingGroup.
+    // to delete the old SchedulingGroup, which cancels its Workers. Start a
+    // Worker if needed so that the transferred entries get processed.
+    //
+    // The footprints of all entries are now stale since the indices in this
+    // SchedulingGroup have changed.
+    mutex::scoped_lock lock(mutex_);
+    generation_ = max(generation_, rhs->generation_) + 1;
     work_queue_.transfer(work_queue_.end(), rhs->work_queue_);
+    if (!work_queue_.empty() && workers_.empty()) {
+        WorkerStart();
+    }
     rhs->clear();
 }
 
@@ -733,6 +777,14 @@ void SchedulingGroup::Split(SchedulingGroup *rhs, const RibOutList &rg1,
             rhs->work_queue_.transfer(rhs->work_queue_.end(), loc, work_queue_);
         }
     }
+
+    // Footprints of the moved entries refer to indices in this group, so
+    // make sure they are rebuilt. Start a Worker for the moved entries.
+    rhs->generation_ = max(rhs->generation_, generation_) + 1;
+    mutex::scoped_lock lock(rhs->mutex_);
+    if (!rhs->work_queue_.empty() && rhs->workers_.empty()) {
+        rhs->WorkerStart();
+    }
 }
 
 //
@@ -810,38 +862,168 @@ bool SchedulingGroup::IsSendReady(IPeerUpdate *peer) const {
 }
 
 //
-// Dequeue the first WorkBase item from the work queue and return an
-// auto_ptr to it.  Clear out Worker related state if the work queue
-// is empty.
+// Build the footprint for the WorkBase unless it's already up to date.
+//
+// A WorkRibOut accesses the RibState and the PeerStates of all peers that
+// advertise the RibOut. A WorkPeer accesses the PeerState, all RibStates of
+// the peer and the PeerStates of all peers advertising any of those RibOuts,
+// since PeerDequeue may merge their markers and send updates to them.
 //
-auto_ptr<SchedulingGroup::WorkBase> SchedulingGroup::WorkDequeue() {
+// Membership can only change when no Worker is running, so the RibStates and
+// PeerStates can be accessed without further locking.
+//
+void SchedulingGroup::BuildFootprint(WorkBase *wentry) {
+    if (wentry->generation == generation_)
+        return;
+
+    wentry->generation = generation_;
+    wentry->peers.clear();
+    wentry->ribouts.clear();
+    switch (wentry->type) {
+    case WorkBase::WRibOut: {
+        WorkRibOut *work = static_cast<WorkRibOut *>(wentry);
+        RibState *rs = rib_state_imap_.Find(work->ribout);
+        if (rs == NULL)
+            break;
+        wentry->ribouts.set(rs->index());
+        wentry->peers |= rs->peer_set();
+        break;
+    }
+    case WorkBase::WPeer: {
+        WorkPeer *work = static_cast<WorkPeer *>(wentry);
+        PeerState *ps = peer_state_imap_.Find(work->peer);
+        if (ps == NULL)
+            break;
+        wentry->peers.set(ps->index());
+        for (PeerState::iterator iter = ps->begin(rib_state_imap_);
+             iter != ps->end(rib_state_imap_); ++iter) {
+            RibState *rs = iter.rib_state();
+            wentry->ribouts.set(rs->index());
+            wentry->peers |= rs->peer_set();
+        }
+        break;
+    }
+    }
+}
+
+//
+// Return true if the footprint of the WorkBase overlaps with the given sets.
+//
+bool SchedulingGroup::WorkConflict(const WorkBase *wentry,
+        const GroupPeerSet &peers, const BitSet &ribouts) const {
+    return (wentry->peers.intersects(peers) ||
+            wentry->ribouts.intersects(ribouts));
+}
+
+//
+// Create a new Worker and enqueue it to the scheduler. The caller must hold
+// the mutex or be running in a task that excludes the bgp send task.
+//
+void SchedulingGroup::WorkerStart() {
+    Worker *worker = new Worker(this);
+    workers_.push_back(worker);
+    stats_.workers_started++;
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->Enqueue(worker);
+}
+
+//
+// Account for the WorkBase entry that the Worker is done with, if any, and
+// return an auto_ptr to the next entry for the Worker.  The Worker is removed
+// from the list of Workers if there's nothing it can do.
+//
+// With a single Worker, this is simply the first entry in the work queue.
+// Otherwise it's the first entry within kMaxLookahead whose footprint does
+// not overlap the footprint of an entry being processed by another Worker or
+// of an entry ahead of it in the queue.  Another Worker is started if there's
+// a second such entry.
+//
+auto_ptr<SchedulingGroup::WorkBase> SchedulingGroup::WorkDequeue(
+        Worker *worker, WorkBase *done) {
     CHECK_CONCURRENCY("bgp::SendTask");
 
     mutex::scoped_lock lock(mutex_);
-    auto_ptr<WorkBase> wentry;
-    if (work_queue_.empty()) {
-        worker_task_ = NULL;
-        running_ = false;
+    uint64_t now = UTCTimestampUsec();
+    if (done) {
+        busy_peers_.Reset(done->peers);
+        busy_ribouts_.Reset(done->ribouts);
+        if (done->type == WorkBase::WRibOut) {
+            stats_.tail_dequeues++;
+        } else {
+            stats_.peer_dequeues++;
+        }
+        stats_.work_usecs += now - done->start;
+        if (--active_ == 0) {
+            stats_.active_usecs += now - active_start_;
+        }
+    }
+
+    WorkQueue::iterator loc = work_queue_.end();
+    bool more = false;
+    if (max_workers_ == 1) {
+        loc = work_queue_.begin();
     } else {
-        wentry.reset(work_queue_.pop_front().release());
+        GroupPeerSet skip_peers = busy_peers_;
+        BitSet skip_ribouts = busy_ribouts_;
+        int count = 0;
+        for (WorkQueue::iterator iter = work_queue_.begin();
+             iter != work_queue_.end() && count < kMaxLookahead;
+             ++iter, ++count) {
+            WorkBase *wentry = iter.operator->();
+            BuildFootprint(wentry);
+            bool conflict = WorkConflict(wentry, skip_peers, skip_ribouts);
+            skip_peers |= wentry->peers;
+            skip_ribouts |= wentry->ribouts;
+            if (conflict) {
+                if (loc == work_queue_.end())
+                    stats_.deferred++;
+                continue;
+            }
+            if (loc != work_queue_.end()) {
+                more = true;
+                break;
+            }
+            loc = iter;
+        }
+    }
+
+    auto_ptr<WorkBase> wentry;
+    if (loc == work_queue_.end()) {
+        workers_.remove(worker);
+        return wentry;
+    }
+
+    wentry.reset(work_queue_.release(loc).release());
+    busy_peers_ |= wentry->peers;
+    busy_ribouts_ |= wentry->ribouts;
+    wentry->start = now;
+    if (active_++ == 0) {
+        active_start_ = now;
+    }
+    stats_.peak_concurrency = max(stats_.peak_concurrency, active_);
+    if (more && (int) workers_.size() < max_workers_) {
+        WorkerStart();
     }
     return wentry;
 }
 
 //
 // Enqueue a WorkBase entry into the the work queue and start a new Worker
-// task if required.
+// task if required.  An additional Worker is started if the entry does not
+// conflict with the ones being processed.
 //
 void SchedulingGroup::WorkEnqueue(WorkBase *wentry) {
     CHECK_CONCURRENCY("db::DBTable", "bgp::SendTask", "bgp::SendReadyTask");
 
     mutex::scoped_lock lock(mutex_);
     work_queue_.push_back(wentry);
-    if (!running_) {
-        worker_task_ = new Worker(this);
-        TaskScheduler *scheduler = TaskScheduler::GetInstance();
-        scheduler->Enqueue(worker_task_);
-        running_ = true;
+    if (workers_.empty()) {
+        WorkerStart();
+    } else if ((int) workers_.size() < max_workers_) {
+        BuildFootprint(wentry);
+        if (!WorkConflict(wentry, busy_peers_, busy_ribouts_)) {
+            WorkerStart();
+        }
     }
 }
 
@@ -1137,6 +1319,7 @@ struct WorkQueueDelete<IPeerUpdate *> {
 // Constructor for SchedulingGroupManager. Initialize send ready WorkQueue.
 //
 SchedulingGroupManager::SchedulingGroupManager() :
+    max_workers_(1),
     send_ready_queue_(
             TaskScheduler::GetInstance()->GetTaskId("bgp::SendReadyTask"), 0,
             boost::bind(&SchedulingGroupManager::SendReadyCallback, this, _1)) {
@@ -1146,6 +1329,37 @@ SchedulingGroupManager::~SchedulingGroupManager() {
     STLDeleteValues(&groups_);
 }
 
+//
+// Create a new SchedulingGroup and add it to the GroupList.
+//
+SchedulingGroup *SchedulingGroupManager::CreateGroup() {
+    SchedulingGroup *sg = new SchedulingGroup();
+    sg->set_max_workers(max_workers_);
+    groups_.push_back(sg);
+    return sg;
+}
+
+//
+// Set the maximum number of Workers for existing and future groups.
+//
+void SchedulingGroupManager::set_max_workers(int max_workers) {
+    max_workers_ = max(max_workers, 1);
+    for (GroupList::iterator iter = groups_.begin();
+         iter != groups_.end(); ++iter) {
+        (*iter)->set_max_workers(max_workers_);
+    }
+}
+
+void SchedulingGroupManager::GetStats(
+        vector<SchedulingGroup::Stats> *list) const {
+    for (GroupList::const_iterator iter = groups_.begin();
+         iter != groups_.end(); ++iter) {
+        SchedulingGroup::Stats stats;
+        (*iter)->GetStats(&stats);
+        list->push_back(stats);
+    }
+}
+
 
 //
 // Return the SchedulingGroup for the specified IPeerUpdate.
@@ -1182,8 +1396,7 @@ void SchedulingGroupManager::Join(RibOut *ribout, IPeerUpdate *peer) {
     if (i1 == peer_map_.end()) {
         if (i2 == ribout_map_.end()) {
             // Create new empty group
-            sg = new SchedulingGroup();
-            groups_.push_back(sg);
+            sg = CreateGroup();
             ribout_map_.insert(make_pair(ribout, sg));
         } else {
             // Add peer to existing group
@@ -1330,8 +1543,7 @@ void SchedulingGroupManager::Split(
         SchedulingGroup *sg, const RibOutList &rg1, const RibOutList &rg2) {
     CHECK_CONCURRENCY("bgp::PeerMembership");
 
-    SchedulingGroup *sg2 = new SchedulingGroup();
-    groups_.push_back(sg2);
+    SchedulingGroup *sg2 = CreateGroup();
 
     // Note that calling the Split method results in the creation of all
     // necessary PeerState and RibOutState in sg2. Hence, there's no typo
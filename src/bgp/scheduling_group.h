@@ -33,6 +33,16 @@ class GroupPeerSet : public BitSet {
 // to one sending thread. We want one thread to write to a IPeerUpdate across
 // all RibOuts so that we can avoid contention on the IPeerUpdate.
 //
+// A large group can optionally be drained by up to max_workers Worker tasks
+// at the same time. Each WorkBase entry has a footprint: the RibStates and
+// PeerStates that processing it may read or modify. A Worker only takes an
+// entry whose footprint does not overlap the footprint of an entry being
+// processed by another Worker, or of an earlier entry that is still on the
+// WorkQueue. Hence a given IPeerUpdate is still written by one thread at a
+// time, entries for the same RibOut or IPeerUpdate are processed in enqueue
+// order, and the marker and peer set handling is the same as with a single
+// Worker.
+//
 // A SchedulingGroup maintains two indexed maps for it's internal bookkeeping
 // purposes.
 //
@@ -59,9 +69,33 @@ public:
     typedef std::vector<RibOut *> RibOutList;
     typedef std::vector<IPeerUpdate *> PeerList;
 
+    // Number of WorkQueue entries that a Worker looks at when searching for
+    // an entry that does not conflict with the ones being processed.
+    static const int kMaxLookahead = 64;
+
+    struct Stats {
+        int max_workers;
+        int peer_count;
+        int ribout_count;
+        uint64_t queue_count;
+        uint64_t tail_dequeues;     // WorkRibOut entries processed
+        uint64_t peer_dequeues;     // WorkPeer entries processed
+        uint64_t workers_started;
+        uint64_t deferred;          // entries skipped due to a conflict
+        int peak_concurrency;       // max entries processed at the same time
+        uint64_t work_usecs;        // sum of the time spent on each entry
+        uint64_t active_usecs;      // time with at least one entry in process
+    };
+
     SchedulingGroup();
     ~SchedulingGroup();
 
+    // Maximum number of Worker tasks that drain the WorkQueue concurrently.
+    void set_max_workers(int max_workers);
+    int max_workers() const { return max_workers_; }
+
+    void GetStats(Stats *stats) const;
+
     void Merge(SchedulingGroup *rhs);
     void Split(SchedulingGroup *other, const RibOutList &rg1,
                const RibOutList &rg2);
@@ -122,8 +156,12 @@ private:
 
     class PeerIterator;
 
-    std::auto_ptr<WorkBase> WorkDequeue();
+    std::auto_ptr<WorkBase> WorkDequeue(Worker *worker, WorkBase *done);
     void WorkEnqueue(WorkBase *wentry);
+    void WorkerStart();
+    void BuildFootprint(WorkBase *wentry);
+    bool WorkConflict(const WorkBase *wentry, const GroupPeerSet &peers,
+                      const BitSet &ribouts) const;
 
     void UpdateRibOut(RibOut *ribout, int queue_id);
     void UpdatePeer(IPeerUpdate *peer);
@@ -149,10 +187,21 @@ private:
     RibOut *PeerRibOutNext(PeerState *ps, size_t start);
 
     // The mutex controls access to WorkQueue and related Worker state.
-    tbb::mutex mutex_;
+    mutable tbb::mutex mutex_;
     WorkQueue work_queue_;
-    bool running_;
-    Worker *worker_task_;
+    std::list<Worker *> workers_;
+    int max_workers_;
+
+    // Entries being processed and the union of their footprints.
+    int active_;
+    GroupPeerSet busy_peers_;
+    BitSet busy_ribouts_;
+
+    // Bumped whenever membership changes, which invalidates footprints.
+    uint64_t generation_;
+
+    Stats stats_;
+    uint64_t active_start_;
 
     PeerStateMap peer_state_imap_;
     RibStateMap rib_state_imap_;
@@ -199,6 +248,14 @@ public:
     // Notification that a peer is send ready.
     void SendReady(IPeerUpdate *peer);
 
+    // Maximum number of Worker tasks per SchedulingGroup.
+    void set_max_workers(int max_workers);
+    int max_workers() const { return max_workers_; }
+
+    // Statistics of all the SchedulingGroups. Must not run concurrently with
+    // the bgp peer membership task.
+    void GetStats(std::vector<SchedulingGroup::Stats> *list) const;
+
     bool CheckInvariants() const;
 
     // Number of SchedulingGroups.
@@ -214,9 +271,12 @@ private:
 
     void Move(SchedulingGroup *group, SchedulingGroup *dst);
 
+    SchedulingGroup *CreateGroup();
+
     GroupList groups_;
     PeerMap peer_map_;
     RibOutMap ribout_map_;
+    int max_workers_;
 
     // Deferred send ready processing.
     WorkQueue<IPeerUpdate *> send_ready_queue_;
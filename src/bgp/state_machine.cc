@@ -1048,6 +1048,7 @@ StateMachine::StateMachine(BgpPeer *peer)
         attempts_(0),
         deleted_(false),
         state_(IDLE) {
+    work_queue_.SetAdaptive(WorkQueue<EventContainer>::kDefaultTimeSliceUsecs);
     initiate();
 }
 
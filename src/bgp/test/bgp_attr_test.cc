@@ -8,6 +8,7 @@
 
 #include "base/logging.h"
 #include "base/task.h"
+#include "base/util.h"
 #include "base/test/task_test_util.h"
 #include "bgp/bgp_log.h"
 #include "bgp/bgp_server.h"
@@ -481,6 +482,88 @@ TEST_F(BgpAttrTest, ExtCommunityDBConcurrency) {
                     ExtCommunitySpec>(extcomm_db_);
 }
 
+// ----- Benchmark parallel Locate of attributes that are already present,
+// as done by db partitions during a full table learn.
+
+static const int kLocateBenchAttrs = 1000;
+
+struct LocateBenchArgs {
+    BgpAttrDB *db;
+    int count;
+};
+
+static void BuildSpec(BgpAttrSpec *spec, int index) {
+    spec->push_back(new BgpAttrOrigin(BgpAttrOrigin::IGP));
+    spec->push_back(new BgpAttrNextHop(0x0a000001 + index % 16));
+    spec->push_back(new BgpAttrMultiExitDisc(index));
+    CommunitySpec *community = new CommunitySpec;
+    community->communities.push_back(0x87654321);
+    spec->push_back(community);
+}
+
+static void *LocateBenchRun(void *objp) {
+    LocateBenchArgs *args = reinterpret_cast<LocateBenchArgs *>(objp);
+    std::vector<BgpAttrSpec> specs(kLocateBenchAttrs);
+    for (int i = 0; i < kLocateBenchAttrs; i++) {
+        BuildSpec(&specs[i], i);
+    }
+    for (int i = 0; i < args->count; i++) {
+        BgpAttrPtr ptr = args->db->Locate(specs[i % kLocateBenchAttrs]);
+    }
+    BOOST_FOREACH(BgpAttrSpec &spec, specs) {
+        STLDeleteValues(&spec);
+    }
+    return NULL;
+}
+
+// Runs a small number of Locate calls per thread as part of the unit tests;
+// set LOCATE_BENCH_COUNT to e.g. 200000 for meaningful numbers. The number
+// of threads can be overridden with THREAD_COUNT.
+TEST_F(BgpAttrTest, LocateBench) {
+    int count = task_util_bench_count("LOCATE_BENCH_COUNT", 10000);
+    int max_threads = task_util_bench_count("THREAD_COUNT",
+        TaskScheduler::GetInstance()->HardwareThreadCount());
+
+    // Keep a reference to every attribute, so that Locate finds them.
+    std::vector<BgpAttrPtr> attrs;
+    for (int i = 0; i < kLocateBenchAttrs; i++) {
+        BgpAttrSpec spec;
+        BuildSpec(&spec, i);
+        attrs.push_back(attr_db_->Locate(spec));
+        STLDeleteValues(&spec);
+    }
+    EXPECT_EQ(kLocateBenchAttrs, attr_db_->Size());
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        uint64_t hits = attr_db_->lookup_hits();
+        uint64_t contention = attr_db_->lock_contention();
+        LocateBenchArgs args = { attr_db_, count };
+        std::vector<pthread_t> thread_ids;
+        pthread_t tid;
+
+        uint64_t start = UTCTimestampUsec();
+        for (int i = 0; i < threads; i++) {
+            if (!pthread_create(&tid, NULL, &LocateBenchRun, &args)) {
+                thread_ids.push_back(tid);
+            }
+        }
+        BOOST_FOREACH(tid, thread_ids) { pthread_join(tid, NULL); }
+        uint64_t elapsed = UTCTimestampUsec() - start;
+
+        EXPECT_EQ(kLocateBenchAttrs, attr_db_->Size());
+        std::cout << "threads " << threads << " stripes "
+                  << attr_db_->hash_size() << " locate "
+                  << (uint64_t) threads * count * 1000000 /
+                     (elapsed ? elapsed : 1) << "/s"
+                  << " hits " << attr_db_->lookup_hits() - hits
+                  << " lock contention "
+                  << attr_db_->lock_contention() - contention << std::endl;
+    }
+
+    attrs.clear();
+    TASK_UTIL_EXPECT_EQ(0, attr_db_->Size());
+}
+
 static void SetUp() {
     bgp_log_test::init();
     ControlNode::SetDefaultSchedulingPolicy();
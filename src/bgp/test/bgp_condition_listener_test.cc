@@ -52,8 +52,23 @@ private:
 class TestConditionMatch : public ConditionMatch {
 public:
     typedef std::map<Ip4Prefix, BgpRoute *> MatchList;
-    TestConditionMatch(Ip4Prefix &prefix, bool hold_db_state) 
-        : prefix_(prefix), hold_db_state_(hold_db_state) {
+    TestConditionMatch(Ip4Prefix &prefix, bool hold_db_state,
+                       bool range = false)
+        : prefix_(prefix), hold_db_state_(hold_db_state), range_(range) {
+    }
+
+    // Restrict the match to the routes within the prefix
+    bool MatchRange(BgpTable *table, std::auto_ptr<DBEntry> *begin,
+                    std::auto_ptr<DBEntry> *end) {
+        if (!range_)
+            return false;
+        uint32_t mask = prefix_.prefixlen() ?
+            (0xFFFFFFFF << (32 - prefix_.prefixlen())) : 0;
+        Ip4Address first(prefix_.ip4_addr().to_ulong() & mask);
+        Ip4Address last(first.to_ulong() | ~mask);
+        begin->reset(new InetRoute(Ip4Prefix(first, 0)));
+        end->reset(new InetRoute(Ip4Prefix(last, 32)));
+        return true;
     }
 
     bool Match(BgpServer *server, BgpTable *table, 
@@ -125,6 +140,7 @@ private:
     MatchList match_list_;
     Ip4Prefix prefix_;
     bool hold_db_state_;
+    bool range_;
 };
 
 class BgpConditionListenerTest : public ::testing::Test {
@@ -265,11 +281,11 @@ protected:
     }
 
     void AddMatchCondition(string name, std::string match, 
-                           bool hold_db_state = false) {
+                           bool hold_db_state = false, bool range = false) {
         ConcurrencyScope scope("bgp::Config");
         BgpConditionListener *listener = bgp_server_->condition_listener();
         Ip4Prefix prefix = Ip4Prefix::FromString(match);
-        match_.reset(new TestConditionMatch(prefix, hold_db_state));
+        match_.reset(new TestConditionMatch(prefix, hold_db_state, range));
         RoutingInstance *rti =
             bgp_server_->routing_instance_mgr()->GetRoutingInstance(name);
         BgpTable *table = rti->GetTable(Address::INET);
@@ -530,6 +546,47 @@ TEST_F(BgpConditionListenerTest, ChangeNotify) {
     task_util::WaitForIdle();
 }
 
+//
+// Routes outside the range of the match condition are not matched, both
+// on notification and in the walk for the new match condition.
+//
+TEST_F(BgpConditionListenerTest, Range) {
+    AddRoutingInstance("blue");
+    task_util::WaitForIdle();
+
+    AddInetRoute("blue", "192.168.1.2/32");
+    AddInetRoute("blue", "192.168.2.2/32");
+    AddInetRoute("blue", "10.1.1.1/32");
+
+    AddMatchCondition("blue", "192.168.1.0/24", false, true);
+    task_util::WaitForIdle();
+
+    TestConditionMatch *match = 
+        static_cast<TestConditionMatch *>(match_.get());
+    TASK_UTIL_EXPECT_EQ(1, match->matched_routes_size());
+    TASK_UTIL_EXPECT_TRUE(match->lookup_matched_routes(
+        Ip4Prefix::FromString("192.168.1.2/32")) != NULL);
+
+    AddInetRoute("blue", "192.168.1.3/32");
+    AddInetRoute("blue", "192.168.1.255/32");
+    AddInetRoute("blue", "192.168.2.3/32");
+    AddInetRoute("blue", "10.1.1.2/32");
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(3, match->matched_routes_size());
+
+    RemoveMatchCondition("blue");
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_TRUE(match->matched_routes_empty());
+
+    for (RouteMap::iterator it = routes_added_.begin(), next; 
+         it != routes_added_.end(); it = next) {
+        next = it;
+        next++;
+        DeleteInetRoute(it->first, it->second);
+    }
+    task_util::WaitForIdle();
+}
+
 class TestEnvironment : public ::testing::Environment {
     virtual ~TestEnvironment() { }
 };
@@ -5,6 +5,7 @@
 #include "base/logging.h"
 #include "base/task.h"
 #include "base/task_annotations.h"
+#include "base/util.h"
 #include "base/test/task_test_util.h"
 #include "testing/gunit.h"
 
@@ -21,6 +22,7 @@
 #include "bgp/routing-instance/routing_instance.h"
 #include "control-node/control_node.h"
 #include "io/event_manager.h"
+#include "net/bgp_af.h"
 
 using namespace std;
 
@@ -52,6 +54,86 @@ protected:
     BgpPeer *peer_;
 };
 
+static void BuildAttrSpec(BgpAttrSpec *attr) {
+    attr->push_back(new BgpAttrNextHop(0xabcdef01));
+    attr->push_back(new BgpAttrOrigin(BgpAttrOrigin::INCOMPLETE));
+    attr->push_back(new BgpAttrMultiExitDisc(100));
+    attr->push_back(new BgpAttrLocalPref(2));
+    AsPathSpec *path_spec = new AsPathSpec;
+    AsPathSpec::PathSegment *ps = new AsPathSpec::PathSegment;
+    ps->path_segment_type = AsPathSpec::PathSegment::AS_SEQUENCE;
+    ps->path_segment.push_back(64512);
+    ps->path_segment.push_back(64513);
+    path_spec->path_segments.push_back(ps);
+    attr->push_back(path_spec);
+    CommunitySpec *community = new CommunitySpec;
+    community->communities.push_back(0xFFFFFF01);
+    attr->push_back(community);
+    ExtCommunitySpec *ext_community = new ExtCommunitySpec;
+    ext_community->communities.push_back(0x1020304050607080);
+    ext_community->communities.push_back(0x0002fc0000000001);
+    attr->push_back(ext_community);
+}
+
+// Encode an update the way BgpMessage did before the path attributes were
+// cached in wire format: copy every attribute into a BgpProto::Update and
+// run the generic encoder.
+static vector<uint8_t> LegacyEncode(const RibOutAttr &rib_out_attr,
+                                    const vector<BgpRoute *> &routes) {
+    BgpProto::Update update;
+    const BgpAttr *attr = rib_out_attr.attr();
+    const BgpRoute *route = routes[0];
+
+    update.path_attributes.push_back(new BgpAttrOrigin(attr->origin()));
+    if ((route->Afi() == BgpAf::IPv4) && (route->Safi() == BgpAf::Unicast)) {
+        update.path_attributes.push_back(
+            new BgpAttrNextHop(attr->nexthop().to_v4().to_ulong()));
+    }
+    if (attr->med()) {
+        update.path_attributes.push_back(
+            new BgpAttrMultiExitDisc(attr->med()));
+    }
+    if (attr->local_pref()) {
+        update.path_attributes.push_back(
+            new BgpAttrLocalPref(attr->local_pref()));
+    }
+    if (attr->as_path()) {
+        update.path_attributes.push_back(
+            new AsPathSpec(attr->as_path()->path()));
+    }
+    if (attr->community() && attr->community()->communities().size()) {
+        CommunitySpec *comm = new CommunitySpec;
+        comm->communities = attr->community()->communities();
+        update.path_attributes.push_back(comm);
+    }
+    if (attr->ext_community() && attr->ext_community()->communities().size()) {
+        ExtCommunitySpec *ext_comm = new ExtCommunitySpec;
+        const ExtCommunity::ExtCommunityList &v =
+            attr->ext_community()->communities();
+        for (ExtCommunity::ExtCommunityList::const_iterator it = v.begin();
+             it != v.end(); ++it) {
+            ext_comm->communities.push_back(get_value(it->data(), it->size()));
+        }
+        update.path_attributes.push_back(ext_comm);
+    }
+
+    vector<uint8_t> nh;
+    route->BuildBgpProtoNextHop(nh, attr->nexthop());
+    BgpMpNlri *nlri = new BgpMpNlri(BgpAttribute::MPReachNlri, route->Afi(),
+                                    route->Safi(), nh);
+    update.path_attributes.push_back(nlri);
+    for (size_t i = 0; i < routes.size(); i++) {
+        BgpProtoPrefix *prefix = new BgpProtoPrefix;
+        routes[i]->BuildProtoPrefix(prefix, rib_out_attr.label());
+        nlri->nlri.push_back(prefix);
+    }
+
+    uint8_t data[BgpProto::kMaxMessageSize];
+    int datalen = BgpProto::Encode(&update, data, sizeof(data));
+    EXPECT_LT(0, datalen);
+    return vector<uint8_t>(data, data + max(datalen, 0));
+}
+
 TEST_F(BgpMsgBuilderTest, Build) {
     BgpAttrSpec attr;
     BgpAttrNextHop *nexthop = new BgpAttrNextHop(0xabcdef01);
@@ -157,7 +239,7 @@ TEST_F(BgpMsgBuilderTest, Build) {
 
     nlri = static_cast<BgpMpNlri *>(*(result->path_attributes.end() - 1));
     EXPECT_TRUE(nlri != NULL);
-    EXPECT_EQ(2, nlri->nlri.size());
+    EXPECT_EQ(2U, nlri->nlri.size());
     route2.BuildProtoPrefix(&prefix, 0);
     EXPECT_EQ(prefix.prefixlen, nlri->nlri[1]->prefixlen);
     EXPECT_EQ(prefix.prefix, nlri->nlri[1]->prefix);
@@ -174,6 +256,109 @@ TEST_F(BgpMsgBuilderTest, Build) {
     delete ext_community;
     delete result;
 }
+
+// Messages built from the cached wire format of an attribute must be the
+// same as the first one, which populates the cache, and as the message the
+// generic encoder builds.
+TEST_F(BgpMsgBuilderTest, WireFormatCache) {
+    BgpAttrSpec attr;
+    BuildAttrSpec(&attr);
+    RibOutAttr rib_out_attr;
+    rib_out_attr.set_attr(server_.attr_db()->Locate(attr));
+    EXPECT_TRUE(rib_out_attr.attr()->wire_format(false) == NULL);
+
+    InetVpnRoute route(InetVpnPrefix::FromString("12345:2:1.1.1.1/24"));
+    InetVpnRoute route2(InetVpnPrefix::FromString("12345:2:2.2.2.0/24"));
+    BgpMessage message;
+    message.Start(&rib_out_attr, &route);
+    EXPECT_TRUE(message.AddRoute(&route2, &rib_out_attr));
+    EXPECT_TRUE(rib_out_attr.attr()->wire_format(false) != NULL);
+    EXPECT_TRUE(rib_out_attr.attr()->wire_format(true) == NULL);
+    size_t length;
+    const uint8_t *data = message.GetData(NULL, &length);
+    std::vector<uint8_t> first(data, data + length);
+    vector<BgpRoute *> routes;
+    routes.push_back(&route);
+    routes.push_back(&route2);
+    EXPECT_TRUE(LegacyEncode(rib_out_attr, routes) == first);
+
+    BgpMessage message2;
+    message2.Start(&rib_out_attr, &route);
+    EXPECT_TRUE(message2.AddRoute(&route2, &rib_out_attr));
+    data = message2.GetData(NULL, &length);
+    EXPECT_TRUE(first == std::vector<uint8_t>(data, data + length));
+
+    const BgpProto::Update *result = static_cast<const BgpProto::Update *>(
+        BgpProto::Decode(data, length));
+    ASSERT_TRUE(result != NULL);
+    EXPECT_EQ(attr.size(), result->path_attributes.size());
+    const BgpMpNlri *nlri =
+        static_cast<const BgpMpNlri *>(result->path_attributes.back());
+    EXPECT_EQ(BgpAttribute::MPReachNlri, nlri->code);
+    EXPECT_EQ(2U, nlri->nlri.size());
+
+    delete result;
+    STLDeleteValues(&attr);
+}
+
+// Measure the number of update messages built per second on one core, for
+// messages with one route and with as many routes as fit. Builds a small
+// number of messages as part of the unit tests; set
+// BGP_MSG_BUILDER_BENCH_COUNT to e.g. 200000 for meaningful numbers.
+TEST_F(BgpMsgBuilderTest, Bench) {
+    int count = task_util_bench_count("BGP_MSG_BUILDER_BENCH_COUNT", 10000);
+
+    BgpAttrSpec attr;
+    BuildAttrSpec(&attr);
+    RibOutAttr rib_out_attr;
+    rib_out_attr.set_attr(server_.attr_db()->Locate(attr));
+    STLDeleteValues(&attr);
+
+    std::vector<InetVpnRoute *> routes;
+    for (int i = 0; i < 256; i++) {
+        std::ostringstream prefix;
+        prefix << "12345:2:10.1." << i << ".0/24";
+        routes.push_back(
+            new InetVpnRoute(InetVpnPrefix::FromString(prefix.str())));
+    }
+
+    uint64_t start = UTCTimestampUsec();
+    size_t bytes = 0;
+    for (int i = 0; i < count; i++) {
+        BgpMessage message;
+        message.Start(&rib_out_attr, routes[i % routes.size()]);
+        size_t length;
+        message.GetData(NULL, &length);
+        bytes += length;
+    }
+    uint64_t single = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    size_t route_count = 0;
+    int message_count = count / 10;
+    for (int i = 0; i < message_count; i++) {
+        BgpMessage message;
+        message.Start(&rib_out_attr, routes[0]);
+        route_count++;
+        for (size_t j = 1; j < routes.size(); j++) {
+            if (!message.AddRoute(routes[j], &rib_out_attr)) {
+                break;
+            }
+            route_count++;
+        }
+    }
+    uint64_t full = UTCTimestampUsec() - start;
+
+    cout << "single route updates " << (uint64_t) count * 1000000 /
+            (single ? single : 1) << "/s (" << bytes / count << " bytes)"
+         << endl;
+    cout << "full updates " << (uint64_t) message_count * 1000000 /
+            (full ? full : 1) << "/s routes " << (uint64_t) route_count *
+            1000000 / (full ? full : 1) << "/s" << endl;
+
+    STLDeleteValues(&routes);
+}
+
 }  // namespace
 
 static void SetUp() {
@@ -497,6 +497,41 @@ TEST_F(PeerMembershipMgrTest, PeerDeleteWithDBRequestPending) {
         server_->FindPeer(BgpConfigManager::kMasterInstance, peer_names_[0]));
 }
 
+// The membership queue is adaptive, so it reports the time that the
+// events waited in it.
+TEST_F(PeerMembershipMgrTest, QueueStats) {
+    PeerRibMembershipManager *mgr = server()->membership_mgr();
+    for (int idx = 0; idx < 3; idx++) {
+        mgr->Register(peers_[idx], inet_tbl_,
+                      peers_[idx]->GetRibExportPolicy(), -1);
+    }
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(3, size());
+
+    vector<WorkQueueBase::Stats> stats_list;
+    WorkQueueBase::GetAllStats(&stats_list);
+    const WorkQueueBase::Stats *stats = NULL;
+    for (size_t idx = 0; idx < stats_list.size(); idx++) {
+        if (stats_list[idx].name == "Peer Membership")
+            stats = &stats_list[idx];
+    }
+    ASSERT_TRUE(stats != NULL);
+    EXPECT_TRUE(stats->adaptive);
+    EXPECT_EQ(0U, stats->queue_count);
+    EXPECT_LE(3U, stats->dequeues);
+    uint64_t total = 0;
+    for (int idx = 0; idx < WorkQueueBase::kLatencyBuckets; idx++) {
+        total += stats->latency[idx];
+    }
+    EXPECT_EQ(stats->dequeues, total);
+
+    for (int idx = 0; idx < 3; idx++) {
+        mgr->Unregister(peers_[idx], inet_tbl_);
+    }
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(0, size());
+}
+
 static void SetUp() {
     bgp_log_test::init();
     ControlNode::SetDefaultSchedulingPolicy();
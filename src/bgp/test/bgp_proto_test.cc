@@ -4,6 +4,8 @@
 
 #include "base/logging.h"
 #include "base/proto.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
 #include "control-node/control_node.h"
 #include "testing/gunit.h"
 #include <boost/assign/list_of.hpp>
@@ -31,9 +33,103 @@ protected:
         EXPECT_EQ(offset, ec.data-data);
         EXPECT_EQ(err_size, ec.data_size);
         if (result) delete result;
+        VerifyDecodeInPlace(data, size);
         return true;
     }
 
+    typedef vector<pair<int, vector<uint8_t> > > PrefixList;
+
+    static PrefixList GetPrefixes(BgpProto::PrefixIterator *iter) {
+        PrefixList prefixes;
+        while (iter->HasNext()) {
+            const BgpProtoPrefix *prefix = iter->Next();
+            prefixes.push_back(make_pair(prefix->type << 16 | prefix->prefixlen,
+                                         prefix->prefix));
+        }
+        return prefixes;
+    }
+
+    // Check that DecodeInPlace accepts the same messages as Decode, fails
+    // with the same error and finds the same prefixes. DecodeInPlace also
+    // rejects prefixes that run past the end of their field, which Decode
+    // reads from the following bytes.
+    static void VerifyDecodeInPlace(const uint8_t *data, size_t size) {
+        ParseErrorContext ec, ec_in_place;
+        BgpProto::BgpMessage *msg = BgpProto::Decode(data, size, &ec);
+        BgpProto::BgpMessage *msg_in_place =
+            BgpProto::DecodeInPlace(data, size, &ec_in_place);
+        if (msg_in_place == NULL &&
+            ec_in_place.error_subcode ==
+                BgpProto::Notification::InvalidNetworkField) {
+            EXPECT_EQ(BgpProto::Notification::UpdateMsgErr,
+                      ec_in_place.error_code);
+            delete msg;
+            return;
+        }
+        EXPECT_EQ(msg == NULL, msg_in_place == NULL);
+        if (msg == NULL || msg_in_place == NULL) {
+            EXPECT_EQ(ec.error_code, ec_in_place.error_code);
+            EXPECT_EQ(ec.error_subcode, ec_in_place.error_subcode);
+            if (ec.error_code) {
+                EXPECT_EQ(ec.data, ec_in_place.data);
+                EXPECT_EQ(ec.data_size, ec_in_place.data_size);
+            }
+            delete msg;
+            delete msg_in_place;
+            return;
+        }
+
+        EXPECT_EQ(msg->type, msg_in_place->type);
+        if (msg->type == BgpProto::UPDATE) {
+            const BgpProto::Update *update =
+                static_cast<BgpProto::Update *>(msg);
+            const BgpProto::Update *update_in_place =
+                static_cast<BgpProto::Update *>(msg_in_place);
+            EXPECT_TRUE(update_in_place->withdrawn_routes.empty());
+            EXPECT_TRUE(update_in_place->nlri.empty());
+
+            BgpProto::PrefixIterator withdrawn(update->withdrawn_routes,
+                                               update->withdrawn_data);
+            BgpProto::PrefixIterator withdrawn_in_place(
+                update_in_place->withdrawn_routes,
+                update_in_place->withdrawn_data);
+            EXPECT_TRUE(GetPrefixes(&withdrawn) ==
+                        GetPrefixes(&withdrawn_in_place));
+            BgpProto::PrefixIterator nlri(update->nlri, update->nlri_data);
+            BgpProto::PrefixIterator nlri_in_place(update_in_place->nlri,
+                                                   update_in_place->nlri_data);
+            EXPECT_TRUE(GetPrefixes(&nlri) == GetPrefixes(&nlri_in_place));
+
+            ASSERT_EQ(update->path_attributes.size(),
+                      update_in_place->path_attributes.size());
+            for (size_t i = 0; i < update->path_attributes.size(); i++) {
+                const BgpAttribute *attr = update->path_attributes[i];
+                const BgpAttribute *attr_in_place =
+                    update_in_place->path_attributes[i];
+                if (attr->code != BgpAttribute::MPReachNlri &&
+                    attr->code != BgpAttribute::MPUnreachNlri) {
+                    EXPECT_EQ(0, attr->CompareTo(*attr_in_place));
+                    continue;
+                }
+                const BgpMpNlri *mp_nlri =
+                    static_cast<const BgpMpNlri *>(attr);
+                const BgpMpNlri *mp_nlri_in_place =
+                    static_cast<const BgpMpNlri *>(attr_in_place);
+                EXPECT_EQ(mp_nlri->code, mp_nlri_in_place->code);
+                EXPECT_EQ(mp_nlri->afi, mp_nlri_in_place->afi);
+                EXPECT_EQ(mp_nlri->safi, mp_nlri_in_place->safi);
+                EXPECT_EQ(mp_nlri->nexthop, mp_nlri_in_place->nexthop);
+                EXPECT_TRUE(mp_nlri_in_place->nlri.empty());
+                BgpProto::PrefixIterator iter(mp_nlri);
+                BgpProto::PrefixIterator iter_in_place(mp_nlri_in_place);
+                EXPECT_TRUE(GetPrefixes(&iter) ==
+                            GetPrefixes(&iter_in_place));
+            }
+        }
+        delete msg;
+        delete msg_in_place;
+    }
+
 
     void GenerateByteError(uint8_t *data, size_t data_size){
         enum {
@@ -61,6 +157,7 @@ protected:
 
         BgpProto::BgpMessage *msg = BgpProto::Decode(new_data, data_size);
         if (msg) delete msg;
+        VerifyDecodeInPlace(new_data, data_size);
     }
 };
 
@@ -326,6 +423,7 @@ TEST_F(BgpProtoTest, Update) {
         EXPECT_EQ(0, result->CompareTo(update));
         delete result;
     }
+    VerifyDecodeInPlace(data, res);
 }
 
 TEST_F(BgpProtoTest, L3VPNUpdate) {
@@ -349,9 +447,29 @@ TEST_F(BgpProtoTest, L3VPNUpdate) {
         EXPECT_EQ(0, result->CompareTo(update));
         delete result;
     }
+    VerifyDecodeInPlace(data, res);
 }
 
 
+TEST_F(BgpProtoTest, RTargetUpdate) {
+    BgpProto::Update update;
+    BgpMessageTest::GenerateUpdateMessage(&update, BgpAf::IPv4,
+                                          BgpAf::RTarget);
+    uint8_t data[256];
+
+    int res = BgpProto::Encode(&update, data, 256);
+    EXPECT_NE(-1, res);
+
+    const BgpProto::Update *result;
+    result = static_cast<const BgpProto::Update *>(BgpProto::Decode(data, res));
+    EXPECT_TRUE(result != NULL);
+    if (result) {
+        EXPECT_EQ(0, result->CompareTo(update));
+        delete result;
+    }
+    VerifyDecodeInPlace(data, res);
+}
+
 
 TEST_F(BgpProtoTest, EvpnUpdate) {
     BgpProto::Update update;
@@ -374,6 +492,7 @@ TEST_F(BgpProtoTest, EvpnUpdate) {
         EXPECT_EQ(0, result->CompareTo(update));
         delete result;
     }
+    VerifyDecodeInPlace(data, res);
 }
 
 TEST_F(BgpProtoTest, OpenError) {
@@ -635,6 +754,95 @@ TEST_F(BgpProtoTest, UpdateScale) {
         EXPECT_EQ(0, result->CompareTo(update));
         delete result;
     }
+    VerifyDecodeInPlace(data, res);
+}
+
+// Compare the cost of Decode and DecodeInPlace for UPDATE messages full of
+// L3VPN prefixes, including a walk over the prefixes as ProcessUpdate does.
+// Decodes a small number of messages as part of the unit tests; set
+// BGP_PROTO_BENCH_COUNT to e.g. 20000 for meaningful numbers.
+TEST_F(BgpProtoTest, DecodeBench) {
+    int count = task_util_bench_count("BGP_PROTO_BENCH_COUNT", 1000);
+
+    BgpProto::Update update;
+    update.path_attributes.push_back(
+        new BgpAttrOrigin(BgpAttrOrigin::INCOMPLETE));
+    AsPathSpec *path_spec = new AsPathSpec;
+    AsPathSpec::PathSegment *ps = new AsPathSpec::PathSegment;
+    ps->path_segment_type = AsPathSpec::PathSegment::AS_SEQUENCE;
+    ps->path_segment.push_back(64512);
+    path_spec->path_segments.push_back(ps);
+    update.path_attributes.push_back(path_spec);
+    ExtCommunitySpec *ext_community = new ExtCommunitySpec;
+    ext_community->communities.push_back(0x0002fc0000000001);
+    update.path_attributes.push_back(ext_community);
+
+    BgpMpNlri *mp_nlri = new BgpMpNlri(BgpAttribute::MPReachNlri);
+    mp_nlri->afi = BgpAf::IPv4;
+    mp_nlri->safi = BgpAf::Vpn;
+    uint8_t nh[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 192, 168, 1, 1 };
+    mp_nlri->nexthop.assign(&nh[0], &nh[12]);
+    update.path_attributes.push_back(mp_nlri);
+
+    // Label, route distinguisher and a /24 address.
+    static const int kPrefixSize = 3 + 8 + 3;
+    uint8_t data[BgpProto::kMaxMessageSize];
+    int res;
+    for (int i = 0; ; i++) {
+        BgpProtoPrefix *prefix = new BgpProtoPrefix;
+        prefix->prefixlen = kPrefixSize * 8;
+        prefix->prefix.resize(kPrefixSize);
+        prefix->prefix[kPrefixSize - 2] = i >> 8;
+        prefix->prefix[kPrefixSize - 1] = i;
+        mp_nlri->nlri.push_back(prefix);
+        if (BgpProto::Encode(&update, data, sizeof(data)) < 0) {
+            mp_nlri->nlri.pop_back();
+            delete prefix;
+            break;
+        }
+    }
+    res = BgpProto::Encode(&update, data, sizeof(data));
+    ASSERT_GT(res, 0);
+    size_t prefix_count = mp_nlri->nlri.size();
+
+    uint64_t start = UTCTimestampUsec();
+    size_t found = 0;
+    for (int i = 0; i < count; i++) {
+        BgpProto::Update *result =
+            static_cast<BgpProto::Update *>(BgpProto::Decode(data, res));
+        BgpProto::PrefixIterator iter(
+            static_cast<BgpMpNlri *>(result->path_attributes.back()));
+        while (iter.HasNext()) {
+            found += iter.Next()->prefixlen != 0;
+        }
+        delete result;
+    }
+    uint64_t tree = UTCTimestampUsec() - start;
+    EXPECT_EQ(prefix_count * count, found);
+
+    start = UTCTimestampUsec();
+    found = 0;
+    for (int i = 0; i < count; i++) {
+        BgpProto::Update *result = static_cast<BgpProto::Update *>(
+            BgpProto::DecodeInPlace(data, res));
+        BgpProto::PrefixIterator iter(
+            static_cast<BgpMpNlri *>(result->path_attributes.back()));
+        while (iter.HasNext()) {
+            found += iter.Next()->prefixlen != 0;
+        }
+        delete result;
+    }
+    uint64_t in_place = UTCTimestampUsec() - start;
+    EXPECT_EQ(prefix_count * count, found);
+
+    cout << "messages " << count << " of " << res << " bytes with "
+         << prefix_count << " prefixes" << endl;
+    cout << "decode          " << tree << "us "
+         << (uint64_t) prefix_count * count * 1000000 / (tree ? tree : 1)
+         << " prefixes/s" << endl;
+    cout << "decode in place " << in_place << "us "
+         << (uint64_t) prefix_count * count * 1000000 /
+            (in_place ? in_place : 1) << " prefixes/s" << endl;
 }
 
 TEST_F(BgpProtoTest, RandomError) {
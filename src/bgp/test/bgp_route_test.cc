@@ -12,6 +12,7 @@
 #include "bgp/bgp_log.h"
 #include "bgp/bgp_path.h"
 #include "bgp/bgp_server.h"
+#include "bgp/bgp_table.h"
 #include "bgp/inet/inet_route.h"
 #include "control-node/control_node.h"
 #include "io/event_manager.h"
@@ -134,6 +135,106 @@ TEST_F(BgpRouteTest, Paths) {
     route.RemovePath(&peer);
 }
 
+static BgpPath *BuildPath(BgpAttrDB *db, IPeer *peer, uint32_t path_id,
+                          uint32_t neighbor_as, uint32_t med,
+                          uint32_t local_pref = 100) {
+    BgpAttrSpec spec;
+    BgpAttr *attr = new BgpAttr(db, spec);
+    attr->set_origin(BgpAttrOrigin::IGP);
+    attr->set_med(med);
+    attr->set_local_pref(local_pref);
+
+    AsPathSpec as_path;
+    AsPathSpec::PathSegment *ps = new AsPathSpec::PathSegment;
+    ps->path_segment_type = AsPathSpec::PathSegment::AS_SEQUENCE;
+    ps->path_segment.push_back(neighbor_as);
+    as_path.path_segments.push_back(ps);
+    attr->set_as_path(&as_path);
+
+    return new BgpPath(peer, path_id, BgpPath::BGP_XMPP, attr, 0, 0);
+}
+
+//
+// No path may be preferred over the path in front of it.
+//
+static void VerifyPathOrder(const InetRoute &route) {
+    const Route::PathList &paths = route.GetPathList();
+    Route::PathList::const_iterator prev = paths.begin();
+    if (prev == paths.end())
+        return;
+    for (Route::PathList::const_iterator it = ++paths.begin();
+         it != paths.end(); prev = it, ++it) {
+        EXPECT_FALSE(BgpTable::PathSelection(*it, *prev));
+    }
+}
+
+//
+// MED is only compared between paths from the same neighbor AS, so path
+// selection is not transitive: A beats B on the path id, B beats C on the
+// path id and C beats A on the MED. Once B is deleted, C must be the best
+// path.
+//
+TEST_F(BgpRouteTest, NonTransitiveMed) {
+    BgpAttrDB *db = server_.attr_db();
+    BgpPeerMock peer;
+    Ip4Prefix prefix;
+    InetRoute route(prefix);
+
+    BgpPath *path_a = BuildPath(db, &peer, 1, 100, 20);
+    BgpPath *path_b = BuildPath(db, &peer, 2, 200, 0);
+    BgpPath *path_c = BuildPath(db, &peer, 3, 100, 10);
+    EXPECT_TRUE(BgpTable::PathSelection(*path_a, *path_b));
+    EXPECT_TRUE(BgpTable::PathSelection(*path_b, *path_c));
+    EXPECT_TRUE(BgpTable::PathSelection(*path_c, *path_a));
+
+    route.InsertPath(path_a);
+    route.InsertPath(path_b);
+    route.InsertPath(path_c);
+    VerifyPathOrder(route);
+
+    route.DeletePath(path_b);
+    VerifyPathOrder(route);
+    EXPECT_EQ(path_c, route.BestPath());
+
+    route.DeletePath(path_c);
+    EXPECT_EQ(path_a, route.BestPath());
+    route.DeletePath(path_a);
+    EXPECT_TRUE(route.front() == NULL);
+}
+
+//
+// Paths from several neighbor ASes with different MEDs and local
+// preferences, inserted and deleted in a scrambled order. The paths must
+// stay in order after each change.
+//
+TEST_F(BgpRouteTest, PathOrder) {
+    BgpAttrDB *db = server_.attr_db();
+    BgpPeerMock peer;
+    Ip4Prefix prefix;
+    InetRoute route(prefix);
+    const int kPaths = 64;
+    const uint32_t neighbor_as[] = { 100, 200, 300 };
+
+    std::vector<BgpPath *> paths;
+    for (int idx = 0; idx < kPaths; idx++) {
+        BgpPath *path = BuildPath(db, &peer, (idx * 13) % kPaths,
+                                  neighbor_as[(idx * 7) % 3],
+                                  (idx * 7) % 5, 100 + (idx * 37) % 2);
+        route.InsertPath(path);
+        VerifyPathOrder(route);
+        paths.push_back(path);
+    }
+    EXPECT_EQ(64U, route.count());
+
+    for (int idx = 0; !paths.empty(); idx++) {
+        size_t pos = (idx * 29) % paths.size();
+        route.DeletePath(paths[pos]);
+        paths.erase(paths.begin() + pos);
+        VerifyPathOrder(route);
+    }
+    EXPECT_TRUE(route.front() == NULL);
+}
+
 }  // namespace
 
 static void SetUp() {
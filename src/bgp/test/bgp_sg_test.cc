@@ -4,8 +4,10 @@
 
 #include "bgp/scheduling_group.h"
 
+#include <unistd.h>
 #include <string>
 #include <vector>
+#include <tbb/atomic.h>
 
 #include "base/logging.h"
 #include "base/task.h"
@@ -1924,6 +1926,146 @@ TEST_F(SGMultiRibOutTest, PeerDequeueBlocks1b) {
     }
 }
 
+//
+// Action for TailDequeue that waits for up to timeout_msecs for count calls
+// to be in progress at the same time.
+//
+class TailDequeueRendezvous {
+public:
+    TailDequeueRendezvous(tbb::atomic<int> *arrived, int count,
+                          int timeout_msecs)
+        : arrived_(arrived), count_(count), timeout_msecs_(timeout_msecs) {
+    }
+
+    bool operator()(int queue_id, const RibPeerSet &msync,
+                    RibPeerSet *blocked) {
+        (*arrived_)++;
+        for (int elapsed = 0;
+             *arrived_ < count_ && elapsed < timeout_msecs_; elapsed++) {
+            usleep(1000);
+        }
+        return true;
+    }
+
+private:
+    tbb::atomic<int> *arrived_;
+    int count_;
+    int timeout_msecs_;
+};
+
+class SGParallelTest : public SGTest {
+protected:
+    virtual void SetUp() {
+        SGTest::SetUp();
+        arrived_ = 0;
+        mgr_.set_max_workers(2);
+    }
+
+    // Create a RibOut advertised by peers start_idx through end_idx.
+    void CreateRibOut(int start_idx, int end_idx) {
+        SchedulerStop();
+        SGTest::CreateRibOut();
+        for (int idx = start_idx; idx <= end_idx; idx++) {
+            RibOutRegister(ribouts_.back(), peers_[idx]);
+        }
+        SchedulerStart();
+        EXPECT_CALL(*updates_.back(), PeerDequeue(_, _, _, _)).Times(0);
+    }
+
+    SchedulingGroup::Stats GetStats() {
+        SchedulingGroup::Stats stats;
+        sg_->GetStats(&stats);
+        return stats;
+    }
+
+    tbb::atomic<int> arrived_;
+};
+
+//
+// TailDequeue for RibOuts that have no peers in common runs concurrently.
+//
+TEST_F(SGParallelTest, TailDequeueDisjoint) {
+    if (TaskScheduler::GetInstance()->HardwareThreadCount() < 2)
+        return;
+
+    CreateRibOut(0, 1);
+    CreateRibOut(2, 3);
+    ASSERT_EQ(1, mgr_.size());
+
+    for (int ro_idx = 1; ro_idx <= 2; ro_idx++) {
+        EXPECT_CALL(*updates_[ro_idx],
+            TailDequeue(RibOutUpdates::QUPDATE, _, _))
+            .Times(1)
+            .WillOnce(Invoke(TailDequeueRendezvous(&arrived_, 2, 5000)));
+    }
+
+    SchedulerStop();
+    RibOutActive(ribouts_[1], RibOutUpdates::QUPDATE);
+    RibOutActive(ribouts_[2], RibOutUpdates::QUPDATE);
+    SchedulerStart();
+    task_util::WaitForIdle();
+
+    SchedulingGroup::Stats stats = GetStats();
+    EXPECT_EQ(2, stats.max_workers);
+    EXPECT_EQ(2U, stats.tail_dequeues);
+    EXPECT_EQ(0U, stats.peer_dequeues);
+    EXPECT_EQ(2, stats.peak_concurrency);
+    EXPECT_EQ(0U, stats.queue_count);
+    EXPECT_GE(stats.work_usecs, stats.active_usecs);
+}
+
+//
+// TailDequeue for RibOuts that have a peer in common is serialized.
+//
+TEST_F(SGParallelTest, TailDequeueOverlap) {
+    CreateRibOut(0, 1);
+    CreateRibOut(1, 2);
+    ASSERT_EQ(1, mgr_.size());
+
+    InSequence seq;
+    for (int ro_idx = 1; ro_idx <= 2; ro_idx++) {
+        EXPECT_CALL(*updates_[ro_idx],
+            TailDequeue(RibOutUpdates::QUPDATE, _, _))
+            .Times(1)
+            .WillOnce(Invoke(TailDequeueRendezvous(&arrived_, 2, 100)));
+    }
+
+    SchedulerStop();
+    RibOutActive(ribouts_[1], RibOutUpdates::QUPDATE);
+    RibOutActive(ribouts_[2], RibOutUpdates::QUPDATE);
+    SchedulerStart();
+    task_util::WaitForIdle();
+
+    SchedulingGroup::Stats stats = GetStats();
+    EXPECT_EQ(2U, stats.tail_dequeues);
+    EXPECT_EQ(1, stats.peak_concurrency);
+}
+
+//
+// Entries for the same RibOut are processed in order even if there are
+// idle Workers.
+//
+TEST_F(SGParallelTest, TailDequeueSameRibOut) {
+    const int kTailCount = 8;
+    CreateRibOut(0, 1);
+
+    EXPECT_CALL(*updates_[1], TailDequeue(RibOutUpdates::QUPDATE, _, _))
+        .Times(kTailCount)
+        .WillRepeatedly(Invoke(TailDequeueRendezvous(&arrived_, 0, 0)));
+
+    SchedulerStop();
+    for (int idx = 0; idx < kTailCount; idx++) {
+        RibOutActive(ribouts_[1], RibOutUpdates::QUPDATE);
+    }
+    SchedulerStart();
+    task_util::WaitForIdle();
+
+    SchedulingGroup::Stats stats = GetStats();
+    EXPECT_EQ(kTailCount, (int) stats.tail_dequeues);
+    EXPECT_EQ(1, stats.peak_concurrency);
+    EXPECT_EQ(0U, stats.queue_count);
+}
+
 int main(int argc, char **argv) {
     bgp_log_test::init();
     ControlNode::SetDefaultSchedulingPolicy();
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+//
+// Benchmark of BGP update generation.
+//
+// Two control nodes, peered over BGP, serve agents that are spread evenly
+// across them. All agents subscribe to the same virtual network. The
+// benchmark runs three phases and prints the results of each as a single
+// line JSON object, that can be compared across commits.
+//
+// - inject: routes are added evenly by all agents. Measures the time until
+//   every agent has received every route.
+// - latency: one route at a time is added by each agent in turn. Measures
+//   the time until every agent has received it.
+// - flap: the session of the first agent goes down and comes back up, and
+//   the agent adds its routes again. Measures the time until the other
+//   agents have withdrawn its routes, and the time until every agent has
+//   received every route again.
+//
+// The number of agents, routes and latency samples can be overridden with
+// BGP_BENCH_AGENTS, BGP_BENCH_ROUTES and BGP_BENCH_SAMPLES. The results are
+// also appended to the file named by BGP_BENCH_RESULTS, if set.
+//
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "base/logging.h"
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "bgp/bgp_log.h"
+#include "bgp/inet/inet_route.h"
+#include "bgp/test/bgp_server_test_util.h"
+#include "bgp/test/bgp_test_util.h"
+#include "control-node/control_node.h"
+#include "control-node/test/control_node_test.h"
+#include "control-node/test/network_agent_mock.h"
+#include "io/event_manager.h"
+#include "io/test/event_manager_test.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+// Peak resident set size of the process in KB.
+static uint64_t PeakRssKb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+class BgpUpdateBenchTest : public ::testing::Test {
+protected:
+    static const int kTimeoutSeconds = 300;
+    static const char *kNetwork;
+    static const char *config_tmpl;
+
+    BgpUpdateBenchTest()
+        : thread_(&evm_),
+          node_a_(new test::ControlNodeTest(&evm_, "A")),
+          node_b_(new test::ControlNodeTest(&evm_, "B")),
+          route_count_(0) {
+    }
+
+    virtual void SetUp() {
+        n_agents_ = task_util_bench_count("BGP_BENCH_AGENTS", 8);
+        n_routes_ = task_util_bench_count("BGP_BENCH_ROUTES", 10000);
+        n_samples_ = task_util_bench_count("BGP_BENCH_SAMPLES", 200);
+
+        char config[4096];
+        snprintf(config, sizeof(config), config_tmpl,
+                 node_a_->bgp_port(), node_b_->bgp_port());
+        node_a_->BgpConfig(config);
+        node_b_->BgpConfig(config);
+
+        vector<string> instance_names(1, kNetwork);
+        multimap<string, string> connections;
+        string netconf(
+            bgp_util::NetworkConfigGenerate(instance_names, connections));
+        node_a_->IFMapMessage(netconf);
+        node_b_->IFMapMessage(netconf);
+        task_util::WaitForIdle();
+        node_a_->VerifyRoutingInstance(kNetwork);
+        node_b_->VerifyRoutingInstance(kNetwork);
+
+        thread_.Start();
+        TASK_UTIL_EXPECT_EQ(1, node_a_->BgpEstablishedCount());
+        TASK_UTIL_EXPECT_EQ(1, node_b_->BgpEstablishedCount());
+
+        for (int i = 0; i < n_agents_; i++) {
+            ostringstream name, address;
+            name << "agent-" << i;
+            address << "127.0.0." << i + 1;
+            test::ControlNodeTest *node = (i % 2) ? node_b_.get() :
+                                                    node_a_.get();
+            agents_.push_back(new test::NetworkAgentMock(&evm_, name.str(),
+                node->xmpp_port(), address.str()));
+        }
+        agent_routes_.resize(n_agents_);
+        for (int i = 0; i < n_agents_; i++) {
+            TASK_UTIL_EXPECT_TRUE(agents_[i]->IsEstablished());
+            agents_[i]->Subscribe(kNetwork, 1);
+        }
+        task_util::WaitForIdle();
+    }
+
+    virtual void TearDown() {
+        for (size_t i = 0; i < agents_.size(); i++) {
+            agents_[i]->Delete();
+        }
+        task_util::WaitForIdle();
+        node_a_.reset();
+        node_b_.reset();
+        evm_.Shutdown();
+        thread_.Join();
+        task_util::WaitForIdle();
+        STLDeleteValues(&agents_);
+    }
+
+    // Add a route from the given agent, with a prefix unique to the run.
+    void AddRoute(int agent_id) {
+        Ip4Prefix prefix(Ip4Address(0x0a000000 + route_count_++), 32);
+        agent_routes_[agent_id].push_back(prefix.ToString());
+        agents_[agent_id]->AddRoute(kNetwork, prefix.ToString());
+    }
+
+    // Re-add all the routes of the given agent.
+    void ReAddRoutes(int agent_id) {
+        for (size_t i = 0; i < agent_routes_[agent_id].size(); i++) {
+            agents_[agent_id]->AddRoute(kNetwork, agent_routes_[agent_id][i]);
+        }
+    }
+
+    bool AgentsHaveRoutes(int count, int skip) {
+        for (int i = 0; i < n_agents_; i++) {
+            if (i != skip && agents_[i]->RouteCount(kNetwork) != count) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Wait until all the agents, except skip, have count routes. Returns the
+    // time in usecs since start.
+    uint64_t WaitForRoutes(uint64_t start, int count, int skip = -1) {
+        uint64_t deadline = start + (uint64_t) kTimeoutSeconds * 1000000;
+        while (!AgentsHaveRoutes(count, skip)) {
+            if (UTCTimestampUsec() > deadline) {
+                ADD_FAILURE() << "Timed out waiting for " << count
+                              << " routes at all agents";
+                break;
+            }
+            usleep(100);
+        }
+        return UTCTimestampUsec() - start;
+    }
+
+    void Report(const string &phase, const string &results) {
+        ostringstream oss;
+        oss << "{\"benchmark\": \"bgp_update\", \"phase\": \"" << phase
+            << "\", \"agents\": " << n_agents_
+            << ", \"routes\": " << n_routes_
+            << ", " << results
+            << ", \"peak_rss_kb\": " << PeakRssKb() << "}";
+        cout << oss.str() << endl;
+
+        char *file = getenv("BGP_BENCH_RESULTS");
+        if (file) {
+            ofstream out(file, ios::app);
+            out << oss.str() << endl;
+        }
+    }
+
+    void InjectPhase() {
+        uint64_t start = UTCTimestampUsec();
+        for (int i = 0; i < n_routes_; i++) {
+            AddRoute(i % n_agents_);
+        }
+        uint64_t elapsed = WaitForRoutes(start, route_count_);
+
+        ostringstream oss;
+        oss << "\"elapsed_usecs\": " << elapsed
+            << ", \"routes_per_sec\": "
+            << (uint64_t) n_routes_ * 1000000 / (elapsed ? elapsed : 1)
+            << ", \"updates_per_sec\": "
+            << (uint64_t) n_routes_ * n_agents_ * 1000000 /
+               (elapsed ? elapsed : 1);
+        Report("inject", oss.str());
+    }
+
+    void LatencyPhase() {
+        vector<uint64_t> samples;
+        for (int i = 0; i < n_samples_; i++) {
+            uint64_t start = UTCTimestampUsec();
+            AddRoute(i % n_agents_);
+            samples.push_back(WaitForRoutes(start, route_count_));
+        }
+        if (samples.empty()) {
+            return;
+        }
+        sort(samples.begin(), samples.end());
+
+        ostringstream oss;
+        oss << "\"samples\": " << samples.size()
+            << ", \"p50_usecs\": " << samples[(samples.size() - 1) / 2]
+            << ", \"p99_usecs\": " << samples[(samples.size() * 99 - 1) / 100]
+            << ", \"max_usecs\": " << samples.back();
+        Report("latency", oss.str());
+    }
+
+    void FlapPhase() {
+        int total = route_count_;
+        int withdrawn = agent_routes_[0].size();
+
+        uint64_t start = UTCTimestampUsec();
+        agents_[0]->SessionDown();
+        uint64_t withdraw = WaitForRoutes(start, total - withdrawn, 0);
+
+        start = UTCTimestampUsec();
+        agents_[0]->SessionUp();
+        TASK_UTIL_EXPECT_TRUE(agents_[0]->IsEstablished());
+        agents_[0]->Subscribe(kNetwork, 1);
+        ReAddRoutes(0);
+        uint64_t recovery = WaitForRoutes(start, total);
+
+        ostringstream oss;
+        oss << "\"flapped_routes\": " << withdrawn
+            << ", \"withdraw_usecs\": " << withdraw
+            << ", \"recovery_usecs\": " << recovery;
+        Report("flap", oss.str());
+    }
+
+    EventManager evm_;
+    ServerThread thread_;
+    boost::scoped_ptr<test::ControlNodeTest> node_a_;
+    boost::scoped_ptr<test::ControlNodeTest> node_b_;
+    vector<test::NetworkAgentMock *> agents_;
+    vector<vector<string> > agent_routes_;
+    int route_count_;
+    int n_agents_;
+    int n_routes_;
+    int n_samples_;
+};
+
+const char *BgpUpdateBenchTest::kNetwork = "blue";
+
+const char *BgpUpdateBenchTest::config_tmpl = "\
+<config>\
+    <bgp-router name=\'A\'>\
+        <identifier>192.168.0.1</identifier>\
+        <address>127.0.0.1</address>\
+        <port>%d</port>\
+        <session to=\'B\'>\
+            <address-families><family>inet-vpn</family></address-families>\
+        </session>\
+    </bgp-router>\
+    <bgp-router name=\'B\'>\
+        <identifier>192.168.0.2</identifier>\
+        <address>127.0.0.1</address>\
+        <port>%d</port>\
+        <session to=\'A\'>\
+            <address-families><family>inet-vpn</family></address-families>\
+        </session>\
+    </bgp-router>\
+</config>\
+";
+
+TEST_F(BgpUpdateBenchTest, UpdateGeneration) {
+    InjectPhase();
+    LatencyPhase();
+    FlapPhase();
+}
+
+class TestEnvironment : public ::testing::Environment {
+    virtual ~TestEnvironment() { }
+};
+
+static void SetUp() {
+    ControlNode::SetDefaultSchedulingPolicy();
+    BgpServerTest::GlobalSetUp();
+}
+
+static void TearDown() {
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->Terminate();
+}
+
+int main(int argc, char **argv) {
+    bgp_log_test::init();
+    ::testing::InitGoogleTest(&argc, argv);
+    ::testing::AddGlobalTestEnvironment(new TestEnvironment());
+    SetUp();
+    int result = RUN_ALL_TESTS();
+    TearDown();
+    return result;
+}
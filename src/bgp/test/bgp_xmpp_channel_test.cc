@@ -19,10 +19,14 @@
 #include "control-node/control_node.h"
 #include "bgp/bgp_factory.h"
 #include "bgp/routing-instance/routing_instance.h"
+#include "bgp/bgp_path.h"
+#include "bgp/bgp_route.h"
 #include "bgp/bgp_server.h"
 #include "bgp/bgp_session_manager.h"
 #include "bgp/bgp_peer_membership.h"
 #include "bgp/bgp_xmpp_channel.h"
+#include "bgp/inet/inet_table.h"
+#include "bgp/xmpp_item_decoder.h"
 #include "bgp/test/bgp_server_test_util.h"
 #include "control-node/control_node.h"
 #include "control-node/test/network_agent_mock.h"
@@ -30,6 +34,7 @@
 #include "xmpp/xmpp_channel.h"
 #include "xmpp/xmpp_channel_mux.h"
 #include "xmpp/xmpp_connection.h"
+#include "xmpp/xmpp_proto.h"
 #include "testing/gunit.h"
 
 using namespace std;
@@ -310,6 +315,42 @@ protected:
         return msg;
     }
 
+    // Build a publish request for the stanza, as the XMPP layer does once
+    // the collection request is received. Without the fast path, the request
+    // only has the dom of the complete stanza.
+    std::auto_ptr<XmppStanza::XmppMessageIq> PublishMsg(
+            string rt_instance_name, const string &node, const string &stanza,
+            bool add, bool fast_path) {
+        std::auto_ptr<XmppStanza::XmppMessageIq> msg;
+        if (fast_path) {
+            XmppStanza::XmppMessage *decoded = XmppProto::Decode(
+                XmppStanza::IQ_STANZA,
+                reinterpret_cast<const uint8_t *>(stanza.data()),
+                stanza.size());
+            msg.reset(static_cast<XmppStanza::XmppMessageIq *>(decoded));
+        } else {
+            msg.reset(AllocIq());
+            msg->action = string("publish");
+            msg->dom.reset(XmppStanza::AllocXmppXmlImpl(stanza.c_str()));
+        }
+        msg->node = rt_instance_name;
+        msg->as_node = node;
+        msg->is_as_node = add;
+        return msg;
+    }
+
+    const BgpPath *FindPath(BgpXmppChannel *channel, const string &table_name,
+                            const string &prefix) {
+        BgpTable *table = static_cast<BgpTable *>(
+            server_->database()->FindTable(table_name));
+        EXPECT_FALSE(table == NULL);
+        InetTable::RequestKey key(Ip4Prefix::FromString(prefix), NULL);
+        BgpRoute *route = static_cast<BgpRoute *>(table->Find(&key));
+        if (route == NULL)
+            return NULL;
+        return route->FindPath(channel->Peer());
+    }
+
     BgpServer *server() { return server_.get(); }
 
     BgpXmppChannel *FindChannel(XmppChannel *ch) {
@@ -446,6 +487,142 @@ TEST_F(BgpXmppChannelTest, Connection) {
     EXPECT_EQ(0, Count(mgr_.get()));
 }
 
+static string InetItem(const string &prefix, int label,
+                       const string &comment = "") {
+    ostringstream oss;
+    oss << "<item>"
+        << "<entry xmlns=\"http://ietf.org/protocol/bgpvpn\">" << comment
+        << "<nlri><af>1</af><safi>1</safi>"
+        << "<address>" << prefix << "</address></nlri>"
+        << "<next-hops><next-hop><af>1</af><safi>1</safi>"
+        << "<address>192.168.1.1</address>"
+        << "<label>" << label << "</label>"
+        << "<tunnel-encapsulation-list>"
+        << "<tunnel-encapsulation>gre</tunnel-encapsulation>"
+        << "<tunnel-encapsulation>udp</tunnel-encapsulation>"
+        << "</tunnel-encapsulation-list>"
+        << "</next-hop></next-hops>"
+        << "<version>1</version><virtual-network>blue</virtual-network>"
+        << "<security-group-list><security-group>101</security-group>"
+        << "</security-group-list>"
+        << "</entry></item>\n";
+    return oss.str();
+}
+
+//
+// Items are decoded straight from the stanza until the XmppItemDecoder
+// fails, here on the comment in the second item, and from then on with the
+// dom. The routes must be the same as with the dom for all of the items.
+//
+TEST_F(BgpXmppChannelTest, PublishFastPath) {
+    EXPECT_CALL(*(a.get()), RegisterReceive(xmps::BGP, _))
+                .Times(1);
+    EXPECT_CALL(*(a.get()), UnRegisterReceive(xmps::BGP))
+                .Times(1);
+    mgr_->XmppHandleChannelEvent(a.get(), xmps::READY);
+    EXPECT_EQ(1, Count(mgr_.get()));
+
+    PeerRibMembershipManagerTest *mock_manager =
+        static_cast<PeerRibMembershipManagerTest *>(server_->membership_mgr());
+    EXPECT_CALL(*mock_manager, Register(_, _, _, _,_))
+        .WillRepeatedly(Invoke(mock_manager,
+                         &PeerRibMembershipManagerTest::MockRegister))
+        ;
+    EXPECT_CALL(*mock_manager, Unregister(_, _, _))
+        .WillRepeatedly(Invoke(mock_manager,
+                         &PeerRibMembershipManagerTest::MockUnregister))
+        ;
+
+    std::auto_ptr<XmppStanza::XmppMessageIq> msg;
+    msg = GetSubscribe("blue", true);
+    this->ReceiveUpdate(a.get(), msg.get());
+
+    BgpXmppChannel *channel = this->FindChannel(a.get());
+    ASSERT_FALSE(channel == NULL);
+    task_util::WaitForCondition(&evm_,
+            boost::bind(&BgpXmppChannelTest::PeerRegistered, this,
+                        channel, "blue", true), 1 /* seconds */);
+
+    const char *prefixes[] = { "10.1.1.1/32", "10.1.1.2/32", "10.1.1.3/32" };
+    const int kPrefixes = sizeof(prefixes) / sizeof(prefixes[0]);
+    string node("1/1/blue/10.1.1.1/32");
+    string stanza =
+        "<iq type=\"set\" from=\"agent-a\" "
+        "to=\"network-control@contrailsystems.com/bgp-peer\" id=\"pubsub1\">"
+        "<pubsub xmlns=\"http://jabber.org/protocol/pubsub\">\n"
+        "<publish node=\"" + node + "\">\n" +
+        InetItem(prefixes[0], 1000) +
+        InetItem(prefixes[1], 1001, "<!-- comment -->") +
+        InetItem(prefixes[2], 1002) +
+        "</publish>\n</pubsub>\n</iq>";
+
+    // Add the routes with the dom and keep their attributes.
+    msg = PublishMsg("blue", node, stanza, true, false);
+    this->ReceiveUpdate(a.get(), msg.get());
+    vector<BgpAttrPtr> attrs;
+    vector<uint32_t> labels;
+    for (int i = 0; i < kPrefixes; i++) {
+        TASK_UTIL_EXPECT_TRUE(
+            FindPath(channel, "blue.inet.0", prefixes[i]) != NULL);
+        const BgpPath *path = FindPath(channel, "blue.inet.0", prefixes[i]);
+        ASSERT_TRUE(path != NULL);
+        attrs.push_back(path->GetAttr());
+        labels.push_back(path->GetLabel());
+    }
+
+    msg = PublishMsg("blue", node, stanza, false, false);
+    this->ReceiveUpdate(a.get(), msg.get());
+    for (int i = 0; i < kPrefixes; i++) {
+        TASK_UTIL_EXPECT_TRUE(
+            FindPath(channel, "blue.inet.0", prefixes[i]) == NULL);
+    }
+
+    // The fast path request only has the dom of the envelope and the
+    // decoder stops at the second item.
+    msg = PublishMsg("blue", node, stanza, true, true);
+    ASSERT_TRUE(msg.get() != NULL);
+    EXPECT_EQ("publish", msg->action);
+    EXPECT_TRUE(msg->envelope_only);
+    XmppItemDecoder decoder(msg->data.data(), msg->data.size());
+    XmppInetItem item;
+    while (decoder.NextItem() && decoder.DecodeInetItem(&item)) {
+    }
+    EXPECT_TRUE(decoder.failed());
+    EXPECT_EQ(1, decoder.count());
+
+    // Add the routes with the fast path. The attributes are interned, so
+    // the same requests result in the same attribute pointers.
+    this->ReceiveUpdate(a.get(), msg.get());
+    EXPECT_FALSE(msg->envelope_only);
+    for (int i = 0; i < kPrefixes; i++) {
+        TASK_UTIL_EXPECT_TRUE(
+            FindPath(channel, "blue.inet.0", prefixes[i]) != NULL);
+        const BgpPath *path = FindPath(channel, "blue.inet.0", prefixes[i]);
+        ASSERT_TRUE(path != NULL);
+        EXPECT_EQ(attrs[i].get(), path->GetAttr());
+        EXPECT_EQ(labels[i], path->GetLabel());
+    }
+
+    msg = PublishMsg("blue", node, stanza, false, true);
+    this->ReceiveUpdate(a.get(), msg.get());
+    for (int i = 0; i < kPrefixes; i++) {
+        TASK_UTIL_EXPECT_TRUE(
+            FindPath(channel, "blue.inet.0", prefixes[i]) == NULL);
+    }
+
+    msg = GetSubscribe("blue", false);
+    this->ReceiveUpdate(a.get(), msg.get());
+    task_util::WaitForCondition(&evm_,
+            boost::bind(&BgpXmppChannelTest::PeerRegistered, this,
+                        channel, "blue", false), 1 /* seconds */);
+
+    mgr_->XmppHandleChannelEvent(a.get(), xmps::NOT_READY);
+    task_util::WaitForIdle();
+    delete FindChannel(a.get());
+    mgr_->RemoveChannel(a.get());
+    EXPECT_EQ(0, Count(mgr_.get()));
+}
+
 }
 
 class TestEnvironment : public ::testing::Environment {
@@ -61,11 +61,21 @@ public:
 
     virtual bool Send(const uint8_t *msg, size_t msgsize, 
             xmps::PeerId id, SendReadyCb cb) {
+        return SimulateWriteBlocked(
+            XmppChannelMux::Send(msg, msgsize, id, cb), id, cb);
+    }
+
+    virtual bool SendBuffers(const BufferList &buffers,
+            xmps::PeerId id, SendReadyCb cb) {
+        return SimulateWriteBlocked(
+            XmppChannelMux::SendBuffers(buffers, id, cb), id, cb);
+    }
+
+private:
+    bool SimulateWriteBlocked(bool ret, xmps::PeerId id, SendReadyCb cb) {
         static int count = 0;
-        bool ret;
 
         count++;
-        ret = XmppChannelMux::Send(msg, msgsize, id, cb);
         if (ret && count == 1) {
 
             //
@@ -947,6 +947,81 @@ TEST_F(ReplicationTest, ConnectNetwork) {
     VERIFY_EQ(0, RouteCount("green"));
 }
 
+//
+// The destination tables cached for an extended community must follow the
+// import route targets of the instances: tables that start importing the
+// target get new routes, tables that stop importing it don't. The cache is
+// flushed when an instance joins or leaves the import list of a target.
+//
+TEST_F(ReplicationTest, DestinationCache) {
+    vector<string> instance_names = list_of("blue")("red")("green");
+    multimap<string, string> connections = map_list_of("blue", "red");
+    NetworkConfig(instance_names, connections);
+    task_util::WaitForIdle();
+
+    RoutePathReplicator *replicator = bgp_server_->replicator(Address::INETVPN);
+    error_code ec;
+    peers_.push_back(
+        new BgpPeerMock(Ip4Address::from_string("192.168.0.1", ec)));
+
+    // VPN routes with target "blue" warm up the cache.
+    AddVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.1/32", 100, list_of("blue"));
+    AddVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.2/32", 100, list_of("blue"));
+    AddVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.3/32", 100, list_of("blue"));
+    task_util::WaitForIdle();
+    VERIFY_EQ(3, RouteCount("blue"));
+    VERIFY_EQ(3, RouteCount("red"));
+    VERIFY_EQ(0, RouteCount("green"));
+    EXPECT_NE(0U, replicator->GetDestinationCacheSize());
+
+    // Green starts importing target "blue".
+    ifmap_test_util::IFMapMsgLink(&config_db_,
+                                    "routing-instance", "blue",
+                                    "routing-instance", "green",
+                                    "connection");
+    task_util::WaitForIdle();
+    VERIFY_EQ(3, RouteCount("green"));
+
+    AddVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.4/32", 100, list_of("blue"));
+    task_util::WaitForIdle();
+    VERIFY_EQ(4, RouteCount("blue"));
+    VERIFY_EQ(4, RouteCount("red"));
+    VERIFY_EQ(4, RouteCount("green"));
+
+    // Red stops importing target "blue".
+    ifmap_test_util::IFMapMsgUnlink(&config_db_,
+                                    "routing-instance", "blue",
+                                    "routing-instance", "red",
+                                    "connection");
+    task_util::WaitForIdle();
+    VERIFY_EQ(0, RouteCount("red"));
+
+    AddVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.5/32", 100, list_of("blue"));
+    task_util::WaitForIdle();
+    VERIFY_EQ(5, RouteCount("blue"));
+    VERIFY_EQ(0, RouteCount("red"));
+    VERIFY_EQ(5, RouteCount("green"));
+
+    DeleteVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.1/32");
+    DeleteVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.2/32");
+    DeleteVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.3/32");
+    DeleteVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.4/32");
+    DeleteVPNRoute(peers_[0], "192.168.0.1:1:10.0.1.5/32");
+    task_util::WaitForIdle();
+    VERIFY_EQ(0, RouteCount("blue"));
+    VERIFY_EQ(0, RouteCount("red"));
+    VERIFY_EQ(0, RouteCount("green"));
+
+    // Deleting routes leaves the cache alone, the Leave flushes it.
+    EXPECT_NE(0U, replicator->GetDestinationCacheSize());
+    ifmap_test_util::IFMapMsgUnlink(&config_db_,
+                                    "routing-instance", "blue",
+                                    "routing-instance", "green",
+                                    "connection");
+    task_util::WaitForIdle();
+    VERIFY_EQ(0U, replicator->GetDestinationCacheSize());
+}
+
 TEST_F(ReplicationTest, DeleteNetwork) {
     vector<string> instance_names = list_of("blue")("red")("green");
     multimap<string, string> connections = map_list_of("blue", "red");
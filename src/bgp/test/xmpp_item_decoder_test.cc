@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/xmpp_item_decoder.h"
+
+#include <sstream>
+#include <string>
+
+#include "base/logging.h"
+#include "net/bgp_af.h"
+#include "testing/gunit.h"
+
+using std::string;
+
+static const char *kIqHead =
+    "<iq type=\"set\" from=\"agent-a\" "
+    "to=\"network-control@contrailsystems.com/bgp-peer\" id=\"pubsub1\">"
+    "<pubsub xmlns=\"http://jabber.org/protocol/pubsub\">\n"
+    "<publish node=\"1/1/blue/10.1.1.0/24\">\n";
+
+static const char *kIqTail = "</publish>\n</pubsub>\n</iq>";
+
+static string InetItem(const string &prefix, const string &nexthop,
+                       int label, const string &extra = "") {
+    std::ostringstream oss;
+    oss << "<item>"
+        << "<entry xmlns=\"http://ietf.org/protocol/bgpvpn\">\n"
+        << "  <nlri><af>1</af><safi>1</safi>"
+        << "<address>" << prefix << "</address></nlri>\n"
+        << "  <next-hops><next-hop><af>1</af><safi>1</safi>"
+        << "<address>" << nexthop << "</address>"
+        << "<label>" << label << "</label>"
+        << "<tunnel-encapsulation-list>"
+        << "<tunnel-encapsulation>gre</tunnel-encapsulation>"
+        << "<tunnel-encapsulation>udp</tunnel-encapsulation>"
+        << "</tunnel-encapsulation-list>"
+        << "</next-hop></next-hops>\n"
+        << "  <version>1</version>"
+        << "<virtual-network>blue</virtual-network>\n"
+        << "  <security-group-list><security-group>101</security-group>"
+        << "<security-group>102</security-group></security-group-list>\n"
+        << extra
+        << "</entry></item>\n";
+    return oss.str();
+}
+
+static string Iq(const string &items) {
+    return string(kIqHead) + items + kIqTail;
+}
+
+class XmppItemDecoderTest : public ::testing::Test {
+protected:
+    void DecodeInet(const string &msg, std::vector<XmppInetItem> *items,
+                    bool *failed, size_t *count) {
+        XmppItemDecoder decoder(msg.data(), msg.size());
+        XmppInetItem item;
+        while (decoder.NextItem() && decoder.DecodeInetItem(&item)) {
+            items->push_back(item);
+        }
+        *failed = decoder.failed();
+        *count = decoder.count();
+    }
+};
+
+TEST_F(XmppItemDecoderTest, Inet) {
+    string msg = Iq(InetItem("10.1.1.0/24", "192.168.1.1", 1000) +
+                    InetItem("10.1.2.3/32", "192.168.1.2", 1001));
+    std::vector<XmppInetItem> items;
+    bool failed;
+    size_t count;
+    DecodeInet(msg, &items, &failed, &count);
+    EXPECT_FALSE(failed);
+    EXPECT_EQ(2, count);
+    ASSERT_EQ(2, items.size());
+
+    EXPECT_EQ("10.1.1.0/24", items[0].prefix.ToString());
+    EXPECT_EQ(Ip4Address::from_string("192.168.1.1"), items[0].nexthop);
+    EXPECT_EQ(1000, items[0].label);
+    ASSERT_EQ(2, items[0].tunnel_encap.size());
+    EXPECT_EQ(TunnelEncapType::MPLS_O_GRE, items[0].tunnel_encap[0]);
+    EXPECT_EQ(TunnelEncapType::MPLS_O_UDP, items[0].tunnel_encap[1]);
+    ASSERT_EQ(2, items[0].security_group.size());
+    EXPECT_EQ(101, items[0].security_group[0]);
+    EXPECT_EQ(102, items[0].security_group[1]);
+
+    EXPECT_EQ("10.1.2.3/32", items[1].prefix.ToString());
+    EXPECT_EQ(Ip4Address::from_string("192.168.1.2"), items[1].nexthop);
+    EXPECT_EQ(1001, items[1].label);
+}
+
+TEST_F(XmppItemDecoderTest, InetNoNextHop) {
+    string msg = Iq("<item><entry><nlri><af>1</af>"
+                    "<address>10.1.1.0/24</address></nlri>"
+                    "<next-hops/></entry></item>");
+    std::vector<XmppInetItem> items;
+    bool failed;
+    size_t count;
+    DecodeInet(msg, &items, &failed, &count);
+    EXPECT_FALSE(failed);
+    ASSERT_EQ(1, items.size());
+    EXPECT_EQ("10.1.1.0/24", items[0].prefix.ToString());
+    EXPECT_EQ(Ip4Address(), items[0].nexthop);
+    EXPECT_EQ(0, items[0].label);
+    EXPECT_TRUE(items[0].tunnel_encap.empty());
+}
+
+TEST_F(XmppItemDecoderTest, InvalidTunnelEncap) {
+    string msg = Iq("<item><entry><nlri><af>1</af>"
+        "<address>10.1.1.0/24</address></nlri><next-hops><next-hop>"
+        "<af>1</af><address>192.168.1.1</address><label>16</label>"
+        "<tunnel-encapsulation-list>"
+        "<tunnel-encapsulation>foo</tunnel-encapsulation>"
+        "</tunnel-encapsulation-list></next-hop></next-hops>"
+        "</entry></item>");
+    std::vector<XmppInetItem> items;
+    bool failed;
+    size_t count;
+    DecodeInet(msg, &items, &failed, &count);
+    EXPECT_FALSE(failed);
+    ASSERT_EQ(1, items.size());
+    ASSERT_EQ(1, items[0].tunnel_encap.size());
+    EXPECT_EQ(TunnelEncapType::UNSPEC, items[0].tunnel_encap[0]);
+}
+
+TEST_F(XmppItemDecoderTest, NoItems) {
+    string msg = "<iq type=\"set\" from=\"agent-a\" to=\"bgp-peer\" "
+        "id=\"sub1\"><pubsub xmlns=\"http://jabber.org/protocol/pubsub\">"
+        "<subscribe node=\"blue\"><options><instance-id>1</instance-id>"
+        "</options></subscribe></pubsub></iq>";
+    XmppItemDecoder decoder(msg.data(), msg.size());
+    EXPECT_FALSE(decoder.NextItem());
+    EXPECT_FALSE(decoder.failed());
+    EXPECT_EQ(0, decoder.count());
+}
+
+TEST_F(XmppItemDecoderTest, ProcessingInstruction) {
+    string msg = "<?xml version=\"1.0\"?>\n" +
+        Iq(InetItem("10.1.1.0/24", "192.168.1.1", 1000));
+    std::vector<XmppInetItem> items;
+    bool failed;
+    size_t count;
+    DecodeInet(msg, &items, &failed, &count);
+    EXPECT_FALSE(failed);
+    EXPECT_EQ(1, items.size());
+}
+
+//
+// Markup or values that the decoder doesn't handle make it fail, after
+// decoding the items before them.
+//
+TEST_F(XmppItemDecoderTest, Fallback) {
+    const char *bad[] = {
+        "<!-- comment -->",
+        "<foo><![CDATA[bar]]></foo>",
+        "<nlri><af>1</af><address>10.1.1.0/24&#x20;</address></nlri>",
+        "<nlri><af>2</af><address>10.1.1.0/24</address></nlri>",
+        "<nlri><af>1</af><address>10.1.1/24</address></nlri>",
+        "<nlri><af>1</af><address>10.1.1.01/24</address></nlri>",
+        "<nlri><af>1</af><address>10.1.1.0/33</address></nlri>",
+        "<nlri><af> 1</af><address>10.1.1.0/24</address></nlri>",
+        "<nlri><af>1</af><address>10.1.1.0</address></nlri>",
+        "<next-hops><next-hop><af>1</af><address>1.2.3.4</address>"
+        "<label>1</label></next-hop></next-hops>",
+        "<foo></bar>",
+        "<foo>",
+        "<foo bar></foo>",
+        "<foo bar=baz></foo>",
+        "<foo bar=\"<\"></foo>",
+        "<nlri><af>1</af><address>10.1.1.0/24</nlri></address>",
+    };
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        string msg = Iq(InetItem("10.1.1.0/24", "192.168.1.1", 1000) +
+                        InetItem("10.1.2.0/24", "192.168.1.1", 1000, bad[i]) +
+                        InetItem("10.1.3.0/24", "192.168.1.1", 1000));
+        std::vector<XmppInetItem> items;
+        bool failed;
+        size_t count;
+        DecodeInet(msg, &items, &failed, &count);
+        EXPECT_TRUE(failed) << bad[i];
+        EXPECT_EQ(1, count) << bad[i];
+        EXPECT_EQ(1, items.size()) << bad[i];
+    }
+}
+
+TEST_F(XmppItemDecoderTest, Enet) {
+    string msg = Iq("<item><entry xmlns=\"http://ietf.org/protocol/bgpvpn\">"
+        "<nlri><af>25</af><safi>242</safi><mac>00:1b:2C:3d:4e:5</mac>"
+        "<address>10.1.1.1/32</address></nlri>"
+        "<next-hops><next-hop><af>1</af><address>192.168.1.1</address>"
+        "<label>32</label></next-hop></next-hops></entry></item>");
+    XmppItemDecoder decoder(msg.data(), msg.size());
+    XmppEnetItem item;
+    ASSERT_TRUE(decoder.NextItem());
+    ASSERT_TRUE(decoder.DecodeEnetItem(&item));
+    EXPECT_FALSE(decoder.NextItem());
+    EXPECT_FALSE(decoder.failed());
+    EXPECT_EQ("00:1b:2c:3d:4e:05", item.prefix.mac_addr().ToString());
+    EXPECT_EQ("10.1.1.1/32", item.prefix.ip_prefix().ToString());
+    EXPECT_EQ(Ip4Address::from_string("192.168.1.1"), item.nexthop);
+    EXPECT_EQ(32, item.label);
+
+    string bad_mac = Iq("<item><entry><nlri><af>25</af>"
+        "<mac>00:1b:2c:3d:4e</mac><address>10.1.1.1/32</address></nlri>"
+        "</entry></item>");
+    XmppItemDecoder bad_decoder(bad_mac.data(), bad_mac.size());
+    ASSERT_TRUE(bad_decoder.NextItem());
+    EXPECT_FALSE(bad_decoder.DecodeEnetItem(&item));
+    EXPECT_TRUE(bad_decoder.failed());
+    EXPECT_EQ(0, bad_decoder.count());
+}
+
+TEST_F(XmppItemDecoderTest, Mcast) {
+    string msg = Iq("<item><entry xmlns=\"http://ietf.org/protocol/bgpvpn\">"
+        "<nlri><af>1</af><safi>241</safi><group>225.0.0.1</group>"
+        "<source/><source-label>0</source-label></nlri>"
+        "<next-hops><next-hop><af>1</af><safi>241</safi>"
+        "<address>192.168.1.1</address><label>10000-19999</label>"
+        "</next-hop></next-hops></entry></item>");
+    XmppItemDecoder decoder(msg.data(), msg.size());
+    XmppMcastItem item;
+    ASSERT_TRUE(decoder.NextItem());
+    ASSERT_TRUE(decoder.DecodeMcastItem(&item));
+    EXPECT_FALSE(decoder.NextItem());
+    EXPECT_FALSE(decoder.failed());
+    EXPECT_EQ(Ip4Address::from_string("225.0.0.1"), item.group);
+    EXPECT_EQ(Ip4Address(), item.source);
+    EXPECT_EQ(Ip4Address::from_string("192.168.1.1"), item.nexthop);
+    EXPECT_EQ(10000, item.label_first);
+    EXPECT_EQ(19999, item.label_last);
+
+    string bad_label = Iq("<item><entry><nlri><af>1</af><safi>241</safi>"
+        "<group>225.0.0.1</group></nlri><next-hops><next-hop><af>1</af>"
+        "<address>192.168.1.1</address><label>10000</label>"
+        "</next-hop></next-hops></entry></item>");
+    XmppItemDecoder bad_decoder(bad_label.data(), bad_label.size());
+    ASSERT_TRUE(bad_decoder.NextItem());
+    EXPECT_FALSE(bad_decoder.DecodeMcastItem(&item));
+    EXPECT_TRUE(bad_decoder.failed());
+}
+
+int main(int argc, char **argv) {
+    LoggingInit();
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,773 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "bgp/xmpp_item_decoder.h"
+
+#include <string.h>
+#include <string>
+
+#include "net/bgp_af.h"
+#include "net/mac_address.h"
+
+using std::string;
+
+static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool IsNameChar(char c) {
+    return !IsSpace(c) && c != '<' && c != '>' && c != '/' && c != '=' &&
+        c != '"' && c != '\'' && c != '&';
+}
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline int HexValue(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+//
+// Parse a decimal number of at most max_digits digits starting at *pp and
+// advance *pp past it. Leading zeros are rejected unless allow_zeros is set,
+// the same way inet_pton rejects them in dotted quads.
+//
+static bool ParseDecimal(const char **pp, const char *end, int max_digits,
+                         bool allow_zeros, uint64_t *value) {
+    const char *p = *pp;
+    const char *start = p;
+    uint64_t result = 0;
+    while (p < end && IsDigit(*p) && p - start < max_digits) {
+        result = result * 10 + (*p - '0');
+        p++;
+    }
+    if (p == start || (p < end && IsDigit(*p)))
+        return false;
+    if (!allow_zeros && *start == '0' && p - start > 1)
+        return false;
+    *pp = p;
+    *value = result;
+    return true;
+}
+
+static bool ParseIp4(const char **pp, const char *end, Ip4Address *addr) {
+    uint32_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        if (i > 0) {
+            if (*pp == end || **pp != '.')
+                return false;
+            (*pp)++;
+        }
+        uint64_t octet;
+        if (!ParseDecimal(pp, end, 3, false, &octet) || octet > 255)
+            return false;
+        result = (result << 8) | octet;
+    }
+    *addr = Ip4Address(result);
+    return true;
+}
+
+static bool ParseIp4Address(const char *text, size_t len, Ip4Address *addr) {
+    const char *p = text;
+    return ParseIp4(&p, text + len, addr) && p == text + len;
+}
+
+static bool ParseIp4Prefix(const char *text, size_t len, Ip4Prefix *prefix) {
+    const char *p = text;
+    const char *end = text + len;
+    Ip4Address addr;
+    uint64_t plen;
+    if (!ParseIp4(&p, end, &addr) || p == end || *p++ != '/')
+        return false;
+    if (!ParseDecimal(&p, end, 2, true, &plen) || plen > 32 || p != end)
+        return false;
+    *prefix = Ip4Prefix(addr, plen);
+    return true;
+}
+
+static bool ParseMacAddress(const char *text, size_t len, MacAddress *mac) {
+    const char *p = text;
+    const char *end = text + len;
+    uint8_t data[MacAddress::kSize];
+    for (int i = 0; i < MacAddress::kSize; i++) {
+        if (i > 0) {
+            if (p == end || *p != ':')
+                return false;
+            p++;
+        }
+        if (p == end || HexValue(*p) < 0)
+            return false;
+        data[i] = HexValue(*p++);
+        if (p < end && HexValue(*p) >= 0)
+            data[i] = (data[i] << 4) | HexValue(*p++);
+    }
+    if (p != end)
+        return false;
+    *mac = MacAddress(data);
+    return true;
+}
+
+// Parse a label range of the form <first>-<last>.
+static bool ParseLabelRange(const char *text, size_t len,
+                            uint32_t *first, uint32_t *last) {
+    const char *p = text;
+    const char *end = text + len;
+    uint64_t value1, value2;
+    if (!ParseDecimal(&p, end, 9, true, &value1) || p == end || *p++ != '-')
+        return false;
+    if (!ParseDecimal(&p, end, 9, true, &value2) || p != end)
+        return false;
+    *first = value1;
+    *last = value2;
+    return true;
+}
+
+XmppInetItem::XmppInetItem() {
+    Clear();
+}
+
+void XmppInetItem::Clear() {
+    prefix = Ip4Prefix();
+    nexthop = Ip4Address();
+    label = 0;
+    tunnel_encap.clear();
+    security_group.clear();
+}
+
+XmppEnetItem::XmppEnetItem() {
+    Clear();
+}
+
+void XmppEnetItem::Clear() {
+    prefix = EnetPrefix();
+    nexthop = Ip4Address();
+    label = 0;
+}
+
+XmppMcastItem::XmppMcastItem() {
+    Clear();
+}
+
+void XmppMcastItem::Clear() {
+    group = Ip4Address();
+    source = Ip4Address();
+    nexthop = Ip4Address();
+    label_first = 0;
+    label_last = 0;
+}
+
+struct XmppItemDecoder::Tag {
+    enum Kind {
+        START,
+        EMPTY,
+        END
+    };
+
+    bool NameIs(const char *str) const {
+        return len == strlen(str) && memcmp(name, str, len) == 0;
+    }
+
+    Kind kind;
+    const char *name;
+    size_t len;
+};
+
+XmppItemDecoder::XmppItemDecoder(const char *data, size_t size)
+    : pos_(data), end_(data + size), started_(false), failed_(false),
+      count_(0) {
+}
+
+bool XmppItemDecoder::Fail() {
+    failed_ = true;
+    return false;
+}
+
+//
+// Read the next tag, skipping any text before it as well as processing
+// instructions. Only the envelope of the stanza has been parsed by the DOM,
+// so the decoder checks that end tags match their start tags and that the
+// attributes are well formed, although it doesn't look at them.
+//
+bool XmppItemDecoder::ReadTag(Tag *tag) {
+    while (true) {
+        const char *p = static_cast<const char *>(
+            memchr(pos_, '<', end_ - pos_));
+        if (p == NULL || ++p == end_)
+            return Fail();
+
+        if (*p == '!')
+            return Fail();
+        if (*p == '?') {
+            const char *pi_end = p;
+            do {
+                pi_end = static_cast<const char *>(
+                    memchr(pi_end + 1, '>', end_ - pi_end - 1));
+            } while (pi_end != NULL && pi_end[-1] != '?');
+            if (pi_end == NULL)
+                return Fail();
+            pos_ = pi_end + 1;
+            continue;
+        }
+
+        tag->kind = Tag::START;
+        if (*p == '/') {
+            tag->kind = Tag::END;
+            p++;
+        }
+        tag->name = p;
+        while (p < end_ && IsNameChar(*p))
+            p++;
+        tag->len = p - tag->name;
+        if (tag->len == 0)
+            return Fail();
+
+        if (tag->kind == Tag::END) {
+            while (p < end_ && IsSpace(*p))
+                p++;
+            if (p == end_ || *p != '>' || open_tags_.empty())
+                return Fail();
+            const OpenTag &open = open_tags_.back();
+            if (open.second != tag->len ||
+                memcmp(open.first, tag->name, tag->len) != 0)
+                return Fail();
+            open_tags_.pop_back();
+            pos_ = p + 1;
+            return true;
+        }
+
+        while (true) {
+            while (p < end_ && IsSpace(*p))
+                p++;
+            if (p == end_)
+                return Fail();
+            if (*p == '>') {
+                open_tags_.push_back(OpenTag(tag->name, tag->len));
+                pos_ = p + 1;
+                return true;
+            }
+            if (*p == '/') {
+                if (++p == end_ || *p != '>')
+                    return Fail();
+                tag->kind = Tag::EMPTY;
+                pos_ = p + 1;
+                return true;
+            }
+
+            // Attribute, name="value" or name='value'.
+            const char *attr = p;
+            while (p < end_ && IsNameChar(*p))
+                p++;
+            if (p == attr)
+                return Fail();
+            while (p < end_ && IsSpace(*p))
+                p++;
+            if (p == end_ || *p++ != '=')
+                return Fail();
+            while (p < end_ && IsSpace(*p))
+                p++;
+            if (p == end_ || (*p != '"' && *p != '\''))
+                return Fail();
+            char quote = *p++;
+            const char *value_end = static_cast<const char *>(
+                memchr(p, quote, end_ - p));
+            if (value_end == NULL || memchr(p, '<', value_end - p) != NULL)
+                return Fail();
+            p = value_end + 1;
+        }
+    }
+}
+
+//
+// Read the next child element of the current element. Returns false at the
+// end tag of the current element or if the decoder failed.
+//
+bool XmppItemDecoder::NextChild(Tag *tag) {
+    if (!ReadTag(tag))
+        return false;
+    return tag->kind != Tag::END;
+}
+
+bool XmppItemDecoder::SkipElement(const Tag &tag) {
+    if (tag.kind == Tag::EMPTY)
+        return true;
+    int depth = 1;
+    Tag next;
+    while (depth > 0) {
+        if (!ReadTag(&next))
+            return false;
+        if (next.kind == Tag::START) {
+            depth++;
+        } else if (next.kind == Tag::END) {
+            depth--;
+        }
+    }
+    return true;
+}
+
+//
+// Read the text content of a leaf element, up to and including its end tag.
+// Entity references would have to be expanded, so they aren't handled.
+//
+bool XmppItemDecoder::ReadText(const Tag &tag, const char **text,
+                               size_t *len) {
+    *text = pos_;
+    *len = 0;
+    if (tag.kind == Tag::EMPTY)
+        return true;
+
+    const char *p = static_cast<const char *>(memchr(pos_, '<', end_ - pos_));
+    if (p == NULL)
+        return Fail();
+    *len = p - pos_;
+    if (memchr(*text, '&', *len) != NULL)
+        return Fail();
+
+    Tag end;
+    if (!ReadTag(&end))
+        return false;
+    if (end.kind != Tag::END)
+        return Fail();
+    return true;
+}
+
+bool XmppItemDecoder::ReadInteger(const Tag &tag, uint32_t *value) {
+    const char *text;
+    size_t len;
+    if (!ReadText(tag, &text, &len))
+        return false;
+    const char *p = text;
+    uint64_t result;
+    if (!ParseDecimal(&p, text + len, 9, true, &result) || p != text + len)
+        return Fail();
+    *value = result;
+    return true;
+}
+
+bool XmppItemDecoder::ReadAddress(const Tag &tag, Ip4Address *addr) {
+    const char *text;
+    size_t len;
+    if (!ReadText(tag, &text, &len))
+        return false;
+    if (!ParseIp4Address(text, len, addr))
+        return Fail();
+    return true;
+}
+
+//
+// Position the decoder at the next item element. The first item is the
+// first element called item anywhere in the document and the following
+// ones are its siblings with the same name, which is how the DOM based
+// code finds them.
+//
+bool XmppItemDecoder::NextItem() {
+    if (failed_)
+        return false;
+
+    Tag tag;
+    if (!started_) {
+        started_ = true;
+        do {
+            // No items at all.
+            if (memchr(pos_, '<', end_ - pos_) == NULL)
+                return false;
+            if (!ReadTag(&tag))
+                return false;
+        } while (tag.kind == Tag::END || !tag.NameIs("item"));
+    } else {
+        while (true) {
+            if (!NextChild(&tag))
+                return false;
+            if (tag.NameIs("item"))
+                break;
+            if (!SkipElement(tag))
+                return false;
+        }
+    }
+
+    if (tag.kind != Tag::START)
+        return Fail();
+    return true;
+}
+
+//
+// Read up to the start tag of the entry element of the current item.
+//
+bool XmppItemDecoder::EnterEntry() {
+    Tag tag;
+    while (NextChild(&tag)) {
+        if (tag.NameIs("entry")) {
+            if (tag.kind != Tag::START)
+                return Fail();
+            return true;
+        }
+        if (!SkipElement(tag))
+            return false;
+    }
+    return Fail();
+}
+
+//
+// Read past the end tag of the current item, once its entry is decoded.
+//
+bool XmppItemDecoder::LeaveItem() {
+    Tag tag;
+    if (NextChild(&tag))
+        return Fail();
+    if (failed_)
+        return false;
+    count_++;
+    return true;
+}
+
+bool XmppItemDecoder::DecodeInetItem(XmppInetItem *item) {
+    item->Clear();
+    if (!EnterEntry())
+        return false;
+
+    bool nlri = false;
+    int nexthops = 0;
+    Tag tag;
+    while (NextChild(&tag)) {
+        if (tag.NameIs("nlri")) {
+            if (!DecodeInetNlri(tag, item))
+                return false;
+            nlri = true;
+        } else if (tag.NameIs("next-hops") && tag.kind == Tag::START) {
+            Tag child;
+            while (NextChild(&child)) {
+                if (!child.NameIs("next-hop")) {
+                    if (!SkipElement(child))
+                        return false;
+                    continue;
+                }
+                if (++nexthops > 1 || !DecodeInetNextHop(child, item))
+                    return Fail();
+            }
+            if (failed_)
+                return false;
+        } else if (tag.NameIs("security-group-list") &&
+                   tag.kind == Tag::START) {
+            if (!DecodeSecurityGroupList(item))
+                return false;
+        } else if (!SkipElement(tag)) {
+            return false;
+        }
+    }
+    if (failed_ || !nlri)
+        return Fail();
+    return LeaveItem();
+}
+
+bool XmppItemDecoder::DecodeInetNlri(const Tag &tag, XmppInetItem *item) {
+    if (tag.kind != Tag::START)
+        return Fail();
+
+    uint32_t af = 0;
+    bool address = false;
+    Tag child;
+    while (NextChild(&child)) {
+        if (child.NameIs("af")) {
+            if (!ReadInteger(child, &af))
+                return false;
+        } else if (child.NameIs("address")) {
+            const char *text;
+            size_t len;
+            if (!ReadText(child, &text, &len))
+                return false;
+            if (!ParseIp4Prefix(text, len, &item->prefix))
+                return Fail();
+            address = true;
+        } else if (!SkipElement(child)) {
+            return false;
+        }
+    }
+    if (failed_ || af != BgpAf::IPv4 || !address)
+        return Fail();
+    return true;
+}
+
+bool XmppItemDecoder::DecodeInetNextHop(const Tag &tag, XmppInetItem *item) {
+    if (tag.kind != Tag::START)
+        return Fail();
+
+    uint32_t af = 0;
+    bool address = false;
+    bool label = false;
+    Tag child;
+    while (NextChild(&child)) {
+        if (child.NameIs("af")) {
+            if (!ReadInteger(child, &af))
+                return false;
+        } else if (child.NameIs("address")) {
+            if (!ReadAddress(child, &item->nexthop))
+                return false;
+            address = true;
+        } else if (child.NameIs("label")) {
+            if (!ReadInteger(child, &item->label))
+                return false;
+            label = true;
+        } else if (child.NameIs("tunnel-encapsulation-list") &&
+                   child.kind == Tag::START) {
+            if (!DecodeTunnelEncapList(item))
+                return false;
+        } else if (!SkipElement(child)) {
+            return false;
+        }
+    }
+    if (failed_ || af != BgpAf::IPv4 || !address || !label)
+        return Fail();
+    return true;
+}
+
+bool XmppItemDecoder::DecodeTunnelEncapList(XmppInetItem *item) {
+    item->tunnel_encap.clear();
+    Tag child;
+    while (NextChild(&child)) {
+        if (!child.NameIs("tunnel-encapsulation")) {
+            if (!SkipElement(child))
+                return false;
+            continue;
+        }
+        const char *text;
+        size_t len;
+        if (!ReadText(child, &text, &len))
+            return false;
+        item->tunnel_encap.push_back(
+            TunnelEncapType::TunnelEncapFromString(string(text, len)));
+    }
+    return !failed_;
+}
+
+bool XmppItemDecoder::DecodeSecurityGroupList(XmppInetItem *item) {
+    item->security_group.clear();
+    Tag child;
+    while (NextChild(&child)) {
+        if (!child.NameIs("security-group")) {
+            if (!SkipElement(child))
+                return false;
+            continue;
+        }
+        uint32_t sg;
+        if (!ReadInteger(child, &sg))
+            return false;
+        item->security_group.push_back(sg);
+    }
+    return !failed_;
+}
+
+bool XmppItemDecoder::DecodeEnetItem(XmppEnetItem *item) {
+    item->Clear();
+    if (!EnterEntry())
+        return false;
+
+    bool nlri = false;
+    int nexthops = 0;
+    Tag tag;
+    while (NextChild(&tag)) {
+        if (tag.NameIs("nlri")) {
+            if (!DecodeEnetNlri(tag, item))
+                return false;
+            nlri = true;
+        } else if (tag.NameIs("next-hops") && tag.kind == Tag::START) {
+            Tag child;
+            while (NextChild(&child)) {
+                if (!child.NameIs("next-hop")) {
+                    if (!SkipElement(child))
+                        return false;
+                    continue;
+                }
+                if (++nexthops > 1 || !DecodeEnetNextHop(child, item))
+                    return Fail();
+            }
+            if (failed_)
+                return false;
+        } else if (!SkipElement(tag)) {
+            return false;
+        }
+    }
+    if (failed_ || !nlri)
+        return Fail();
+    return LeaveItem();
+}
+
+bool XmppItemDecoder::DecodeEnetNlri(const Tag &tag, XmppEnetItem *item) {
+    if (tag.kind != Tag::START)
+        return Fail();
+
+    uint32_t af = 0;
+    MacAddress mac;
+    Ip4Prefix prefix;
+    bool has_mac = false;
+    bool has_address = false;
+    Tag child;
+    while (NextChild(&child)) {
+        const char *text;
+        size_t len;
+        if (child.NameIs("af")) {
+            if (!ReadInteger(child, &af))
+                return false;
+        } else if (child.NameIs("mac")) {
+            if (!ReadText(child, &text, &len))
+                return false;
+            if (!ParseMacAddress(text, len, &mac))
+                return Fail();
+            has_mac = true;
+        } else if (child.NameIs("address")) {
+            if (!ReadText(child, &text, &len))
+                return false;
+            if (!ParseIp4Prefix(text, len, &prefix))
+                return Fail();
+            has_address = true;
+        } else if (!SkipElement(child)) {
+            return false;
+        }
+    }
+    if (failed_ || af != BgpAf::L2Vpn || !has_mac || !has_address)
+        return Fail();
+    item->prefix = EnetPrefix(mac, prefix);
+    return true;
+}
+
+bool XmppItemDecoder::DecodeEnetNextHop(const Tag &tag, XmppEnetItem *item) {
+    if (tag.kind != Tag::START)
+        return Fail();
+
+    uint32_t af = 0;
+    bool address = false;
+    bool label = false;
+    Tag child;
+    while (NextChild(&child)) {
+        if (child.NameIs("af")) {
+            if (!ReadInteger(child, &af))
+                return false;
+        } else if (child.NameIs("address")) {
+            if (!ReadAddress(child, &item->nexthop))
+                return false;
+            address = true;
+        } else if (child.NameIs("label")) {
+            if (!ReadInteger(child, &item->label))
+                return false;
+            label = true;
+        } else if (!SkipElement(child)) {
+            return false;
+        }
+    }
+    if (failed_ || af != BgpAf::IPv4 || !address || !label)
+        return Fail();
+    return true;
+}
+
+bool XmppItemDecoder::DecodeMcastItem(XmppMcastItem *item) {
+    item->Clear();
+    if (!EnterEntry())
+        return false;
+
+    bool nlri = false;
+    int nexthops = 0;
+    Tag tag;
+    while (NextChild(&tag)) {
+        if (tag.NameIs("nlri")) {
+            if (!DecodeMcastNlri(tag, item))
+                return false;
+            nlri = true;
+        } else if (tag.NameIs("next-hops") && tag.kind == Tag::START) {
+            Tag child;
+            while (NextChild(&child)) {
+                if (!child.NameIs("next-hop")) {
+                    if (!SkipElement(child))
+                        return false;
+                    continue;
+                }
+                if (++nexthops > 1 || !DecodeMcastNextHop(child, item))
+                    return Fail();
+            }
+            if (failed_)
+                return false;
+        } else if (!SkipElement(tag)) {
+            return false;
+        }
+    }
+
+    // Multicast items always have exactly one next-hop.
+    if (failed_ || !nlri || nexthops != 1)
+        return Fail();
+    return LeaveItem();
+}
+
+bool XmppItemDecoder::DecodeMcastNlri(const Tag &tag, XmppMcastItem *item) {
+    if (tag.kind != Tag::START)
+        return Fail();
+
+    uint32_t af = 0;
+    uint32_t safi = 0;
+    Tag child;
+    while (NextChild(&child)) {
+        const char *text;
+        size_t len;
+        if (child.NameIs("af")) {
+            if (!ReadInteger(child, &af))
+                return false;
+        } else if (child.NameIs("safi")) {
+            if (!ReadInteger(child, &safi))
+                return false;
+        } else if (child.NameIs("group") || child.NameIs("source")) {
+            Ip4Address *addr =
+                child.NameIs("group") ? &item->group : &item->source;
+            if (!ReadText(child, &text, &len))
+                return false;
+            if (len == 0) {
+                *addr = Ip4Address();
+            } else if (!ParseIp4Address(text, len, addr)) {
+                return Fail();
+            }
+        } else if (!SkipElement(child)) {
+            return false;
+        }
+    }
+    if (failed_ || af != BgpAf::IPv4 || safi != BgpAf::Mcast)
+        return Fail();
+    return true;
+}
+
+bool XmppItemDecoder::DecodeMcastNextHop(const Tag &tag,
+                                         XmppMcastItem *item) {
+    if (tag.kind != Tag::START)
+        return Fail();
+
+    uint32_t af = 0;
+    bool address = false;
+    bool label = false;
+    Tag child;
+    while (NextChild(&child)) {
+        if (child.NameIs("af")) {
+            if (!ReadInteger(child, &af))
+                return false;
+        } else if (child.NameIs("address")) {
+            if (!ReadAddress(child, &item->nexthop))
+                return false;
+            address = true;
+        } else if (child.NameIs("label")) {
+            const char *text;
+            size_t len;
+            if (!ReadText(child, &text, &len))
+                return false;
+            if (!ParseLabelRange(text, len, &item->label_first,
+                                 &item->label_last))
+                return Fail();
+            label = true;
+        } else if (!SkipElement(child)) {
+            return false;
+        }
+    }
+    if (failed_ || af != BgpAf::IPv4 || !address || !label)
+        return Fail();
+    return true;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_xmpp_item_decoder_h
+#define ctrlplane_xmpp_item_decoder_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "base/util.h"
+#include "bgp/enet/enet_route.h"
+#include "bgp/inet/inet_route.h"
+#include "net/address.h"
+#include "net/tunnel_encap_type.h"
+
+//
+// Route items published by an agent, as described by xmpp_unicast.xsd,
+// xmpp_enet.xsd and xmpp_multicast.xsd, with the addresses and labels
+// already converted to their binary form. The next-hop and label are
+// zero if the item doesn't have a next-hop.
+//
+struct XmppInetItem {
+    XmppInetItem();
+    void Clear();
+
+    Ip4Prefix prefix;
+    Ip4Address nexthop;
+    uint32_t label;
+    std::vector<TunnelEncapType::Encap> tunnel_encap;
+    std::vector<int> security_group;
+};
+
+struct XmppEnetItem {
+    XmppEnetItem();
+    void Clear();
+
+    EnetPrefix prefix;
+    Ip4Address nexthop;
+    uint32_t label;
+};
+
+struct XmppMcastItem {
+    XmppMcastItem();
+    void Clear();
+
+    Ip4Address group;
+    Ip4Address source;
+    Ip4Address nexthop;
+    uint32_t label_first;
+    uint32_t label_last;
+};
+
+//
+// Decodes the items of a publish request straight from the bytes of the
+// stanza, without building a DOM.
+//
+// Only the markup that agents actually send is understood. The decoder
+// gives up on anything else - comments, CDATA sections, entity references,
+// values that don't parse or that the channel would reject - and leaves it
+// to the DOM based code, which also takes care of logging errors. Markup
+// that isn't well formed makes it fail as well, since only the envelope of
+// the stanza has been parsed by the DOM. Once the decoder fails, failed()
+// returns true and count() is the number of items that were decoded
+// successfully, so that the caller can resume with the DOM at the next item.
+//
+class XmppItemDecoder {
+public:
+    XmppItemDecoder(const char *data, size_t size);
+
+    // Position the decoder at the next item element. Returns false at the
+    // end of the items or if the decoder failed.
+    bool NextItem();
+
+    // Decode the item that the decoder is positioned at.
+    bool DecodeInetItem(XmppInetItem *item);
+    bool DecodeEnetItem(XmppEnetItem *item);
+    bool DecodeMcastItem(XmppMcastItem *item);
+
+    bool failed() const { return failed_; }
+    size_t count() const { return count_; }
+
+private:
+    struct Tag;
+    typedef std::pair<const char *, size_t> OpenTag;
+
+    bool Fail();
+    bool ReadTag(Tag *tag);
+    bool NextChild(Tag *tag);
+    bool SkipElement(const Tag &tag);
+    bool ReadText(const Tag &tag, const char **text, size_t *len);
+    bool ReadInteger(const Tag &tag, uint32_t *value);
+    bool ReadAddress(const Tag &tag, Ip4Address *addr);
+    bool EnterEntry();
+    bool LeaveItem();
+
+    bool DecodeInetNlri(const Tag &tag, XmppInetItem *item);
+    bool DecodeInetNextHop(const Tag &tag, XmppInetItem *item);
+    bool DecodeTunnelEncapList(XmppInetItem *item);
+    bool DecodeSecurityGroupList(XmppInetItem *item);
+    bool DecodeEnetNlri(const Tag &tag, XmppEnetItem *item);
+    bool DecodeEnetNextHop(const Tag &tag, XmppEnetItem *item);
+    bool DecodeMcastNlri(const Tag &tag, XmppMcastItem *item);
+    bool DecodeMcastNextHop(const Tag &tag, XmppMcastItem *item);
+
+    const char *pos_;
+    const char *end_;
+    bool started_;
+    bool failed_;
+    size_t count_;
+    std::vector<OpenTag> open_tags_;
+
+    DISALLOW_COPY_AND_ASSIGN(XmppItemDecoder);
+};
+
+#endif
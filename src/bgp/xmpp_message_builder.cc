@@ -38,8 +38,12 @@ public:
     virtual bool AddRoute(const BgpRoute *route, const RibOutAttr *roattr);
     virtual void Finish() { }
     virtual const uint8_t *GetData(IPeerUpdate *peer, size_t *lenp);
+    virtual bool GetBuffers(IPeerUpdate *peer,
+                            IPeerUpdate::BufferList *buffers);
 
 private:
+    void EncodeRepr(const string &to);
+
     void EncodeNextHop(const BgpRoute *route, RibOutAttr::NextHop nexthop,
                        autogen::ItemType &item);
     void AddInetReach(const BgpRoute *route, const RibOutAttr *roattr);
@@ -85,6 +89,7 @@ private:
     std::vector<int> security_group_list_;
     string repr_;
     string repr_new_;
+    string repr_to_;
     size_t repr_part1_;
     size_t repr_part2_;
     DISALLOW_COPY_AND_ASSIGN(BgpXmppMessage);
@@ -292,24 +297,17 @@ bool BgpXmppMessage::AddMcastRoute(const BgpRoute *route, const RibOutAttr *roat
     return true;
 }
 
-const uint8_t *BgpXmppMessage::GetData(IPeerUpdate *peer, size_t *lenp) {
-    std::string str = peer->ToString() + "/" + XmppInit::kBgpPeer;
-
-    // If the message has already been constructed, just replace the 'to' part.
-    if (!repr_.empty()) {
-        repr_new_ = string(repr_, 0, repr_part1_) + "to=\"" + str + "\">" +
-                    string(repr_, repr_part2_);
-
-        *lenp = repr_new_.size();
-        return reinterpret_cast<const uint8_t *>(repr_new_.c_str());
-    }
-
+//
+// Serialize the DOM tree with the given 'to' attribute and remember where
+// the attribute is, so that it can be replaced for other peers.
+//
+void BgpXmppMessage::EncodeRepr(const string &to) {
     xml_node message =  xdoc_.child("message");
     xml_attribute attr_to = message.attribute("to");
     if (!attr_to) {
         attr_to = message.append_attribute("to");
     }
-    attr_to.set_value(str.c_str());
+    attr_to.set_value(to.c_str());
     ostringstream oss;
     xdoc_.save(oss);
     repr_ = oss.str();
@@ -318,11 +316,47 @@ const uint8_t *BgpXmppMessage::GetData(IPeerUpdate *peer, size_t *lenp) {
     assert(repr_part1_ != string::npos);
     repr_part2_ = repr_.find("\n\t<event xmlns");
     assert(repr_part2_ != string::npos);
+}
+
+const uint8_t *BgpXmppMessage::GetData(IPeerUpdate *peer, size_t *lenp) {
+    std::string str = peer->ToString() + "/" + XmppInit::kBgpPeer;
+
+    // If the message has already been constructed, just replace the 'to' part.
+    if (!repr_.empty()) {
+        repr_new_ = string(repr_, 0, repr_part1_) + "to=\"" + str + "\">" +
+                    string(repr_, repr_part2_);
+
+        *lenp = repr_new_.size();
+        return reinterpret_cast<const uint8_t *>(repr_new_.c_str());
+    }
 
+    EncodeRepr(str);
     *lenp = repr_.size();
     return reinterpret_cast<const uint8_t *>(repr_.c_str());
 }
 
+//
+// The message for a peer is the serialized message with the 'to' attribute
+// replaced. Return the parts before and after the attribute, which are the
+// same for all peers, and the attribute for this peer as separate buffers.
+//
+bool BgpXmppMessage::GetBuffers(IPeerUpdate *peer,
+                                IPeerUpdate::BufferList *buffers) {
+    std::string str = peer->ToString() + "/" + XmppInit::kBgpPeer;
+    if (repr_.empty()) {
+        EncodeRepr(str);
+    }
+
+    repr_to_ = "to=\"" + str + "\">";
+    buffers->clear();
+    buffers->push_back(boost::asio::const_buffer(repr_.data(), repr_part1_));
+    buffers->push_back(
+        boost::asio::const_buffer(repr_to_.data(), repr_to_.size()));
+    buffers->push_back(boost::asio::const_buffer(
+        repr_.data() + repr_part2_, repr_.size() - repr_part2_));
+    return true;
+}
+
 Message *BgpXmppMessageBuilder::Create(const BgpTable *table,
                                        const RibOutAttr *roattr,
                                        const BgpRoute *route) const {
@@ -2,6 +2,8 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <algorithm>
+#include <limits>
 #include <tbb/mutex.h>
 #include "base/util.h"
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -10,25 +12,54 @@
 
 using namespace std;
 
+// A listener may set a NULL state to hold on to a deleted entry. Such a
+// state is stored as a pointer to this object so that an empty slot can be
+// told apart from it.
+static DBState null_state;
+
+static DBState *FromSlot(DBState *slot) {
+    return slot == &null_state ? NULL : slot;
+}
+
+void DBEntryBase::GrowState(DBTablePartBase *tpart, ListenerId listener) {
+    size_t size = static_cast<size_t>(listener) + 1;
+    assert(size <= std::numeric_limits<uint16_t>::max());
+    DBState **state = new DBState *[size];
+    std::copy(state_, state_ + state_size_, state);
+    std::fill(state + state_size_, state + size, static_cast<DBState *>(NULL));
+    delete [] state_;
+    tpart->state_memory_ += (size - state_size_) * sizeof(DBState *);
+    state_ = state;
+    state_size_ = size;
+}
+
+void DBEntryBase::FreeState(DBTablePartBase *tpart) {
+    tpart->state_memory_ -= state_size_ * sizeof(DBState *);
+    delete [] state_;
+    state_ = NULL;
+    state_size_ = 0;
+}
+
 void DBEntryBase::SetState(DBTableBase *tbl_base, ListenerId listener,
                            DBState *state) {
     DBTablePartBase *tpart = tbl_base->GetTablePartition(this);
     tbb::mutex::scoped_lock lock(tpart->dbstate_mutex());
-    pair<StateMap::iterator, bool> res = state_.insert(
-        make_pair(listener, state));
-    if (!res.second) {
-        res.first->second = state;
-    } else {
+    if ((size_t) listener >= state_size_) {
+        GrowState(tpart, listener);
+    }
+    if (state_[listener] == NULL) {
         assert(!IsDeleted());
+        state_count_++;
+        tpart->state_count_++;
     }
+    state_[listener] = state ? state : &null_state;
 }
 
 DBState *DBEntryBase::GetState(DBTableBase *tbl_base, ListenerId listener) {
     DBTablePartBase *tpart = tbl_base->GetTablePartition(this);
     tbb::mutex::scoped_lock lock(tpart->dbstate_mutex());
-    StateMap::iterator loc = state_.find(listener);
-    if (loc != state_.end()) {
-        return loc->second;
+    if ((size_t) listener < state_size_) {
+        return FromSlot(state_[listener]);
     }
     return NULL;
 }
@@ -38,9 +69,8 @@ const DBState *DBEntryBase::GetState(const DBTableBase *tbl_base,
     DBTableBase *table = const_cast<DBTableBase *>(tbl_base);
     DBTablePartBase *tpart = table->GetTablePartition(this);
     tbb::mutex::scoped_lock lock(tpart->dbstate_mutex());
-    StateMap::const_iterator loc = state_.find(listener);
-    if (loc != state_.end()) {
-        return loc->second;
+    if ((size_t) listener < state_size_) {
+        return FromSlot(state_[listener]);
     }
     return NULL;
 }
@@ -48,16 +78,32 @@ const DBState *DBEntryBase::GetState(const DBTableBase *tbl_base,
 void DBEntryBase::ClearState(DBTableBase *tbl_base, ListenerId listener) {
     DBTablePartBase *tpart = tbl_base->GetTablePartition(this);
     tbb::mutex::scoped_lock lock(tpart->dbstate_mutex());
-    state_.erase(listener);
-    if (state_.empty() && IsDeleted() && !is_onlist()) {
+    if ((size_t) listener < state_size_ && state_[listener] != NULL) {
+        state_[listener] = NULL;
+        state_count_--;
+        tpart->state_count_--;
+        if (state_count_ == 0) {
+            FreeState(tpart);
+        }
+    }
+    if (state_count_ == 0 && IsDeleted() && !is_onlist()) {
         assert(!IsOnRemoveQ());
         tbl_base->EnqueueRemove(this);
     }
 }
 
+void DBEntryBase::ReleaseState(DBTablePartBase *tpart) {
+    tbb::mutex::scoped_lock lock(tpart->dbstate_mutex());
+    if (state_ != NULL) {
+        tpart->state_count_ -= state_count_;
+        state_count_ = 0;
+        FreeState(tpart);
+    }
+}
+
 bool DBEntryBase::is_state_empty(DBTablePartBase *tpart) {
     tbb::mutex::scoped_lock lock(tpart->dbstate_mutex());
-    return state_.empty(); 
+    return state_count_ == 0;
 }
 
 void DBEntryBase::set_last_change_at_to_now() {
@@ -22,9 +22,11 @@ public:
     typedef DBTableBase::ListenerId ListenerId;
     typedef std::auto_ptr<DBRequestKey> KeyPtr;
 
-    DBEntryBase() : table_(NULL), flags(0), last_change_at_(UTCTimestampUsec()) {
+    DBEntryBase()
+        : table_(NULL), state_(NULL), state_size_(0), state_count_(0),
+          flags(0), last_change_at_(UTCTimestampUsec()) {
     }
-    virtual ~DBEntryBase() { }
+    virtual ~DBEntryBase() { delete [] state_; }
     virtual std::string ToString() const = 0;
     virtual KeyPtr GetDBRequestKey() const = 0;
     virtual bool IsMoreSpecific(const std::string &match) const {
@@ -37,6 +39,12 @@ public:
     const DBState *GetState(const DBTableBase *tbl_base,
                             ListenerId listener) const;
     bool is_state_empty(DBTablePartBase *tpart);
+    // Release the state storage of an entry that is removed from its
+    // partition. Listeners that unregistered may have left state behind.
+    void ReleaseState(DBTablePartBase *tpart);
+
+    // Bytes allocated outside of the entry to store listener state.
+    size_t state_memory() const { return state_size_ * sizeof(DBState *); }
 
     void MarkDelete() { flags |= DeleteMarked; }
     void ClearDelete() { flags &= ~DeleteMarked; }
@@ -66,9 +74,16 @@ private:
         DeleteMarked = 1 << 1,
         OnRemoveQ    = 1 << 2,
     };
-    typedef std::map<ListenerId, DBState *> StateMap;
+    void GrowState(DBTablePartBase *tpart, ListenerId listener);
+    void FreeState(DBTablePartBase *tpart);
+
     DBTableBase *table_;
-    StateMap state_;
+    // Listener state indexed by ListenerId. Sized to the highest listener
+    // that set state on the entry, grown on demand and released when the
+    // last state is cleared.
+    DBState **state_;
+    uint16_t state_size_;
+    uint16_t state_count_;
     uint8_t flags;
     uint64_t last_change_at_; // time at which entry was last 'changed'
     DISALLOW_COPY_AND_ASSIGN(DBEntryBase);
@@ -89,6 +104,12 @@ public:
     // Comparator used in Tree management 
     virtual bool IsLess(const DBEntry &rhs) const = 0;
 
+    // 64-bit prefix of the key used by the B-tree partition storage to
+    // order entries without calling IsLess. Must be consistent with IsLess:
+    // if a.SortKey() < b.SortKey(), a must be less than b. Entries with the
+    // same SortKey are ordered using IsLess.
+    virtual uint64_t SortKey() const { return 0; }
+
     bool operator<(const DBEntry &rhs) const {
         return IsLess(rhs);
     }
@@ -0,0 +1,458 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "db/db_entry_btree.h"
+
+#include <assert.h>
+
+#include "db/db_entry.h"
+
+struct DBEntryBTree::Node {
+    Node() : count(0) { }
+    int count;
+};
+
+struct DBEntryBTree::LeafNode : public DBEntryBTree::Node {
+    LeafNode() : next(NULL), prev(NULL) { }
+    uint64_t keys[kLeafSlots];
+    DBEntry *entries[kLeafSlots];
+    LeafNode *next;
+    LeafNode *prev;
+};
+
+// Slot 0 of keys/entries is not used. For i > 0, keys[i]/entries[i] is the
+// smallest entry in the subtree rooted at children[i].
+struct DBEntryBTree::InnerNode : public DBEntryBTree::Node {
+    uint64_t keys[kInnerSlots];
+    DBEntry *entries[kInnerSlots];
+    Node *children[kInnerSlots];
+};
+
+// Inner nodes traversed from the root to a leaf along with the index of
+// the child taken at each level.
+struct DBEntryBTree::Path {
+    InnerNode *node[kMaxDepth];
+    int index[kMaxDepth];
+};
+
+DBEntryBTree::DBEntryBTree()
+    : root_(NULL), height_(0), first_leaf_(NULL), size_(0), leaf_count_(0),
+      inner_count_(0), hint_leaf_(NULL), hint_pos_(0) {
+}
+
+DBEntryBTree::~DBEntryBTree() {
+    if (root_ != NULL) {
+        DeleteNode(root_, height_);
+    }
+}
+
+void DBEntryBTree::DeleteNode(Node *node, int height) {
+    if (height == 0) {
+        delete static_cast<LeafNode *>(node);
+        return;
+    }
+    InnerNode *inner = static_cast<InnerNode *>(node);
+    for (int i = 0; i < inner->count; i++) {
+        DeleteNode(inner->children[i], height - 1);
+    }
+    delete inner;
+}
+
+int DBEntryBTree::Compare(uint64_t lkey, const DBEntry *lhs,
+                          uint64_t rkey, const DBEntry *rhs) {
+    if (lkey < rkey) {
+        return -1;
+    }
+    if (lkey > rkey) {
+        return 1;
+    }
+    if (lhs == rhs) {
+        return 0;
+    }
+    if (lhs->IsLess(*rhs)) {
+        return -1;
+    }
+    if (rhs->IsLess(*lhs)) {
+        return 1;
+    }
+    return 0;
+}
+
+// Returns the leaf that covers key. Must not be called on an empty tree.
+DBEntryBTree::LeafNode *DBEntryBTree::Descend(uint64_t key,
+                                              const DBEntry *entry,
+                                              Path *path) const {
+    Node *node = root_;
+    for (int depth = 0; depth < height_; depth++) {
+        InnerNode *inner = static_cast<InnerNode *>(node);
+
+        // Find the last child whose smallest entry is <= key.
+        int lo = 1, hi = inner->count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (Compare(inner->keys[mid], inner->entries[mid],
+                        key, entry) <= 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        path->node[depth] = inner;
+        path->index[depth] = lo - 1;
+        node = inner->children[lo - 1];
+    }
+    return static_cast<LeafNode *>(node);
+}
+
+// Returns the first slot in the leaf that is >= key.
+int DBEntryBTree::LeafLowerBound(const LeafNode *leaf, uint64_t key,
+                                 const DBEntry *entry) {
+    int lo = 0, hi = leaf->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (Compare(leaf->keys[mid], leaf->entries[mid], key, entry) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool DBEntryBTree::Insert(DBEntry *entry) {
+    uint64_t key = entry->SortKey();
+    hint_leaf_ = NULL;
+
+    if (root_ == NULL) {
+        LeafNode *leaf = new LeafNode();
+        leaf->keys[0] = key;
+        leaf->entries[0] = entry;
+        leaf->count = 1;
+        root_ = first_leaf_ = leaf;
+        height_ = 0;
+        leaf_count_++;
+        size_++;
+        return true;
+    }
+
+    Path path;
+    LeafNode *leaf = Descend(key, entry, &path);
+    int pos = LeafLowerBound(leaf, key, entry);
+    if (pos < leaf->count &&
+        Compare(leaf->keys[pos], leaf->entries[pos], key, entry) == 0) {
+        return false;
+    }
+
+    LeafNode *target = leaf;
+    LeafNode *right = NULL;
+    if (leaf->count == kLeafSlots) {
+        // Split the leaf in two halves and insert in the proper half.
+        const int half = kLeafSlots / 2;
+        right = new LeafNode();
+        leaf_count_++;
+        for (int i = half; i < kLeafSlots; i++) {
+            right->keys[i - half] = leaf->keys[i];
+            right->entries[i - half] = leaf->entries[i];
+        }
+        right->count = kLeafSlots - half;
+        leaf->count = half;
+
+        right->next = leaf->next;
+        if (right->next != NULL) {
+            right->next->prev = right;
+        }
+        right->prev = leaf;
+        leaf->next = right;
+
+        if (pos > half) {
+            target = right;
+            pos -= half;
+        }
+    }
+
+    for (int i = target->count; i > pos; i--) {
+        target->keys[i] = target->keys[i - 1];
+        target->entries[i] = target->entries[i - 1];
+    }
+    target->keys[pos] = key;
+    target->entries[pos] = entry;
+    target->count++;
+    size_++;
+
+    if (right != NULL) {
+        InsertInParent(&path, height_ - 1, leaf, right,
+                       right->keys[0], right->entries[0]);
+    }
+    return true;
+}
+
+// Insert node right, whose smallest entry is key/entry, after node left in
+// the inner node at the given depth of the path. Splits inner nodes as
+// required, growing the tree at the root.
+void DBEntryBTree::InsertInParent(Path *path, int depth, Node *left,
+                                  Node *right, uint64_t key, DBEntry *entry) {
+    if (depth < 0) {
+        assert(height_ + 1 < kMaxDepth);
+        InnerNode *root = new InnerNode();
+        inner_count_++;
+        root->children[0] = left;
+        root->children[1] = right;
+        root->keys[1] = key;
+        root->entries[1] = entry;
+        root->count = 2;
+        root_ = root;
+        height_++;
+        return;
+    }
+
+    InnerNode *inner = path->node[depth];
+    int idx = path->index[depth] + 1;
+
+    if (inner->count < kInnerSlots) {
+        for (int i = inner->count; i > idx; i--) {
+            inner->keys[i] = inner->keys[i - 1];
+            inner->entries[i] = inner->entries[i - 1];
+            inner->children[i] = inner->children[i - 1];
+        }
+        inner->keys[idx] = key;
+        inner->entries[idx] = entry;
+        inner->children[idx] = right;
+        inner->count++;
+        return;
+    }
+
+    // Build the combined slot list and split it in two halves. The smallest
+    // entry of the new sibling becomes its separator in the parent.
+    uint64_t keys[kInnerSlots + 1];
+    DBEntry *entries[kInnerSlots + 1];
+    Node *children[kInnerSlots + 1];
+    for (int i = 0, j = 0; i <= kInnerSlots; i++) {
+        if (i == idx) {
+            keys[i] = key;
+            entries[i] = entry;
+            children[i] = right;
+        } else {
+            keys[i] = inner->keys[j];
+            entries[i] = inner->entries[j];
+            children[i] = inner->children[j];
+            j++;
+        }
+    }
+
+    const int half = (kInnerSlots + 1) / 2;
+    InnerNode *sibling = new InnerNode();
+    inner_count_++;
+    for (int i = 0; i < half; i++) {
+        inner->keys[i] = keys[i];
+        inner->entries[i] = entries[i];
+        inner->children[i] = children[i];
+    }
+    inner->count = half;
+    for (int i = half; i <= kInnerSlots; i++) {
+        sibling->keys[i - half] = keys[i];
+        sibling->entries[i - half] = entries[i];
+        sibling->children[i - half] = children[i];
+    }
+    sibling->count = kInnerSlots + 1 - half;
+
+    InsertInParent(path, depth - 1, inner, sibling, keys[half], entries[half]);
+}
+
+void DBEntryBTree::Remove(DBEntry *entry) {
+    assert(root_ != NULL);
+    uint64_t key = entry->SortKey();
+    hint_leaf_ = NULL;
+    Path path;
+    LeafNode *leaf = Descend(key, entry, &path);
+    int pos = LeafLowerBound(leaf, key, entry);
+    assert(pos < leaf->count && leaf->entries[pos] == entry);
+
+    for (int i = pos; i < leaf->count - 1; i++) {
+        leaf->keys[i] = leaf->keys[i + 1];
+        leaf->entries[i] = leaf->entries[i + 1];
+    }
+    leaf->count--;
+    size_--;
+
+    // If the entry was the smallest one of a subtree, the separator of that
+    // subtree refers to it. Replace it with the successor of the entry,
+    // which is the new smallest entry of the subtree unless the subtree
+    // becomes empty, in which case the separator is removed below.
+    if (pos == 0) {
+        LeafNode *succ_leaf = leaf->count ? leaf : leaf->next;
+        for (int depth = height_ - 1; depth >= 0; depth--) {
+            if (path.index[depth] == 0) {
+                continue;
+            }
+            if (succ_leaf != NULL) {
+                InnerNode *inner = path.node[depth];
+                inner->keys[path.index[depth]] = succ_leaf->keys[0];
+                inner->entries[path.index[depth]] = succ_leaf->entries[0];
+            }
+            break;
+        }
+    }
+
+    if (leaf->count > 0) {
+        MaybeMergeLeaf(&path, height_ - 1, leaf);
+        return;
+    }
+
+    if (leaf->prev != NULL) {
+        leaf->prev->next = leaf->next;
+    } else {
+        first_leaf_ = leaf->next;
+    }
+    if (leaf->next != NULL) {
+        leaf->next->prev = leaf->prev;
+    }
+    delete leaf;
+    leaf_count_--;
+
+    if (height_ == 0) {
+        root_ = NULL;
+        return;
+    }
+    RemoveFromParent(&path, height_ - 1);
+}
+
+// Merge a leaf that is less than a quarter full with a sibling under the
+// same parent if their entries fit in a single leaf.
+void DBEntryBTree::MaybeMergeLeaf(Path *path, int depth, LeafNode *leaf) {
+    if (depth < 0 || leaf->count >= kLeafSlots / 4) {
+        return;
+    }
+
+    InnerNode *inner = path->node[depth];
+    int idx = path->index[depth];
+    LeafNode *left, *right;
+    if (idx + 1 < inner->count) {
+        left = leaf;
+        right = static_cast<LeafNode *>(inner->children[idx + 1]);
+        path->index[depth] = idx + 1;
+    } else if (idx > 0) {
+        left = static_cast<LeafNode *>(inner->children[idx - 1]);
+        right = leaf;
+    } else {
+        return;
+    }
+    if (left->count + right->count > kLeafSlots) {
+        return;
+    }
+
+    for (int i = 0; i < right->count; i++) {
+        left->keys[left->count + i] = right->keys[i];
+        left->entries[left->count + i] = right->entries[i];
+    }
+    left->count += right->count;
+    left->next = right->next;
+    if (left->next != NULL) {
+        left->next->prev = left;
+    }
+    delete right;
+    leaf_count_--;
+
+    RemoveFromParent(path, depth);
+}
+
+// Remove the child at the given depth of the path from its inner node.
+// Empty inner nodes are removed recursively and a root with a single child
+// is replaced by the child.
+void DBEntryBTree::RemoveFromParent(Path *path, int depth) {
+    InnerNode *inner = path->node[depth];
+    int idx = path->index[depth];
+
+    for (int i = idx; i < inner->count - 1; i++) {
+        inner->keys[i] = inner->keys[i + 1];
+        inner->entries[i] = inner->entries[i + 1];
+        inner->children[i] = inner->children[i + 1];
+    }
+    inner->count--;
+
+    if (inner->count == 0) {
+        delete inner;
+        inner_count_--;
+        if (depth == 0) {
+            root_ = NULL;
+            height_ = 0;
+        } else {
+            RemoveFromParent(path, depth - 1);
+        }
+        return;
+    }
+
+    if (depth == 0) {
+        while (height_ > 0 && static_cast<InnerNode *>(root_)->count == 1) {
+            InnerNode *root = static_cast<InnerNode *>(root_);
+            root_ = root->children[0];
+            delete root;
+            inner_count_--;
+            height_--;
+        }
+    }
+}
+
+DBEntry *DBEntryBTree::Find(const DBEntry *key) const {
+    DBEntry *entry = LowerBound(key);
+    if (entry != NULL &&
+        Compare(entry->SortKey(), entry, key->SortKey(), key) == 0) {
+        return entry;
+    }
+    return NULL;
+}
+
+DBEntry *DBEntryBTree::LowerBound(const DBEntry *key) const {
+    if (root_ == NULL) {
+        return NULL;
+    }
+    uint64_t sort_key = key->SortKey();
+    Path path;
+    LeafNode *leaf = Descend(sort_key, key, &path);
+    int pos = LeafLowerBound(leaf, sort_key, key);
+    if (pos < leaf->count) {
+        return SetHint(leaf, pos);
+    }
+    return SetHint(leaf->next, 0);
+}
+
+// Remember the position of the entry being returned.
+DBEntry *DBEntryBTree::SetHint(LeafNode *leaf, int pos) const {
+    hint_leaf_ = leaf;
+    hint_pos_ = pos;
+    return leaf ? leaf->entries[pos] : NULL;
+}
+
+DBEntry *DBEntryBTree::GetNext(const DBEntry *entry) const {
+    if (root_ == NULL) {
+        return NULL;
+    }
+
+    LeafNode *leaf;
+    int pos;
+    if (hint_leaf_ != NULL && hint_leaf_->entries[hint_pos_] == entry) {
+        leaf = hint_leaf_;
+        pos = hint_pos_ + 1;
+    } else {
+        uint64_t key = entry->SortKey();
+        Path path;
+        leaf = Descend(key, entry, &path);
+        pos = LeafLowerBound(leaf, key, entry);
+        if (pos < leaf->count &&
+            Compare(leaf->keys[pos], leaf->entries[pos], key, entry) == 0) {
+            pos++;
+        }
+    }
+    if (pos < leaf->count) {
+        return SetHint(leaf, pos);
+    }
+    return SetHint(leaf->next, 0);
+}
+
+DBEntry *DBEntryBTree::GetFirst() const {
+    return SetHint(first_leaf_, 0);
+}
+
+size_t DBEntryBTree::NodeMemory() const {
+    return leaf_count_ * sizeof(LeafNode) + inner_count_ * sizeof(InnerNode);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef ctrlplane_db_entry_btree_h
+#define ctrlplane_db_entry_btree_h
+
+#include <stdint.h>
+#include <cstddef>
+
+#include "base/util.h"
+
+class DBEntry;
+
+// B+tree of DBEntry pointers used as an alternative storage for
+// DBTablePartition.
+//
+// Each slot stores the DBEntry::SortKey() of the entry next to the entry
+// pointer, so that most comparisons are done on an integer in the node
+// rather than through a virtual IsLess call on an entry elsewhere in
+// memory. DBEntry::IsLess is only invoked when the sort keys are equal.
+//
+// Leaves are linked, which makes GetNext and full table walks sequential
+// in memory. The position of the last entry returned by a lookup is kept
+// as a hint, so that GetNext on it does not search from the root.
+//
+// Separators in the inner nodes are the smallest entry of the subtree to
+// their right. They are kept up to date when that entry is removed, since
+// the entries they point to may be freed afterwards.
+class DBEntryBTree {
+public:
+    DBEntryBTree();
+    ~DBEntryBTree();
+
+    // Insert an entry. Returns false if an equal entry is already present.
+    bool Insert(DBEntry *entry);
+
+    // Remove an entry that is present in the tree.
+    void Remove(DBEntry *entry);
+
+    // Returns the entry equal to key or NULL.
+    DBEntry *Find(const DBEntry *key) const;
+
+    // Returns the entry equal to key or the next one in key order.
+    DBEntry *LowerBound(const DBEntry *key) const;
+
+    // Returns the entry following an entry that is present in the tree.
+    DBEntry *GetNext(const DBEntry *entry) const;
+
+    DBEntry *GetFirst() const;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Memory used by the nodes of the tree.
+    size_t NodeMemory() const;
+
+private:
+    static const int kLeafSlots = 32;
+    static const int kInnerSlots = 32;
+    static const int kMaxDepth = 16;
+
+    struct Node;
+    struct LeafNode;
+    struct InnerNode;
+    struct Path;
+
+    static int Compare(uint64_t lkey, const DBEntry *lhs,
+                       uint64_t rkey, const DBEntry *rhs);
+    LeafNode *Descend(uint64_t key, const DBEntry *entry, Path *path) const;
+    static int LeafLowerBound(const LeafNode *leaf, uint64_t key,
+                              const DBEntry *entry);
+    void InsertInParent(Path *path, int depth, Node *left, Node *right,
+                        uint64_t key, DBEntry *entry);
+    void RemoveFromParent(Path *path, int depth);
+    void MaybeMergeLeaf(Path *path, int depth, LeafNode *leaf);
+    void DeleteNode(Node *node, int height);
+    DBEntry *SetHint(LeafNode *leaf, int pos) const;
+
+    Node *root_;
+    int height_;            // number of inner levels above the leaves
+    LeafNode *first_leaf_;
+    size_t size_;
+    size_t leaf_count_;
+    size_t inner_count_;
+    mutable LeafNode *hint_leaf_;
+    mutable int hint_pos_;
+
+    DISALLOW_COPY_AND_ASSIGN(DBEntryBTree);
+};
+
+#endif
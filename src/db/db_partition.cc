@@ -8,6 +8,7 @@
 #include <tbb/atomic.h>
 #include <tbb/concurrent_queue.h>
 #include <tbb/mutex.h>
+#include <tbb/spin_mutex.h>
 
 #include "base/task.h"
 #include "db/db_client.h"
@@ -17,15 +18,100 @@ using namespace tbb;
 
 int DBPartition::db_partition_task_id_ = -1;
 
+// Requests enqueued together are chained through next and pushed onto the
+// request queue as a single node.
 struct RequestQueueEntry {
-    // Constructor takes ownership of DBRequest key, data.
-    RequestQueueEntry(DBTablePartBase *tpart, DBClient *client, DBRequest *req)
-        : tpart(tpart), client(client) {
+    RequestQueueEntry() : tpart(NULL), client(NULL), next(NULL) {
+    }
+
+    // Takes ownership of DBRequest key, data.
+    void Set(DBTablePartBase *tpart, DBClient *client, DBRequest *req) {
+        this->tpart = tpart;
+        this->client = client;
         request.Swap(req);
     }
+
+    void Reset() {
+        tpart = NULL;
+        client = NULL;
+        next = NULL;
+        request.oper = static_cast<DBRequest::DBOperation>(0);
+        request.key.reset();
+        request.data.reset();
+    }
+
     DBTablePartBase *tpart;
     DBClient *client;
     DBRequest request;
+    RequestQueueEntry *next;
+};
+
+// Free list of RequestQueueEntry. Entries processed by the QueueRunner are
+// returned here and reused by producers, so that steady state enqueues do
+// not allocate from the heap. The list is bounded by kMaxSize.
+class RequestEntryPool {
+public:
+    static const size_t kMaxSize = 1024;
+
+    RequestEntryPool() : free_list_(NULL), size_(0) {
+    }
+    ~RequestEntryPool() {
+        while (free_list_ != NULL) {
+            RequestQueueEntry *entry = free_list_;
+            free_list_ = entry->next;
+            delete entry;
+        }
+    }
+
+    // Allocate a chain of count entries linked through next.
+    RequestQueueEntry *Alloc(size_t count) {
+        RequestQueueEntry *head = NULL;
+        size_t allocated = 0;
+        {
+            tbb::spin_mutex::scoped_lock lock(mutex_);
+            while (allocated < count && free_list_ != NULL) {
+                RequestQueueEntry *entry = free_list_;
+                free_list_ = entry->next;
+                entry->next = head;
+                head = entry;
+                allocated++;
+            }
+            size_ -= allocated;
+        }
+        for (; allocated < count; allocated++) {
+            RequestQueueEntry *entry = new RequestQueueEntry();
+            entry->next = head;
+            head = entry;
+        }
+        return head;
+    }
+
+    // Return a chain of count entries linked through next.
+    void Free(RequestQueueEntry *head, RequestQueueEntry *tail, size_t count) {
+        if (head == NULL) {
+            return;
+        }
+        {
+            tbb::spin_mutex::scoped_lock lock(mutex_);
+            if (size_ + count <= kMaxSize) {
+                tail->next = free_list_;
+                free_list_ = head;
+                size_ += count;
+                return;
+            }
+        }
+        while (head != NULL) {
+            RequestQueueEntry *entry = head;
+            head = entry->next;
+            delete entry;
+        }
+    }
+
+private:
+    tbb::spin_mutex mutex_;
+    RequestQueueEntry *free_list_;
+    size_t size_;
+    DISALLOW_COPY_AND_ASSIGN(RequestEntryPool);
 };
 
 struct RemoveQueueEntry {
@@ -44,31 +130,66 @@ public:
     typedef std::list<DBTablePartBase *> TablePartList;
 
     explicit WorkQueue(int partition_id) 
-        : db_partition_id_(partition_id), disable_(false), running_(false) {
+        : db_partition_id_(partition_id), disable_(false), running_(false),
+          pending_(NULL), released_head_(NULL), released_tail_(NULL),
+          released_count_(0) {
         request_count_ = 0;
     }
     ~WorkQueue() {
+        DeleteChain(pending_);
         for (RequestQueue::iterator iter = request_queue_.unsafe_begin();
              iter != request_queue_.unsafe_end();) {
             RequestQueueEntry *req_entry = *iter;
             ++iter;
-            delete req_entry;
+            DeleteChain(req_entry);
         }
         request_queue_.clear();
+        DeleteChain(released_head_);
     }
 
-    bool EnqueueRequest(RequestQueueEntry *req_entry) {
+    RequestQueueEntry *AllocEntries(size_t count) {
+        return entry_pool_.Alloc(count);
+    }
+
+    // Enqueue a chain of count requests as a single queue node.
+    // Returns false once the number of requests in the queue reaches
+    // kThreshold.
+    bool EnqueueRequest(RequestQueueEntry *req_entry, size_t count) {
         request_queue_.push(req_entry);
         MaybeStartRunner();
-        return request_count_.fetch_and_increment() < (kThreshold - 1);
+        return request_count_.fetch_and_add(count) + (long) count < kThreshold;
     }
 
+    // concurrency: called from QueueRunner.
+    // Requests of a chain are handed out one at a time, so that the runner
+    // can yield in the middle of a batch.
     bool DequeueRequest(RequestQueueEntry **req_entry) {
-        bool success = request_queue_.try_pop(*req_entry);
-        if (success) {
-            request_count_.fetch_and_decrement();
+        if (pending_ == NULL && !request_queue_.try_pop(pending_)) {
+            return false;
         }
-        return success;
+        *req_entry = pending_;
+        pending_ = pending_->next;
+        request_count_.fetch_and_decrement();
+        return true;
+    }
+
+    // concurrency: called from QueueRunner.
+    // Processed entries are collected locally and returned to the pool in
+    // one go by FlushReleased.
+    void ReleaseEntry(RequestQueueEntry *req_entry) {
+        req_entry->Reset();
+        if (released_tail_ == NULL) {
+            released_tail_ = req_entry;
+        }
+        req_entry->next = released_head_;
+        released_head_ = req_entry;
+        released_count_++;
+    }
+
+    void FlushReleased() {
+        entry_pool_.Free(released_head_, released_tail_, released_count_);
+        released_head_ = released_tail_ = NULL;
+        released_count_ = 0;
     }
 
     void EnqueueRemove(RemoveQueueEntry *rm_entry) {
@@ -103,13 +224,22 @@ public:
     }
 
     bool IsDBQueueEmpty() {
-        return (request_queue_.empty() && change_list_.empty());
+        return (request_queue_.empty() && pending_ == NULL &&
+                change_list_.empty());
     }
 
     bool disable() { return disable_; }
     void set_disable(bool disable) { disable_ = disable; }
 
 private:
+    static void DeleteChain(RequestQueueEntry *req_entry) {
+        while (req_entry != NULL) {
+            RequestQueueEntry *next = req_entry->next;
+            delete req_entry;
+            req_entry = next;
+        }
+    }
+
     RequestQueue request_queue_;
     TablePartList change_list_;
     atomic<long> request_count_;
@@ -118,6 +248,11 @@ private:
     int db_partition_id_;
     bool disable_;
     bool running_;
+    RequestEntryPool entry_pool_;
+    RequestQueueEntry *pending_;        // remainder of the current batch
+    RequestQueueEntry *released_head_;
+    RequestQueueEntry *released_tail_;
+    size_t released_count_;
     DISALLOW_COPY_AND_ASSIGN(WorkQueue);
 };
 
@@ -163,12 +298,14 @@ public:
         RequestQueueEntry *req_entry = NULL;
         while (queue_->DequeueRequest(&req_entry)) {
             req_entry->tpart->Process(req_entry->client, &req_entry->request);
-            delete req_entry;
+            queue_->ReleaseEntry(req_entry);
             if (++count == kMaxIterations) {
+                queue_->FlushReleased();
                 return false;
             }
         }
-        
+        queue_->FlushReleased();
+
         while (true) {
             DBTablePartBase *tpart = queue_->GetActiveTable();
             if (tpart == NULL) {
@@ -200,7 +337,7 @@ void DBPartition::WorkQueue::MaybeStartRunner() {
 
 bool DBPartition::WorkQueue::RunnerDone() {
     mutex::scoped_lock lock(mutex_);
-    if (request_queue_.empty() && remove_queue_.empty()) {
+    if (request_queue_.empty() && pending_ == NULL && remove_queue_.empty()) {
         running_ = false;
         return true;
     }
@@ -224,8 +361,24 @@ DBPartition::~DBPartition() {
 
 bool DBPartition::EnqueueRequest(DBTablePartBase *tpart, DBClient *client,
                                  DBRequest *req) {
-    RequestQueueEntry *entry = new RequestQueueEntry(tpart, client, req);
-    return work_queue_->EnqueueRequest(entry);
+    RequestQueueEntry *entry = work_queue_->AllocEntries(1);
+    entry->Set(tpart, client, req);
+    return work_queue_->EnqueueRequest(entry, 1);
+}
+
+bool DBPartition::EnqueueRequestBatch(DBTablePartBase *tpart, DBClient *client,
+                                      const std::vector<DBRequest *> &reqs) {
+    if (reqs.empty()) {
+        return true;
+    }
+    RequestQueueEntry *head = work_queue_->AllocEntries(reqs.size());
+    RequestQueueEntry *entry = head;
+    for (std::vector<DBRequest *>::const_iterator iter = reqs.begin();
+         iter != reqs.end(); ++iter) {
+        entry->Set(tpart, client, *iter);
+        entry = entry->next;
+    }
+    return work_queue_->EnqueueRequest(head, reqs.size());
 }
 
 void DBPartition::EnqueueRemove(DBTablePartBase *tpart, DBEntryBase *db_entry) {
@@ -5,6 +5,7 @@
 #ifndef ctrlplane_db_partition_h
 #define ctrlplane_db_partition_h
 
+#include <vector>
 #include <boost/function.hpp>
 
 #include "base/util.h"
@@ -29,6 +30,13 @@ public:
     bool EnqueueRequest(DBTablePartBase *tpart, DBClient *client,
                         DBRequest *req);
 
+    // Enqueue a set of requests for the same table partition as a single
+    // node of the request queue. Takes ownership of the key and data of
+    // each request. Returns false if the client should stop enqueuing
+    // updates.
+    bool EnqueueRequestBatch(DBTablePartBase *tpart, DBClient *client,
+                             const std::vector<DBRequest *> &reqs);
+
     void EnqueueRemove(DBTablePartBase *tpart, DBEntryBase *db_entry);
 
     // Enqueue table on change list.
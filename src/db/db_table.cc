@@ -2,6 +2,7 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <map>
 #include <vector>
 #include <tbb/spin_rw_mutex.h>
 
@@ -119,6 +120,33 @@ bool DBTableBase::Enqueue(DBRequest *req) {
     return partition->EnqueueRequest(tpart, NULL, req);
 }
 
+bool DBTableBase::EnqueueBatch(const vector<DBRequest *> &reqs) {
+    typedef vector<DBRequest *> RequestList;
+    vector<DBTablePartBase *> tparts(DB::PartitionCount(), NULL);
+    vector<RequestList> groups(DB::PartitionCount());
+
+    for (RequestList::const_iterator iter = reqs.begin(); iter != reqs.end();
+         ++iter) {
+        DBTablePartBase *tpart = GetTablePartition((*iter)->key.get());
+        int index = tpart->index();
+        tparts[index] = tpart;
+        groups[index].push_back(*iter);
+    }
+
+    bool success = true;
+    for (size_t index = 0; index < groups.size(); index++) {
+        if (groups[index].empty()) {
+            continue;
+        }
+        DBPartition *partition = db_->GetPartition(index);
+        if (!partition->EnqueueRequestBatch(tparts[index], NULL,
+                                            groups[index])) {
+            success = false;
+        }
+    }
+    return success;
+}
+
 void DBTableBase::EnqueueRemove(DBEntryBase *db_entry) {
     DBTablePartBase *tpart = GetTablePartition(db_entry);
     DBPartition *partition = db_->GetPartition(tpart->index());
@@ -215,6 +243,32 @@ size_t DBTable::Size() const {
     return total;
 }
 
+size_t DBTable::StateCount() const {
+    size_t total = 0;
+    for (vector<DBTablePartition *>::const_iterator iter = partitions_.begin();
+         iter != partitions_.end(); iter++) {
+        total += (*iter)->state_count();
+    }
+    return total;
+}
+
+size_t DBTable::StateMemory() const {
+    size_t total = Size() * sizeof(DBState **);
+    for (vector<DBTablePartition *>::const_iterator iter = partitions_.begin();
+         iter != partitions_.end(); iter++) {
+        total += (*iter)->state_memory();
+    }
+    return total;
+}
+
+// Estimate: the map in every entry, and a tree node per state holding the
+// value, three links and the color.
+size_t DBTable::StateMapMemory() const {
+    typedef std::map<ListenerId, DBState *> StateMap;
+    return Size() * sizeof(StateMap) +
+        StateCount() * (sizeof(StateMap::value_type) + 4 * sizeof(void *));
+}
+
 void DBTable::Input(DBTablePartition *tbl_partition, DBClient *client,
                     DBRequest *req) {
     DBRequestKey *key = 
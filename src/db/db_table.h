@@ -58,6 +58,11 @@ public:
 
     // Enqueue a request to the table. Takes ownership of the data.
     bool Enqueue(DBRequest *req);
+    // Enqueue a set of requests to the table. Requests are grouped by table
+    // partition and each group is queued as one unit. Takes ownership of the
+    // key and data of every request. Returns false if any of the partition
+    // queues asks the client to stop enqueuing updates.
+    bool EnqueueBatch(const std::vector<DBRequest *> &reqs);
     void EnqueueRemove(DBEntryBase *db_entry);
 
     // Determine the table partition depending on the record key.
@@ -127,6 +132,11 @@ public:
     // Override if *really* necessary
     virtual DBTablePartition *AllocPartition(int index);
 
+    // Store the entries of the partitions in a B-tree keyed on
+    // DBEntry::SortKey instead of a red-black tree. Tables with large
+    // number of entries and a selective SortKey should opt in.
+    virtual bool UseBTreeStorage() const { return false; }
+
     // Input processing implemented by derived class. Default 
     // implementation takes care of Add/Delete/Change.
     // Override if *really* necessary
@@ -174,6 +184,15 @@ public:
     // Calcuate the size across all partitions.
     virtual size_t Size() const;
 
+    // Number of listener states across all partitions.
+    size_t StateCount() const;
+
+    // Memory used to store listener state across all partitions, and the
+    // memory the same states would use if each entry kept them in a
+    // std::map.
+    size_t StateMemory() const;
+    size_t StateMapMemory() const;
+
 private:
     ///////////////////////////////////////////////////////////
     // Utility methods
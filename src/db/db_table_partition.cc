@@ -62,7 +62,8 @@ void DBTablePartBase::Delete(DBEntryBase *entry) {
 }
 
 DBTablePartition::DBTablePartition(DBTable *table, int index)
-    : DBTablePartBase(table, index) {
+    : DBTablePartBase(table, index),
+      btree_(table->UseBTreeStorage() ? new DBEntryBTree() : NULL) {
 }
 
 void DBTablePartition::Process(DBClient *client, DBRequest *req) {
@@ -72,7 +73,11 @@ void DBTablePartition::Process(DBClient *client, DBRequest *req) {
 
 void DBTablePartition::Add(DBEntry *entry) {
     tbb::mutex::scoped_lock lock(mutex_);
-    tree_.insert(*entry);
+    if (btree_.get()) {
+        btree_->Insert(entry);
+    } else {
+        tree_.insert(*entry);
+    }
     entry->set_table(static_cast<DBTableBase *>(table()));
     Notify(entry);
 }
@@ -86,18 +91,26 @@ void DBTablePartition::Remove(DBEntryBase *db_entry) {
     tbb::mutex::scoped_lock lock(mutex_);
     DBEntry *entry = static_cast<DBEntry *>(db_entry);
 
-    tree_.erase(*entry);
+    if (btree_.get()) {
+        btree_->Remove(entry);
+    } else {
+        tree_.erase(*entry);
+    }
+    entry->ReleaseState(this);
     delete entry;
 
     //
     // If a table is marked for deletion, then we may trigger the deletion
     // process when the last prefix is deleted
     //
-    table()->MayResumeDelete(tree_.empty());
+    table()->MayResumeDelete(size() == 0);
 }
 
 DBEntry *DBTablePartition::Find(const DBEntry *entry) {
     tbb::mutex::scoped_lock lock(mutex_);
+    if (btree_.get()) {
+        return btree_->Find(entry);
+    }
     Tree::iterator loc = tree_.find(*entry);
     if (loc != tree_.end()) {
         return loc.operator->();
@@ -109,6 +122,9 @@ DBEntry *DBTablePartition::Find(const DBRequestKey *key) {
     tbb::mutex::scoped_lock lock(mutex_);
     DBTable *table = static_cast<DBTable *>(parent());
     std::auto_ptr<DBEntry> entry_ptr = table->AllocEntry(key);
+    if (btree_.get()) {
+        return btree_->Find(entry_ptr.get());
+    }
 
     Tree::iterator loc = tree_.find(*(entry_ptr.get()));
     if (loc != tree_.end()) {
@@ -121,6 +137,9 @@ DBEntry *DBTablePartition::Find(const DBRequestKey *key) {
 DBEntry *DBTablePartition::lower_bound(const DBEntryBase *key) {
     const DBEntry *entry = static_cast<const DBEntry *>(key);
     tbb::mutex::scoped_lock lock(mutex_);
+    if (btree_.get()) {
+        return btree_->LowerBound(entry);
+    }
 
     Tree::iterator it = tree_.lower_bound(*entry);
     if (it != tree_.end()) {
@@ -131,6 +150,9 @@ DBEntry *DBTablePartition::lower_bound(const DBEntryBase *key) {
 
 DBEntry *DBTablePartition::GetFirst() {
     tbb::mutex::scoped_lock lock(mutex_);
+    if (btree_.get()) {
+        return btree_->GetFirst();
+    }
     Tree::iterator it = tree_.begin();
     if (it == tree_.end()) {
         return NULL;
@@ -142,6 +164,9 @@ DBEntry *DBTablePartition::GetFirst() {
 DBEntry *DBTablePartition::GetNext(const DBEntryBase *key) {
     const DBEntry *entry = static_cast<const DBEntry *>(key);
     tbb::mutex::scoped_lock lock(mutex_);
+    if (btree_.get()) {
+        return btree_->GetNext(entry);
+    }
 
     Tree::const_iterator it = tree_.iterator_to(*entry);
     it++;
@@ -6,9 +6,11 @@
 #define ctrlplane_db_table_partition_h
 
 #include <boost/intrusive/list.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <tbb/mutex.h>
 
 #include "db/db_entry.h"
+#include "db/db_entry_btree.h"
 
 class DBTableBase;
 class DBTable;
@@ -24,7 +26,8 @@ public:
 
 
     DBTablePartBase(DBTableBase *tbl_base, int index)
-        : parent_(tbl_base), index_(index) {
+        : parent_(tbl_base), index_(index), state_count_(0),
+          state_memory_(0) {
     }
 
     // Input processing stage for DBRequests. Called from per-partition thread.
@@ -52,15 +55,27 @@ public:
         return dbstate_mutex_;
     }
 
+    // Number of listener states set on the entries of the partition and
+    // bytes allocated to store them.
+    size_t state_count() const { return state_count_; }
+    size_t state_memory() const { return state_memory_; }
+
     virtual ~DBTablePartBase() {};
 private:
+    friend class DBEntryBase;
+
     tbb::mutex dbstate_mutex_;
     DBTableBase *parent_;
     int index_;
     ChangeList change_list_;
+    // Updated with dbstate_mutex_ held.
+    size_t state_count_;
+    size_t state_memory_;
     DISALLOW_COPY_AND_ASSIGN(DBTablePartBase);
 };
 
+// Entries are kept in a boost::intrusive::set through DBEntry::node_ or,
+// if the table opts in with DBTable::UseBTreeStorage, in a DBEntryBTree.
 class DBTablePartition : public DBTablePartBase {
 public:
     typedef boost::intrusive::member_hook<DBEntry,
@@ -102,11 +117,14 @@ public:
     DBEntry *Find(const DBRequestKey *key);
 
     DBTable *table();
-    size_t size() const { return tree_.size(); }
+    size_t size() const {
+        return btree_.get() ? btree_->size() : tree_.size();
+    }
 
 private:
     tbb::mutex mutex_;
     Tree tree_;
+    boost::scoped_ptr<DBEntryBTree> btree_;
     DISALLOW_COPY_AND_ASSIGN(DBTablePartition);
 };
 
@@ -27,12 +27,23 @@ DBTableWalker::DBTableWalker() {
     walk_request_count_ = 0;
     walk_complete_count_ = 0;
     walk_cancel_count_ = 0;
+    walk_traversal_count_ = 0;
+    walk_coalesce_count_ = 0;
+    walk_visit_count_ = 0;
+    walk_latency_total_usecs_ = 0;
+    walk_latency_max_usecs_ = 0;
 }
+
 class DBTableWalker::Walker {
 public:
-    Walker(WalkId id, DBTableWalker *wkmgr, DBTable *table,
-           const DBRequestKey *key, WalkFn walker, 
-           WalkCompleteFn walk_done);
+    Walker(WalkId id, DBTableWalker *wkmgr, WalkFn walker,
+           WalkCompleteFn walk_done, int yield_budget)
+        : id_(id), wkmgr_(wkmgr), walker_fn_(walker), done_fn_(walk_done),
+          yield_budget_(yield_budget > 0 ? yield_budget : GetIterationToYield()),
+          request_time_(UTCTimestampUsec()) {
+        should_stop_ = false;
+        visit_count_ = 0;
+    }
 
     void StopWalk() {
         should_stop_.fetch_and_store(true);
@@ -43,17 +54,56 @@ public:
     // Parent walker manager
     DBTableWalker *wkmgr_;
 
+    WalkFn walker_fn_;
+    WalkCompleteFn done_fn_;
+
+    // Will be true if Table walk is cancelled
+    tbb::atomic<bool> should_stop_;
+
+    int yield_budget_;
+    uint64_t request_time_;
+
+    // Number of walker_fn_ calls, across all partitions
+    tbb::atomic<uint64_t> visit_count_;
+};
+
+class DBTableWalker::Traversal {
+public:
+    Traversal(DBTableWalker *wkmgr, DBTable *table, const DBRequestKey *key)
+        : wkmgr_(wkmgr), table_(table),
+          key_start_(const_cast<DBRequestKey *>(key)), started_(false),
+          yield_budget_(0) {
+    }
+
+    ~Traversal() {
+        STLDeleteValues(&walkers_);
+    }
+
+    // Called with the walkers_mutex_ of the walker manager held, before
+    // the traversal has started.
+    void AddWalker(Walker *walker) {
+        assert(!started_);
+        walkers_.push_back(walker);
+        if (yield_budget_ == 0 || walker->yield_budget_ < yield_budget_) {
+            yield_budget_ = walker->yield_budget_;
+        }
+    }
+
+    void Start();
+
+    // Parent walker manager
+    DBTableWalker *wkmgr_;
+
     // Table on which walk is done
     DBTable *table_;
 
     // Take the ownership of key passed
     std::auto_ptr<DBRequestKey> key_start_;
 
-    WalkFn walker_fn_;
-    WalkCompleteFn done_fn_;
-
-    // Will be true if Table walk is cancelled
-    tbb::atomic<bool> should_stop_;
+    // Walkers sharing this traversal. Not modified once started_ is set.
+    WalkerList walkers_;
+    bool started_;
+    int yield_budget_;
 
     // check whether iteraton is completed on all Table Partition
     tbb::atomic<long> status_;
@@ -61,24 +111,34 @@ public:
 
 class DBTableWalker::Worker : public Task {
 public:
-    Worker(Walker *walker, int db_partition_id, const DBRequestKey *key) 
-        : Task(walker_task_id_, db_partition_id), walker_(walker), 
-          key_start_(key) {
+    Worker(Traversal *traversal, int db_partition_id)
+        : Task(walker_task_id_, db_partition_id), traversal_(traversal),
+          started_(false) {
         tbl_partition_ = static_cast<DBTablePartition *>(
-            walker_->table_->GetTablePartition(db_partition_id));
+            traversal_->table_->GetTablePartition(db_partition_id));
     }
 
     virtual bool Run();
 
 private:
-    DBTableWalker::Walker *walker_;
+    // Invoke the walker function of every walker that is still active in
+    // this partition. Returns false if no walker is active anymore.
+    bool Visit(DBEntry *entry, int *count);
+
+    // Account the walker function calls made since the last flush.
+    void FlushVisits();
+
+    DBTableWalker::Traversal *traversal_;
+    bool started_;
+
+    // Walkers that did not stop the walk in this partition, and calls to
+    // their walker function since the last flush.
+    std::vector<bool> active_;
+    std::vector<uint64_t> visits_;
 
     // Store the last visited node to continue walk
     std::auto_ptr<DBRequestKey> walk_ctx_;
 
-    // This is where the walk started
-    const DBRequestKey *key_start_;
-
     // Table partition for which this worker was created
     DBTablePartition *tbl_partition_;
 };
@@ -99,24 +159,63 @@ static void db_walker_wait() {
     }
 }
 
+bool DBTableWalker::Worker::Visit(DBEntry *entry, int *count) {
+    const WalkerList &walkers = traversal_->walkers_;
+    bool more = false;
+    for (size_t i = 0; i < walkers.size(); i++) {
+        if (!active_[i]) {
+            continue;
+        }
+        Walker *walker = walkers[i];
+        // Check whether Walker was requested to be cancelled
+        if (walker->should_stop_) {
+            active_[i] = false;
+            continue;
+        }
+        visits_[i]++;
+        (*count)++;
+        if (!walker->walker_fn_(tbl_partition_, entry)) {
+            active_[i] = false;
+            continue;
+        }
+        more = true;
+    }
+    return more;
+}
+
+void DBTableWalker::Worker::FlushVisits() {
+    const WalkerList &walkers = traversal_->walkers_;
+    uint64_t total = 0;
+    for (size_t i = 0; i < walkers.size(); i++) {
+        if (visits_[i]) {
+            walkers[i]->visit_count_ += visits_[i];
+            total += visits_[i];
+            visits_[i] = 0;
+        }
+    }
+    traversal_->wkmgr_->walk_visit_count_ += total;
+}
+
 bool DBTableWalker::Worker::Run() {
+    if (!started_) {
+        traversal_->wkmgr_->StartTraversal(traversal_);
+        active_.assign(traversal_->walkers_.size(), true);
+        visits_.assign(traversal_->walkers_.size(), 0);
+        started_ = true;
+    }
+
     int count = 0;
     DBRequestKey *key_resume;
 
-    // Check whether Walker was requested to be cancelled
-    if (walker_->should_stop_) {
-        goto walk_done;
-    }
-
     // Check where we left in last iteration
     if ((key_resume = walk_ctx_.get()) == NULL) {
         // First time invoke of worker thread, start from key_start_
-        key_resume = const_cast <DBRequestKey *>(key_start_);
+        key_resume = traversal_->key_start_.get();
     }
 
     DBEntry *entry;
     if (key_resume != NULL) {
-        DBTable *table = walker_->table_;
+        DBTable *table = traversal_->table_;
         std::auto_ptr<const DBEntryBase> start;
         start = table->AllocEntry(key_resume);
         // Find matching or next in sort order
@@ -124,88 +223,80 @@ bool DBTableWalker::Worker::Run() {
     } else {
         entry = tbl_partition_->GetFirst();
     }
-    if (entry == NULL) {
-        goto walk_done;
-    }
 
     for (DBEntry *next = NULL; entry; entry = next) {
         next = tbl_partition_->GetNext(entry);
-        // Check whether Walker was requested to be cancelled
-        if (walker_->should_stop_) {
-            break; 
-        }
-        if (count == GetIterationToYield()) {
+        if (count >= traversal_->yield_budget_) {
             // store the context
             walk_ctx_ = entry->GetDBRequestKey();
+            FlushVisits();
             return false;
         }
 
-        // Invoke walker function
-        bool more = walker_->walker_fn_(tbl_partition_, entry);
-        if (!more) {
+        // Invoke walker functions
+        if (!Visit(entry, &count)) {
             break;
         }
 
         db_walker_wait();
-        count++;
     }
+    FlushVisits();
 
-walk_done:
     // Check whether all other walks on the table is completed
-    long num_walkers_on_tpart = walker_->status_.fetch_and_decrement();
+    long num_walkers_on_tpart = traversal_->status_.fetch_and_decrement();
     if (num_walkers_on_tpart == 1) {
-        // Invoke Walker_Complete callback
-        if (!walker_->should_stop_) {
-            walker_->wkmgr_->update_walk_complete_count(+1);
-        }
-        if (walker_->done_fn_ != NULL) {
-            if (!walker_->should_stop_) {
-                walker_->done_fn_(walker_->table_);
-            }
-        }
-        // Release the memory for walker and bitmap
-        walker_->wkmgr_->PurgeWalker(walker_->id_);
+        traversal_->wkmgr_->TraversalDone(traversal_);
     }
     return true;
 }
 
-DBTableWalker::Walker::Walker(WalkId id, DBTableWalker *wkmgr,
-                              DBTable *table, const DBRequestKey *key,
-                              WalkFn walker, WalkCompleteFn walk_done)
-    : id_(id), wkmgr_(wkmgr), table_(table),
-      key_start_(const_cast<DBRequestKey *>(key)), 
-      walker_fn_(walker), done_fn_(walk_done) {
-    int num_worker = DB::PartitionCount(); 
-    should_stop_ = false;
+void DBTableWalker::Traversal::Start() {
+    int num_worker = DB::PartitionCount();
     status_ = num_worker;
     for (int i = 0; i < num_worker; i++) {
-        Worker *task = new Worker(this, i, key);
+        Worker *task = new Worker(this, i);
         TaskScheduler *scheduler = TaskScheduler::GetInstance();
         scheduler->Enqueue(task);
     }
 }
 
-DBTableWalker::WalkId DBTableWalker::WalkTable(DBTable *table, 
-                                               const DBRequestKey *key_start, 
-                                               WalkFn walkerfn , 
-                                               WalkCompleteFn walk_complete) {
+DBTableWalker::WalkId DBTableWalker::WalkTable(DBTable *table,
+                                               const DBRequestKey *key_start,
+                                               WalkFn walkerfn,
+                                               WalkCompleteFn walk_complete,
+                                               int yield_budget) {
     tbb::mutex::scoped_lock lock(walkers_mutex_);
     walk_request_count_++;
     size_t i = walker_map_.find_first();
     if (i == walker_map_.npos) {
         i = walkers_.size();
-        Walker *walker = new Walker(i, this, table, key_start, 
-                                    walkerfn, walk_complete);
-        walkers_.push_back(walker);
+        walkers_.push_back(NULL);
     } else {
         walker_map_.reset(i);
         if (walker_map_.none()) {
             walker_map_.clear();
         }
-        Walker *walker = new Walker(i, this, table, key_start, 
-                                    walkerfn, walk_complete);
-        walkers_[i] = walker;
     }
+    Walker *walker = new Walker(i, this, walkerfn, walk_complete,
+                                yield_budget);
+    walkers_[i] = walker;
+
+    if (key_start == NULL) {
+        TraversalMap::iterator loc = pending_.find(table);
+        if (loc != pending_.end()) {
+            loc->second->AddWalker(walker);
+            walk_coalesce_count_++;
+            return i;
+        }
+    }
+
+    Traversal *traversal = new Traversal(this, table, key_start);
+    traversal->AddWalker(walker);
+    if (key_start == NULL) {
+        pending_.insert(std::make_pair(table, traversal));
+    }
+    walk_traversal_count_++;
+    traversal->Start();
     return i;
 }
 
@@ -216,10 +307,59 @@ void DBTableWalker::WalkCancel(WalkId id) {
     // Purge to be called after task has stopped
 }
 
+uint64_t DBTableWalker::WalkProgress(WalkId id) {
+    tbb::mutex::scoped_lock lock(walkers_mutex_);
+    if ((size_t) id >= walkers_.size() || walkers_[id] == NULL) {
+        return 0;
+    }
+    return walkers_[id]->visit_count_;
+}
+
+void DBTableWalker::StartTraversal(Traversal *traversal) {
+    tbb::mutex::scoped_lock lock(walkers_mutex_);
+    if (traversal->started_) {
+        return;
+    }
+    traversal->started_ = true;
+    TraversalMap::iterator loc = pending_.find(traversal->table_);
+    if (loc != pending_.end() && loc->second == traversal) {
+        pending_.erase(loc);
+    }
+}
+
+void DBTableWalker::TraversalDone(Traversal *traversal) {
+    uint64_t now = UTCTimestampUsec();
+    for (WalkerList::iterator iter = traversal->walkers_.begin();
+         iter != traversal->walkers_.end(); ++iter) {
+        Walker *walker = *iter;
+        // Invoke Walker_Complete callback
+        if (walker->should_stop_) {
+            continue;
+        }
+        {
+            tbb::mutex::scoped_lock lock(walkers_mutex_);
+            uint64_t latency = now - walker->request_time_;
+            walk_complete_count_++;
+            walk_latency_total_usecs_ += latency;
+            if (latency > walk_latency_max_usecs_) {
+                walk_latency_max_usecs_ = latency;
+            }
+        }
+        if (walker->done_fn_ != NULL) {
+            walker->done_fn_(traversal->table_);
+        }
+    }
+
+    // Release the memory for walkers and bitmap
+    for (WalkerList::iterator iter = traversal->walkers_.begin();
+         iter != traversal->walkers_.end(); ++iter) {
+        PurgeWalker((*iter)->id_);
+    }
+    delete traversal;
+}
+
 void DBTableWalker::PurgeWalker(WalkId id) {
     tbb::mutex::scoped_lock lock(walkers_mutex_);
-    Walker *walker = walkers_[id];
-    delete walker;
     walkers_[id] = NULL;
     if ((size_t) id == walkers_.size() - 1) {
         while (!walkers_.empty() && walkers_.back() == NULL) {
@@ -5,8 +5,12 @@
 #ifndef ctrlplane_db_table_walker_h
 #define ctrlplane_db_table_walker_h
 
+#include <map>
+#include <vector>
 #include <boost/function.hpp>
 #include <boost/dynamic_bitset.hpp>
+#include <tbb/atomic.h>
+#include <tbb/mutex.h>
 #include <tbb/task.h>
 
 #include "base/logging.h"
@@ -35,22 +39,47 @@ public:
     // Start a walk request on the specified table. If non null, 'key_start'
     // specifies the starting point for the walk. The walk is performed in
     // all table shards in parallel.
+    //
+    // Walks of the whole table that are requested before an earlier walk
+    // of the whole table has started are merged into a single traversal:
+    // each entry is passed to the walker function of every merged walk.
+    //
+    // 'yield_budget' is the number of walker function calls after which
+    // the task walking a shard yields. The traversal uses the smallest
+    // budget of the walks merged into it. Zero selects the default.
     WalkId WalkTable(DBTable *table, const DBRequestKey *key_start,
-                     WalkFn walker, WalkCompleteFn walk_complete);
+                     WalkFn walker, WalkCompleteFn walk_complete,
+                     int yield_budget = 0);
 
     // cancel a walk that may be in progress. This cannot be called from
     // the walker function itself.
     void WalkCancel(WalkId id);
 
+    // Number of entries passed so far to the walker function of a walk
+    // that is in progress.
+    uint64_t WalkProgress(WalkId id);
+
     DBTableWalker();
 
     uint64_t walk_request_count() { return walk_request_count_; }
     uint64_t walk_complete_count() { return walk_complete_count_; }
-    void update_walk_complete_count(uint64_t inc) {
+    uint64_t walk_cancel_count() { return walk_cancel_count_; }
+
+    // Number of table traversals and of walk requests merged into a
+    // traversal that was already pending.
+    uint64_t walk_traversal_count() { return walk_traversal_count_; }
+    uint64_t walk_coalesce_count() { return walk_coalesce_count_; }
+
+    // Total number of walker function calls.
+    uint64_t walk_visit_count() { return walk_visit_count_; }
+
+    // Time from request to completion of the walks that completed.
+    uint64_t walk_latency_max_usecs() { return walk_latency_max_usecs_; }
+    uint64_t walk_latency_avg_usecs() {
         tbb::mutex::scoped_lock lock(walkers_mutex_);
-        walk_complete_count_ += inc;
+        return walk_complete_count_ ?
+            walk_latency_total_usecs_ / walk_complete_count_ : 0;
     }
-    uint64_t walk_cancel_count() { return walk_cancel_count_; }
 
 private:
     static const int kIterationToYield = 1024;
@@ -75,11 +104,22 @@ private:
     // A Walker allocated to iterator through a DBTable
     class Walker;
 
+    // A traversal of a DBTable shared by one or more Walkers
+    class Traversal;
+
     // A Job for walking through the DBTablePartition
     class Worker;
 
     typedef std::vector<Walker *> WalkerList;
     typedef boost::dynamic_bitset<> WalkerMap;
+    typedef std::map<DBTable *, Traversal *> TraversalMap;
+
+    // Called by the first worker of a traversal to run. No walker can be
+    // merged into the traversal afterwards.
+    void StartTraversal(Traversal *traversal);
+
+    // Called when the traversal is done on all partitions.
+    void TraversalDone(Traversal *traversal);
 
     // Purge the walker after the walk is completed/cancelled
     void PurgeWalker(WalkId id);
@@ -89,9 +129,17 @@ private:
     WalkerList walkers_;
     WalkerMap walker_map_;
 
+    // Traversals of a whole table that have not started yet
+    TraversalMap pending_;
+
     uint64_t walk_request_count_;
     uint64_t walk_complete_count_;
     uint64_t walk_cancel_count_;
+    uint64_t walk_traversal_count_;
+    uint64_t walk_coalesce_count_;
+    tbb::atomic<uint64_t> walk_visit_count_;
+    uint64_t walk_latency_total_usecs_;
+    uint64_t walk_latency_max_usecs_;
 
     static int walker_task_id_;
 };
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+#include <vector>
+#include <boost/intrusive/set.hpp>
+
+#include "base/util.h"
+#include "base/test/task_test_util.h"
+#include "db/db_entry.h"
+#include "db/db_entry_btree.h"
+#include "testing/gunit.h"
+
+using namespace std;
+
+// Entry with a 32-bit key. The number of low order bits of the key dropped
+// from the SortKey is configurable, so that ties that must be resolved with
+// IsLess can be exercised.
+class TestEntry : public DBEntry {
+public:
+    TestEntry(uint32_t key, int shift) : key_(key), shift_(shift) { }
+
+    virtual std::string ToString() const { return "TestEntry"; }
+    virtual KeyPtr GetDBRequestKey() const { return KeyPtr(NULL); }
+    virtual void SetKey(const DBRequestKey *key) { }
+    virtual bool IsLess(const DBEntry &rhs) const {
+        return key_ < static_cast<const TestEntry &>(rhs).key_;
+    }
+    virtual uint64_t SortKey() const {
+        return shift_ >= 64 ? 0 : (uint64_t) key_ >> shift_;
+    }
+
+    uint32_t key() const { return key_; }
+
+    boost::intrusive::set_member_hook<> set_node_;
+
+private:
+    uint32_t key_;
+    int shift_;
+};
+
+typedef boost::intrusive::member_hook<TestEntry,
+    boost::intrusive::set_member_hook<>, &TestEntry::set_node_> SetMember;
+typedef boost::intrusive::set<TestEntry, SetMember> EntrySet;
+
+static uint32_t Key(const DBEntry *entry) {
+    return static_cast<const TestEntry *>(entry)->key();
+}
+
+class DBEntryBTreeTest : public ::testing::TestWithParam<int> {
+protected:
+    virtual void TearDown() {
+        STLDeleteValues(&entries_);
+    }
+
+    TestEntry *Alloc(uint32_t key) {
+        TestEntry *entry = new TestEntry(key, GetParam());
+        entries_.push_back(entry);
+        return entry;
+    }
+
+    void Verify(const DBEntryBTree &tree, const set<uint32_t> &keys) {
+        EXPECT_EQ(keys.size(), tree.size());
+        set<uint32_t>::const_iterator it = keys.begin();
+        for (DBEntry *entry = tree.GetFirst(); entry != NULL;
+             entry = tree.GetNext(entry)) {
+            ASSERT_TRUE(it != keys.end());
+            EXPECT_EQ(*it, Key(entry));
+            ++it;
+        }
+        EXPECT_TRUE(it == keys.end());
+    }
+
+    vector<TestEntry *> entries_;
+};
+
+TEST_P(DBEntryBTreeTest, Empty) {
+    DBEntryBTree tree;
+    TestEntry *key = Alloc(10);
+    EXPECT_TRUE(tree.empty());
+    EXPECT_TRUE(tree.GetFirst() == NULL);
+    EXPECT_TRUE(tree.Find(key) == NULL);
+    EXPECT_TRUE(tree.LowerBound(key) == NULL);
+    EXPECT_TRUE(tree.GetNext(key) == NULL);
+}
+
+TEST_P(DBEntryBTreeTest, Sequential) {
+    DBEntryBTree tree;
+    set<uint32_t> keys;
+    vector<TestEntry *> inserted;
+    for (uint32_t i = 0; i < 10000; i++) {
+        TestEntry *entry = Alloc(i * 2);
+        EXPECT_TRUE(tree.Insert(entry));
+        inserted.push_back(entry);
+        keys.insert(i * 2);
+    }
+    EXPECT_FALSE(tree.Insert(Alloc(100)));
+    Verify(tree, keys);
+
+    for (uint32_t i = 0; i < 10000; i++) {
+        TestEntry *key = Alloc(i * 2 + 1);
+        DBEntry *entry = tree.LowerBound(key);
+        if (i == 9999) {
+            EXPECT_TRUE(entry == NULL);
+        } else {
+            ASSERT_TRUE(entry != NULL);
+            EXPECT_EQ(i * 2 + 2, Key(entry));
+        }
+        EXPECT_TRUE(tree.Find(key) == NULL);
+    }
+
+    // Remove every entry from the front, exercising separator updates.
+    for (size_t i = 0; i < inserted.size(); i++) {
+        tree.Remove(inserted[i]);
+        keys.erase(inserted[i]->key());
+        if (i % 1000 == 0) {
+            Verify(tree, keys);
+        }
+    }
+    EXPECT_TRUE(tree.empty());
+    EXPECT_EQ(0U, tree.NodeMemory());
+}
+
+TEST_P(DBEntryBTreeTest, Random) {
+    DBEntryBTree tree;
+    set<uint32_t> keys;
+    vector<TestEntry *> present;
+    srand(1);
+
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < 20000; i++) {
+            uint32_t value = rand() % 100000;
+            TestEntry *entry = Alloc(value);
+            bool inserted = tree.Insert(entry);
+            EXPECT_EQ(keys.insert(value).second, inserted);
+            if (inserted) {
+                present.push_back(entry);
+            }
+        }
+        Verify(tree, keys);
+
+        for (int i = 0; i < 2000; i++) {
+            TestEntry *key = Alloc(rand() % 100000);
+            set<uint32_t>::iterator it = keys.lower_bound(key->key());
+            DBEntry *entry = tree.LowerBound(key);
+            if (it == keys.end()) {
+                EXPECT_TRUE(entry == NULL);
+            } else {
+                ASSERT_TRUE(entry != NULL);
+                EXPECT_EQ(*it, Key(entry));
+            }
+        }
+
+        random_shuffle(present.begin(), present.end());
+        size_t remove_count = present.size() * 3 / 4;
+        for (size_t i = 0; i < remove_count; i++) {
+            TestEntry *entry = present.back();
+            present.pop_back();
+            EXPECT_EQ(entry, tree.Find(entry));
+            tree.Remove(entry);
+            keys.erase(entry->key());
+            EXPECT_TRUE(tree.Find(entry) == NULL);
+        }
+        Verify(tree, keys);
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(SortKey, DBEntryBTreeTest,
+                        ::testing::Values(0, 12, 64));
+
+// Compare insert, find and full walk cost of the red-black tree and the
+// B-tree. Runs with a small number of entries as part of the unit tests;
+// set DB_BTREE_BENCH_COUNT to e.g. 1000000 for meaningful numbers.
+TEST(DBEntryBTreeBench, Compare) {
+    int count = task_util_bench_count("DB_BTREE_BENCH_COUNT", 10000);
+
+    // Multiplying by an odd constant generates distinct keys in random
+    // order.
+    vector<TestEntry *> entries;
+    for (int i = 0; i < count; i++) {
+        entries.push_back(new TestEntry(i * 2654435761U, 0));
+    }
+    vector<TestEntry *> lookups(entries);
+    random_shuffle(lookups.begin(), lookups.end());
+
+    EntrySet rbtree;
+    uint64_t start = UTCTimestampUsec();
+    for (int i = 0; i < count; i++) {
+        rbtree.insert(*entries[i]);
+    }
+    uint64_t rb_insert = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    size_t found = 0;
+    for (int i = 0; i < count; i++) {
+        found += (rbtree.find(*lookups[i]) != rbtree.end());
+    }
+    uint64_t rb_find = UTCTimestampUsec() - start;
+    EXPECT_EQ(rbtree.size(), found);
+
+    start = UTCTimestampUsec();
+    size_t walked = 0;
+    for (EntrySet::iterator it = rbtree.begin(); it != rbtree.end(); ++it) {
+        walked++;
+    }
+    uint64_t rb_walk = UTCTimestampUsec() - start;
+    EXPECT_EQ(rbtree.size(), walked);
+    rbtree.clear();
+
+    DBEntryBTree btree;
+    start = UTCTimestampUsec();
+    for (int i = 0; i < count; i++) {
+        btree.Insert(entries[i]);
+    }
+    uint64_t bt_insert = UTCTimestampUsec() - start;
+
+    start = UTCTimestampUsec();
+    found = 0;
+    for (int i = 0; i < count; i++) {
+        found += (btree.Find(lookups[i]) != NULL);
+    }
+    uint64_t bt_find = UTCTimestampUsec() - start;
+    EXPECT_EQ(btree.size(), found);
+
+    // Walk as DBTableWalker does, through GetNext.
+    start = UTCTimestampUsec();
+    walked = 0;
+    for (DBEntry *entry = btree.GetFirst(); entry != NULL;
+         entry = btree.GetNext(entry)) {
+        walked++;
+    }
+    uint64_t bt_walk = UTCTimestampUsec() - start;
+    EXPECT_EQ(btree.size(), walked);
+
+    cout << "entries " << count << endl;
+    cout << "rbtree insert " << rb_insert << "us find " << rb_find
+         << "us walk " << rb_walk << "us" << endl;
+    cout << "btree  insert " << bt_insert << "us find " << bt_find
+         << "us walk " << bt_walk << "us node memory "
+         << btree.NodeMemory() << " bytes" << endl;
+
+    for (int i = 0; i < count; i++) {
+        btree.Remove(entries[i]);
+    }
+    EXPECT_TRUE(btree.empty());
+    STLDeleteValues(&entries);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -131,6 +131,116 @@ public:
 
 #include "db_test_cmn.h"
 
+// Listener state is stored in a vector indexed by listener id. Verify
+// states of several listeners, NULL states and the memory accounting.
+TEST_F(DBTest, StateVector) {
+    DBTableBase::ListenerId id[3];
+    for (int i = 0; i < 3; i++) {
+        id[i] = itbl->Register(
+            boost::bind(&DBTest::DBTestListener, this, _1, _2));
+    }
+
+    const int kCount = 64;
+    for (int i = 0; i < kCount; i++) {
+        DBRequest addReq;
+        addReq.key.reset(new VlanTableReqKey(i + 1));
+        addReq.data.reset(new VlanTableReqData("DB Test Vlan"));
+        addReq.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        itbl->Enqueue(&addReq);
+    }
+    task_util::WaitForIdle();
+    EXPECT_EQ(0U, itbl->StateCount());
+
+    VlanState states[3] = { VlanState(0), VlanState(1), VlanState(2) };
+    for (int i = 0; i < kCount; i++) {
+        VlanTableReqKey key(i + 1);
+        Vlan *vlan = itbl->Find(&key);
+        ASSERT_TRUE(vlan != NULL);
+        // The vector is sized to the highest listener id with state.
+        vlan->SetState(itbl, id[0], &states[0]);
+        EXPECT_EQ((id[0] + 1) * sizeof(DBState *), vlan->state_memory());
+        vlan->SetState(itbl, id[2], &states[2]);
+        EXPECT_EQ((id[2] + 1) * sizeof(DBState *), vlan->state_memory());
+        EXPECT_TRUE(vlan->GetState(itbl, id[1]) == NULL);
+        EXPECT_EQ(&states[2], vlan->GetState(itbl, id[2]));
+        EXPECT_EQ(&states[0], vlan->GetState(itbl, id[0]));
+    }
+    EXPECT_EQ(2U * kCount, itbl->StateCount());
+    EXPECT_LT(itbl->StateMemory(), itbl->StateMapMemory());
+
+    // A NULL state keeps a deleted entry in the table.
+    VlanTableReqKey key(1);
+    Vlan *vlan = itbl->Find(&key);
+    vlan->SetState(itbl, id[1], NULL);
+    EXPECT_TRUE(vlan->GetState(itbl, id[1]) == NULL);
+    EXPECT_EQ(2U * kCount + 1, itbl->StateCount());
+    vlan->ClearState(itbl, id[0]);
+    vlan->ClearState(itbl, id[2]);
+
+    for (int i = 0; i < kCount; i++) {
+        DBRequest delReq;
+        delReq.key.reset(new VlanTableReqKey(i + 1));
+        delReq.oper = DBRequest::DB_ENTRY_DELETE;
+        itbl->Enqueue(&delReq);
+    }
+    task_util::WaitForIdle();
+    vlan = itbl->Find(&key);
+    ASSERT_TRUE(vlan != NULL);
+    EXPECT_TRUE(vlan->IsDeleted());
+    vlan->ClearState(itbl, id[1]);
+
+    for (int i = 1; i < kCount; i++) {
+        VlanTableReqKey key(i + 1);
+        Vlan *vlan = itbl->Find(&key);
+        ASSERT_TRUE(vlan != NULL);
+        vlan->ClearState(itbl, id[0]);
+        vlan->ClearState(itbl, id[2]);
+        EXPECT_EQ(0U, vlan->state_memory());
+    }
+    task_util::WaitForIdle();
+    for (int i = 0; i < kCount; i++) {
+        VlanTableReqKey key(i + 1);
+        EXPECT_TRUE(itbl->Find(&key) == NULL);
+    }
+    EXPECT_EQ(0U, itbl->StateCount());
+    EXPECT_EQ(0U, itbl->StateMemory());
+
+    for (int i = 0; i < 3; i++) {
+        itbl->Unregister(id[i]);
+    }
+}
+
+// State left behind by a listener that unregistered is released with the
+// entry.
+TEST_F(DBTest, StateUnregister) {
+    DBTableBase::ListenerId id = itbl->Register(
+        boost::bind(&DBTest::DBTestListener, this, _1, _2));
+
+    DBRequest addReq;
+    addReq.key.reset(new VlanTableReqKey(1));
+    addReq.data.reset(new VlanTableReqData("DB Test Vlan"));
+    addReq.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+    itbl->Enqueue(&addReq);
+    task_util::WaitForIdle();
+
+    VlanTableReqKey key(1);
+    Vlan *vlan = itbl->Find(&key);
+    ASSERT_TRUE(vlan != NULL);
+    VlanState state(1);
+    vlan->SetState(itbl, id, &state);
+    EXPECT_EQ(1U, itbl->StateCount());
+    itbl->Unregister(id);
+
+    DBRequest delReq;
+    delReq.key.reset(new VlanTableReqKey(1));
+    delReq.oper = DBRequest::DB_ENTRY_DELETE;
+    itbl->Enqueue(&delReq);
+    task_util::WaitForIdle();
+    EXPECT_TRUE(itbl->Find(&key) == NULL);
+    EXPECT_EQ(0U, itbl->StateCount());
+    EXPECT_EQ(0U, itbl->StateMemory());
+}
+
 void RegisterFactory() {
     DB::RegisterFactory("db.test.vlan.0", &VlanTable::CreateTable);
 }
@@ -520,6 +520,99 @@ TEST_F(DBTest, JWalker) {
     EXPECT_TRUE(del_notification == walk_count);
 }
 
+static bool CountingWalk(tbb::atomic<long> *count, DBTablePartBase *root,
+                         DBEntryBase *entry) {
+    (*count)++;
+    return true;
+}
+
+static void CountingWalkDone(tbb::atomic<long> *count, DBTableBase *table) {
+    (*count)++;
+}
+
+// Walks of the whole table requested before the traversal starts are
+// merged. A walk with a start key gets its own traversal.
+TEST_F(DBTest, WalkCoalesce) {
+    DBTable *table = dynamic_cast<DBTable *>(itbl);
+    ASSERT_TRUE(table != NULL);
+
+    const int kCount = 256;
+    for (int i = 0; i < kCount; i++) {
+        DBRequest addReq;
+        addReq.key.reset(new VlanTableReqKey(i));
+        addReq.data.reset(new VlanTableReqData("DB Test Vlan"));
+        addReq.oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        itbl->Enqueue(&addReq);
+    }
+    task_util::WaitForIdle();
+
+    DBTableWalker *walker = db_.GetWalker();
+    uint64_t traversals = walker->walk_traversal_count();
+    uint64_t coalesced = walker->walk_coalesce_count();
+    uint64_t completes = walker->walk_complete_count();
+    uint64_t requests = walker->walk_request_count();
+    uint64_t cancels = walker->walk_cancel_count();
+    uint64_t calls = walker->walk_visit_count();
+
+    tbb::atomic<long> visits[4];
+    tbb::atomic<long> done[4];
+    for (int i = 0; i < 4; i++) {
+        visits[i] = 0;
+        done[i] = 0;
+    }
+
+    TaskScheduler *scheduler = TaskScheduler::GetInstance();
+    scheduler->Stop();
+    DBTableWalker::WalkId id[4];
+    for (int i = 0; i < 3; i++) {
+        id[i] = walker->WalkTable(table, NULL,
+            boost::bind(&CountingWalk, &visits[i], _1, _2),
+            boost::bind(&CountingWalkDone, &done[i], _1), i == 1 ? 16 : 0);
+    }
+    id[3] = walker->WalkTable(table, new VlanTableReqKey(kCount / 2),
+        boost::bind(&CountingWalk, &visits[3], _1, _2),
+        boost::bind(&CountingWalkDone, &done[3], _1));
+    walker->WalkCancel(id[2]);
+    EXPECT_EQ(traversals + 2, walker->walk_traversal_count());
+    EXPECT_EQ(coalesced + 2, walker->walk_coalesce_count());
+    scheduler->Start();
+    task_util::WaitForIdle();
+
+    EXPECT_EQ(kCount, visits[0]);
+    EXPECT_EQ(kCount, visits[1]);
+    EXPECT_EQ(0, visits[2]);
+    EXPECT_EQ(kCount / 2, visits[3]);
+    EXPECT_EQ(1, done[0]);
+    EXPECT_EQ(1, done[1]);
+    EXPECT_EQ(0, done[2]);
+    EXPECT_EQ(1, done[3]);
+    EXPECT_EQ(completes + 3, walker->walk_complete_count());
+    EXPECT_EQ(requests + 4, walker->walk_request_count());
+    EXPECT_EQ(cancels + 1, walker->walk_cancel_count());
+    EXPECT_EQ(calls + 2 * kCount + kCount / 2, walker->walk_visit_count());
+    EXPECT_EQ(0U, walker->WalkProgress(id[0]));
+
+    // A walk requested after the traversal is done gets a new one.
+    visits[0] = 0;
+    walker->WalkTable(table, NULL,
+        boost::bind(&CountingWalk, &visits[0], _1, _2),
+        DBTableWalker::WalkCompleteFn());
+    task_util::WaitForIdle();
+    EXPECT_EQ(kCount, visits[0]);
+    EXPECT_EQ(traversals + 3, walker->walk_traversal_count());
+    EXPECT_EQ(coalesced + 2, walker->walk_coalesce_count());
+    EXPECT_EQ(completes + 4, walker->walk_complete_count());
+    EXPECT_EQ(calls + 3 * kCount + kCount / 2, walker->walk_visit_count());
+
+    for (int i = 0; i < kCount; i++) {
+        DBRequest delReq;
+        delReq.key.reset(new VlanTableReqKey(i));
+        delReq.oper = DBRequest::DB_ENTRY_DELETE;
+        itbl->Enqueue(&delReq);
+    }
+    task_util::WaitForIdle();
+}
+
 // To Test:
 // Verify Bulk ADD DELETE of objects to DBTable
 TEST_F(DBTest, Bulk) {
@@ -590,6 +683,79 @@ TEST_F(DBTest, Bulk) {
     del_notification = 0;
 }
 
+// To Test:
+// Verify Bulk ADD DELETE of objects to DBTable using EnqueueBatch
+TEST_F(DBTest, BulkBatch) {
+    int bulk_count = 1000;
+    tid_ = 
+        itbl->Register(boost::bind(&DBTest::DBTestListener, this, _1, _2));
+
+    adc_notification = 0;
+    del_notification = 0;
+
+    std::vector<DBRequest *> reqs;
+    for (int i = 0; i < bulk_count; i++) {
+        DBRequest *addReq = new DBRequest();
+        addReq->key.reset(new VlanTableReqKey(i));
+        addReq->data.reset(new VlanTableReqData("DB Test Vlan"));
+        addReq->oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+        reqs.push_back(addReq);
+    }
+    itbl->EnqueueBatch(reqs);
+
+    // Ownership of key and data is transferred to the table.
+    for (int i = 0; i < bulk_count; i++) {
+        EXPECT_TRUE(reqs[i]->key.get() == NULL);
+        EXPECT_TRUE(reqs[i]->data.get() == NULL);
+    }
+    STLDeleteValues(&reqs);
+
+    task_util::WaitForIdle();
+    EXPECT_TRUE(adc_notification == bulk_count);
+    for (int i = 0; i < bulk_count; i++) {
+        VlanTableReqKey lookupKey(i);
+        EXPECT_TRUE(itbl->Find(&lookupKey) != NULL);
+    }
+
+    // Add and delete of the same key in one batch are processed in order.
+    for (int i = 0; i < bulk_count; i++) {
+        DBRequest *delReq = new DBRequest();
+        delReq->key.reset(new VlanTableReqKey(i));
+        delReq->oper = DBRequest::DB_ENTRY_DELETE;
+        reqs.push_back(delReq);
+    }
+    DBRequest *addReq = new DBRequest();
+    addReq->key.reset(new VlanTableReqKey(0));
+    addReq->data.reset(new VlanTableReqData("DB Test Vlan"));
+    addReq->oper = DBRequest::DB_ENTRY_ADD_CHANGE;
+    reqs.push_back(addReq);
+    itbl->EnqueueBatch(reqs);
+    STLDeleteValues(&reqs);
+
+    task_util::WaitForIdle();
+    for (int i = 0; i < bulk_count; i++) {
+        VlanTableReqKey lookupKey(i);
+        Vlan *vlan = itbl->Find(&lookupKey);
+        if (i == 0) {
+            EXPECT_TRUE(vlan != NULL);
+        } else {
+            EXPECT_TRUE(vlan == NULL);
+        }
+    }
+
+    DBRequest delReq;
+    delReq.key.reset(new VlanTableReqKey(0));
+    delReq.oper = DBRequest::DB_ENTRY_DELETE;
+    itbl->Enqueue(&delReq);
+    task_util::WaitForIdle();
+    VlanTableReqKey lookupKey(0);
+    EXPECT_TRUE(itbl->Find(&lookupKey) == NULL);
+
+    itbl->Unregister(tid_);
+    adc_notification = 0;
+    del_notification = 0;
+}
+
 // To Test:
 // Verify that requests enqueued when a notification running is serviced
 TEST_F(DBTest, ReqInNotifyPath) {
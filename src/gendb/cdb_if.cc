@@ -124,6 +124,7 @@ bool CdbIf::Db_Init(std::string task_id, int task_instance) {
             TaskScheduler::GetInstance()->GetTaskId(task_id), task_instance,
             boost::bind(&CdbIf::Db_AsyncAddColumn, this, _1),
             boost::bind(&CdbIf::Db_IsInitDone, this)));
+        cdbq_->set_name("Cassandra Add Column");
     }
 
     if (enable_stats_) {
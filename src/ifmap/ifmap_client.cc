@@ -14,6 +14,16 @@ IFMapClient::IFMapClient()
 IFMapClient::~IFMapClient() {
 }
 
+bool IFMapClient::SendUpdateBuffers(const BufferList &buffers) {
+    std::string msg;
+    for (BufferList::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        msg.append(boost::asio::buffer_cast<const char *>(*iter),
+                   boost::asio::buffer_size(*iter));
+    }
+    return SendUpdate(msg);
+}
+
 void IFMapClient::Initialize(IFMapExporter *exporter, int index) {
     index_ = index;
     exporter_ = exporter;
@@ -9,6 +9,7 @@
 #include <map>
 #include <string>
 #include <vector>
+#include <boost/asio/buffer.hpp>
 
 class IFMapExporter;
 
@@ -16,6 +17,7 @@ class IFMapExporter;
 class IFMapClient {
 public:
     typedef std::map<std::string, std::string> VmMap;
+    typedef std::vector<boost::asio::const_buffer> BufferList;
     static const int kIndexInvalid = -1;
 
     IFMapClient();
@@ -24,6 +26,10 @@ public:
     virtual const std::string &identifier() const = 0;
     virtual bool SendUpdate(const std::string &msg) = 0;
 
+    // Send an update made of several buffers. The default implementation
+    // copies them into one string and calls SendUpdate.
+    virtual bool SendUpdateBuffers(const BufferList &buffers);
+
     int index() const { return index_; }
     uint64_t msgs_sent() const { return msgs_sent_; }
     uint64_t msgs_blocked() const { return msgs_blocked_; }
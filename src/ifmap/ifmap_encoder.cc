@@ -12,7 +12,9 @@
 using namespace pugi;
 using namespace std;
 
-IFMapMessage::IFMapMessage() : op_type_(NONE), node_count_(0),
+static const char kToAttribute[] = " to=\"";
+
+IFMapMessage::IFMapMessage() : op_type_(NONE), to_offset_(0), node_count_(0),
     objects_per_message_(kObjectsPerMessage) {
     // init empty document
     Open();
@@ -31,16 +33,34 @@ void IFMapMessage::Close() {
     ostringstream oss;
     doc_.save(oss);
     str_ = oss.str();
+    to_offset_ = str_.find(kToAttribute);
+    assert(to_offset_ != string::npos);
+    to_offset_ += sizeof(kToAttribute) - 1;
 }
 
-void IFMapMessage::SetReceiverInMsg(const std::string &cli_identifier) {
-    xml_node iq = doc_.child("iq");
-    assert(iq);
-    xml_attribute iqattr = iq.attribute("to");
-    assert(iqattr);
-    std::string str(cli_identifier);
-    str += "/config";
-    iqattr.set_value(str.c_str());
+void IFMapMessage::GetBuffers(const std::string &cli_identifier,
+                              IFMapClient::BufferList *buffers) {
+    assert(!str_.empty());
+
+    // Escape the identifier the same way as pugixml escapes attributes.
+    to_.clear();
+    for (string::const_iterator it = cli_identifier.begin();
+         it != cli_identifier.end(); ++it) {
+        switch (*it) {
+        case '&': to_ += "&amp;"; break;
+        case '<': to_ += "&lt;"; break;
+        case '>': to_ += "&gt;"; break;
+        case '"': to_ += "&quot;"; break;
+        default: to_ += *it; break;
+        }
+    }
+    to_ += "/config";
+
+    buffers->clear();
+    buffers->push_back(boost::asio::const_buffer(str_.data(), to_offset_));
+    buffers->push_back(boost::asio::const_buffer(to_.data(), to_.size()));
+    buffers->push_back(boost::asio::const_buffer(str_.data() + to_offset_,
+                                                 str_.size() - to_offset_));
 }
 
 void IFMapMessage::SetObjectsPerMessage(int num) {
@@ -108,12 +128,8 @@ bool IFMapMessage::IsEmpty() {
 
 void IFMapMessage::Reset() {
     doc_.reset();
+    str_.clear();
     node_count_ = 0;
     op_type_ = NONE;
     Open();
 }
-
-const char * IFMapMessage::c_str() const {
-    assert(!str_.empty());
-    return str_.c_str();
-}
@@ -6,6 +6,7 @@
 #define __ctrlplane__ifmap_encoder__
 
 #include <pugixml/pugixml.hpp>
+#include "ifmap/ifmap_client.h"
 
 class IFMapNode;
 class IFMapLink;
@@ -16,17 +17,21 @@ public:
     static const int kObjectsPerMessage = 16;
     IFMapMessage();
 
+    // Save the document as a string. The 'to' attribute is left empty and
+    // filled in per client by GetBuffers.
     void Close();
-    // set the 'to' field in the message
-    void SetReceiverInMsg(const std::string &cli_identifier);
+    // Get the closed message for a client as the parts of the document
+    // before and after the 'to' attribute, which are shared by all clients,
+    // and the attribute value for this client. The buffers are valid until
+    // the next call or until the message is reset.
+    void GetBuffers(const std::string &cli_identifier,
+                    IFMapClient::BufferList *buffers);
     void SetObjectsPerMessage(int num);
     void EncodeUpdate(const IFMapUpdate *update);
     bool IsFull();
     bool IsEmpty();
     void Reset();
 
-    const char *c_str() const;
-
 private:
     enum Op {
         NONE,
@@ -42,6 +47,8 @@ private:
     Op op_type_;             // the current  type of op_node_
     pugi::xml_node op_node_;
     std::string str_;
+    size_t to_offset_;       // offset of the 'to' value in str_
+    std::string to_;
     int node_count_;
     int objects_per_message_;
 };
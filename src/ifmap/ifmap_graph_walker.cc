@@ -71,6 +71,7 @@ IFMapGraphWalker::IFMapGraphWalker(DBGraph *graph, IFMapExporter *exporter)
                   boost::bind(&IFMapGraphWalker::Worker, this, _1)) {
     work_queue_.SetExitCallback(
         boost::bind(&IFMapGraphWalker::WorkBatchEnd, this, _1));
+    work_queue_.set_name("IFMap Graph Walker");
     traversal_white_list_.reset(new IFMapTypenameWhiteList());
     AddNodesToWhitelist();
     AddLinksToWhitelist();
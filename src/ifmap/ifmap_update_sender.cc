@@ -229,6 +229,11 @@ void IFMapUpdateSender::SendUpdate(BitSet send_set, BitSet *blocked_set) {
 
     assert(!message_->IsEmpty());
 
+    // Close the message to save the document as string. This is done once
+    // for all the clients, only the 'to' attribute differs between them.
+    message_->Close();
+    IFMapClient::BufferList buffers;
+
     for (size_t i = send_set.find_first(); i != BitSet::npos;
          i = send_set.find_next(i)) {
         assert(!send_blocked_.test(i));
@@ -236,12 +241,10 @@ void IFMapUpdateSender::SendUpdate(BitSet send_set, BitSet *blocked_set) {
         if (client == NULL) {
             continue;
         }
-        message_->SetReceiverInMsg(client->identifier());
-        // Close the message to save the document as string
-        message_->Close();
 
-        // Send the string version of the message to the client.
-        send_result = client->SendUpdate(message_->c_str());
+        // Send the shared message body along with the client's 'to' value.
+        message_->GetBuffers(client->identifier(), &buffers);
+        send_result = client->SendUpdateBuffers(buffers);
 
         // Keep track of all the clients whose buffers are full. 
         if (!send_result) {
@@ -87,6 +87,7 @@ public:
     IFMapSender(IFMapXmppChannel *parent);
 
     virtual bool SendUpdate(const std::string &msg);
+    virtual bool SendUpdateBuffers(const BufferList &buffers);
 
     virtual std::string ToString() const { return identifier_; }
     virtual const std::string &identifier() const { return identifier_; }
@@ -98,6 +99,8 @@ public:
     }
 
 private:
+    bool UpdateSendStats(bool sent);
+
     IFMapXmppChannel *parent_;
     std::string hostname_;      // hostname
     std::string identifier_;    // FQN
@@ -111,7 +114,17 @@ bool IFMapXmppChannel::IFMapSender::SendUpdate(const std::string &msg) {
     bool sent = parent_->channel_->Send(
         (const uint8_t *)msg.data(), msg.size(), xmps::CONFIG,
         boost::bind(&IFMapXmppChannel::WriteReadyCb, parent_, _1));
+    return UpdateSendStats(sent);
+}
+
+bool IFMapXmppChannel::IFMapSender::SendUpdateBuffers(
+        const BufferList &buffers) {
+    bool sent = parent_->channel_->SendBuffers(buffers, xmps::CONFIG,
+        boost::bind(&IFMapXmppChannel::WriteReadyCb, parent_, _1));
+    return UpdateSendStats(sent);
+}
 
+bool IFMapXmppChannel::IFMapSender::UpdateSendStats(bool sent) {
     if (sent) {
         incr_msgs_sent();
     } else {
@@ -37,10 +37,12 @@ public:
     virtual bool SendUpdate(const std::string &msg) {
         cout << "Sending " << endl << msg << endl;
         send_update_cnt_++;
+        last_msg_ = msg;
         return send_success_;
     }
 
     int get_send_update_cnt() { return send_update_cnt_; }
+    const string &last_msg() const { return last_msg_; }
 
     // Control if you want to block or continue sending
     void set_send_success(bool succ) { send_success_ = succ; }
@@ -49,6 +51,7 @@ private:
     string identifier_;
     bool send_success_;
     int send_update_cnt_;
+    string last_msg_;
 };
 
 struct IFMapUpdateDeleter {
@@ -164,6 +167,48 @@ TEST_F(IFMapUpdateSenderTest, BasicQTraversal) {
     queue_->Leave(c0.index());
 }
 
+// All the clients get the same message, except for the 'to' attribute.
+TEST_F(IFMapUpdateSenderTest, SharedMessageBody) {
+    TestClient c0("c0");
+    TestClient c1("c1");
+    server_.ClientRegister(&c0);
+    server_.ClientRegister(&c1);
+
+    IFMapUpdate *u1 = CreateUpdate("u1", true);
+    IFMapUpdate *u2 = CreateUpdate("u2", false);
+
+    BitSet cli_bs;
+    cli_bs.set(c0.index());
+    cli_bs.set(c1.index());
+    u1->AdvertiseOr(cli_bs);
+    u2->AdvertiseOr(cli_bs);
+
+    queue_->Join(c0.index());
+    queue_->Join(c1.index());
+    queue_->Enqueue(u1);
+    queue_->Enqueue(u2);
+
+    sender_->QueueActive();
+    task_util::WaitForIdle();
+    TASK_UTIL_EXPECT_EQ(1, c0.get_send_update_cnt());
+    TASK_UTIL_EXPECT_EQ(1, c1.get_send_update_cnt());
+
+    string msg0 = c0.last_msg();
+    string msg1 = c1.last_msg();
+    size_t pos0 = msg0.find("to=\"c0/config\"");
+    size_t pos1 = msg1.find("to=\"c1/config\"");
+    ASSERT_NE(string::npos, pos0);
+    ASSERT_NE(string::npos, pos1);
+    EXPECT_EQ(pos0, pos1);
+    msg1.replace(pos1, string("to=\"c1/config\"").size(), "to=\"c0/config\"");
+    EXPECT_EQ(msg0, msg1);
+    EXPECT_NE(string::npos, msg0.find("<update>"));
+    EXPECT_NE(string::npos, msg0.find("<delete>"));
+
+    queue_->Leave(c0.index());
+    queue_->Leave(c1.index());
+}
+
 TEST_F(IFMapUpdateSenderTest, QTraversalNoInterest) {
     TestClient c0("c0");
     TestClient c1("c1");
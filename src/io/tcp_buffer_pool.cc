@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "io/tcp_buffer_pool.h"
+
+TcpBufferPool::TcpBufferPool(size_t buffer_size, size_t max_free)
+    : buffer_size_(buffer_size), max_free_(max_free) {
+    free_count_ = 0;
+}
+
+TcpBufferPool::~TcpBufferPool() {
+    uint8_t *data;
+    while (free_list_.try_pop(data)) {
+        delete[] data;
+    }
+}
+
+uint8_t *TcpBufferPool::Allocate() {
+    uint8_t *data;
+    if (free_list_.try_pop(data)) {
+        free_count_--;
+        stats_.hits++;
+        return data;
+    }
+    stats_.misses++;
+    return new uint8_t[buffer_size_];
+}
+
+void TcpBufferPool::Release(uint8_t *data) {
+    // The count may briefly exceed max_free_ when threads race, which is ok.
+    if (free_count_ < max_free_) {
+        free_count_++;
+        free_list_.push(data);
+        stats_.recycled++;
+        return;
+    }
+    stats_.freed++;
+    delete[] data;
+}
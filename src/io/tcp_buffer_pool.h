@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __TCP_BUFFER_POOL_H__
+#define __TCP_BUFFER_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
+
+#include "base/util.h"
+
+//
+// Pool of fixed size receive buffers shared by the sessions of a TcpServer.
+//
+// Buffers are allocated by the thread that starts a read and released by
+// the reader task, usually on a different thread, so released buffers go
+// back on a concurrent free list that any thread can allocate from. At most
+// max_free buffers are kept on the free list, the others are deleted.
+//
+// The pool is reference counted by the server and its sessions, since a
+// session can release its buffers after the server is gone.
+//
+class TcpBufferPool {
+public:
+    static const size_t kDefaultMaxFree = 1024;
+
+    struct Stats {
+        Stats() {
+            hits = 0;
+            misses = 0;
+            recycled = 0;
+            freed = 0;
+        }
+        tbb::atomic<uint64_t> hits;         // Allocated from the free list.
+        tbb::atomic<uint64_t> misses;       // Allocated from the heap.
+        tbb::atomic<uint64_t> recycled;     // Released to the free list.
+        tbb::atomic<uint64_t> freed;        // Released to the heap.
+    };
+
+    TcpBufferPool(size_t buffer_size, size_t max_free = kDefaultMaxFree);
+    ~TcpBufferPool();
+
+    uint8_t *Allocate();
+    void Release(uint8_t *data);
+
+    size_t buffer_size() const { return buffer_size_; }
+    size_t free_count() const { return free_count_; }
+    const Stats &stats() const { return stats_; }
+
+private:
+    size_t buffer_size_;
+    size_t max_free_;
+    tbb::concurrent_queue<uint8_t *> free_list_;
+    tbb::atomic<size_t> free_count_;
+    Stats stats_;
+
+    DISALLOW_COPY_AND_ASSIGN(TcpBufferPool);
+};
+
+#endif  // __TCP_BUFFER_POOL_H__
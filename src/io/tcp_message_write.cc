@@ -4,8 +4,12 @@
 
 #include "io/tcp_message_write.h"
 
+#include <algorithm>
+#include <iterator>
+
 #include "base/util.h"
 #include "base/logging.h"
+#include "base/task.h"
 #include "io/tcp_session.h"
 #include "io/io_log.h"
 
@@ -14,7 +18,8 @@ using namespace boost::system;
 using tbb::mutex;
 
 TcpMessageWriter::TcpMessageWriter(Socket *socket, TcpSession *session) :
-    socket_(socket), offset_(0), session_(session) {
+    socket_(socket), offset_(0), session_(session), coalescing_(false),
+    flush_pending_(false) {
 }
 
 TcpMessageWriter::~TcpMessageWriter() {
@@ -25,9 +30,9 @@ TcpMessageWriter::~TcpMessageWriter() {
     buffer_queue_.clear();
 }
 
-int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
-    int wrote = 0;
-
+template <typename BufferSequence>
+int TcpMessageWriter::Send(const BufferSequence &buffers, size_t len,
+                           error_code &ec) {
     // Update socket write call statistics.
     session_->stats_.write_calls++;
     session_->stats_.write_bytes += len;
@@ -35,26 +40,120 @@ int TcpMessageWriter::Send(const uint8_t *data, size_t len, error_code &ec) {
     session_->server_->stats_.write_calls++;
     session_->server_->stats_.write_bytes += len;
 
-    if (buffer_queue_.empty()) {
-        wrote = socket_->write_some(boost::asio::buffer(data, len), ec);
-        if (TcpSession::IsSocketErrorHard(ec)) return -1;
-        assert(wrote >= 0);
-
-        if ((size_t)wrote != len) {
-            TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
-                "Encountered partial send of " << wrote << " bytes when "
-                "sending " << len << " bytes, Error: " << ec);
-            BufferAppend(data + wrote, len - wrote);
-            DeferWrite();
-        }
-    } else {
+    if (!buffer_queue_.empty()) {
         TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
             "Write not ready. Enqueue buffer (len = " << len << ") and return");
-        BufferAppend(data, len);
+        BufferAppend(buffers, len, 0);
+        return 0;
+    }
+
+    size_t pending = coalesce_buffer_.size();
+    if (coalescing_ && len <= kCoalesceMessageSize &&
+        pending + len <= kCoalesceBufferSize &&
+        std::distance(buffers.begin(), buffers.end()) == 1 &&
+        ScheduleFlush()) {
+        CoalesceAppend(buffers);
+        return len;
+    }
+    if (pending == 0) {
+        return Write(buffers, len, ec);
+    }
+
+    // Write the pending messages along with this one.
+    TcpSession::BufferList list;
+    list.push_back(boost::asio::const_buffer(&coalesce_buffer_[0], pending));
+    list.insert(list.end(), buffers.begin(), buffers.end());
+    int wrote = Write(list, pending + len, ec);
+    coalesce_buffer_.clear();
+    if (wrote < 0) return -1;
+    return std::max(wrote - static_cast<int>(pending), 0);
+}
+
+//
+// Write the buffers with a single system call and queue whatever couldn't be
+// written. Returns the number of bytes written or -1 on a hard error.
+//
+template <typename BufferSequence>
+int TcpMessageWriter::Write(const BufferSequence &buffers, size_t len,
+                            error_code &ec) {
+    int wrote = socket_->write_some(buffers, ec);
+    if (TcpSession::IsSocketErrorHard(ec)) return -1;
+    assert(wrote >= 0);
+
+    session_->stats_.write_syscalls++;
+    session_->stats_.write_syscall_bytes += wrote;
+    session_->server_->stats_.write_syscalls++;
+    session_->server_->stats_.write_syscall_bytes += wrote;
+
+    if ((size_t)wrote != len) {
+        TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_OUT,
+            "Encountered partial send of " << wrote << " bytes when "
+            "sending " << len << " bytes, Error: " << ec);
+        BufferAppend(buffers, len, wrote);
+        DeferWrite();
     }
     return wrote;
 }
 
+//
+// Arrange for the pending messages to be written when the running task
+// returns from Run(). Returns false if not called from a task.
+//
+bool TcpMessageWriter::ScheduleFlush() {
+    if (flush_pending_)
+        return true;
+    if (!Task::AtRunExit(boost::bind(&TcpMessageWriter::Flush, this,
+                                     TcpSessionPtr(session_)))) {
+        return false;
+    }
+    flush_pending_ = true;
+    return true;
+}
+
+void TcpMessageWriter::Flush(TcpSessionPtr session_ref) {
+    mutex::scoped_lock lock(session_->mutex());
+    flush_pending_ = false;
+    if (coalesce_buffer_.empty())
+        return;
+    // Pending messages are written by FlushOnClose() when the session is
+    // closed.
+    if (session_->IsClosedLocked()) {
+        coalesce_buffer_.clear();
+        return;
+    }
+
+    size_t pending = coalesce_buffer_.size();
+    error_code ec;
+    int wrote = Write(buffer(&coalesce_buffer_[0], pending), pending, ec);
+    coalesce_buffer_.clear();
+    if (wrote < 0) {
+        lock.release();
+        TCP_SESSION_LOG_INFO(session_, TCP_DIR_OUT,
+            "Write failed due to error: " << ec.category().name() << " "
+                                          << ec.message());
+        session_->CloseInternal(true);
+    }
+}
+
+void TcpMessageWriter::FlushOnClose() {
+    if (coalesce_buffer_.empty())
+        return;
+
+    // Whatever the socket doesn't take right away is dropped, just like the
+    // data in the buffer_queue_.
+    size_t pending = coalesce_buffer_.size();
+    error_code ec;
+    int wrote = socket_->write_some(buffer(&coalesce_buffer_[0], pending), ec);
+    coalesce_buffer_.clear();
+    if (TcpSession::IsSocketErrorHard(ec))
+        return;
+
+    session_->stats_.write_syscalls++;
+    session_->stats_.write_syscall_bytes += wrote;
+    session_->server_->stats_.write_syscalls++;
+    session_->server_->stats_.write_syscall_bytes += wrote;
+}
+
 void TcpMessageWriter::DeferWrite() {
 
     // Update socket write block count.
@@ -101,6 +200,10 @@ void TcpMessageWriter::HandleWriteReady(TcpSessionPtr session_ptr,
             return;
         }
         assert(wrote >= 0);
+        session_->stats_.write_syscalls++;
+        session_->stats_.write_syscall_bytes += wrote;
+        session_->server_->stats_.write_syscalls++;
+        session_->server_->stats_.write_syscall_bytes += wrote;
         if (wrote != remaining) {
             offset_ += wrote;
             DeferWrite();
@@ -124,13 +227,44 @@ done:
     return;
 }
 
-void TcpMessageWriter::BufferAppend(const uint8_t *src, int bytes) {
+//
+// Copy the buffers of total size len, except for the first skip bytes, into
+// a single buffer and add it to the queue.
+//
+template <typename BufferSequence>
+void TcpMessageWriter::BufferAppend(const BufferSequence &buffers, size_t len,
+                                    size_t skip) {
+    size_t bytes = len - skip;
     u_int8_t *data = new u_int8_t[bytes];
-    memcpy(data, src, bytes);
+    u_int8_t *dst = data;
+    for (typename BufferSequence::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        const u_int8_t *src = buffer_cast<const u_int8_t *>(*iter);
+        size_t size = buffer_size(*iter);
+        if (skip >= size) {
+            skip -= size;
+            continue;
+        }
+        memcpy(dst, src + skip, size - skip);
+        dst += size - skip;
+        skip = 0;
+    }
     mutable_buffer buffer = mutable_buffer(data, bytes);
     buffer_queue_.push_back(buffer);
 }
 
+template <typename BufferSequence>
+void TcpMessageWriter::CoalesceAppend(const BufferSequence &buffers) {
+    if (coalesce_buffer_.capacity() < kCoalesceBufferSize)
+        coalesce_buffer_.reserve(kCoalesceBufferSize);
+    for (typename BufferSequence::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        const u_int8_t *src = buffer_cast<const u_int8_t *>(*iter);
+        coalesce_buffer_.insert(coalesce_buffer_.end(), src,
+                                src + buffer_size(*iter));
+    }
+}
+
 void TcpMessageWriter::DeleteBuffer(mutable_buffer buffer) {
     const uint8_t *data = buffer_cast<const uint8_t *>(buffer);
     delete[] data;
@@ -140,3 +274,8 @@ void TcpMessageWriter::DeleteBuffer(mutable_buffer buffer) {
 void TcpMessageWriter::RegisterNotification(SendReadyCb cb) {
     cb_ = cb;
 }
+
+template int TcpMessageWriter::Send(const const_buffers_1 &buffers,
+                                    size_t len, error_code &ec);
+template int TcpMessageWriter::Send(const TcpSession::BufferList &buffers,
+                                    size_t len, error_code &ec);
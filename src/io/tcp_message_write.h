@@ -6,6 +6,7 @@
 #define __MESSAGE_WRITE_H__
 
 #include <list>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/asio/buffer.hpp>
@@ -25,16 +26,41 @@ public:
     explicit TcpMessageWriter(Socket *, TcpSession *session);
     ~TcpMessageWriter();
 
-    // return false for send  
-    int Send(const uint8_t *msg, size_t len, error_code &ec);
+    // Write a sequence of buffers of total size len with one system call.
+    // Returns the number of bytes written or -1 on a hard error. Data that
+    // can't be written right away is copied and written later.
+    template <typename BufferSequence>
+    int Send(const BufferSequence &buffers, size_t len, error_code &ec);
 
     typedef boost::function<void(const error_code &ec)> SendReadyCb;
     void RegisterNotification(SendReadyCb);
 
+    // With write coalescing, small messages sent from a task are copied and
+    // written with a single system call when the task returns from Run(),
+    // or as soon as kCoalesceBufferSize bytes are pending. Messages larger
+    // than kCoalesceMessageSize, scatter/gather messages and messages sent
+    // outside of a task are written right away, along with any pending
+    // data in the same system call.
+    static const size_t kCoalesceBufferSize = 16 * 1024;
+    static const size_t kCoalesceMessageSize = 512;
+    void set_coalescing(bool coalescing) { coalescing_ = coalescing; }
+
+    // Write the pending messages right before the socket is closed, so that
+    // a message sent just before closing the session, such as a BGP
+    // notification, isn't lost. Requires the session lock.
+    void FlushOnClose();
+
 private:
     typedef boost::intrusive_ptr<TcpSession> TcpSessionPtr;
     typedef std::list<boost::asio::mutable_buffer> BufferQueue;
-    void BufferAppend(const uint8_t *data, int len);
+    template <typename BufferSequence>
+    int Write(const BufferSequence &buffers, size_t len, error_code &ec);
+    template <typename BufferSequence>
+    void BufferAppend(const BufferSequence &buffers, size_t len, size_t skip);
+    template <typename BufferSequence>
+    void CoalesceAppend(const BufferSequence &buffers);
+    bool ScheduleFlush();
+    void Flush(TcpSessionPtr session_ref);
     void DeleteBuffer(boost::asio::mutable_buffer buffer); 
     void DeferWrite();
     void HandleWriteReady(TcpSessionPtr session_ref, const error_code &ec,
@@ -45,6 +71,12 @@ private:
     Socket *socket_;
     int offset_;
     TcpSession *session_;
+
+    // Messages waiting to be written at the end of the task run. Only used
+    // while the buffer_queue_ is empty.
+    bool coalescing_;
+    bool flush_pending_;
+    std::vector<uint8_t> coalesce_buffer_;
 };
 
 #endif
@@ -19,7 +19,8 @@ using namespace std;
 using namespace tbb;
 
 TcpServer::TcpServer(EventManager *evm)
-    : evm_(evm) {
+    : buffer_pool_(new TcpBufferPool(TcpSession::kDefaultBufferSize)),
+      evm_(evm) {
     refcount_ = 0;
     TcpServerManager::AddServer(this);
 }
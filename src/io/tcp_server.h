@@ -10,12 +10,14 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <tbb/mutex.h>
 #ifndef _LIBCPP_VERSION
 #include <tbb/compat/condition_variable>
 #endif
 
 #include "base/util.h"
+#include "io/tcp_buffer_pool.h"
 
 class EventManager;
 class TcpSession;
@@ -63,6 +65,8 @@ class TcpServer {
             write_bytes = 0;
             write_blocked = 0;
             write_blocked_duration_usecs = 0;
+            write_syscalls = 0;
+            write_syscall_bytes = 0;
         }
 
         tbb::atomic<uint64_t> read_calls;
@@ -71,9 +75,16 @@ class TcpServer {
         tbb::atomic<uint64_t> write_bytes;
         tbb::atomic<uint64_t> write_blocked;
         tbb::atomic<uint64_t> write_blocked_duration_usecs;
+        // System calls that wrote to the socket and the bytes they wrote.
+        // With write coalescing there are fewer of them than write_calls.
+        tbb::atomic<uint64_t> write_syscalls;
+        tbb::atomic<uint64_t> write_syscall_bytes;
     };
     const SocketStats &GetSocketStats() const { return stats_; }
 
+    // Receive buffers are allocated from a pool shared by all the sessions.
+    const TcpBufferPool &GetBufferPool() const { return *buffer_pool_; }
+
     //
     // Return the number of tcp sessions in the map
     //
@@ -138,6 +149,7 @@ class TcpServer {
     void SetName(Endpoint local_endpoint);
 
     SocketStats stats_;
+    boost::shared_ptr<TcpBufferPool> buffer_pool_;
     EventManager *evm_;
     // mutex protects the session maps
     mutable tbb::mutex mutex_;
@@ -6,7 +6,6 @@
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
-#include <boost/scoped_array.hpp>
 #include <boost/asio/detail/socket_option.hpp>
 
 #include "base/logging.h"
@@ -50,7 +49,9 @@ TcpSession::TcpSession(
     : server_(server),
       socket_(socket),
       read_on_connect_(async_read_ready),
-      buffer_size_(kDefaultBufferSize),
+      buffer_pool_(server ? server->buffer_pool_ :
+                   boost::shared_ptr<TcpBufferPool>(
+                       new TcpBufferPool(kDefaultBufferSize))),
       established_(false),
       closed_(false),
       direction_(ACTIVE),
@@ -75,8 +76,8 @@ TcpSession::~TcpSession() {
 }
 
 mutable_buffer TcpSession::AllocateBuffer() {
-    u_int8_t *data = new u_int8_t[buffer_size_];
-    mutable_buffer buffer = mutable_buffer(data, buffer_size_);
+    u_int8_t *data = buffer_pool_->Allocate();
+    mutable_buffer buffer = mutable_buffer(data, buffer_pool_->buffer_size());
     {
         mutex::scoped_lock lock(mutex_);
         buffer_queue_.push_back(buffer);
@@ -86,7 +87,7 @@ mutable_buffer TcpSession::AllocateBuffer() {
 
 void TcpSession::DeleteBuffer(mutable_buffer buffer) {
     uint8_t *data = buffer_cast<uint8_t *>(buffer);
-    delete[] data;
+    buffer_pool_->Release(data);
 }
 
 static int BufferCmp(const mutable_buffer &lhs, const const_buffer &rhs) {
@@ -206,6 +207,9 @@ void TcpSession::CloseInternal(bool callObserver) {
     mutex::scoped_lock lock(mutex_);
 
     if (socket_.get() != NULL && !closed_) {
+        if (established_) {
+            writer_->FlushOnClose();
+        }
         boost::system::error_code err;
         socket_->close(err);
     }
@@ -262,6 +266,25 @@ void TcpSession::AsyncWriteHandler(TcpSessionPtr session,
 }
 
 bool TcpSession::Send(const u_int8_t *data, size_t size, size_t *sent) {
+    return SendInternal(buffer(data, size), size, sent);
+}
+
+void TcpSession::set_write_coalescing(bool coalescing) {
+    writer_->set_coalescing(coalescing);
+}
+
+bool TcpSession::SendBuffers(const BufferList &buffers, size_t *sent) {
+    size_t size = 0;
+    for (BufferList::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        size += BufferSize(*iter);
+    }
+    return SendInternal(buffers, size, sent);
+}
+
+template <typename BufferSequence>
+bool TcpSession::SendInternal(const BufferSequence &buffers, size_t size,
+                              size_t *sent) {
     bool ret = true;
     mutex::scoped_lock lock(mutex_);
 
@@ -275,7 +298,7 @@ bool TcpSession::Send(const u_int8_t *data, size_t size, size_t *sent) {
 
     if (socket_->non_blocking()) {
         boost::system::error_code error;
-        int len = writer_->Send(data, size, error);
+        int len = writer_->Send(buffers, size, error);
         lock.release();
         if (len < 0) {
             TCP_SESSION_LOG_INFO(this, TCP_DIR_OUT,
@@ -288,7 +311,7 @@ bool TcpSession::Send(const u_int8_t *data, size_t size, size_t *sent) {
         if (sent) *sent = (len > 0) ? len : 0;
     } else {
         boost::asio::async_write(
-            *socket_.get(), buffer(data, size),
+            *socket_.get(), buffers,
             boost::bind(&TcpSession::AsyncWriteHandler, TcpSessionPtr(this),
                         placeholders::error));
         if (sent) *sent = size;
@@ -361,167 +384,100 @@ int32_t TcpSession::remote_port() const {
 
 TcpMessageReader::TcpMessageReader(TcpSession *session, 
                                    ReceiveCallback callback)
-    : session_(session), callback_(callback), offset_(0), remain_(-1) {
+    : session_(session), callback_(callback), failed_(false) {
 }
 
 TcpMessageReader::~TcpMessageReader() {
 }
 
-// Returns a buffer allocation size that is larger than the message.
-int TcpMessageReader::AllocBufferSize(int length) {
-    const int kMaxMessageSize = GetMaxMessageSize();
-    if (length == -1) {
-        return kMaxMessageSize;
+size_t TcpMessageReader::Reassemble(const uint8_t *data, size_t size,
+                                    size_t length) {
+    if (pending_.empty()) {
+        pending_.reserve(GetMaxMessageSize());
     }
-    int bufsize = 1 << 8;
-    for (; bufsize < kMaxMessageSize && bufsize < length;
-         bufsize <<= 1);
-    return bufsize;
-}
-
-uint8_t *TcpMessageReader::BufferConcat(uint8_t *data, Buffer buffer,
-                                        int msglength) {
-    uint8_t *dst = data;
-
-    while (!queue_.empty()) {
-        Buffer head = queue_.front();
-        const uint8_t *cp = TcpSession::BufferData(head) + offset_;
-        int bytes = TcpSession::BufferSize(head) - offset_;
-        assert((dst - data) + bytes < msglength);
-        memcpy(dst, cp, bytes);
-        dst += bytes;
-        queue_.pop_front();
-        session_->ReleaseBuffer(head);
-        offset_ = 0;
-        remain_ = -1;
+    size_t count = 0;
+    if (pending_.size() < length) {
+        count = min(size, length - pending_.size());
+        pending_.insert(pending_.end(), data, data + count);
     }
-
-    int count = msglength - (dst - data);
-    assert((dst - data) + count <= msglength);
-    memcpy(dst, TcpSession::BufferData(buffer), count);
-    offset_ = count;
-
-    return data;
+    return count;
 }
 
-int TcpMessageReader::QueueByteLength() const {
-    int total = 0;
-    for (BufferQueue::const_iterator iter = queue_.begin();
-         iter != queue_.end(); ++iter) {
-        if (total == 0) {
-            total = TcpSession::BufferSize(*iter) - offset_;
-        } else {
-            total += TcpSession::BufferSize(*iter);
-        }
-    }
-    return total;
+// The message length is invalid, so the rest of the stream can't be framed.
+// Stop reading and close the session.
+void TcpMessageReader::Fail(int msglength) {
+    TCP_SESSION_LOG_INFO(session_, TCP_DIR_IN,
+        "Invalid message length " << msglength << ", closing session");
+    failed_ = true;
+    std::vector<uint8_t>().swap(pending_);
+    session_->CloseInternal(true);
 }
 
-TcpMessageReader::Buffer TcpMessageReader::PullUp(
-               uint8_t *data, Buffer buffer, size_t size) const {
-    size_t offset = 0;
-
-    for (BufferQueue::const_iterator iter = queue_.begin();
-         iter != queue_.end(); ++iter) {
-        const uint8_t *cp;
-        int avail;
-        if (offset == 0) {
-            cp = TcpSession::BufferData(*iter) + offset_;
-            avail = TcpSession::BufferSize(*iter) - offset_;
-        } else {
-            cp = TcpSession::BufferData(*iter);
-            avail = TcpSession::BufferSize(*iter);
-        }
-        int remain = size - offset;
-        avail = min(avail, remain);
-        assert(offset + avail <= size);
-        memcpy(data + offset, cp, avail);
-        offset += avail;
-    }
-
-    int avail = TcpSession::BufferSize(buffer);
-    int remain = size - offset;
-    avail = min(avail, remain);
-    assert(offset + avail <= size);
-    memcpy(data + offset, TcpSession::BufferData(buffer), avail);
-    offset += avail;
-
-    if (offset < size) {
-        return Buffer();
-    }
-    return Buffer(data, size);
+bool TcpMessageReader::IsValidLength(int msglength) {
+    return msglength >= GetHeaderLenSize() &&
+        msglength <= GetMaxMessageSize();
 }
 
 // Read the socket stream and send messages to the peer object.
 void TcpMessageReader::OnRead(Buffer buffer) {
     const int kHeaderLenSize = GetHeaderLenSize();
-    const int kMaxMessageSize = GetMaxMessageSize();
+    const uint8_t *data = TcpSession::BufferData(buffer);
     size_t size = TcpSession::BufferSize(buffer);
     TCP_SESSION_LOG_UT_DEBUG(session_, TCP_DIR_IN, "Read " << size << " bytes");
 
-    if (!queue_.empty()) {
-        int msglength = MsgLength(queue_.front(), offset_);
-        if (msglength < 0) {
-            int queuelen = QueueByteLength();
-            if (queuelen + (int) size < kHeaderLenSize) {
-                queue_.push_back(buffer);
-                return;
-            }
-            boost::scoped_array<uint8_t> data(new uint8_t[kHeaderLenSize]);
-            Buffer header = PullUp(data.get(), buffer, kHeaderLenSize);
-            assert(TcpSession::BufferSize(header) == (size_t) kHeaderLenSize);
-
-            msglength = MsgLength(header, 0);
-            remain_ = msglength - queuelen;
+    if (failed_) {
+        session_->ReleaseBuffer(buffer);
+        return;
+    }
+
+    int offset = 0;
+    if (!pending_.empty()) {
+        // Complete the header, then the message.
+        offset += Reassemble(data, size, kHeaderLenSize);
+        if (pending_.size() < (size_t) kHeaderLenSize) {
+            session_->ReleaseBuffer(buffer);
+            return;
         }
-        if (msglength > kMaxMessageSize) {
-            // TODO: post an error.
+        int msglength = MsgLength(Buffer(&pending_[0], pending_.size()), 0);
+        if (!IsValidLength(msglength)) {
+            Fail(msglength);
+            session_->ReleaseBuffer(buffer);
             return;
         }
-
-        assert(remain_ > 0);
-        if (size < (size_t) remain_) {
-            queue_.push_back(buffer);
-            remain_ -= size;
+        offset += Reassemble(data + offset, size - offset, msglength);
+        if (pending_.size() < (size_t) msglength) {
+            session_->ReleaseBuffer(buffer);
             return;
         }
 
-        // concat the buffers into a contiguous message.
-        boost::scoped_array<uint8_t>
-            data(new uint8_t[AllocBufferSize(msglength)]);
-        BufferConcat(data.get(), buffer, msglength);
-        assert(remain_ == -1);
         // Receive the message
-        callback_(data.get(), msglength);
+        callback_(&pending_[0], msglength);
+        pending_.clear();
     }
 
-    int avail = size - offset_;
+    int avail = size - offset;
     while (avail > 0) {
-        int msglength = MsgLength(buffer, offset_);
-        if (msglength < 0) {
+        int msglength = MsgLength(buffer, offset);
+        if (msglength >= 0 && !IsValidLength(msglength)) {
+            Fail(msglength);
             break;
         }
-        if (msglength > kMaxMessageSize) {
-            // TODO: post an error.
-            return;
-        }
-        if (msglength > avail) {
-            remain_ = msglength - avail;
+        if (msglength < 0 || msglength > avail) {
+            Reassemble(data + offset, avail, avail);
             break;
         }
         // Receive the message
-        callback_(TcpSession::BufferData(buffer) + offset_, msglength);
-        offset_ += msglength;
+        callback_(data + offset, msglength);
+        offset += msglength;
         avail -= msglength;
     }
 
-    if (avail > 0) {
-        queue_.push_back(buffer);
-    } else {
-        session_->ReleaseBuffer(buffer);
-        offset_ = 0;
-        assert(remain_ == -1);
+    // Release the reassembly buffer when the read ends on a message boundary,
+    // it is only needed while messages straddle reads.
+    if (pending_.empty() && pending_.capacity() != 0) {
+        std::vector<uint8_t>().swap(pending_);
     }
+    session_->ReleaseBuffer(buffer);
 }
 
 //
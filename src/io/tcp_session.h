@@ -7,6 +7,7 @@
 
 #include <list>
 #include <deque>
+#include <vector>
 
 #include <boost/asio/buffer.hpp>
 #include <boost/asio/io_service.hpp>
@@ -14,6 +15,7 @@
 #include <boost/intrusive_ptr.hpp>
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <tbb/mutex.h>
 #include <tbb/task.h>
@@ -52,12 +54,16 @@ class TcpSession {
     typedef boost::asio::ip::tcp::endpoint Endpoint;
     typedef boost::function<void(TcpSession *, Event)> EventObserver;
     typedef boost::asio::const_buffer Buffer;
+    typedef std::vector<Buffer> BufferList;
 
     // TcpSession constructor takes ownership of socket.
     TcpSession(TcpServer *server, Socket *socket,
                bool async_read_ready_ = true);
     // Performs a non-blocking send operation.
     virtual bool Send(const u_int8_t *data, size_t size, size_t *sent);
+    // Scatter/gather version of Send. The buffers are written with a single
+    // system call; only data that can't be written right away is copied.
+    bool SendBuffers(const BufferList &buffers, size_t *sent);
 
     // Called by TcpServer to trigger async read.
     virtual bool Connected(Endpoint remote);
@@ -124,6 +130,9 @@ class TcpSession {
     virtual boost::system::error_code SetSocketOptions();
     static bool IsSocketErrorHard(const boost::system::error_code &ec);
     void set_read_on_connect(bool read) { read_on_connect_ = read; }
+    // Coalesce the messages sent from one run of a task into as few system
+    // calls as possible. Must be set before the session sends any data.
+    void set_write_coalescing(bool coalescing);
     void SessionEstablished(Endpoint remote, Direction direction);
 
     void AsyncReadStart();
@@ -146,6 +155,7 @@ class TcpSession {
     typedef boost::intrusive_ptr<TcpSession> TcpSessionPtr;
     friend class TcpServer;
     friend class TcpMessageWriter;
+    friend class TcpMessageReader;
     friend void intrusive_ptr_add_ref(TcpSession *session);
     friend void intrusive_ptr_release(TcpSession *session);
     typedef std::list<boost::asio::mutable_buffer> BufferQueue;
@@ -159,6 +169,10 @@ class TcpSession {
     static void AsyncWriteHandler(TcpSessionPtr session,
                                   const boost::system::error_code &error);
 
+    template <typename BufferSequence>
+    bool SendInternal(const BufferSequence &buffers, size_t size,
+                      size_t *sent);
+
     void ReleaseBufferLocked(Buffer buffer);
     void CloseInternal(bool callObserver);
     void SetEstablished(Endpoint remote, Direction dir);
@@ -179,7 +193,7 @@ class TcpSession {
     TcpServer *server_;
     boost::scoped_ptr<Socket> socket_;
     bool read_on_connect_;
-    int buffer_size_;
+    boost::shared_ptr<TcpBufferPool> buffer_pool_;
 
     // Protects session state and buffer queue.
     mutable tbb::mutex mutex_;
@@ -222,6 +236,12 @@ inline void intrusive_ptr_release(TcpSession *session) {
 // Provides base implementation of OnRead() for TcpSession assuming
 // fixed message header length
 //
+// Messages that are contained in a receive buffer are passed to the callback
+// in place. The part of a message that straddles receive buffers is copied
+// into a reassembly buffer, so that each receive buffer can be released as
+// soon as it has been read. A message with an invalid length closes the
+// session, since the rest of the stream can't be framed.
+//
 class TcpMessageReader {
 public:
     typedef boost::asio::const_buffer Buffer;
@@ -237,22 +257,16 @@ protected:
     virtual const int GetMaxMessageSize() = 0;
 
 private:
-    typedef std::deque<Buffer> BufferQueue;
-
-    // Copy the queue into one contiguous buffer.
-    uint8_t *BufferConcat(uint8_t *data, Buffer buffer, int msglength);
-
-    int QueueByteLength() const;
-
-    Buffer PullUp(uint8_t *data, Buffer buffer, size_t size) const;
-
-    int AllocBufferSize(int length);
+    // Append up to size bytes of data to the reassembly buffer so that it
+    // holds at most length bytes. Returns the number of bytes appended.
+    size_t Reassemble(const uint8_t *data, size_t size, size_t length);
+    bool IsValidLength(int msglength);
+    void Fail(int msglength);
 
     TcpSession *session_;
     ReceiveCallback callback_;
-    BufferQueue queue_;
-    int offset_;
-    int remain_;
+    std::vector<uint8_t> pending_;
+    bool failed_;
 
     DISALLOW_COPY_AND_ASSIGN(TcpMessageReader);
 };
@@ -3,6 +3,7 @@
  */
 
 #include <memory>
+#include <vector>
 
 #include <pthread.h>
 #include <sys/types.h>
@@ -21,6 +22,7 @@
 #include "base/test/task_test_util.h"
 
 #include "io/event_manager.h"
+#include "io/tcp_message_write.h"
 #include "io/tcp_server.h"
 #include "io/tcp_session.h"
 #include "io/test/event_manager_test.h"
@@ -103,6 +105,9 @@ class EchoServer : public TcpServer {
     bool Send(const u_int8_t *data, size_t size, size_t *actual) {
         return session_->Send(data, size, actual);
     }
+    bool SendBuffers(const TcpSession::BufferList &buffers, size_t *actual) {
+        return session_->SendBuffers(buffers, actual);
+    }
 
     EchoSession *GetSession() const { return session_; }
     void SetSocketOptions() { session_->SetSocketOptions(); }
@@ -116,6 +121,37 @@ EchoSession::EchoSession(EchoServer *server, Socket *socket)
     set_observer(boost::bind(&EchoSession::OnEvent, this, _1, _2));
 }
 
+//
+// Sends a number of small messages from a single run of a task.
+//
+class SendTask : public Task {
+public:
+    SendTask(EchoServer *server, int count, size_t size, bool close = false)
+        : Task(TaskScheduler::GetInstance()->GetTaskId("io::test::Send")),
+          server_(server), count_(count), size_(size), close_(close) {
+    }
+
+    virtual bool Run() {
+        std::vector<u_int8_t> msg(size_, 0x5a);
+        for (int i = 0; i < count_; i++) {
+            size_t sent = 0;
+            bool res = server_->Send(&msg[0], msg.size(), &sent);
+            EXPECT_TRUE(res);
+            EXPECT_EQ(msg.size(), sent);
+        }
+        if (close_) {
+            server_->GetSession()->Close();
+        }
+        return true;
+    }
+
+private:
+    EchoServer *server_;
+    int count_;
+    size_t size_;
+    bool close_;
+};
+
 class EchoServerTest : public ::testing::Test {
 protected:
     EchoServerTest() {
@@ -248,6 +284,137 @@ TEST_F(EchoServerTest, Basic) {
     task_util::WaitForIdle();
     TASK_UTIL_ASSERT_EQ(total, server_->GetSession()->GetTotal());
     server_->GetSession()->ResetTotal();
+
+    // Receive buffers are recycled through the server's buffer pool.
+    const TcpBufferPool &pool = server_->GetBufferPool();
+    EXPECT_LT(0, (int) pool.stats().hits);
+    EXPECT_LT(0, (int) pool.stats().recycled);
+}
+
+TEST_F(EchoServerTest, SendBuffers) {
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();		// Must be called after initialization
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+
+    client_->CreateSession();
+    client_->EchoServer::ConnectTest(port);
+    client_->SetSocketOptions();
+    task_util::WaitForIdle();
+    TASK_UTIL_ASSERT_TRUE((server_->GetSession() != NULL));
+
+    const char head[] = "Head";
+    char body[4096];
+    memset(body, 0xab, sizeof(body));
+    TcpSession::BufferList buffers;
+    buffers.push_back(boost::asio::buffer(head, sizeof(head)));
+    buffers.push_back(boost::asio::buffer(body, sizeof(body)));
+
+    size_t sent = 0;
+    int total = 0;
+    for (int i = 0; i < 64; i++) {
+        bool res = client_->SendBuffers(buffers, &sent);
+        total += sizeof(head) + sizeof(body);
+        if (!res) {
+            // The unwritten data is copied, so the buffers can be reused.
+            memset(body, 0, sizeof(body));
+            break;
+        }
+        EXPECT_EQ(sizeof(head) + sizeof(body), sent);
+    }
+    TASK_UTIL_ASSERT_EQ(total, server_->GetSession()->GetTotal());
+    server_->GetSession()->ResetTotal();
+}
+
+//
+// Messages sent from one run of a task are coalesced into a few system calls,
+// some of them when the pending data exceeds the coalesce buffer size.
+//
+TEST_F(EchoServerTest, WriteCoalescing) {
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();		// Must be called after initialization
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+
+    client_->CreateSession();
+    client_->GetSession()->set_write_coalescing(true);
+    client_->EchoServer::ConnectTest(port);
+    client_->SetSocketOptions();
+    task_util::WaitForIdle();
+    TASK_UTIL_ASSERT_TRUE((server_->GetSession() != NULL));
+    TASK_UTIL_ASSERT_TRUE(client_->GetSession()->IsEstablished());
+
+    const int kCount = 1024;
+    const size_t kSize = 40;
+    TaskScheduler::GetInstance()->Enqueue(
+        new SendTask(client_, kCount, kSize));
+    task_util::WaitForIdle();
+    TASK_UTIL_ASSERT_EQ(kCount * kSize,
+                        (size_t) server_->GetSession()->GetTotal());
+
+    const TcpServer::SocketStats &stats =
+        client_->GetSession()->GetSocketStats();
+    EXPECT_EQ(kCount, (int) stats.write_calls);
+    EXPECT_EQ(kCount * kSize, (size_t) stats.write_syscall_bytes);
+    EXPECT_LT(0, (int) stats.write_syscalls);
+    EXPECT_GT(kCount / 16, (int) stats.write_syscalls);
+
+    // Large messages are written right away, one system call each, rather
+    // than copied.
+    size_t total = kCount * kSize;
+    int syscalls = stats.write_syscalls;
+    const int kLargeCount = 4;
+    const size_t kLargeSize = 4 * TcpMessageWriter::kCoalesceMessageSize;
+    TaskScheduler::GetInstance()->Enqueue(
+        new SendTask(client_, kLargeCount, kLargeSize));
+    task_util::WaitForIdle();
+    total += kLargeCount * kLargeSize;
+    TASK_UTIL_ASSERT_EQ(total, (size_t) server_->GetSession()->GetTotal());
+    EXPECT_LE(syscalls + kLargeCount, (int) stats.write_syscalls);
+
+    // Messages sent outside of a task are written right away.
+    const char msg[] = "Test Message";
+    client_->Send((const u_int8_t *) msg, sizeof(msg), NULL);
+    total += sizeof(msg);
+    TASK_UTIL_ASSERT_EQ(total, (size_t) server_->GetSession()->GetTotal());
+    EXPECT_EQ(total, (size_t) stats.write_syscall_bytes);
+}
+
+//
+// Messages sent from a task that then closes the session, like a BGP
+// notification, are written before the socket is closed.
+//
+TEST_F(EchoServerTest, WriteCoalescingClose) {
+    server_->Initialize(0);
+    task_util::WaitForIdle();
+    thread_->Start();		// Must be called after initialization
+    int port = server_->GetPort();
+    ASSERT_LT(0, port);
+
+    client_->CreateSession();
+    client_->GetSession()->set_write_coalescing(true);
+    client_->EchoServer::ConnectTest(port);
+    client_->SetSocketOptions();
+    task_util::WaitForIdle();
+    TASK_UTIL_ASSERT_TRUE((server_->GetSession() != NULL));
+    TASK_UTIL_ASSERT_TRUE(client_->GetSession()->IsEstablished());
+
+    const int kCount = 16;
+    const size_t kSize = 40;
+    TaskScheduler::GetInstance()->Enqueue(
+        new SendTask(client_, kCount, kSize, true));
+    task_util::WaitForIdle();
+    TASK_UTIL_ASSERT_EQ(kCount * kSize,
+                        (size_t) server_->GetSession()->GetTotal());
+    EXPECT_FALSE(client_->GetSession()->IsEstablished());
+    TASK_UTIL_EXPECT_FALSE(server_->GetSession()->IsEstablished());
+
+    const TcpServer::SocketStats &stats =
+        client_->GetSession()->GetSocketStats();
+    EXPECT_EQ(kCount * kSize, (size_t) stats.write_syscall_bytes);
+    EXPECT_EQ(1, (int) stats.write_syscalls);
 }
 
 TEST_F(EchoServerTest, ReadInterrupt) {
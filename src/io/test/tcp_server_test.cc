@@ -415,6 +415,77 @@ TEST_F(ReaderUnitTest, StreamRead) {
     TASK_UTIL_EXPECT_EQ(buf_list.size(), (size_t) session_.release_count());
 }
 
+//
+// A message that spans several reads, including one that splits its header,
+// is reassembled and every buffer is released as soon as it has been read.
+//
+TEST_F(ReaderUnitTest, StreamReadStraddle) {
+    uint8_t stream[4096];
+    int sizes[] = { 1000, 50 };
+    uint8_t *data = stream;
+    for (size_t i = 0; i < ARRAYLEN(sizes); i++) {
+        CreateFakeMessage(data, sizes[i]);
+        data += sizes[i];
+    }
+    int segments[] = { 5, 300, 300, 395, 30, 20 };
+    data = stream;
+    for (size_t i = 0; i < ARRAYLEN(segments); i++) {
+        session_.Read(mutable_buffer(data, segments[i]));
+        data += segments[i];
+        EXPECT_EQ(i + 1, (size_t) session_.release_count());
+    }
+
+    int i = 0;
+    for (vector<int>::const_iterator iter = session_.begin();
+         iter != session_.end(); ++iter) {
+        EXPECT_EQ(sizes[i], *iter);
+        i++;
+    }
+    EXPECT_EQ(ARRAYLEN(sizes), i);
+}
+
+//
+// A message with an invalid length closes the session and nothing after it
+// is parsed.
+//
+TEST_F(ReaderUnitTest, InvalidLength) {
+    uint8_t stream[512];
+    CreateFakeMessage(stream, 100);
+    memset(stream + 100, 0xff, 16);
+    put_value(stream + 116, 2, 10);
+    CreateFakeMessage(stream + 200, 100);
+
+    session_.Read(mutable_buffer(stream, 150));
+    session_.Read(mutable_buffer(stream + 150, 150));
+    EXPECT_TRUE(session_.IsClosed());
+    ASSERT_EQ(1, session_.end() - session_.begin());
+    EXPECT_EQ(100, *session_.begin());
+    EXPECT_EQ(2, session_.release_count());
+}
+
+TEST(TcpBufferPoolTest, Recycle) {
+    TcpBufferPool pool(64, 2);
+    uint8_t *buffers[3];
+    for (int i = 0; i < 3; i++) {
+        buffers[i] = pool.Allocate();
+    }
+    EXPECT_EQ(0, (int) pool.stats().hits);
+    EXPECT_EQ(3, (int) pool.stats().misses);
+
+    for (int i = 0; i < 3; i++) {
+        pool.Release(buffers[i]);
+    }
+    EXPECT_EQ(2, (int) pool.stats().recycled);
+    EXPECT_EQ(1, (int) pool.stats().freed);
+    EXPECT_EQ(2, (int) pool.free_count());
+
+    uint8_t *data = pool.Allocate();
+    EXPECT_TRUE(data == buffers[0] || data == buffers[1]);
+    EXPECT_EQ(1, (int) pool.stats().hits);
+    EXPECT_EQ(1, (int) pool.free_count());
+    pool.Release(data);
+}
+
 }  // namespace
 
 int main(int argc, char **argv) {
@@ -1096,6 +1096,7 @@ KSyncObjectManager::KSyncObjectManager() {
     event_queue_ = new WorkQueue<KSyncObjectEvent *>
                    (TaskScheduler::GetInstance()->GetTaskId("Agent::KSync"), 0,
                     boost::bind(&KSyncObjectManager::Process, this, _1));
+    event_queue_->set_name("KSync Object Events");
 }
 
 KSyncObjectManager::~KSyncObjectManager() {
@@ -284,6 +284,7 @@ KSyncSock::KSyncSock() : tx_count_(0), err_count_(0) {
                              GetTaskId(IoContext::io_wq_names[i]), 0,
                              boost::bind(&KSyncSock::ProcessKernelData, this, 
                                          _1));
+        work_queue_[i]->set_name(IoContext::io_wq_names[i]);
     }
     rx_buff_ = NULL;
     seqno_ = 0;
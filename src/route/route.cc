@@ -4,6 +4,8 @@
 
 #include "route/route.h"
 
+#include <iterator>
+
 Route::Route() {
 }
 
@@ -43,3 +45,74 @@ void Route::Sort(Compare compare, const Path *prev_front) {
         set_last_change_at_to_now();
     }
 }
+
+//
+// Binary search for the first path that is worse than the new one and
+// insert the new path before it. The new path ends up after any paths that
+// are equally preferred, which is where the (stable) Sort would put it.
+// Even if the compare function is not transitive, the new path is in order
+// with the paths on either side of it.
+//
+// Advancing list iterators is cheap compared to the compare function, so
+// this only makes a logarithmic number of comparisons.
+//
+size_t Route::InsertSorted(const Path *ipath, Compare compare,
+                           const Path *prev_front) {
+    Path *path = const_cast<Path *> (ipath);
+    size_t compares = 0;
+
+    path->set_time_stamp_usecs(UTCTimestampUsec());
+    PathList::iterator first = path_.begin();
+    size_t count = path_.size();
+    while (count > 0) {
+        size_t step = count / 2;
+        PathList::iterator it = first;
+        std::advance(it, step);
+        compares++;
+        if (!compare(*path, *it)) {
+            first = ++it;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    path_.insert(first, *path);
+
+    // If the best path changes, update route's time stamp.
+    if (prev_front != front()) {
+        set_last_change_at_to_now();
+    }
+    return compares;
+}
+
+//
+// Remove a path from a sorted list. The compare function need not be
+// transitive (BGP compares MED only between paths from the same neighbor
+// AS), so the two paths that become adjacent may be out of order even
+// though each of them was in order with the removed path. Sort the whole
+// list in that case. Returns false if the list had to be sorted.
+//
+bool Route::RemoveSorted(const Path *ipath, Compare compare,
+                         const Path *prev_front, size_t *compares) {
+    Path *path = const_cast<Path *> (ipath);
+    bool in_order = true;
+
+    *compares = 0;
+    path->set_time_stamp_usecs(UTCTimestampUsec());
+    PathList::iterator next = path_.erase(path_.iterator_to(*path));
+    if (next != path_.begin() && next != path_.end()) {
+        PathList::iterator prev = next;
+        --prev;
+        (*compares)++;
+        if (compare(*next, *prev)) {
+            path_.sort(compare);
+            in_order = false;
+        }
+    }
+
+    // If the best path changes, update route's time stamp.
+    if (prev_front != front()) {
+        set_last_change_at_to_now();
+    }
+    return in_order;
+}
@@ -43,6 +43,17 @@ public:
     // Sort paths based on compare function.
     void Sort(Compare compare, const Path *prev_front);
 
+    // Insert a path into a list that is already sorted based on compare
+    // function. Returns the number of comparisons made.
+    size_t InsertSorted(const Path *path, Compare compare,
+                        const Path *prev_front);
+
+    // Remove a path from a sorted list, sorting the remaining paths again if
+    // the ones next to it are out of order. Returns false if the list was
+    // sorted.
+    bool RemoveSorted(const Path *path, Compare compare,
+                      const Path *prev_front, size_t *compares);
+
     const PathList &GetPathList() const {
         return path_;
     }
@@ -323,9 +323,14 @@ bool Inet4UcRouteTable::DelExplicitRoute(DBTablePartBase *part,
 }
 
 Inet4UcRoute *Inet4UcRouteTable::FindLPM(const Ip4Address &ip) {
-    Ip4Address addr = ip::address_v4(ip.to_ulong());
-    Inet4UcRoute key(NULL, addr, 32);
-    return tree_.LPMFind(&key);
+    return FindLPM(ip, 32);
+}
+
+// Search with the address bytes rather than an Inet4UcRoute key, which
+// would run the DBEntry constructor on every lookup.
+Inet4UcRoute *Inet4UcRouteTable::FindLPM(const Ip4Address &ip, uint8_t plen) {
+    Ip4Address::bytes_type key = ip.to_bytes();
+    return tree_.LPMFind(key.data(), plen);
 }
 
 Inet4UcRoute *Inet4UcRouteTable::FindRoute(const string &vrf_name, 
@@ -339,8 +344,7 @@ Inet4UcRoute *Inet4UcRouteTable::FindResolveRoute(const Ip4Address &ip) {
     uint8_t plen = 32;
     Inet4UcRoute *rt = NULL;
     do {
-        Inet4UcRoute key(NULL, ip, plen);
-        rt = tree_.LPMFind(&key);
+        rt = FindLPM(ip, plen);
         if (rt) {
             const NextHop *nh = rt->GetActiveNextHop();
             if (nh && nh->GetType() == NextHop::RESOLVE)
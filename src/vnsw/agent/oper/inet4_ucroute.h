@@ -337,6 +337,8 @@ public:
                                uint8_t plen);
     // Find a matching route for the IP address
     Inet4UcRoute *FindLPM(const Ip4Address &ip);
+    // Find the longest route of at most plen bits matching the address
+    Inet4UcRoute *FindLPM(const Ip4Address &ip, uint8_t plen);
     static Inet4UcRoute *FindRoute(const string &vrf_name, const Ip4Address &ip);
     Inet4UcRoute *FindResolveRoute(const Ip4Address &ip);
     static Inet4UcRoute *FindResolveRoute(const string &vrf_name, const Ip4Address &ip);
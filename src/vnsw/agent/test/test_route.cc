@@ -570,6 +570,10 @@ TEST_F(RouteTest, FindLPM) {
 
     rt = Agent::GetInstance()->GetDefaultInet4UcRouteTable()->FindLPM(lpm4_ip_);
     EXPECT_EQ(lpm4_ip_, rt->GetIpAddress());
+    rt = Agent::GetInstance()->GetDefaultInet4UcRouteTable()->FindLPM(lpm4_ip_, 24);
+    EXPECT_EQ(lpm3_ip_, rt->GetIpAddress());
+    rt = Agent::GetInstance()->GetDefaultInet4UcRouteTable()->FindLPM(lpm4_ip_, 12);
+    EXPECT_EQ(lpm1_ip_, rt->GetIpAddress());
     DeleteRoute(Agent::GetInstance()->GetLocalPeer(), Agent::GetInstance()->GetDefaultVrf(), lpm4_ip_, 32);
     client->WaitForIdle();
     rt = Agent::GetInstance()->GetDefaultInet4UcRouteTable()->FindLPM(lpm4_ip_);
@@ -13,6 +13,8 @@ public:
     // Set new xml doc. Null string means reset to new doc. 
     // Resets previous doc
     virtual int LoadDoc(const std::string &doc) = 0;
+    // Set new xml doc from a buffer that needs not be null terminated.
+    virtual int LoadDoc(const char *doc, size_t size) = 0;
 
     // returns bytes encoded. -1 for error.
     virtual int WriteDoc(uint8_t *buf)= 0;
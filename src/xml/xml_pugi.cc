@@ -171,16 +171,20 @@ void XmlPugi::SetContext(pugi::xml_node node, pugi::xml_attribute attrib) {
 }
 
 int XmlPugi::LoadDoc(const std::string &document) {
+    return LoadDoc(document.c_str(), document.size());
+}
+
+int XmlPugi::LoadDoc(const char *document, size_t size) {
     RewindDoc();
     doc_.reset();
 
-    pugi::xml_parse_result ret = doc_.load_buffer(document.c_str(), document.size(), 
+    pugi::xml_parse_result ret = doc_.load_buffer(document, size,
                                                  pugi::parse_default, 
                                                  pugi::encoding_utf8);
     if (ret == false) {
         LOG(DEBUG, "XML doc load failed, code: " << ret << " " << ret.description());
-        LOG(DEBUG, "Error offset: " << ret.offset << " (error at [..." << (document.c_str() + ret.offset) << "]");
-        LOG(DEBUG, "Document: " << document);
+        LOG(DEBUG, "Error offset: " << ret.offset << " (error at [..." << std::string(document + ret.offset, size - ret.offset) << "]");
+        LOG(DEBUG, "Document: " << std::string(document, size));
         return -1;
     }
     return 0;
@@ -11,6 +11,7 @@ class XmlPugi : public XmlBase {
 public:
 
     virtual int LoadDoc(const std::string &doc);
+    virtual int LoadDoc(const char *doc, size_t size);
     virtual int WriteDoc(uint8_t *buf);
     virtual int WriteRawDoc(uint8_t *buf);
     virtual void PrintDoc(std::ostream& os) const;
@@ -2,170 +2,384 @@
  * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
  */
 
+#include <boost/regex.hpp>
+
 #include "control-node/control_node.h"
 #include "base/test/task_test_util.h"
-#include "xmpp/xmpp_state_machine.h"
-#include "xmpp/xmpp_session.h"
+#include "xmpp/xmpp_stanza_parser.h"
 #include "xmpp/xmpp_str.h"
 
 #include "base/logging.h"
+#include "base/task.h"
 #include "base/util.h"
-#include "xmpp/xmpp_config.h"
 
 #include "testing/gunit.h"
 
 using namespace std;
 
-class XmppRegexMock : public XmppSession {
+//
+// Regular expression based matching of the messages in an XMPP stream, as
+// done by XmppSession before XmppStanzaParser. Baseline of the benchmark.
+//
+class XmppRegexMock {
 public:
-    XmppRegexMock(TcpServer *server, Socket *sock) : 
-                  XmppSession(server, sock), p1("<(iq|message)"), bufx_("") { }
+    XmppRegexMock() : p1("<(iq|message)"), tag_known_(0) {
+        offset_ = buf_.begin();
+    }
     ~XmppRegexMock() { }
 
-    //boost::regex Regex() { return p1; }
-    void SetRegex(const char *ss) { p1 = ss; }
+    // Split the stanzas in a received buffer, returns the number of
+    // complete messages.
+    int Read(const uint8_t *data, size_t size) {
+        int count = 0;
+        bool more = Match(data, size, true);
+        while (!more) {
+            // The message used to be copied out of the buffer.
+            string::const_iterator st = buf_.begin();
+            string xml(st, offset_);
+            count++;
+            if (LeftOver()) {
+                string::const_iterator st = buf_.end();
+                ReplaceBuf(string(offset_, st));
+                more = Match(data, size, false);
+            } else {
+                buf_.clear();
+                break;
+            }
+        }
+        return count;
+    }
 
-    void AppendString(const string &str) {
-        bufx_ += str;
-        SetBuf(str);
+private:
+    static boost::regex tag_to_pattern(const char *tag) {
+        std::string token("</");
+        token += ++tag;
+        token += "[\\s\\t\\r\\n]*>";
+        return boost::regex(token.c_str());
     }
 
-    void SetString(const string &str) {
-        bufx_ = str;
-        ReplaceBuf(bufx_);
+    void SetBuf(const std::string &str) {
+        if (buf_.empty()) {
+            ReplaceBuf(str);
+        } else {
+            int pos = offset_ - buf_.begin();
+            buf_ += str;
+            offset_ = buf_.begin() + pos;
+        }
     }
 
-    int MatchTest() {
-        int ret = this->MatchRegex(p1);
-        return ret;
+    void ReplaceBuf(const std::string &str) {
+        buf_ = str;
+        buf_.reserve(4096 + 8);
+        offset_ = buf_.begin();
     }
 
-    const char *TagStr(uint8_t i) {
-        tag_ = string(res_[i].first, res_[i].second);
-        return tag_.c_str();
+    bool LeftOver() const {
+        if (buf_.empty())
+            return false;
+        return (buf_.end() != offset_);
     }
 
-    const char *FromOffset() {
-        string::const_iterator end = buf_.end();
-        tag_ = string(offset_, end); 
-        return tag_.c_str();
+    int MatchRegex(const boost::regex &patt) {
+        std::string::const_iterator end = buf_.end();
+        if (regex_search(offset_, end, res_, patt,
+                         boost::match_default | boost::match_partial) == 0) {
+            return -1;
+        }
+        if (res_[0].matched == false) {
+            offset_ = res_[0].first;
+            return 1;
+        } else {
+            begin_tag_ = string(res_[0].first, res_[0].second);
+            offset_ = res_[0].second;
+            return 0;
+        }
     }
 
-    const char *Buf() {
-        string::const_iterator st = buf_.begin();
-        tag_ = string(st, offset_); 
-        return tag_.c_str();
+    // Returns false when a complete message ends at offset_.
+    bool Match(const uint8_t *data, size_t size, bool new_buf) {
+        if (new_buf) {
+            std::string str(data, data + size);
+            SetBuf(str);
+        }
+        do {
+            if (!tag_known_) {
+                size_t pos = buf_.find_first_not_of(sXMPP_VALIDWS);
+                if (pos != 0) {
+                    if (pos == string::npos) pos = buf_.size();
+                    offset_ = buf_.begin() + pos;
+                    return false;
+                }
+            }
+            int m = MatchRegex(tag_known_ ?
+                               tag_to_pattern(begin_tag_.c_str()) : p1);
+            if (m != 0)
+                return true;
+            tag_known_ ^= 1;
+            if (!tag_known_)
+                return false;
+        } while (true);
     }
 
-private:
     boost::regex p1;
-    string bufx_;
-    string tag_;
+    string buf_;
+    string::const_iterator offset_;
+    string begin_tag_;
+    int tag_known_;
+    boost::match_results<std::string::const_iterator> res_;
 };
 
-class XmppRegexTest : public ::testing::Test {
+namespace {
+
+class XmppStanzaParserTest : public ::testing::Test {
 protected:
-    virtual void SetUp() {
-        regex_.reset(new XmppRegexMock(NULL, NULL));
+    typedef pair<XmppStanza::XmppMessageType, string> Message;
+
+    // Feed the chunks to the parser the way XmppSession does.
+    vector<Message> Parse(const vector<string> &chunks,
+                          XmppStanzaParser::Mode mode) {
+        vector<Message> messages;
+        string partial;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const uint8_t *data =
+                reinterpret_cast<const uint8_t *>(chunks[i].data());
+            size_t size = chunks[i].size();
+            size_t offset = 0;
+            while (offset < size) {
+                size_t len = parser_.Scan(data + offset, size - offset, mode);
+                partial.append(chunks[i], offset, len);
+                offset += len;
+                if (parser_.complete()) {
+                    messages.push_back(make_pair(parser_.type(), partial));
+                    partial.clear();
+                }
+            }
+        }
+        partial_ = partial;
+        return messages;
     }
 
-    virtual void TearDown() {
+    XmppStanzaParser parser_;
+    string partial_;
+};
+
+TEST_F(XmppStanzaParserTest, Stanza) {
+    vector<string> chunks;
+    chunks.push_back("<iq> blah blah </iq><");
+    chunks.push_back("iq> Rest of the messsage </iq>");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(2, messages.size());
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[0].first);
+    EXPECT_EQ("<iq> blah blah </iq>", messages[0].second);
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[1].first);
+    EXPECT_EQ("<iq> Rest of the messsage </iq>", messages[1].second);
+    EXPECT_TRUE(partial_.empty());
+}
+
+TEST_F(XmppStanzaParserTest, Whitespace) {
+    vector<string> chunks;
+    chunks.push_back("Ȁ<message to='a'/>\n <iq/>  ");
+    chunks.push_back("\t<i");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(6, messages.size());
+    EXPECT_EQ(XmppStanza::WHITESPACE_MESSAGE_STANZA, messages[0].first);
+    EXPECT_EQ("Ȁ", messages[0].second);
+    EXPECT_EQ(XmppStanza::MESSAGE_STANZA, messages[1].first);
+    EXPECT_EQ("<message to='a'/>", messages[1].second);
+    EXPECT_EQ(XmppStanza::WHITESPACE_MESSAGE_STANZA, messages[2].first);
+    EXPECT_EQ("\n ", messages[2].second);
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[3].first);
+    EXPECT_EQ(XmppStanza::WHITESPACE_MESSAGE_STANZA, messages[4].first);
+    EXPECT_EQ("  ", messages[4].second);
+    EXPECT_EQ(XmppStanza::WHITESPACE_MESSAGE_STANZA, messages[5].first);
+    EXPECT_EQ("\t", messages[5].second);
+    EXPECT_EQ("<i", partial_);
+}
+
+// Markup that looks like the end of the stanza inside attribute values,
+// CDATA sections and comments, and nested elements with the same name.
+TEST_F(XmppStanzaParserTest, Markup) {
+    vector<string> chunks;
+    chunks.push_back("<iq a='</iq>' b=\"/>\"><iq><x/></iq>");
+    chunks.push_back("<![CDATA[</iq>]]><!-- </iq> -->");
+    chunks.push_back("<?pi </iq> ?></iq>");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[0].first);
+    EXPECT_EQ(chunks[0] + chunks[1] + chunks[2], messages[0].second);
+}
+
+// Each byte in a separate buffer.
+TEST_F(XmppStanzaParserTest, ByteAtATime) {
+    string iq("<iq type='set'><pubsub><item id='1'/></pubsub></iq>");
+    vector<string> chunks;
+    for (size_t i = 0; i < iq.size(); i++) {
+        chunks.push_back(iq.substr(i, 1));
     }
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[0].first);
+    EXPECT_EQ(iq, messages[0].second);
+}
 
+// Text before the stanza is part of it, an unmatched end tag and unknown
+// elements are invalid messages.
+TEST_F(XmppStanzaParserTest, Garbage) {
+    vector<string> chunks;
+    chunks.push_back("abc <iq/></stream:stream><presence/>");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(3, messages.size());
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[0].first);
+    EXPECT_EQ("abc <iq/>", messages[0].second);
+    EXPECT_EQ(XmppStanza::INVALID, messages[1].first);
+    EXPECT_EQ("</stream:stream>", messages[1].second);
+    EXPECT_EQ(XmppStanza::INVALID, messages[2].first);
+}
 
-    auto_ptr<XmppRegexMock> regex_;
-};
+// The first start tag is the type of the stanza, nested elements and text
+// are part of it.
+TEST_F(XmppStanzaParserTest, Type) {
+    vector<string> chunks;
+    chunks.push_back("<iq what =1><comm> blah </comm> </iq>");
+    chunks.push_back("<message a = '2'> <item> blah blah </item></message>");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(2, messages.size());
+    EXPECT_EQ(XmppStanza::IQ_STANZA, messages[0].first);
+    EXPECT_EQ(chunks[0], messages[0].second);
+    EXPECT_EQ(XmppStanza::MESSAGE_STANZA, messages[1].first);
+    EXPECT_EQ(chunks[1], messages[1].second);
+    EXPECT_TRUE(partial_.empty());
+}
 
-namespace {
+// End tag of the stanza split across buffers.
+TEST_F(XmppStanzaParserTest, PartialEndTag) {
+    vector<string> chunks;
+    chunks.push_back("<message a = '2'> <item> blah blah </item></mess");
+    chunks.push_back("age><iq a = '2'> <item>");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ(XmppStanza::MESSAGE_STANZA, messages[0].first);
+    EXPECT_EQ("<message a = '2'> <item> blah blah </item></message>",
+              messages[0].second);
+    EXPECT_EQ("<iq a = '2'> <item>", partial_);
+}
+
+// Stanza that is incomplete until the last buffer, followed by the start of
+// the next one.
+TEST_F(XmppStanzaParserTest, Incomplete) {
+    vector<string> chunks;
+    chunks.push_back("<message a = '2'> ");
+    chunks.push_back("<item> blah blah ");
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STANZA);
+    EXPECT_EQ(0, messages.size());
+    EXPECT_EQ(chunks[0] + chunks[1], partial_);
+
+    chunks.push_back("</item></message><somejunk>");
+    parser_.Reset();
+    messages = Parse(chunks, XmppStanzaParser::STANZA);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ(XmppStanza::MESSAGE_STANZA, messages[0].first);
+    EXPECT_EQ("<message a = '2'> <item> blah blah </item></message>",
+              messages[0].second);
+    EXPECT_EQ("<somejunk>", partial_);
+}
+
+TEST_F(XmppStanzaParserTest, StreamHeader) {
+    string header("<?xml version=\"1.0\"?>\n<stream:stream from=\"a\" "
+        "to=\"b\" xmlns:stream=\"http://etherx.jabber.org/streams\" >");
+    vector<string> chunks;
+    chunks.push_back(header.substr(0, 30));
+    chunks.push_back(header.substr(30));
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STREAM_HEADER);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ(XmppStanza::STREAM_HEADER, messages[0].first);
+    EXPECT_EQ(header, messages[0].second);
+}
+
+// The stream header ends with the stream start tag, whatever its attributes.
+TEST_F(XmppStanzaParserTest, StreamHeaderAttributes) {
+    string header("<?xml version='1.0'?><stream:stream iq = '2'>");
+    vector<string> chunks;
+    chunks.push_back(header);
+    vector<Message> messages = Parse(chunks, XmppStanzaParser::STREAM_HEADER);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ(XmppStanza::STREAM_HEADER, messages[0].first);
+    EXPECT_EQ(header, messages[0].second);
+}
+
+//
+// Benchmark of the stanza splitting of a stream of route updates, with the
+// regular expressions used before and with XmppStanzaParser. The stream is
+// read in chunks of the size of the TcpSession receive buffers. Only runs
+// when the number of messages is set with XMPP_BENCH_MESSAGES, e.g. 2000.
+//
+TEST_F(XmppStanzaParserTest, Benchmark) {
+    int count = task_util_bench_count("XMPP_BENCH_MESSAGES", 0);
+    if (count == 0)
+        return;
+
+    string iq("<iq type='set' from='agent@vnsw.contrailsystems.com' "
+              "to='network-control@contrailsystems.com/bgp-peer' "
+              "id='pubsub1'>\n"
+              "<pubsub xmlns='http://jabber.org/protocol/pubsub'>\n"
+              "<publish node='blue'>\n");
+    for (int i = 0; i < 32; i++) {
+        iq += "<item id='10.1.1.1/32'><entry xmlns='http://www.contrailsystems"
+              ".com/bgp-l3vpn-unicast-cfg.xsd'><nlri><af>1</af><address>"
+              "10.1.1.1/32</address></nlri><next-hops><next-hop><af>1</af>"
+              "<address>192.168.1.1</address><label>10000</label></next-hop>"
+              "</next-hops><version>1</version></entry></item>\n";
+    }
+    iq += "</publish>\n</pubsub>\n</iq>";
 
-TEST_F(XmppRegexTest, Connection) {
-    string str("<iq what =1><comm> blah </comm> </iq>");
-    string tag;
-
-    // basic test...
-    regex_->SetString(str);
-    
-    // full match
-    int ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "<iq"); 
-    //std::cout << " Matching string : " << regex_->TagStr(0) << std::endl;
-
-    // expect no match
-    regex_->SetString(str);
-    regex_->SetRegex("<bbl");
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == -1);
-
-    regex_->SetString(str);
-    regex_->SetRegex("</iq>t"); // partial match
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 1);
-    //std::cout << " Matching string : " << regex_->TagStr(0) << std::endl;
-
-    str = "<?xml version='1.0'?><stream:stream iq = '2\"><tag1> document blah </tag1> </stream:stream>";
-    regex_->SetString(str);
-
-    regex_->SetRegex("(<?.*?>)(<stream:stream\\s*iq\\s*=\\s*[\"'].*[\"'])");
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    //std::cout << " Matching string : " << regex_->TagStr(2) << std::endl;
-    const char *match = "<stream:stream iq = '2\"";
-    ASSERT_STREQ(regex_->TagStr(2), match);
-
-    regex_->SetString(str);
-    regex_->SetRegex(rXMPP_STREAM_START);
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "<?xml version='1.0'?><stream:stream");
-
-    str = "<iq a = '2'> <item> blah blah </item></iq>";
-    regex_->SetString(str);
-    regex_->SetRegex(rXMPP_MESSAGE);
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "<iq");
-
-    str = "<message a = '2'> <item> blah blah </item></message>";
-    regex_->SetString(str);
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "<message");
-
-    //partial match
-    str = "<message a = '2'> <item> blah blah </item></mess";
-    regex_->SetString(str);
-    regex_->SetRegex("</(iq|message)>");
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 1);
-    ASSERT_STREQ(regex_->TagStr(0), "</mess");
-    ASSERT_STREQ(regex_->FromOffset(), "</mess");
-
-    str = "age><iq a = '2'> <item>";
-    regex_->AppendString(str);
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "</message>");
-
-    // no match
-    str = "<message a = '2'> ";
-    regex_->SetString(str);
-    regex_->SetRegex(rXMPP_MESSAGE);
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "<message");
-
-    str = "<item> blah blah ";
-    regex_->AppendString(str);
-    regex_->SetRegex("</(iq|message)>");
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == -1);
-    str = "</item></message><somejunk>";
-    regex_->AppendString(str);
-    ret = regex_->MatchTest();
-    EXPECT_TRUE(ret == 0);
-    ASSERT_STREQ(regex_->TagStr(0), "</message>");
-    ASSERT_STREQ(regex_->Buf(), "<message a = '2'> <item> blah blah </item></message>");
+    string stream;
+    for (int i = 0; i < count; i++) {
+        stream += iq;
+        if (i % 16 == 0) stream += " ";
+    }
+    int expected = count + (count + 15) / 16;
+    const size_t kChunkSize = 4096;
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(stream.data());
+
+    XmppRegexMock regex;
+    int regex_count = 0;
+    uint64_t start = UTCTimestampUsec();
+    for (size_t offset = 0; offset < stream.size(); offset += kChunkSize) {
+        regex_count += regex.Read(data + offset,
+                                  min(kChunkSize, stream.size() - offset));
+    }
+    uint64_t regex_usec = UTCTimestampUsec() - start;
+    EXPECT_EQ(expected, regex_count);
+
+    int parser_count = 0;
+    string partial;
+    start = UTCTimestampUsec();
+    for (size_t offset = 0; offset < stream.size(); offset += kChunkSize) {
+        size_t size = min(kChunkSize, stream.size() - offset);
+        size_t pos = 0;
+        while (pos < size) {
+            size_t len = parser_.Scan(data + offset + pos, size - pos,
+                                      XmppStanzaParser::STANZA);
+            if (!parser_.complete()) {
+                partial.append(stream, offset + pos, len);
+            } else {
+                partial.clear();
+                parser_count++;
+            }
+            pos += len;
+        }
+    }
+    uint64_t parser_usec = UTCTimestampUsec() - start;
+    EXPECT_EQ(expected, parser_count);
+
+    double mbytes = (double) stream.size() / (1024 * 1024);
+    cout << "messages " << count << " bytes " << stream.size() << endl;
+    cout << "regex  " << regex_usec / 1000 << " msec "
+         << (uint64_t) (mbytes * 1000000 / (regex_usec ? regex_usec : 1))
+         << " MB/s" << endl;
+    cout << "parser " << parser_usec / 1000 << " msec "
+         << (uint64_t) (mbytes * 1000000 / (parser_usec ? parser_usec : 1))
+         << " MB/s" << endl;
 }
 
 }
@@ -54,10 +54,12 @@ class XmppMockConnection : public XmppClientConnection {
 public:
     XmppMockConnection(TcpServer *server, const XmppChannelConfig *config)
         : XmppClientConnection(server, config), byte_count(0), msg_count(0) {}
-    virtual void ReceiveMsg(XmppSession *session, const string &str) {
-        byte_count += str.size();
+    virtual void ReceiveMsg(XmppSession *session,
+                            XmppStanza::XmppMessageType type,
+                            const uint8_t *data, size_t size) {
+        byte_count += size;
         msg_count++;
-        XmppConnection::ReceiveMsg(session, str);
+        XmppConnection::ReceiveMsg(session, type, data, size);
     }
     virtual bool IsClient() const { return true; }
     void ResetStats() {
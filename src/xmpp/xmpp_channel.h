@@ -5,6 +5,8 @@
 #ifndef __XMPP_CHANNEL_INTERFACE_H__
 #define __XMPP_CHANNEL_INTERFACE_H__
 
+#include <vector>
+#include <boost/asio/buffer.hpp>
 #include <boost/function.hpp>
 #include <boost/system/error_code.hpp>
 #include "xmpp/xmpp_proto.h"
@@ -33,9 +35,24 @@ public:
     typedef boost::function<
         void(const XmppStanza::XmppMessage *, xmps::PeerState state)
         > ReceiveCb;
+    typedef std::vector<boost::asio::const_buffer> BufferList;
 
     virtual ~XmppChannel() { }
     virtual bool Send(const uint8_t *, size_t, xmps::PeerId, SendReadyCb) = 0;
+
+    // Send a message made of several buffers. The default implementation
+    // copies them into one buffer.
+    virtual bool SendBuffers(const BufferList &buffers, xmps::PeerId id,
+                             SendReadyCb cb) {
+        std::vector<uint8_t> data;
+        for (BufferList::const_iterator iter = buffers.begin();
+             iter != buffers.end(); ++iter) {
+            const uint8_t *src =
+                boost::asio::buffer_cast<const uint8_t *>(*iter);
+            data.insert(data.end(), src, src + boost::asio::buffer_size(*iter));
+        }
+        return Send(data.empty() ? NULL : &data[0], data.size(), id, cb);
+    }
     virtual void RegisterReceive(xmps::PeerId, ReceiveCb) = 0;
     virtual void UnRegisterReceive(xmps::PeerId) = 0;
     virtual std::string ToString() const = 0;
@@ -48,6 +48,18 @@ bool XmppChannelMux::Send(const uint8_t *msg, size_t msgsize,
     return res;
 }
 
+bool XmppChannelMux::SendBuffers(const BufferList &buffers, xmps::PeerId id,
+                                 SendReadyCb cb) {
+    if (!connection_) return false;
+
+    tbb::mutex::scoped_lock lock(mutex_);
+    bool res = connection_->SendBuffers(buffers);
+    if (res == false) {
+        RegisterWriteReady(id, cb);
+    }
+    return res;
+}
+
 void XmppChannelMux::RegisterReceive(xmps::PeerId id, ReceiveCb cb) {
     rxmap_.insert(make_pair(id, cb));
 }
@@ -19,6 +19,8 @@ public:
     virtual ~XmppChannelMux();
 
     virtual bool Send(const uint8_t *, size_t, xmps::PeerId, SendReadyCb);
+    virtual bool SendBuffers(const BufferList &buffers, xmps::PeerId id,
+                             SendReadyCb cb);
     virtual void RegisterReceive(xmps::PeerId, ReceiveCb);
     virtual void UnRegisterReceive(xmps::PeerId);
     size_t ReceiverCount() const;
@@ -3,6 +3,7 @@
  */
 
 #include "xmpp/xmpp_connection.h"
+#include <algorithm>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <sstream>
 
@@ -182,6 +183,56 @@ bool XmppConnection::Send(const uint8_t *data, size_t size) {
     return session_->Send(data, size, &sent);
 }
 
+static size_t BufferListSize(const TcpSession::BufferList &buffers) {
+    size_t size = 0;
+    for (TcpSession::BufferList::const_iterator iter = buffers.begin();
+         iter != buffers.end(); ++iter) {
+        size += TcpSession::BufferSize(*iter);
+    }
+    return size;
+}
+
+//
+// Build the trace for a message made of several buffers. The first buffer
+// is the prefix shared by all the peers and is left out. The trace has the
+// per-peer header that follows it and the start of the body, bounded so
+// that a large message doesn't get copied in full for every peer.
+//
+static string BufferListTrace(const TcpSession::BufferList &buffers) {
+    static const size_t kMaxTraceSize = 512;
+    string trace;
+    TcpSession::BufferList::const_iterator iter = buffers.begin();
+    if (buffers.size() > 1)
+        ++iter;
+    for (; iter != buffers.end() && trace.size() < kMaxTraceSize; ++iter) {
+        size_t size = std::min(TcpSession::BufferSize(*iter),
+                               kMaxTraceSize - trace.size());
+        trace.append(reinterpret_cast<const char *>(
+                         TcpSession::BufferData(*iter)), size);
+    }
+    return trace;
+}
+
+//
+// Send a message made of several buffers without copying them into one.
+// The trace has the size of the whole message but only the per-peer header
+// and the start of the body, see BufferListTrace.
+//
+bool XmppConnection::SendBuffers(const TcpSession::BufferList &buffers) {
+    size_t sent;
+    tbb::spin_mutex::scoped_lock lock(spin_mutex_);
+    if (session_ == NULL) {
+        return false;
+    }
+    XMPP_MESSAGE_TRACE(XmppTxStream,
+           session_->remote_endpoint().address().to_string(),
+           session_->remote_endpoint().port(), BufferListSize(buffers),
+           BufferListTrace(buffers));
+
+    stats_[1].update++;
+    return session_->SendBuffers(buffers, &sent);
+}
+
 void XmppConnection::SendOpen(TcpSession *session) {
     if (!session) return;
     XmppProto::XmppStanza::XmppStreamMessage openstream;
@@ -352,29 +403,35 @@ void XmppConnection::IncProtoStats(unsigned int type) {
     }
 }
 
-void XmppConnection::ReceiveMsg(XmppSession *session, const string &msg) {
-    XmppStanza::XmppMessage *minfo = XmppDecode(msg);
+void XmppConnection::ReceiveMsg(XmppSession *session,
+                                XmppStanza::XmppMessageType type,
+                                const uint8_t *data, size_t size) {
+    XmppStanza::XmppMessage *minfo = XmppDecode(type, data, size);
 
     if (minfo) {
-        session->IncStats((unsigned int)minfo->type, msg.size());
+        session->IncStats((unsigned int)minfo->type, size);
         if (minfo->type != XmppStanza::WHITESPACE_MESSAGE_STANZA) {
             XMPP_MESSAGE_TRACE(XmppRxStream, 
                   session->remote_endpoint().address().to_string(),
-                  session->remote_endpoint().port(), msg.size(), msg);
+                  session->remote_endpoint().port(), size,
+                  string(reinterpret_cast<const char *>(data), size));
         }   
         IncProtoStats((unsigned int)minfo->type);
         state_machine_->OnMessage(session, minfo);
     } else {
-        session->IncStats(XmppStanza::INVALID, msg.size());
+        session->IncStats(XmppStanza::INVALID, size);
         XMPP_MESSAGE_TRACE(XmppRxStream, 
              session->remote_endpoint().address().to_string(),
-             session->remote_endpoint().port(), msg.size(), msg);
+             session->remote_endpoint().port(), size,
+             string(reinterpret_cast<const char *>(data), size));
     }
     return;
 }
 
-XmppStanza::XmppMessage *XmppConnection::XmppDecode(const string &msg) {
-    auto_ptr<XmppStanza::XmppMessage> minfo(XmppProto::Decode(msg));
+XmppStanza::XmppMessage *XmppConnection::XmppDecode(
+        XmppStanza::XmppMessageType type, const uint8_t *data, size_t size) {
+    auto_ptr<XmppStanza::XmppMessage> minfo(
+        XmppProto::Decode(type, data, size));
     if (minfo.get() == NULL) {
         return NULL;
     }
@@ -40,7 +40,10 @@ public:
     void SetConfig(const XmppChannelConfig *);
     // Invoked from XmppServer when a session is accepted.
     virtual bool AcceptSession(XmppSession *session);
-    virtual void ReceiveMsg(XmppSession *session, const std::string &); 
+    // Invoked from XmppSession with each message found in the stream.
+    virtual void ReceiveMsg(XmppSession *session,
+                            XmppStanza::XmppMessageType type,
+                            const uint8_t *data, size_t size);
 
     virtual boost::asio::ip::tcp::endpoint endpoint() const;
     virtual boost::asio::ip::tcp::endpoint local_endpoint() const;
@@ -52,6 +55,7 @@ public:
     std::string FromString() const;
     void SetAdminDown(bool toggle);
     bool Send(const uint8_t *data, size_t size);
+    bool SendBuffers(const TcpSession::BufferList &buffers);
 
     // Xmpp connection messages
     void SendOpen(TcpSession *session);
@@ -176,7 +180,8 @@ private:
     bool KeepAliveTimerExpired();
     void KeepaliveTimerErrorHanlder(std::string error_name,
                                     std::string error_message);
-    XmppStanza::XmppMessage *XmppDecode(const std::string &msg);
+    XmppStanza::XmppMessage *XmppDecode(XmppStanza::XmppMessageType type,
+                                        const uint8_t *data, size_t size);
     void LogKeepAliveSend();
 
     TcpServer *server_;
@@ -3,6 +3,9 @@
  */
 
 #include "xmpp/xmpp_proto.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <boost/algorithm/string/replace.hpp>
@@ -27,6 +30,26 @@ auto_ptr<XmlBase> XmppProto::open_doc_(AllocXmppXmlImpl(sXMPP_STREAM_OPEN));
 XmppStanza::XmppStanza() {
 }
 
+//
+// Publish requests are decoded with a dom of the envelope only. Parse the
+// complete stanza the first time the items are needed, and restore the
+// publish node that may have been changed by the collection request.
+//
+XmlBase *XmppStanza::XmppMessageIq::LoadDom() const {
+    XmlBase *impl = dom.get();
+    if (!envelope_only)
+        return impl;
+
+    envelope_only = false;
+    if (impl->LoadDoc(data.data(), data.size()) == -1) {
+        XMPP_WARNING(XmppIqMessageParseFail);
+        return impl;
+    }
+    impl->ReadNode("publish");
+    impl->ModifyAttribute("node", node);
+    return impl;
+}
+
 XmppProto::XmppProto() { 
 }
 
@@ -155,12 +178,17 @@ int XmppProto::EncodeOpen(uint8_t *buf, string &to, string &from) {
     return len;
 }
 
-XmppStanza::XmppMessage *XmppProto::Decode(const string &ts) {
+XmppStanza::XmppMessage *XmppProto::Decode(XmppStanza::XmppMessageType type,
+                                           const uint8_t *data, size_t size) {
+    if (type == XmppStanza::WHITESPACE_MESSAGE_STANZA) {
+        return new XmppStanza::XmppMessage(WHITESPACE_MESSAGE_STANZA);
+    }
+
     XmlBase *impl = XmppStanza::AllocXmppXmlImpl();
     if (impl == NULL) {
         return NULL;
     }
-    XmppStanza::XmppMessage *msg = DecodeInternal(ts, impl);
+    XmppStanza::XmppMessage *msg = DecodeInternal(type, data, size, impl);
     if (!msg) return NULL;
 
     // keep the dom
@@ -169,18 +197,26 @@ XmppStanza::XmppMessage *XmppProto::Decode(const string &ts) {
     return msg;
 }
 
-XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts, 
-                                                   XmlBase *impl) {
+XmppStanza::XmppMessage *XmppProto::DecodeInternal(
+        XmppStanza::XmppMessageType type, const uint8_t *data, size_t size,
+        XmlBase *impl) {
     XmppStanza::XmppMessage *ret = NULL;
+    const char *doc = reinterpret_cast<const char *>(data);
 
     string ns(sXMPP_STREAM_O);
-    string ws(sXMPP_WHITESPACE);
     string iq(sXMPP_IQ_KEY);
 
-    if (ts.find(sXMPP_IQ) != string::npos) {
-        string ts_tmp = ts;
-
-        if (impl->LoadDoc(ts) == -1) {
+    if (type == XmppStanza::IQ_STANZA) {
+        // The items of a publish request are decoded from the copy of the
+        // stanza, only build the dom for the envelope.
+        size_t envelope = XmppProto::GetPublishEnvelopeSize(doc, size);
+        if (envelope) {
+            string tmp(doc, envelope);
+            tmp.append("</publish></pubsub></iq>");
+            if (impl->LoadDoc(tmp) == -1)
+                envelope = 0;
+        }
+        if (!envelope && impl->LoadDoc(doc, size) == -1) {
             XMPP_WARNING(XmppIqMessageParseFail);
             assert(false);
             goto done;
@@ -200,6 +236,10 @@ XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts,
         if (XmppProto::GetNode(impl, msg->action)) {
             msg->node = XmppProto::GetNode(impl, msg->action);
         }
+        if (msg->action.compare("publish") == 0) {
+            msg->data.assign(doc, size);
+            msg->envelope_only = (envelope != 0);
+        }
         //associate or dissociate collection node
         if (msg->action.compare("collection") == 0) {
             if (XmppProto::GetAsNode(impl)) {
@@ -219,8 +259,8 @@ XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts,
                    msg->from, msg->to, msg->id, msg->iq_type);
         goto done;
 
-    } else if (ts.find(sXMPP_MESSAGE) != string::npos) {
-        if (impl->LoadDoc(ts) == -1) {
+    } else if (type == XmppStanza::MESSAGE_STANZA) {
+        if (impl->LoadDoc(doc, size) == -1) {
             XMPP_WARNING(XmppChatMessageParseFail);
             goto done;
         }
@@ -235,11 +275,11 @@ XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts,
         XMPP_UTDEBUG(XmppChatMessageProcess, msg->type, msg->from, msg->to);
         goto done;
 
-    } else if (ts.find(sXMPP_STREAM_O) != string::npos) {
+    } else if (type == XmppStanza::STREAM_HEADER) {
         // check if the buf is xmpp open or response message
         // As end tag will be missing we need to modify the 
         // string for stream open, else dom decoder will fail 
-        string ts_tmp = ts;
+        string ts_tmp(doc, size);
         boost::algorithm::replace_last(ts_tmp, ">", "/>");
 
         if (impl->LoadDoc(ts_tmp) == -1) {
@@ -257,11 +297,6 @@ XmppStanza::XmppMessage *XmppProto::DecodeInternal(const string &ts,
         ret = strm;
 
         XMPP_UTDEBUG(XmppRxOpenMessage, strm->from, strm->to);
-
-    } else if (ts.find_first_of(sXMPP_VALIDWS) != string::npos) {
-        XmppStanza::XmppMessage *msg = 
-            new XmppStanza::XmppMessage(WHITESPACE_MESSAGE_STANZA);
-        return msg;
     }
 
 done:
@@ -358,3 +393,52 @@ const char *XmppProto::GetDsNode(XmlBase *doc) {
 
     return(NULL);
 }
+
+static bool MatchTag(const char *pos, const char *end, const char *name) {
+    size_t len = strlen(name);
+    if ((size_t) (end - pos) <= len || strncmp(pos, name, len) != 0)
+        return false;
+    return (isspace(pos[len]) || pos[len] == '>' || pos[len] == '/');
+}
+
+// Return the '>' that ends the start tag at pos, or NULL.
+static const char *SkipStartTag(const char *pos, const char *end) {
+    char quote = 0;
+    for (; pos != end; ++pos) {
+        if (quote) {
+            if (*pos == quote)
+                quote = 0;
+        } else if (*pos == '"' || *pos == '\'') {
+            quote = *pos;
+        } else if (*pos == '>') {
+            return pos;
+        }
+    }
+    return NULL;
+}
+
+//
+// Return the size of the envelope of a publish request, up to and including
+// the start tag of the publish element, or 0 if the stanza doesn't look like
+// a publish request with items. The envelope is parsed by the dom, which
+// catches anything this doesn't check.
+//
+size_t XmppProto::GetPublishEnvelopeSize(const char *doc, size_t size) {
+    static const char kPubSub[] = "<pubsub";
+    const char *end = doc + size;
+    const char *pos = std::search(doc, end, kPubSub,
+                                  kPubSub + sizeof(kPubSub) - 1);
+    if (pos == end || !MatchTag(pos, end, kPubSub))
+        return 0;
+    pos = SkipStartTag(pos, end);
+    if (pos == NULL || pos[-1] == '/')
+        return 0;
+    for (++pos; pos != end && isspace(*pos); ++pos) {
+    }
+    if (!MatchTag(pos, end, "<publish"))
+        return 0;
+    pos = SkipStartTag(pos, end);
+    if (pos == NULL || pos[-1] == '/')
+        return 0;
+    return pos + 1 - doc;
+}
@@ -124,7 +124,7 @@ public:
     };
 
     struct XmppMessageIq : public XmppMessage {
-        XmppMessageIq() : XmppMessage(IQ_STANZA) {
+        XmppMessageIq() : XmppMessage(IQ_STANZA), envelope_only(false) {
         }
         enum XmppIqSubtype {
             GET = 1,
@@ -144,6 +144,16 @@ public:
         std::string action;
         std::string as_node;
         bool is_as_node;
+
+        // Copy of the stanza, kept for publish requests so that the items
+        // can be decoded without going through the dom. The dom of such a
+        // request only holds the envelope, up to the publish element, until
+        // LoadDom() parses the complete stanza.
+        std::string data;
+        mutable bool envelope_only;
+
+        // Return the dom of the complete stanza.
+        XmlBase *LoadDom() const;
     };
 
     XmppStanza();
@@ -162,7 +172,9 @@ private:
 class XmppProto : public XmppStanza {
 public:
 
-    static XmppStanza::XmppMessage *Decode(const std::string &ts);
+    // Decode a message whose type was determined by XmppStanzaParser.
+    static XmppStanza::XmppMessage *Decode(XmppStanza::XmppMessageType type,
+                                           const uint8_t *data, size_t size);
     static int EncodeStream(const XmppStreamMessage &str, std::string &to, 
                             std::string &from, uint8_t *data, size_t size);
     static int EncodeStream(const XmppMessage &str, uint8_t *data, size_t size);
@@ -187,9 +199,11 @@ private:
     static const char *GetNode(XmlBase *doc, const std::string &str);
     static const char *GetAsNode(XmlBase *doc);
     static const char *GetDsNode(XmlBase *doc);
+    static size_t GetPublishEnvelopeSize(const char *doc, size_t size);
 
-    static XmppStanza::XmppMessage *DecodeInternal(const std::string &ts,
-                                                   XmlBase *impl); 
+    static XmppStanza::XmppMessage *DecodeInternal(
+        XmppStanza::XmppMessageType type, const uint8_t *data, size_t size,
+        XmlBase *impl);
 
     static std::auto_ptr<XmlBase> open_doc_;
 
@@ -6,14 +6,13 @@
 #define __XMPP_SESSION_H__
 
 #include <string>
-#include <boost/regex.hpp>
 #include "io/tcp_server.h"
 #include "io/tcp_session.h"
+#include "xmpp/xmpp_stanza_parser.h"
 
 class XmppStream;
 class XmppServer;
 class XmppConnection;
-class XmppRegexMock;
 
 class XmppSession : public TcpSession {
 public:
@@ -34,37 +33,21 @@ public:
     void IncStats(unsigned int message_type, uint64_t bytes);
 
     static const int kMaxMessageSize = 4096;
-    friend class XmppRegexMock;
-   
+
 protected:
     std::string jid;
     virtual void OnRead(Buffer buffer);
     
 private:
-    typedef std::deque<Buffer> BufferQueue;
-
-    boost::regex tag_to_pattern(const char *); 
-    int MatchRegex(const boost::regex &patt);
-    bool Match(Buffer buffer, int *result, bool NewBuf);
-    void SetBuf(const std::string &);
-    void ReplaceBuf(const std::string &);
-    bool LeftOver() const;
+    XmppStanzaParser::Mode ParserMode() const;
 
     XmppConnection *connection_;
-    BufferQueue queue_;
     XmppStream *stream_;
-    std::string begin_tag_;
-    std::string buf_;
-    std::string::const_iterator offset_;
-    int tag_known_;
-    boost::match_results<std::string::const_iterator> res_;
+    XmppStanzaParser parser_;
+    // Beginning of a message that spans receive buffers.
+    std::string partial_;
     std::vector<StatsPair> stats_; // packet count
 
-    static const boost::regex patt_;
-    static const boost::regex stream_patt_;
-    static const boost::regex stream_res_end_;
-    static const boost::regex whitespace_;
-
     DISALLOW_COPY_AND_ASSIGN(XmppSession);
 };
 
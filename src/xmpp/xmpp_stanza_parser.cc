@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#include "xmpp/xmpp_stanza_parser.h"
+
+#include <string.h>
+
+#include "xmpp/xmpp_str.h"
+
+static inline bool IsStreamWhitespace(uint8_t c) {
+    return memchr(sXMPP_VALIDWS, c, sizeof(sXMPP_VALIDWS) - 1) != NULL;
+}
+
+static inline bool IsSpace(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline uint16_t Tail(uint8_t c1, uint8_t c2) {
+    return (c1 << 8) | c2;
+}
+
+XmppStanzaParser::XmppStanzaParser() {
+    Reset();
+}
+
+void XmppStanzaParser::Reset() {
+    state_ = START;
+    mode_ = STANZA;
+    type_ = XmppStanza::INVALID;
+    depth_ = 0;
+    in_name_ = false;
+    slash_ = false;
+    quote_ = 0;
+    tail_ = 0;
+    name_len_ = 0;
+}
+
+void XmppStanzaParser::AppendName(uint8_t c) {
+    if (depth_ != 0)
+        return;
+    if (name_len_ < kMaxNameLen)
+        name_[name_len_] = c;
+    if (name_len_ <= kMaxNameLen)
+        name_len_++;
+}
+
+bool XmppStanzaParser::NameIs(const char *name) const {
+    size_t len = strlen(name);
+    return name_len_ == len && memcmp(name_, name, len) == 0;
+}
+
+void XmppStanzaParser::Complete(XmppStanza::XmppMessageType type) {
+    state_ = DONE;
+    type_ = type;
+}
+
+//
+// Called at the '>' of a start tag. Returns true if the message is complete.
+//
+bool XmppStanzaParser::EndStartTag(bool empty) {
+    state_ = TEXT;
+    if (mode_ == STREAM_HEADER) {
+        Complete(NameIs(sXMPP_STREAM_O) ?
+                 XmppStanza::STREAM_HEADER : XmppStanza::INVALID);
+        return true;
+    }
+
+    if (depth_ == 0) {
+        if (NameIs(sXMPP_IQ_KEY)) {
+            type_ = XmppStanza::IQ_STANZA;
+        } else if (NameIs(sXMPP_MESSAGE_KEY)) {
+            type_ = XmppStanza::MESSAGE_STANZA;
+        } else {
+            type_ = XmppStanza::INVALID;
+        }
+        if (empty) {
+            Complete(type_);
+            return true;
+        }
+    }
+    if (!empty)
+        depth_++;
+    return false;
+}
+
+//
+// Called at the '>' of an end tag. Returns true if the message is complete.
+// An end tag without a matching start tag, e.g. the end of the stream, is
+// an invalid message by itself.
+//
+bool XmppStanzaParser::EndEndTag() {
+    state_ = TEXT;
+    if (depth_ == 0) {
+        Complete(XmppStanza::INVALID);
+        return true;
+    }
+    if (--depth_ == 0) {
+        Complete(type_);
+        return true;
+    }
+    return false;
+}
+
+size_t XmppStanzaParser::Scan(const uint8_t *data, size_t size, Mode mode) {
+    if (state_ == DONE)
+        Reset();
+    if (size == 0)
+        return 0;
+
+    if (state_ == START) {
+        mode_ = mode;
+        state_ = IsStreamWhitespace(data[0]) ? WHITESPACE : TEXT;
+    }
+
+    const uint8_t *p = data;
+    const uint8_t *end = data + size;
+    while (p < end) {
+        uint8_t c = *p++;
+        switch (state_) {
+        case WHITESPACE:
+            if (!IsStreamWhitespace(c)) {
+                Complete(XmppStanza::WHITESPACE_MESSAGE_STANZA);
+                return p - 1 - data;
+            }
+            break;
+
+        case TEXT:
+            // Skip to the next markup.
+            if (c != '<') {
+                p = static_cast<const uint8_t *>(memchr(p, '<', end - p));
+                if (p == NULL) {
+                    p = end;
+                    break;
+                }
+                p++;
+            }
+            state_ = TAG_OPEN;
+            break;
+
+        case TAG_OPEN:
+            if (c == '/') {
+                state_ = END_TAG;
+            } else if (c == '?') {
+                state_ = PROC_INST;
+                tail_ = 0;
+            } else if (c == '!') {
+                state_ = MARKUP_DECL;
+                in_name_ = true;
+            } else {
+                state_ = START_TAG;
+                in_name_ = true;
+                slash_ = false;
+                quote_ = 0;
+                if (depth_ == 0)
+                    name_len_ = 0;
+                AppendName(c);
+            }
+            break;
+
+        case START_TAG:
+            if (quote_) {
+                // Skip to the end of the attribute value.
+                if (c != quote_) {
+                    p = static_cast<const uint8_t *>(
+                        memchr(p, quote_, end - p));
+                    if (p == NULL) {
+                        p = end;
+                        break;
+                    }
+                    p++;
+                }
+                quote_ = 0;
+                break;
+            }
+            if (c == '>') {
+                if (EndStartTag(slash_))
+                    return p - data;
+                break;
+            }
+            slash_ = (c == '/');
+            if (c == '"' || c == '\'') {
+                quote_ = c;
+                in_name_ = false;
+            } else if (in_name_) {
+                if (IsSpace(c) || slash_) {
+                    in_name_ = false;
+                } else {
+                    AppendName(c);
+                }
+            }
+            break;
+
+        case END_TAG:
+            if (c == '>' && EndEndTag())
+                return p - data;
+            break;
+
+        case PROC_INST:
+            if (c == '>' && (tail_ & 0xff) == '?')
+                state_ = TEXT;
+            tail_ = (tail_ << 8) | c;
+            break;
+
+        case MARKUP_DECL:
+            if (in_name_) {
+                in_name_ = false;
+                tail_ = 0;
+                if (c == '-') {
+                    state_ = COMMENT;
+                } else if (c == '[') {
+                    state_ = CDATA;
+                } else if (c == '>') {
+                    state_ = TEXT;
+                }
+            } else if (c == '>') {
+                state_ = TEXT;
+            }
+            break;
+
+        case COMMENT:
+            if (c == '>' && tail_ == Tail('-', '-'))
+                state_ = TEXT;
+            tail_ = (tail_ << 8) | c;
+            break;
+
+        case CDATA:
+            if (c == '>' && tail_ == Tail(']', ']'))
+                state_ = TEXT;
+            tail_ = (tail_ << 8) | c;
+            break;
+
+        case START:
+        case DONE:
+            assert(false);
+            break;
+        }
+    }
+
+    // A run of whitespace ends with the data.
+    if (state_ == WHITESPACE)
+        Complete(XmppStanza::WHITESPACE_MESSAGE_STANZA);
+    return size;
+}
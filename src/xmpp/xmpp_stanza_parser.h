@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2013 Juniper Networks, Inc. All rights reserved.
+ */
+
+#ifndef __XMPP_STANZA_PARSER_H__
+#define __XMPP_STANZA_PARSER_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "base/util.h"
+#include "xmpp/xmpp_proto.h"
+
+//
+// Incremental tokenizer that finds the boundaries of the messages in an
+// XMPP stream. Data is scanned as it is received, one buffer at a time,
+// without being copied, and the scan resumes where it left off when a
+// message spans buffers.
+//
+// A run of whitespace between messages is a message of its own. Other
+// messages are delimited by the XML markup: in STREAM_HEADER mode a message
+// ends with the first start tag, which is the stream header, and in STANZA
+// mode it ends with the end of the first top level element. The type of
+// the message is derived from the name of that element.
+//
+class XmppStanzaParser {
+public:
+    enum Mode {
+        STREAM_HEADER,
+        STANZA
+    };
+
+    XmppStanzaParser();
+
+    // Scan the data, continuing the message that the previous call left
+    // incomplete if any. Returns the number of bytes consumed: either up to
+    // and including the end of a message, or all of the data if the message
+    // isn't complete yet. The mode is latched at the start of each message.
+    size_t Scan(const uint8_t *data, size_t size, Mode mode);
+
+    // Whether the last call to Scan completed a message.
+    bool complete() const { return state_ == DONE; }
+
+    // Type of the completed message.
+    XmppStanza::XmppMessageType type() const { return type_; }
+
+    void Reset();
+
+private:
+    enum State {
+        START,
+        WHITESPACE,
+        TEXT,
+        TAG_OPEN,
+        START_TAG,
+        END_TAG,
+        PROC_INST,
+        MARKUP_DECL,
+        COMMENT,
+        CDATA,
+        DONE
+    };
+
+    static const size_t kMaxNameLen = 16;
+
+    void AppendName(uint8_t c);
+    bool NameIs(const char *name) const;
+    bool EndStartTag(bool empty);
+    bool EndEndTag();
+    void Complete(XmppStanza::XmppMessageType type);
+
+    State state_;
+    Mode mode_;
+    XmppStanza::XmppMessageType type_;
+    int depth_;
+
+    // State within the current markup.
+    bool in_name_;
+    bool slash_;
+    uint8_t quote_;
+    uint16_t tail_;
+
+    // Name of the top level element.
+    char name_[kMaxNameLen];
+    size_t name_len_;
+
+    DISALLOW_COPY_AND_ASSIGN(XmppStanzaParser);
+};
+
+#endif // __XMPP_STANZA_PARSER_H__